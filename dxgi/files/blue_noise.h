@@ -0,0 +1,108 @@
+// Blue-noise threshold map (void-and-cluster)
+//
+// Ulichney's void-and-cluster method on a toroidal grid: every cell gets a
+// rank 0..size^2-1 so that the cells ranked below any threshold form an
+// evenly spread, low-frequency-free pattern, and the pattern tiles without
+// seams. The render path dithers with it (g_PixelShaderHDR); the table it
+// uses is generated once by blue-noise-gen into blue_noise_64.h.
+//
+// Portable C++17.
+
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+#include <random>
+#include <vector>
+
+// Gaussian energy of a binary pattern, kept up to date as cells flip
+class BlueNoiseEnergy {
+public:
+    BlueNoiseEnergy(int size, float sigma) : n(size), kernel(size * size), energy(size * size, 0.0f) {
+        for (int y = 0; y < n; y++) {
+            for (int x = 0; x < n; x++) {
+                int dx = x <= n / 2 ? x : n - x;    // Toroidal distance
+                int dy = y <= n / 2 ? y : n - y;
+                kernel[y * n + x] = expf(-(float)(dx * dx + dy * dy) / (2.0f * sigma * sigma));
+            }
+        }
+    }
+
+    void Flip(int cell, bool set) {
+        float sign = set ? 1.0f : -1.0f;
+        int cx = cell % n, cy = cell / n;
+        for (int y = 0; y < n; y++) {
+            const float* k = &kernel[((y - cy + n) % n) * n];
+            float* e = &energy[y * n];
+            for (int x = 0; x < n; x++) e[x] += sign * k[(x - cx + n) % n];
+        }
+    }
+
+    // Tightest cluster: the set cell with the most energy
+    int TightestCluster(const std::vector<uint8_t>& pattern) const { return Extreme(pattern, 1, true); }
+    // Largest void: the empty cell with the least energy
+    int LargestVoid(const std::vector<uint8_t>& pattern) const { return Extreme(pattern, 0, false); }
+
+private:
+    int Extreme(const std::vector<uint8_t>& pattern, uint8_t value, bool max) const {
+        int best = -1;
+        for (int i = 0; i < n * n; i++) {
+            if (pattern[i] != value) continue;
+            if (best < 0 || (max ? energy[i] > energy[best] : energy[i] < energy[best])) best = i;
+        }
+        return best;
+    }
+
+    int n;
+    std::vector<float> kernel;
+    std::vector<float> energy;
+};
+
+// Ranks for a size x size tile (row-major). Deterministic for a given seed.
+inline void GenerateBlueNoise(int size, std::vector<uint16_t>* ranks, float sigma = 1.5f, uint32_t seed = 1) {
+    const int cells = size * size;
+    ranks->assign(cells, 0);
+
+    // Initial pattern: ~10% random cells, then move the tightest cluster into
+    // the largest void until that stops changing anything
+    std::vector<uint8_t> pattern(cells, 0);
+    BlueNoiseEnergy energy(size, sigma);
+    std::mt19937 rng(seed);
+    int ones = cells / 10;
+    for (int placed = 0; placed < ones;) {
+        int cell = (int)(rng() % (uint32_t)cells);
+        if (pattern[cell]) continue;
+        pattern[cell] = 1;
+        energy.Flip(cell, true);
+        placed++;
+    }
+    for (;;) {
+        int cluster = energy.TightestCluster(pattern);
+        if (cluster < 0) break;
+        pattern[cluster] = 0;
+        energy.Flip(cluster, false);
+        int hole = energy.LargestVoid(pattern);
+        pattern[hole] = 1;
+        energy.Flip(hole, true);
+        if (hole == cluster) break;
+    }
+
+    // Phase 1: rank the initial cells by removing tightest clusters
+    std::vector<uint8_t> work = pattern;
+    BlueNoiseEnergy phase1 = energy;
+    for (int rank = ones - 1; rank >= 0; rank--) {
+        int cluster = phase1.TightestCluster(work);
+        work[cluster] = 0;
+        phase1.Flip(cluster, false);
+        (*ranks)[cluster] = (uint16_t)rank;
+    }
+
+    // Phases 2 and 3: fill the largest void until every cell is set. (Phase 3's
+    // tightest cluster of empty cells is the same cell as the largest void.)
+    for (int rank = ones; rank < cells; rank++) {
+        int hole = energy.LargestVoid(pattern);
+        pattern[hole] = 1;
+        energy.Flip(hole, true);
+        (*ranks)[hole] = (uint16_t)rank;
+    }
+}
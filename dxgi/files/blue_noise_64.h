@@ -0,0 +1,76 @@
+// Generated by blue-noise-gen --size 64 --sigma 1.5. Do not edit.
+//
+// 64x64 void-and-cluster threshold map, rank * 256 / 4096, row-major.
+
+#pragma once
+
+#include <stdint.h>
+
+const int kBlueNoiseSize = 64;
+
+const uint8_t kBlueNoise[64 * 64] = {
+    229, 152, 214, 172, 139, 118, 38, 142, 57, 80, 137, 191, 120, 223, 149, 22, 194, 42, 70, 130, 222, 191, 62, 139, 83, 186, 31, 56, 152, 26, 247, 173, 227, 137, 69, 206, 147, 194, 244, 46, 76, 213, 144, 68, 201, 152, 58, 186, 27, 222, 67, 10, 213, 52, 100, 151, 40, 239, 181, 3, 151, 89, 241, 9,
+    65, 195, 112, 31, 75, 224, 194, 88, 215, 16, 175, 95, 52, 0, 90, 180, 136, 99, 210, 172, 27, 112, 161, 214, 49, 130, 232, 92, 214, 191, 46, 119, 2, 189, 30, 109, 10, 60, 179, 136, 161, 232, 36, 125, 94, 11, 167, 83, 111, 133, 174, 234, 141, 178, 253, 72, 168, 104, 78, 134, 220, 25, 168, 124,
+    178, 18, 85, 248, 185, 10, 103, 244, 152, 114, 230, 33, 246, 172, 210, 61, 249, 6, 153, 56, 243, 77, 3, 254, 23, 201, 158, 6, 69, 108, 165, 82, 237, 56, 160, 254, 125, 224, 82, 117, 1, 59, 173, 192, 236, 47, 215, 254, 3, 204, 49, 104, 76, 31, 130, 16, 223, 198, 30, 248, 110, 49, 204, 101,
+    42, 236, 131, 45, 146, 62, 174, 25, 48, 187, 68, 158, 135, 79, 122, 34, 111, 225, 86, 123, 196, 145, 95, 177, 115, 66, 103, 179, 251, 136, 17, 206, 147, 96, 214, 77, 41, 168, 28, 249, 202, 106, 84, 23, 147, 105, 131, 65, 191, 90, 245, 18, 156, 210, 190, 89, 53, 120, 160, 59, 191, 156, 73, 219,
+    149, 99, 199, 166, 222, 117, 211, 134, 79, 208, 9, 102, 217, 17, 232, 166, 199, 50, 184, 15, 39, 224, 52, 208, 150, 236, 43, 128, 32, 219, 57, 183, 36, 127, 13, 196, 148, 216, 98, 184, 42, 153, 242, 212, 70, 181, 16, 159, 41, 143, 169, 121, 225, 58, 110, 241, 144, 7, 211, 96, 17, 233, 129, 0,
+    175, 63, 23, 79, 15, 91, 41, 239, 168, 121, 254, 38, 195, 53, 150, 73, 22, 138, 157, 236, 108, 170, 133, 30, 85, 10, 215, 189, 82, 150, 98, 233, 74, 246, 171, 103, 63, 6, 137, 69, 228, 130, 14, 119, 40, 238, 208, 97, 226, 72, 29, 195, 83, 1, 172, 36, 183, 230, 72, 178, 141, 37, 89, 251,
+    112, 206, 231, 128, 252, 191, 147, 7, 95, 56, 142, 170, 116, 88, 188, 244, 101, 213, 79, 57, 201, 20, 74, 248, 179, 101, 162, 63, 242, 7, 168, 118, 22, 144, 51, 229, 119, 238, 164, 19, 90, 179, 61, 196, 169, 85, 124, 25, 188, 113, 237, 47, 140, 251, 153, 69, 99, 126, 43, 242, 115, 213, 188, 54,
+    136, 37, 154, 105, 54, 172, 72, 228, 203, 19, 223, 74, 239, 3, 132, 42, 123, 10, 250, 131, 95, 231, 155, 120, 57, 225, 126, 22, 113, 196, 42, 223, 204, 178, 87, 27, 182, 40, 195, 106, 214, 33, 248, 102, 4, 146, 58, 245, 136, 5, 178, 95, 210, 117, 26, 224, 202, 22, 166, 83, 9, 64, 165, 25,
+    216, 71, 186, 4, 214, 135, 26, 116, 159, 186, 105, 26, 205, 161, 217, 66, 174, 192, 37, 166, 0, 188, 41, 206, 14, 192, 45, 153, 212, 88, 141, 60, 106, 0, 131, 212, 150, 78, 247, 52, 157, 133, 75, 161, 234, 200, 33, 173, 80, 207, 63, 159, 13, 74, 193, 134, 58, 249, 143, 193, 222, 151, 102, 240,
+    10, 171, 92, 244, 38, 95, 238, 51, 80, 132, 45, 149, 57, 94, 31, 143, 224, 87, 115, 227, 72, 143, 110, 87, 238, 134, 94, 254, 70, 174, 25, 243, 79, 193, 253, 54, 98, 14, 138, 115, 226, 10, 209, 44, 115, 71, 221, 98, 151, 41, 226, 127, 243, 106, 38, 174, 87, 4, 104, 45, 128, 20, 198, 83,
+    116, 230, 133, 62, 202, 153, 180, 209, 0, 249, 195, 231, 122, 191, 252, 108, 14, 57, 152, 204, 46, 243, 28, 159, 64, 172, 32, 187, 4, 227, 117, 165, 147, 39, 112, 167, 228, 200, 176, 26, 83, 191, 97, 142, 23, 186, 132, 9, 255, 115, 19, 175, 55, 215, 157, 234, 118, 210, 182, 231, 78, 255, 56, 143,
+    205, 51, 17, 166, 112, 12, 67, 124, 101, 167, 20, 84, 171, 7, 72, 158, 233, 196, 26, 98, 175, 122, 216, 194, 8, 229, 118, 55, 136, 100, 45, 214, 17, 221, 71, 9, 125, 45, 68, 234, 163, 56, 252, 178, 228, 89, 46, 203, 165, 74, 198, 91, 147, 25, 82, 13, 49, 152, 63, 26, 114, 156, 185, 35,
+    162, 103, 237, 189, 84, 255, 142, 230, 38, 217, 65, 112, 39, 214, 129, 47, 181, 78, 135, 253, 6, 83, 54, 135, 105, 75, 210, 163, 244, 199, 67, 183, 93, 136, 190, 237, 88, 153, 207, 104, 132, 33, 123, 1, 62, 157, 235, 107, 58, 135, 240, 39, 191, 125, 248, 179, 131, 223, 97, 171, 205, 1, 93, 224,
+    22, 78, 140, 31, 217, 53, 24, 192, 89, 154, 133, 245, 184, 147, 241, 99, 29, 114, 207, 62, 164, 229, 183, 20, 249, 146, 26, 88, 11, 151, 30, 126, 250, 53, 156, 35, 181, 24, 247, 9, 189, 215, 81, 167, 212, 121, 15, 185, 30, 219, 11, 110, 225, 58, 103, 200, 72, 19, 247, 42, 134, 237, 67, 129,
+    250, 197, 56, 157, 122, 175, 106, 161, 58, 9, 198, 26, 94, 64, 11, 204, 171, 237, 14, 144, 110, 34, 150, 89, 203, 42, 188, 225, 114, 76, 235, 172, 4, 82, 117, 205, 101, 140, 61, 86, 149, 50, 244, 102, 31, 78, 150, 245, 93, 174, 153, 76, 170, 1, 158, 34, 216, 110, 188, 77, 163, 108, 49, 181,
+    8, 116, 212, 90, 2, 228, 73, 205, 248, 117, 220, 167, 49, 227, 120, 75, 150, 53, 91, 223, 190, 59, 240, 117, 64, 161, 128, 57, 169, 211, 42, 108, 198, 222, 21, 243, 48, 220, 173, 113, 230, 21, 183, 139, 200, 226, 43, 132, 64, 208, 47, 129, 202, 235, 90, 134, 169, 56, 145, 12, 213, 30, 223, 152,
+    98, 171, 37, 246, 187, 44, 129, 15, 141, 43, 77, 105, 142, 196, 165, 38, 216, 129, 179, 22, 82, 208, 12, 174, 218, 0, 100, 252, 17, 134, 86, 160, 61, 139, 170, 68, 127, 2, 199, 36, 165, 71, 116, 7, 59, 170, 100, 193, 6, 115, 250, 24, 99, 37, 65, 252, 9, 225, 119, 242, 89, 194, 123, 75,
+    53, 224, 135, 68, 146, 100, 241, 184, 92, 234, 175, 4, 255, 23, 85, 241, 1, 101, 249, 46, 161, 135, 104, 40, 141, 234, 74, 201, 38, 189, 229, 13, 246, 34, 95, 192, 157, 80, 250, 137, 93, 210, 240, 162, 88, 251, 21, 153, 232, 82, 186, 146, 221, 193, 155, 106, 198, 84, 32, 177, 47, 158, 22, 240,
+    182, 26, 109, 12, 203, 166, 25, 63, 155, 32, 121, 211, 70, 133, 108, 175, 143, 70, 195, 121, 230, 66, 252, 193, 85, 29, 179, 145, 118, 70, 148, 101, 186, 120, 218, 15, 233, 108, 59, 17, 192, 53, 29, 130, 205, 37, 120, 215, 46, 166, 14, 72, 51, 124, 20, 180, 47, 149, 205, 103, 131, 68, 211, 141,
+    85, 206, 153, 232, 84, 48, 216, 115, 199, 226, 55, 190, 159, 36, 220, 56, 208, 33, 154, 10, 98, 27, 169, 54, 124, 209, 105, 51, 242, 25, 211, 45, 157, 77, 56, 135, 42, 207, 183, 120, 234, 149, 106, 227, 64, 146, 182, 69, 96, 135, 238, 108, 176, 245, 79, 230, 128, 71, 233, 2, 255, 169, 13, 112,
+    243, 59, 173, 35, 124, 238, 140, 88, 19, 78, 145, 14, 89, 233, 185, 16, 119, 236, 84, 218, 179, 205, 142, 6, 243, 153, 19, 221, 160, 95, 128, 239, 1, 204, 255, 176, 84, 145, 32, 161, 76, 4, 180, 83, 15, 195, 108, 1, 230, 191, 27, 207, 153, 3, 101, 35, 214, 19, 163, 56, 188, 81, 228, 43,
+    127, 3, 96, 197, 70, 178, 6, 164, 251, 177, 103, 241, 118, 62, 140, 98, 164, 189, 51, 131, 35, 69, 114, 219, 95, 62, 174, 80, 7, 201, 60, 172, 89, 144, 24, 101, 220, 7, 246, 98, 213, 46, 253, 158, 216, 48, 247, 163, 38, 116, 62, 87, 45, 218, 143, 171, 111, 192, 138, 97, 123, 27, 151, 192,
+    163, 221, 143, 253, 23, 105, 209, 58, 119, 31, 202, 45, 214, 171, 27, 252, 75, 11, 112, 247, 155, 230, 82, 165, 38, 197, 123, 253, 110, 181, 30, 223, 116, 53, 194, 124, 66, 168, 115, 60, 185, 141, 112, 30, 125, 89, 137, 73, 221, 146, 171, 251, 130, 193, 67, 242, 48, 85, 247, 37, 203, 219, 102, 65,
+    33, 79, 113, 50, 158, 228, 40, 137, 220, 72, 160, 132, 6, 82, 198, 48, 216, 144, 206, 92, 3, 50, 182, 17, 135, 233, 26, 54, 210, 140, 75, 154, 16, 236, 162, 39, 240, 199, 36, 228, 20, 91, 199, 67, 177, 232, 19, 206, 95, 23, 198, 8, 110, 31, 95, 13, 157, 209, 6, 176, 71, 141, 12, 248,
+    174, 210, 15, 188, 126, 80, 201, 93, 180, 11, 246, 95, 152, 237, 127, 107, 160, 35, 65, 170, 197, 123, 241, 209, 107, 74, 146, 167, 89, 42, 247, 187, 97, 212, 76, 136, 12, 88, 149, 124, 165, 222, 42, 244, 6, 149, 59, 183, 127, 52, 230, 71, 159, 236, 178, 221, 132, 61, 114, 151, 238, 49, 184, 120,
+    55, 146, 232, 67, 244, 1, 151, 27, 233, 112, 50, 196, 32, 60, 185, 18, 239, 87, 222, 22, 140, 100, 61, 150, 43, 179, 221, 25, 235, 132, 6, 119, 58, 28, 178, 109, 219, 187, 68, 249, 1, 76, 120, 157, 95, 195, 114, 34, 248, 163, 104, 139, 212, 53, 120, 75, 28, 186, 224, 80, 18, 98, 229, 83,
+    203, 107, 90, 37, 172, 111, 185, 66, 130, 167, 78, 220, 176, 101, 227, 73, 136, 178, 118, 253, 40, 204, 13, 86, 250, 4, 95, 118, 197, 71, 166, 224, 200, 148, 243, 48, 159, 27, 104, 49, 190, 137, 209, 27, 219, 74, 228, 143, 84, 13, 190, 38, 86, 19, 205, 147, 245, 102, 40, 164, 124, 193, 138, 4,
+    239, 26, 160, 222, 138, 52, 212, 252, 40, 204, 14, 117, 140, 0, 157, 43, 202, 12, 54, 153, 75, 177, 232, 159, 190, 129, 211, 60, 17, 181, 103, 31, 85, 127, 3, 96, 232, 133, 213, 169, 234, 90, 56, 178, 111, 47, 10, 180, 209, 64, 223, 115, 254, 167, 98, 42, 173, 9, 203, 250, 56, 217, 36, 170,
+    51, 186, 124, 16, 201, 83, 11, 102, 146, 88, 230, 58, 251, 83, 212, 126, 246, 93, 193, 107, 211, 125, 32, 105, 69, 46, 155, 246, 141, 230, 48, 157, 253, 68, 208, 186, 60, 80, 9, 115, 32, 156, 13, 255, 141, 169, 240, 92, 122, 30, 173, 146, 0, 196, 65, 233, 125, 87, 143, 108, 24, 152, 73, 116,
+    137, 81, 231, 63, 105, 156, 226, 171, 28, 184, 130, 161, 41, 187, 27, 103, 65, 162, 34, 234, 2, 58, 143, 216, 15, 202, 89, 32, 109, 76, 192, 135, 15, 169, 113, 23, 154, 251, 197, 144, 70, 217, 99, 198, 69, 21, 133, 55, 159, 245, 75, 48, 227, 109, 157, 18, 210, 47, 189, 67, 234, 177, 94, 254,
+    7, 208, 40, 174, 249, 35, 127, 51, 241, 71, 21, 208, 107, 148, 229, 173, 7, 219, 141, 79, 171, 248, 87, 163, 238, 135, 176, 219, 164, 1, 210, 93, 231, 44, 218, 138, 39, 173, 93, 47, 238, 181, 129, 37, 227, 107, 201, 221, 5, 105, 199, 130, 84, 34, 134, 180, 78, 242, 160, 2, 128, 210, 20, 194,
+    168, 98, 151, 118, 10, 189, 74, 209, 116, 194, 91, 236, 9, 77, 57, 137, 199, 113, 52, 189, 120, 23, 194, 43, 113, 77, 22, 57, 128, 239, 38, 120, 64, 187, 99, 78, 224, 120, 17, 207, 110, 4, 58, 161, 86, 177, 32, 79, 184, 142, 24, 213, 175, 248, 58, 219, 115, 29, 101, 222, 80, 43, 147, 63,
+    219, 28, 237, 67, 214, 139, 96, 162, 2, 149, 48, 172, 124, 202, 242, 41, 88, 255, 17, 225, 94, 153, 66, 226, 5, 186, 254, 99, 189, 73, 154, 180, 26, 147, 244, 10, 190, 62, 245, 165, 80, 149, 195, 243, 14, 143, 250, 124, 44, 237, 66, 102, 13, 144, 97, 6, 200, 147, 54, 196, 166, 103, 233, 121,
+    50, 141, 181, 88, 45, 243, 25, 227, 66, 253, 101, 216, 32, 157, 111, 21, 181, 131, 73, 166, 37, 240, 134, 102, 209, 123, 152, 41, 229, 17, 108, 246, 212, 127, 54, 163, 107, 148, 28, 127, 41, 234, 96, 121, 47, 208, 64, 161, 91, 196, 166, 228, 49, 190, 236, 168, 69, 249, 121, 17, 240, 30, 179, 85,
+    246, 111, 5, 200, 158, 114, 176, 43, 132, 185, 20, 140, 61, 87, 192, 221, 155, 48, 211, 112, 200, 11, 177, 46, 161, 30, 67, 211, 136, 170, 50, 88, 5, 76, 204, 35, 235, 79, 194, 222, 176, 21, 68, 221, 174, 111, 22, 217, 7, 114, 29, 149, 122, 73, 24, 129, 43, 182, 91, 154, 71, 136, 207, 16,
+    187, 73, 215, 131, 20, 62, 197, 90, 208, 111, 77, 226, 179, 247, 1, 69, 100, 240, 7, 141, 56, 90, 220, 77, 246, 93, 181, 12, 85, 200, 125, 227, 159, 112, 181, 131, 211, 0, 99, 51, 113, 203, 159, 8, 139, 74, 183, 241, 133, 59, 255, 85, 200, 222, 158, 94, 231, 9, 218, 40, 194, 109, 60, 160,
+    32, 150, 52, 250, 101, 224, 145, 12, 245, 35, 163, 14, 118, 49, 146, 126, 33, 170, 81, 184, 250, 155, 127, 19, 197, 133, 222, 115, 248, 61, 21, 185, 42, 255, 18, 87, 55, 171, 144, 251, 74, 133, 38, 248, 90, 202, 31, 100, 152, 211, 173, 42, 2, 109, 54, 205, 142, 77, 164, 128, 253, 3, 234, 93,
+    126, 230, 83, 174, 39, 164, 78, 122, 55, 147, 235, 197, 99, 211, 167, 235, 201, 113, 218, 39, 105, 26, 206, 61, 150, 5, 53, 169, 37, 157, 215, 99, 143, 68, 218, 149, 240, 115, 33, 187, 10, 212, 100, 180, 52, 233, 158, 48, 76, 20, 96, 231, 138, 183, 248, 32, 114, 195, 23, 98, 176, 47, 144, 217,
+    8, 194, 21, 121, 207, 4, 233, 200, 181, 91, 66, 132, 36, 76, 23, 87, 59, 15, 135, 71, 233, 179, 82, 241, 109, 188, 79, 235, 103, 137, 74, 238, 12, 177, 106, 28, 197, 70, 229, 92, 160, 235, 62, 150, 118, 1, 128, 223, 180, 198, 125, 162, 65, 90, 14, 171, 63, 242, 50, 226, 80, 118, 202, 68,
+    111, 162, 92, 237, 67, 139, 46, 100, 21, 214, 7, 177, 255, 140, 222, 181, 154, 249, 198, 162, 2, 119, 43, 160, 29, 229, 124, 23, 183, 0, 195, 51, 128, 203, 44, 163, 127, 16, 175, 50, 123, 19, 197, 29, 216, 67, 169, 106, 12, 245, 54, 29, 202, 235, 122, 152, 216, 102, 139, 187, 17, 156, 36, 180,
+    50, 254, 33, 150, 189, 109, 173, 251, 152, 125, 225, 106, 57, 193, 5, 104, 123, 32, 54, 97, 220, 145, 194, 91, 208, 64, 165, 213, 87, 251, 117, 168, 91, 229, 77, 249, 94, 219, 148, 209, 81, 143, 105, 241, 85, 184, 250, 38, 144, 83, 113, 218, 147, 46, 76, 192, 40, 0, 166, 68, 208, 244, 96, 226,
+    76, 126, 203, 59, 14, 226, 81, 27, 72, 50, 165, 29, 150, 89, 44, 241, 72, 217, 188, 130, 24, 65, 253, 12, 139, 104, 41, 134, 54, 154, 31, 211, 22, 141, 5, 185, 59, 36, 109, 3, 255, 190, 47, 162, 132, 16, 97, 59, 229, 191, 170, 4, 93, 182, 19, 253, 92, 129, 237, 109, 45, 130, 11, 146,
+    24, 178, 102, 219, 135, 41, 123, 207, 179, 243, 85, 202, 237, 126, 208, 161, 139, 11, 86, 169, 231, 109, 164, 55, 183, 244, 21, 232, 200, 72, 104, 243, 68, 191, 111, 157, 130, 238, 187, 63, 168, 24, 76, 213, 34, 196, 155, 208, 129, 25, 64, 243, 134, 225, 113, 145, 203, 55, 217, 21, 175, 86, 189, 210,
+    229, 155, 1, 73, 169, 241, 158, 96, 3, 138, 117, 15, 70, 174, 22, 59, 183, 111, 246, 45, 77, 198, 34, 122, 218, 82, 175, 116, 8, 178, 137, 44, 164, 232, 52, 218, 14, 81, 138, 226, 99, 129, 231, 112, 62, 237, 118, 6, 78, 160, 104, 200, 54, 29, 174, 64, 11, 154, 182, 76, 145, 249, 60, 114,
+    90, 55, 247, 197, 92, 18, 61, 190, 231, 44, 218, 186, 39, 109, 216, 93, 227, 35, 204, 153, 7, 133, 212, 96, 3, 142, 50, 156, 94, 226, 203, 13, 123, 88, 33, 101, 201, 167, 44, 25, 156, 203, 7, 177, 144, 84, 49, 182, 254, 215, 40, 126, 164, 83, 214, 104, 239, 87, 33, 116, 221, 4, 164, 35,
+    193, 123, 142, 43, 116, 212, 146, 35, 107, 66, 145, 94, 155, 243, 134, 1, 146, 67, 125, 97, 184, 243, 61, 170, 236, 70, 204, 254, 34, 59, 81, 155, 212, 182, 252, 143, 62, 242, 118, 214, 72, 53, 93, 244, 25, 168, 225, 106, 33, 144, 90, 230, 18, 249, 140, 41, 186, 127, 232, 200, 48, 101, 133, 240,
+    14, 176, 28, 227, 184, 80, 255, 126, 208, 171, 247, 8, 199, 79, 51, 195, 254, 172, 18, 228, 49, 87, 147, 29, 190, 126, 16, 108, 192, 129, 245, 106, 28, 73, 5, 115, 191, 20, 88, 183, 250, 135, 191, 45, 123, 206, 11, 134, 63, 175, 5, 190, 107, 69, 204, 20, 158, 60, 8, 162, 71, 179, 206, 74,
+    221, 84, 103, 156, 6, 51, 173, 12, 77, 26, 119, 57, 223, 28, 166, 114, 82, 41, 210, 156, 119, 15, 220, 112, 47, 161, 222, 75, 148, 3, 174, 51, 231, 148, 172, 225, 48, 159, 140, 0, 106, 30, 154, 220, 100, 69, 154, 199, 239, 81, 213, 150, 55, 179, 121, 94, 246, 195, 107, 139, 255, 19, 41, 148,
+    57, 201, 249, 65, 134, 234, 97, 196, 138, 232, 91, 178, 132, 103, 240, 15, 184, 137, 105, 71, 250, 168, 201, 78, 242, 92, 25, 181, 236, 40, 216, 86, 198, 121, 36, 96, 75, 202, 233, 66, 172, 209, 81, 17, 176, 248, 50, 94, 22, 122, 45, 242, 131, 10, 226, 50, 145, 80, 31, 218, 91, 127, 236, 111,
+    8, 124, 37, 168, 216, 119, 31, 162, 52, 214, 151, 39, 193, 67, 147, 205, 59, 237, 21, 188, 35, 57, 131, 5, 145, 209, 122, 50, 96, 133, 162, 110, 16, 64, 239, 209, 130, 28, 113, 42, 225, 125, 60, 235, 116, 33, 131, 227, 187, 169, 101, 29, 199, 85, 166, 206, 14, 235, 182, 52, 204, 66, 189, 167,
+    225, 151, 191, 18, 86, 202, 70, 245, 105, 15, 72, 252, 6, 220, 35, 91, 128, 164, 217, 95, 150, 224, 103, 182, 38, 65, 249, 167, 201, 70, 27, 252, 138, 187, 155, 12, 165, 254, 185, 151, 96, 9, 183, 140, 88, 197, 163, 0, 62, 145, 222, 74, 155, 254, 34, 111, 65, 130, 159, 114, 4, 144, 30, 82,
+    52, 95, 235, 111, 49, 148, 0, 132, 183, 203, 122, 165, 86, 117, 177, 231, 3, 46, 75, 123, 9, 197, 71, 231, 158, 194, 22, 109, 8, 231, 182, 53, 213, 84, 40, 108, 60, 89, 18, 76, 242, 158, 206, 49, 13, 221, 77, 112, 250, 38, 191, 8, 117, 52, 138, 190, 228, 97, 23, 247, 175, 230, 107, 199,
+    21, 139, 63, 184, 248, 166, 218, 45, 84, 31, 233, 48, 140, 198, 57, 155, 109, 247, 202, 169, 241, 44, 119, 18, 97, 132, 81, 154, 218, 120, 82, 149, 0, 126, 245, 176, 228, 197, 122, 216, 57, 31, 102, 251, 175, 148, 53, 202, 134, 80, 108, 234, 170, 217, 91, 2, 152, 44, 200, 68, 89, 48, 156, 252,
+    180, 215, 5, 131, 32, 75, 113, 238, 142, 176, 102, 212, 24, 242, 16, 80, 188, 138, 25, 58, 90, 137, 176, 254, 54, 207, 238, 39, 59, 174, 32, 236, 103, 193, 55, 136, 8, 148, 36, 170, 137, 190, 120, 66, 26, 98, 236, 15, 167, 209, 23, 142, 67, 28, 177, 207, 81, 241, 169, 139, 215, 13, 129, 73,
+    116, 158, 81, 224, 102, 207, 12, 186, 62, 16, 156, 69, 93, 168, 113, 215, 39, 97, 157, 227, 187, 25, 213, 79, 166, 2, 105, 183, 139, 92, 205, 163, 66, 224, 24, 86, 215, 69, 105, 229, 2, 79, 214, 145, 227, 127, 180, 37, 94, 243, 50, 184, 98, 244, 128, 56, 112, 20, 122, 33, 104, 192, 223, 34,
+    238, 47, 194, 148, 58, 172, 125, 91, 205, 252, 126, 192, 228, 36, 136, 253, 68, 207, 12, 116, 72, 151, 106, 39, 142, 190, 70, 223, 20, 242, 10, 123, 36, 143, 171, 118, 186, 250, 51, 199, 94, 246, 18, 167, 44, 78, 195, 114, 65, 155, 125, 225, 11, 154, 39, 232, 159, 213, 63, 178, 234, 55, 165, 91,
+    206, 106, 14, 253, 27, 228, 43, 152, 24, 107, 52, 2, 144, 61, 182, 8, 129, 172, 238, 38, 201, 245, 15, 221, 117, 244, 30, 126, 156, 110, 74, 187, 253, 92, 207, 45, 17, 156, 131, 28, 152, 180, 60, 110, 203, 7, 254, 142, 219, 3, 198, 78, 115, 203, 73, 187, 8, 84, 251, 148, 2, 78, 142, 18,
+    64, 137, 184, 119, 72, 138, 192, 235, 81, 213, 163, 239, 110, 221, 85, 197, 102, 56, 146, 87, 128, 61, 179, 85, 51, 160, 93, 196, 43, 175, 226, 53, 154, 4, 70, 240, 100, 180, 83, 237, 116, 40, 136, 238, 86, 154, 57, 30, 173, 90, 44, 162, 33, 253, 140, 100, 124, 198, 46, 94, 188, 118, 248, 176,
+    224, 35, 86, 162, 211, 97, 4, 60, 177, 133, 36, 77, 171, 18, 151, 43, 227, 27, 212, 185, 2, 163, 234, 136, 205, 8, 219, 62, 249, 86, 24, 132, 217, 111, 193, 128, 220, 58, 13, 213, 70, 189, 217, 24, 172, 224, 102, 132, 239, 204, 108, 236, 176, 61, 23, 220, 37, 167, 134, 223, 30, 211, 44, 99,
+    151, 201, 237, 11, 49, 246, 168, 117, 28, 247, 97, 194, 55, 209, 121, 244, 164, 113, 71, 251, 99, 46, 110, 27, 73, 180, 104, 138, 13, 149, 210, 98, 37, 170, 21, 159, 34, 147, 195, 103, 160, 5, 97, 65, 122, 41, 189, 79, 23, 61, 148, 16, 130, 92, 182, 149, 66, 245, 10, 109, 65, 161, 129, 5,
+    55, 121, 68, 110, 188, 131, 73, 220, 199, 148, 8, 125, 235, 31, 96, 63, 5, 141, 173, 22, 135, 217, 193, 155, 252, 122, 34, 230, 185, 113, 64, 181, 247, 81, 232, 63, 94, 252, 121, 39, 226, 130, 245, 150, 196, 9, 247, 160, 114, 228, 186, 80, 223, 205, 0, 235, 117, 81, 204, 177, 233, 86, 196, 239,
+    173, 19, 165, 222, 34, 153, 20, 92, 44, 67, 223, 182, 83, 137, 170, 188, 219, 84, 206, 53, 232, 69, 11, 92, 44, 215, 159, 82, 49, 240, 160, 7, 55, 144, 114, 185, 210, 3, 74, 177, 61, 29, 204, 46, 79, 215, 139, 51, 178, 5, 126, 54, 34, 107, 164, 47, 193, 28, 141, 53, 16, 149, 29, 77,
+    192, 255, 133, 82, 200, 100, 231, 185, 121, 161, 104, 41, 156, 13, 255, 46, 125, 29, 106, 185, 151, 119, 173, 206, 145, 66, 1, 199, 100, 20, 207, 127, 195, 220, 16, 47, 128, 163, 218, 140, 236, 88, 165, 117, 175, 99, 19, 75, 206, 96, 250, 196, 153, 242, 69, 136, 92, 229, 164, 100, 251, 119, 215, 107,
+    37, 93, 52, 2, 241, 60, 168, 6, 252, 205, 24, 239, 64, 201, 107, 75, 229, 158, 246, 9, 89, 39, 239, 19, 108, 244, 170, 119, 225, 138, 71, 90, 36, 99, 167, 240, 84, 35, 104, 18, 188, 110, 10, 251, 33, 225, 121, 239, 145, 40, 162, 87, 120, 21, 189, 217, 11, 124, 63, 207, 42, 184, 60, 142,
+};
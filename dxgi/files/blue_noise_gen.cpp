@@ -0,0 +1,48 @@
+// Blue-noise table generator
+//
+// Writes the 8-bit threshold map the render path dithers with, as a C++
+// header. The output is checked in (blue_noise_64.h) so neither the build
+// nor startup pays for the void-and-cluster search; rerun this only to
+// change the tile size or the filter.
+//
+// Build: cl /O2 /EHsc blue_noise_gen.cpp    or    g++ -O2 blue_noise_gen.cpp
+//
+// Usage: blue-noise-gen [--size N] [--sigma F] [--out FILE]    (default: 64, 1.5, stdout)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "blue_noise.h"
+
+int main(int argc, char** argv) {
+    int size = 64;
+    float sigma = 1.5f;
+    const char* outPath = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--size") && i+1 < argc) size = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--sigma") && i+1 < argc) sigma = (float)atof(argv[++i]);
+        else if (!strcmp(argv[i], "--out") && i+1 < argc) outPath = argv[++i];
+        else { fprintf(stderr, "Usage: %s [--size N] [--sigma F] [--out FILE]\n", argv[0]); return 1; }
+    }
+    if (size < 4 || size > 256 || (size & (size - 1))) { fprintf(stderr, "--size must be a power of two, 4..256\n"); return 1; }
+
+    std::vector<uint16_t> ranks;
+    GenerateBlueNoise(size, &ranks, sigma);
+
+    FILE* f = outPath ? fopen(outPath, "w") : stdout;
+    if (!f) { fprintf(stderr, "Cannot write %s\n", outPath); return 1; }
+    fprintf(f, "// Generated by blue-noise-gen --size %d --sigma %g. Do not edit.\n", size, sigma);
+    fprintf(f, "//\n// %dx%d void-and-cluster threshold map, rank * 256 / %d, row-major.\n\n", size, size, size * size);
+    fprintf(f, "#pragma once\n\n#include <stdint.h>\n\n");
+    fprintf(f, "const int kBlueNoiseSize = %d;\n\n", size);
+    fprintf(f, "const uint8_t kBlueNoise[%d * %d] = {\n", size, size);
+    for (int y = 0; y < size; y++) {
+        fprintf(f, "   ");
+        for (int x = 0; x < size; x++) fprintf(f, " %d,", ranks[y * size + x] * 256 / (size * size));
+        fprintf(f, "\n");
+    }
+    fprintf(f, "};\n");
+    if (outPath) fclose(f);
+    return 0;
+}
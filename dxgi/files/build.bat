@@ -4,7 +4,7 @@ REM Run this from a "Developer Command Prompt for VS" or "x64 Native Tools Comma
 
 echo Building dxgi-mirror...
 
-cl /O2 /EHsc /W3 /DNDEBUG main.cpp /Fe:dxgi-mirror.exe /link d3d11.lib dxgi.lib d3dcompiler.lib user32.lib winmm.lib
+cl /O2 /EHsc /W3 /DNDEBUG main.cpp /Fe:dxgi-mirror.exe /link d3d11.lib dxgi.lib d3dcompiler.lib user32.lib winmm.lib ws2_32.lib
 
 if %ERRORLEVEL% EQU 0 (
     echo.
@@ -0,0 +1,36 @@
+// Case results and the summary shared by the *-check tools
+//
+// Each case fills one CaseResult. Fail() marks it failed and keeps the first
+// reason as its detail, so a case can go on checking and still report what
+// broke first. ReportResults prints one line per case, then FAILED if any
+// case failed, and returns the tool's exit code.
+//
+// Portable C++17.
+
+#pragma once
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+struct CaseResult {
+    std::string name;
+    bool pass = true;
+    std::string detail;
+};
+
+inline void Fail(CaseResult* r, const std::string& what) {
+    if (r->pass) r->detail = what;
+    r->pass = false;
+}
+
+// nameWidth: the column the case names are padded to
+inline int ReportResults(const std::vector<CaseResult>& results, int nameWidth) {
+    bool ok = true;
+    for (const CaseResult& r : results) {
+        printf("%-*s %s%s\n", nameWidth, r.name.c_str(), r.pass ? "ok  " : "FAILED: ", r.detail.c_str());
+        if (!r.pass) ok = false;
+    }
+    if (!ok) printf("\nFAILED\n");
+    return ok ? 0 : 1;
+}
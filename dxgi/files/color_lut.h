@@ -0,0 +1,292 @@
+// 3D LUT for the HDR -> SDR color pipeline
+//
+// The whole per-pixel transform (SDR white scaling, any of the tonemap
+// operators, gamut clip, sRGB OETF) is baked into an N^3 RGBA16F table so the pixel shader does one
+// shaper + one 3D lookup instead of the analytic math.
+//
+// scRGB spans ~2^-14 .. 2^7 (10000 nits) and the transform is closest to
+// linear in log space, so the lattice is indexed through a log2 shaper:
+//
+//   s = saturate((log2(max(c, 2^minLog2)) - minLog2) / (maxLog2 - minLog2))
+//
+// The builder evaluates HdrToSdrReference (tonemap.h) at every lattice
+// point, splitting blue slices across threads; per-axis shaper decodes are
+// computed once per axis rather than per texel. Built tables are cached on
+// disk keyed by every parameter that affects their contents.
+//
+// SampleColorLut mirrors the shader lookups (trilinear and tetrahedral) so
+// MeasureColorLutAccuracy can report delta E against the analytic math on
+// any platform.
+//
+// Portable C++17.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <math.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "color_math.h"
+#include "tonemap.h"
+
+// Bump when the transform or file layout changes so stale caches are ignored
+const uint32_t kColorLutVersion = 2;
+
+const float kLutShaperMinLog2 = -14.0f;
+const float kLutShaperMaxLog2 = 7.0f;     // 128 scRGB = 10240 nits
+
+enum class LutInterpolation {
+    Trilinear,      // Hardware filtered SampleLevel
+    Tetrahedral,    // Four Loads, fewer hue shifts along the neutral axis
+};
+
+struct ColorLut {
+    int size = 0;
+    float minLog2 = kLutShaperMinLog2, maxLog2 = kLutShaperMaxLog2;
+    std::vector<uint16_t> texels;   // RGBA16F, red fastest, then green, then blue
+
+    const uint16_t* At(int r, int g, int b) const {
+        return texels.data() + (((size_t)b * size + g) * size + r) * 4;
+    }
+};
+
+// Linear input -> shaper coordinate in [0, 1]
+inline float LutShaperEncode(const ColorLut& lut, float c) {
+    float lo = exp2f(lut.minLog2);
+    float s = (log2f(c > lo ? c : lo) - lut.minLog2) / (lut.maxLog2 - lut.minLog2);
+    return Saturate(s);
+}
+
+inline float LutShaperDecode(const ColorLut& lut, float s) {
+    return exp2f(lut.minLog2 + s * (lut.maxLog2 - lut.minLog2));
+}
+
+// Stretches the shaper range slightly so SDR white (scaled 1.0, where the
+// tonemap curve starts) falls exactly on a lattice plane
+inline void ColorLutShaperRange(const TonemapParams& params, int size, float* minLog2, float* maxLog2) {
+    float whiteLog2 = log2f(params.sdrWhiteNits / 80.0f);
+    float step = (kLutShaperMaxLog2 - kLutShaperMinLog2) / (size - 1);
+    float k = floorf((whiteLog2 - kLutShaperMinLog2) / step + 0.5f);
+    if (k >= 1.0f && k < size - 1) step = (whiteLog2 - kLutShaperMinLog2) / k;
+    *minLog2 = kLutShaperMinLog2;
+    *maxLog2 = kLutShaperMinLog2 + step * (size - 1);
+}
+
+inline void BuildColorLut(const TonemapParams& params, int size, ColorLut* out, int threads = 0) {
+    out->size = size;
+    ColorLutShaperRange(params, size, &out->minLog2, &out->maxLog2);
+    out->texels.assign((size_t)size * size * size * 4, 0);
+
+    // Lattice point i decodes to the same linear value on every axis
+    std::vector<float> axis(size);
+    for (int i = 0; i < size; i++) axis[i] = LutShaperDecode(*out, (float)i / (size - 1));
+    axis[0] = 0.0f;     // Everything below the shaper floor is black
+
+    if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+    if (threads <= 0) threads = 1;
+    if (threads > size) threads = size;
+
+    const TonemapConstants constants = ComputeTonemapConstants(params);
+    std::atomic<int> nextSlice{0};
+    auto worker = [&]() {
+        for (int b; (b = nextSlice.fetch_add(1, std::memory_order_relaxed)) < size;) {
+            uint16_t* dst = out->texels.data() + (size_t)b * size * size * 4;
+            for (int g = 0; g < size; g++) {
+                for (int r = 0; r < size; r++, dst += 4) {
+                    float in[3] = {axis[r], axis[g], axis[b]}, rgb[3];
+                    HdrToSdrReference(params, constants, in, rgb);
+                    dst[0] = FloatToHalf(rgb[0]);
+                    dst[1] = FloatToHalf(rgb[1]);
+                    dst[2] = FloatToHalf(rgb[2]);
+                    dst[3] = 0x3C00;    // 1.0
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int i = 1; i < threads; i++) pool.emplace_back(worker);
+    worker();
+    for (std::thread& t : pool) t.join();
+}
+
+inline void LoadLutTexel(const ColorLut& lut, int r, int g, int b, float out[3]) {
+    const uint16_t* t = lut.At(r, g, b);
+    out[0] = HalfToFloat(t[0]);
+    out[1] = HalfToFloat(t[1]);
+    out[2] = HalfToFloat(t[2]);
+}
+
+// CPU version of the shader lookup: linear scRGB in, sRGB-encoded out
+inline void SampleColorLut(const ColorLut& lut, LutInterpolation interp, const float in[3], float out[3]) {
+    float p[3];
+    int i0[3];
+    float f[3];
+    for (int c = 0; c < 3; c++) {
+        p[c] = LutShaperEncode(lut, in[c]) * (lut.size - 1);
+        int i = (int)floorf(p[c]);
+        if (i > lut.size - 2) i = lut.size - 2;
+        i0[c] = i;
+        f[c] = p[c] - i;
+    }
+    int r = i0[0], g = i0[1], b = i0[2];
+
+    if (interp == LutInterpolation::Trilinear) {
+        float acc[3] = {0, 0, 0};
+        for (int corner = 0; corner < 8; corner++) {
+            int dr = corner & 1, dg = (corner >> 1) & 1, db = (corner >> 2) & 1;
+            float w = (dr ? f[0] : 1 - f[0]) * (dg ? f[1] : 1 - f[1]) * (db ? f[2] : 1 - f[2]);
+            float t[3];
+            LoadLutTexel(lut, r + dr, g + dg, b + db, t);
+            for (int c = 0; c < 3; c++) acc[c] += w * t[c];
+        }
+        for (int c = 0; c < 3; c++) out[c] = acc[c];
+        return;
+    }
+
+    // Tetrahedral: walk from c000 to c111 along the axes in order of
+    // decreasing fraction, same case split as the shader
+    int first, second, third;
+    if (f[0] > f[1]) {
+        if (f[1] > f[2])      { first = 0; second = 1; third = 2; }
+        else if (f[0] > f[2]) { first = 0; second = 2; third = 1; }
+        else                  { first = 2; second = 0; third = 1; }
+    } else {
+        if (f[2] > f[1])      { first = 2; second = 1; third = 0; }
+        else if (f[2] > f[0]) { first = 1; second = 2; third = 0; }
+        else                  { first = 1; second = 0; third = 2; }
+    }
+    int idx[3] = {r, g, b};
+    float c0[3], c1[3], c2[3], c3[3];
+    LoadLutTexel(lut, idx[0], idx[1], idx[2], c0);
+    idx[first]++;
+    LoadLutTexel(lut, idx[0], idx[1], idx[2], c1);
+    idx[second]++;
+    LoadLutTexel(lut, idx[0], idx[1], idx[2], c2);
+    idx[third]++;
+    LoadLutTexel(lut, idx[0], idx[1], idx[2], c3);
+    for (int c = 0; c < 3; c++) {
+        out[c] = c0[c] + f[first] * (c1[c] - c0[c]) + f[second] * (c2[c] - c1[c]) + f[third] * (c3[c] - c2[c]);
+    }
+}
+
+// FNV-1a over everything that changes the table contents
+inline uint64_t ColorLutKey(const TonemapParams& params, int size) {
+    uint64_t h = 0xCBF29CE484222325ull;
+    auto mix = [&h](const void* data, size_t len) {
+        const uint8_t* p = (const uint8_t*)data;
+        for (size_t i = 0; i < len; i++) { h ^= p[i]; h *= 0x100000001B3ull; }
+    };
+    float minLog2, maxLog2;
+    ColorLutShaperRange(params, size, &minLog2, &maxLog2);
+    mix(&kColorLutVersion, sizeof(kColorLutVersion));
+    mix(&size, sizeof(size));
+    mix(&minLog2, sizeof(minLog2));
+    mix(&maxLog2, sizeof(maxLog2));
+    int op = (int)params.op;
+    mix(&op, sizeof(op));
+    mix(&params.sdrWhiteNits, sizeof(params.sdrWhiteNits));
+    mix(&params.peakNits, sizeof(params.peakNits));
+    mix(&params.knee, sizeof(params.knee));
+    mix(&params.exposure, sizeof(params.exposure));
+    return h;
+}
+
+inline std::string ColorLutCachePath(const std::string& dir, uint64_t key) {
+    char name[64];
+    snprintf(name, sizeof(name), "dxgi-mirror-lut-%016llx.bin", (unsigned long long)key);
+    if (dir.empty()) return name;
+    char last = dir.back();
+    return dir + (last == '/' || last == '\\' ? "" : "/") + name;
+}
+
+struct ColorLutFileHeader {
+    char magic[4];      // "DXLU"
+    uint32_t version;
+    uint64_t key;
+    int32_t size;
+    float minLog2, maxLog2;
+    uint32_t reserved;
+};
+
+inline bool SaveColorLut(const std::string& path, uint64_t key, const ColorLut& lut) {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) return false;
+    ColorLutFileHeader h = {{'D', 'X', 'L', 'U'}, kColorLutVersion, key, lut.size, lut.minLog2, lut.maxLog2, 0};
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+              fwrite(lut.texels.data(), sizeof(uint16_t), lut.texels.size(), f) == lut.texels.size();
+    fclose(f);
+    if (!ok) remove(path.c_str());
+    return ok;
+}
+
+// Fails (and leaves out untouched) on a missing, stale or truncated file
+inline bool LoadColorLut(const std::string& path, uint64_t key, int size, ColorLut* out) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    ColorLutFileHeader h;
+    bool ok = fread(&h, sizeof(h), 1, f) == 1 && !memcmp(h.magic, "DXLU", 4) &&
+              h.version == kColorLutVersion && h.key == key && h.size == size;
+    ColorLut lut;
+    if (ok) {
+        lut.size = size;
+        lut.minLog2 = h.minLog2;
+        lut.maxLog2 = h.maxLog2;
+        lut.texels.resize((size_t)size * size * size * 4);
+        ok = fread(lut.texels.data(), sizeof(uint16_t), lut.texels.size(), f) == lut.texels.size();
+    }
+    fclose(f);
+    if (ok) *out = std::move(lut);
+    return ok;
+}
+
+struct LutAccuracy {
+    float maxDeltaE = 0, p99DeltaE = 0, meanDeltaE = 0;
+    float worstInput[3] = {0, 0, 0};
+};
+
+// Delta E of the LUT lookup against the analytic transform, sampled at the
+// center of every lattice cell (where interpolation error peaks)
+inline LutAccuracy MeasureColorLutAccuracy(const TonemapParams& params, const ColorLut& lut,
+                                           LutInterpolation interp) {
+    const TonemapConstants constants = ComputeTonemapConstants(params);
+    LutAccuracy acc;
+    double sum = 0;
+    int64_t n = 0;
+    const int kBins = 1000;         // 0.01 wide, last bin catches everything above 10
+    std::vector<int64_t> hist(kBins + 1, 0);
+    const int samplesPerAxis = lut.size - 1;
+    std::vector<float> axis(samplesPerAxis);
+    for (int i = 0; i < samplesPerAxis; i++) {
+        axis[i] = LutShaperDecode(lut, (i + 0.5f) / samplesPerAxis);
+    }
+    for (int b = 0; b < samplesPerAxis; b++) {
+        for (int g = 0; g < samplesPerAxis; g++) {
+            for (int r = 0; r < samplesPerAxis; r++) {
+                float in[3] = {axis[r], axis[g], axis[b]}, ref[3], got[3];
+                HdrToSdrReference(params, constants, in, ref);
+                SampleColorLut(lut, interp, in, got);
+                float de = DeltaE76(ref, got);
+                sum += de;
+                n++;
+                int bin = (int)(de * 100.0f);
+                hist[bin < kBins ? bin : kBins]++;
+                if (de > acc.maxDeltaE) {
+                    acc.maxDeltaE = de;
+                    acc.worstInput[0] = in[0]; acc.worstInput[1] = in[1]; acc.worstInput[2] = in[2];
+                }
+            }
+        }
+    }
+    acc.meanDeltaE = n ? (float)(sum / n) : 0.0f;
+    int64_t seen = 0;
+    for (int i = 0; i <= kBins; i++) {
+        seen += hist[i];
+        if (seen * 100 >= n * 99) { acc.p99DeltaE = i < kBins ? (i + 1) * 0.01f : acc.maxDeltaE; break; }
+    }
+    return acc;
+}
@@ -0,0 +1,229 @@
+// Color LUT (color_lut.h) accuracy check
+//
+// Builds the 33^3 and 65^3 tables for every tonemap operator with the
+// default parameters and measures both lookups (tetrahedral, trilinear)
+// against the analytic transform with MeasureColorLutAccuracy: delta E at
+// the center of every lattice cell. Fails when the max delta E of any table
+// is above its operator's limit.
+//
+// reinhard steps from 1.0 down to 0.5 where maxRGB crosses SDR white, which
+// no interpolated table can follow: the cells that straddle the step are
+// measured on their own against a limit that only asks for the step to stay
+// inside them, and the rest of the table against a limit like the other
+// operators'. reinhard, bt2390 and knee scale by maxRGB, whose ridges and
+// slope kinks trilinear smears much more than tetrahedral, so the limits
+// are per lookup. reinhard also needs SDR white on a lattice plane
+// (ColorLutShaperRange), or the cells just below it blend in the step.
+//
+//   lookup     SampleColorLut on hand-built tables it must reproduce exactly
+//              (within half precision) at random points: tetrahedral is
+//              exact for max / median / min of the lattice coordinates
+//              (linear on each of its six tetrahedra, so a wrong case split
+//              shows), trilinear for x, x * y and x * y * z.
+//
+// Build: cl /O2 /EHsc color_lut_check.cpp    or    g++ -O2 -pthread color_lut_check.cpp
+//
+// Usage: color-lut-check
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "color_lut.h"
+
+// Max delta E per table: measured, with about 50% headroom
+struct LutLimit {
+    TonemapOperator op;
+    int size;
+    float tetrahedral, trilinear;
+};
+
+const LutLimit kLimits[] = {
+    {TonemapOperator::Reinhard, 33, 0.7f, 8.5f},      // Away from the step
+    {TonemapOperator::Reinhard, 65, 0.2f, 4.5f},
+    {TonemapOperator::Bt2390, 33, 1.0f, 9.0f},
+    {TonemapOperator::Bt2390, 65, 0.3f, 5.0f},
+    {TonemapOperator::Hable, 33, 1.5f, 1.5f},
+    {TonemapOperator::Hable, 65, 0.8f, 0.8f},
+    {TonemapOperator::Aces, 33, 1.5f, 1.5f},
+    {TonemapOperator::Aces, 65, 0.45f, 0.45f},
+    {TonemapOperator::Knee, 33, 5.0f, 9.0f},
+    {TonemapOperator::Knee, 65, 1.8f, 5.0f},
+};
+
+// reinhard across the step: 1.0 against 0.5 linear is ~24 delta E
+const float kReinhardStepLimit = 26.0f;
+
+// reinhard only: the same samples as MeasureColorLutAccuracy, split by
+// whether the cell's corners fall on both sides of maxRGB = SDR white
+struct SplitAccuracy {
+    float smoothMax = 0, stepMax = 0;
+    int64_t stepCells = 0, cells = 0;
+    bool whiteOnPlane = false;
+};
+
+static SplitAccuracy MeasureAroundStep(const TonemapParams& params, const ColorLut& lut, LutInterpolation interp) {
+    const TonemapConstants constants = ComputeTonemapConstants(params);
+    const int n = lut.size - 1;
+    std::vector<float> lattice(lut.size), center(n);
+    for (int i = 0; i < lut.size; i++) lattice[i] = LutShaperDecode(lut, (float)i / n);     // As BuildColorLut
+    lattice[0] = 0.0f;
+    for (int i = 0; i < n; i++) center[i] = LutShaperDecode(lut, (i + 0.5f) / n);
+    auto above = [&](int r, int g, int b) {
+        float m = lattice[r] > lattice[g] ? lattice[r] : lattice[g];
+        if (lattice[b] > m) m = lattice[b];
+        return m * constants.scale > 1.0f;
+    };
+    SplitAccuracy acc;
+    for (float v : lattice) acc.whiteOnPlane = acc.whiteOnPlane || fabsf(v * constants.scale - 1.0f) < 1e-4f;
+    for (int b = 0; b < n; b++) {
+        for (int g = 0; g < n; g++) {
+            for (int r = 0; r < n; r++) {
+                float in[3] = {center[r], center[g], center[b]}, ref[3], got[3];
+                HdrToSdrReference(params, constants, in, ref);
+                SampleColorLut(lut, interp, in, got);
+                float de = DeltaE76(ref, got);
+                bool step = !above(r, g, b) && above(r + 1, g + 1, b + 1);
+                float& max = step ? acc.stepMax : acc.smoothMax;
+                if (de > max) max = de;
+                acc.stepCells += step;
+                acc.cells++;
+            }
+        }
+    }
+    return acc;
+}
+
+static CaseResult Check(const LutLimit& limit) {
+    CaseResult r;
+    r.name = std::string(TonemapOperatorName(limit.op)) + " " + std::to_string(limit.size);
+    TonemapParams params;
+    params.op = limit.op;
+    ColorLut lut;
+    BuildColorLut(params, limit.size, &lut);
+
+    std::string detail;
+    const LutInterpolation interps[] = {LutInterpolation::Tetrahedral, LutInterpolation::Trilinear};
+    for (LutInterpolation interp : interps) {
+        bool tetra = interp == LutInterpolation::Tetrahedral;
+        const char* name = tetra ? "tetrahedral" : "trilinear";
+        float maxLimit = tetra ? limit.tetrahedral : limit.trilinear;
+        LutAccuracy acc = MeasureColorLutAccuracy(params, lut, interp);
+        char text[160];
+        if (limit.op == TonemapOperator::Reinhard) {
+            SplitAccuracy split = MeasureAroundStep(params, lut, interp);
+            if (split.stepCells == 0) Fail(&r, "no cell straddles SDR white");
+            if (!split.whiteOnPlane) Fail(&r, "SDR white is not on a lattice plane");
+            if (split.smoothMax > maxLimit) {
+                Fail(&r, std::string(name) + " dE " + std::to_string(split.smoothMax) + " away from the step, limit " +
+                     std::to_string(maxLimit));
+            }
+            if (acc.maxDeltaE > kReinhardStepLimit) {
+                Fail(&r, std::string(name) + " dE " + std::to_string(acc.maxDeltaE) + " at the step, limit " +
+                     std::to_string(kReinhardStepLimit));
+            }
+            snprintf(text, sizeof(text), "%s max %.2f (%.2f in the %.1f%% of cells at the step)", name, split.smoothMax,
+                     split.stepMax, 100.0 * split.stepCells / split.cells);
+        } else {
+            if (acc.maxDeltaE > maxLimit) {
+                Fail(&r, std::string(name) + " dE " + std::to_string(acc.maxDeltaE) + ", limit " + std::to_string(maxLimit) +
+                     " (worst at " + std::to_string(acc.worstInput[0]) + " " + std::to_string(acc.worstInput[1]) + " " +
+                     std::to_string(acc.worstInput[2]) + ")");
+            }
+            snprintf(text, sizeof(text), "%s max %.2f p99 %.2f mean %.3f", name, acc.maxDeltaE, acc.p99DeltaE, acc.meanDeltaE);
+        }
+        detail += (detail.empty() ? "" : ", ") + std::string(text);
+    }
+    if (r.pass) r.detail = detail;
+    return r;
+}
+
+static uint32_t Random(uint32_t* state) {
+    *state ^= *state << 13; *state ^= *state >> 17; *state ^= *state << 5;
+    return *state;
+}
+
+static void SortDescending(float v[3]) {
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < 2 - i; j++) {
+            if (v[j] < v[j + 1]) { float t = v[j]; v[j] = v[j + 1]; v[j + 1] = t; }
+        }
+    }
+}
+
+static CaseResult CheckLookup() {
+    CaseResult r;
+    r.name = "lookup";
+    const int size = 17;
+    const float n = size - 1;
+    ColorLut tetra, tri;
+    tetra.size = tri.size = size;
+    tetra.texels.resize((size_t)size * size * size * 4);
+    tri.texels.resize(tetra.texels.size());
+    for (int b = 0; b < size; b++) {
+        for (int g = 0; g < size; g++) {
+            for (int x = 0; x < size; x++) {
+                float v[3] = {x / n, g / n, b / n};
+                size_t i = (((size_t)b * size + g) * size + x) * 4;     // As ColorLut::At
+                uint16_t* t = &tri.texels[i];
+                t[0] = FloatToHalf(v[0]);
+                t[1] = FloatToHalf(v[0] * v[1]);
+                t[2] = FloatToHalf(v[0] * v[1] * v[2]);
+                SortDescending(v);
+                t = &tetra.texels[i];
+                for (int c = 0; c < 3; c++) t[c] = FloatToHalf(v[c]);
+            }
+        }
+    }
+
+    uint32_t rng = 0x51ED270B;
+    float worst = 0;
+    for (int k = 0; k < 200000 && r.pass; k++) {
+        float in[3], p[3], got[3], expect[3];
+        for (int c = 0; c < 3; c++) {
+            in[c] = LutShaperDecode(tetra, (Random(&rng) >> 8) * (1.0f / (1 << 24)));
+            p[c] = LutShaperEncode(tetra, in[c]);
+        }
+        bool useTetra = k & 1;
+        if (useTetra) {
+            for (int c = 0; c < 3; c++) expect[c] = p[c];
+            SortDescending(expect);
+            SampleColorLut(tetra, LutInterpolation::Tetrahedral, in, got);
+        } else {
+            expect[0] = p[0];
+            expect[1] = p[0] * p[1];
+            expect[2] = p[0] * p[1] * p[2];
+            SampleColorLut(tri, LutInterpolation::Trilinear, in, got);
+        }
+        for (int c = 0; c < 3; c++) {
+            float e = fabsf(got[c] - expect[c]);
+            if (e > worst) worst = e;
+            if (e > 2e-3f) {
+                Fail(&r, std::string(useTetra ? "tetrahedral" : "trilinear") + " off by " + std::to_string(e) + " at " +
+                     std::to_string(p[0]) + " " + std::to_string(p[1]) + " " + std::to_string(p[2]));
+                break;
+            }
+        }
+    }
+    if (r.pass) {
+        char text[96];
+        snprintf(text, sizeof(text), "both lookups exact for their functions, worst error %.5f", worst);
+        r.detail = text;
+    }
+    return r;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        fprintf(stderr, "Usage: %s\n", argv[0]);
+        return 1;
+    }
+    std::vector<CaseResult> results;
+    results.push_back(CheckLookup());
+    for (const LutLimit& limit : kLimits) results.push_back(Check(limit));
+
+    return ReportResults(results, 12);
+}
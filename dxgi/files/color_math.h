@@ -0,0 +1,100 @@
+// Color math shared by the CPU reference paths
+//
+// Scalar versions of the building blocks the pixel shaders use: half floats
+// and the sRGB transfer functions, plus CIELAB delta E for comparing a fast
+// path against its reference. The tonemap operators are in tonemap.h.
+//
+// Portable C++17.
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+// IEEE half <-> float, round to nearest even
+inline uint16_t FloatToHalf(float f) {
+    uint32_t x; memcpy(&x, &f, 4);
+    uint32_t sign = (x >> 16) & 0x8000;
+    uint32_t absx = x & 0x7FFFFFFF;
+
+    if (absx >= 0x7F800000) return (uint16_t)(sign | 0x7C00 | (absx > 0x7F800000 ? 0x200 : 0));  // Inf/NaN
+    if (absx >= 0x477FF000) return (uint16_t)(sign | 0x7C00);   // Overflow (rounds past 65504)
+    if (absx < 0x38800000) {
+        // Subnormal half (or zero): shift the implicit-one mantissa into place
+        if (absx < 0x33000000) return (uint16_t)sign;
+        uint32_t e = absx >> 23;
+        uint32_t m = (absx & 0x7FFFFF) | 0x800000;
+        uint32_t shift = 126 - e;
+        uint32_t h = m >> shift;
+        uint32_t rem = m & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rem > halfway || (rem == halfway && (h & 1))) h++;
+        return (uint16_t)(sign | h);
+    }
+    uint32_t h = ((absx - 0x38000000) >> 13);
+    uint32_t rem = absx & 0x1FFF;
+    if (rem > 0x1000 || (rem == 0x1000 && (h & 1))) h++;
+    return (uint16_t)(sign | h);
+}
+
+inline float HalfToFloat(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t e = (h >> 10) & 0x1F;
+    uint32_t m = h & 0x3FF;
+    uint32_t x;
+    if (e == 0) {
+        if (m == 0) {
+            x = sign;
+        } else {
+            // Subnormal: normalize
+            e = 113;
+            while (!(m & 0x400)) { m <<= 1; e--; }
+            x = sign | (e << 23) | ((m & 0x3FF) << 13);
+        }
+    } else if (e == 31) {
+        x = sign | 0x7F800000 | (m << 13);
+    } else {
+        x = sign | ((e + 112) << 23) | (m << 13);
+    }
+    float f; memcpy(&f, &x, 4);
+    return f;
+}
+
+inline float Saturate(float v) { return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v); }
+
+// sRGB OETF (linear to gamma) and its inverse
+inline float SrgbEncode(float lin) {
+    return lin <= 0.0031308f ? 12.92f * lin : 1.055f * powf(lin, 1.0f / 2.4f) - 0.055f;
+}
+
+inline float SrgbDecode(float s) {
+    return s <= 0.04045f ? s / 12.92f : powf((s + 0.055f) / 1.055f, 2.4f);
+}
+
+// sRGB-encoded BT.709 color to CIELAB (D65)
+inline void SrgbToLab(const float srgb[3], float lab[3]) {
+    float r = SrgbDecode(srgb[0]), g = SrgbDecode(srgb[1]), b = SrgbDecode(srgb[2]);
+    float xyz[3] = {
+        (0.4124564f * r + 0.3575761f * g + 0.1804375f * b) / 0.95047f,
+        (0.2126729f * r + 0.7151522f * g + 0.0721750f * b),
+        (0.0193339f * r + 0.1191920f * g + 0.9503041f * b) / 1.08883f,
+    };
+    float f[3];
+    for (int i = 0; i < 3; i++) {
+        float t = xyz[i];
+        f[i] = t > 216.0f / 24389.0f ? cbrtf(t) : (24389.0f / 27.0f * t + 16.0f) / 116.0f;
+    }
+    lab[0] = 116.0f * f[1] - 16.0f;
+    lab[1] = 500.0f * (f[0] - f[1]);
+    lab[2] = 200.0f * (f[1] - f[2]);
+}
+
+// CIE76 delta E between two sRGB-encoded colors (1.0 ~ just noticeable)
+inline float DeltaE76(const float a[3], const float b[3]) {
+    float la[3], lb[3];
+    SrgbToLab(a, la);
+    SrgbToLab(b, lb);
+    float d0 = la[0] - lb[0], d1 = la[1] - lb[1], d2 = la[2] - lb[2];
+    return sqrtf(d0 * d0 + d1 * d1 + d2 * d2);
+}
@@ -0,0 +1,138 @@
+// Dirty-region bookkeeping for incremental slot copies
+//
+// DirtyRegion is a small list of rectangles clipped to the frame, coalesced
+// as they are added so the copy list stays short. SlotDirtyTracker keeps one
+// region per capture slot: every captured frame's damage is added to every
+// slot, and writing a slot consumes its region. A slot that sat out a few
+// frames (because the render thread held it) therefore gets the union of
+// everything it missed, not just the latest frame's rects.
+//
+// Portable C++17.
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "frame_source.h"
+
+inline int64_t RectArea(const FrameRect& r) {
+    return (int64_t)(r.right - r.left) * (r.bottom - r.top);
+}
+
+inline bool RectEmpty(const FrameRect& r) {
+    return r.right <= r.left || r.bottom <= r.top;
+}
+
+inline bool RectContains(const FrameRect& outer, const FrameRect& inner) {
+    return inner.left >= outer.left && inner.top >= outer.top &&
+           inner.right <= outer.right && inner.bottom <= outer.bottom;
+}
+
+inline FrameRect RectUnion(const FrameRect& a, const FrameRect& b) {
+    return {a.left < b.left ? a.left : b.left, a.top < b.top ? a.top : b.top,
+            a.right > b.right ? a.right : b.right, a.bottom > b.bottom ? a.bottom : b.bottom};
+}
+
+inline FrameRect RectIntersect(const FrameRect& a, const FrameRect& b) {
+    return {a.left > b.left ? a.left : b.left, a.top > b.top ? a.top : b.top,
+            a.right < b.right ? a.right : b.right, a.bottom < b.bottom ? a.bottom : b.bottom};
+}
+
+class DirtyRegion {
+public:
+    // Beyond this many rects the region collapses to its bounding box
+    static const int kMaxRects = 32;
+
+    void Reset(int32_t width, int32_t height) {
+        bounds = {0, 0, width, height};
+        rects.clear();
+    }
+
+    void Clear() { rects.clear(); }
+    void SetFull() { rects.assign(1, bounds); }
+
+    bool Empty() const { return rects.empty(); }
+    bool IsFull() const { return rects.size() == 1 && RectContains(rects[0], bounds); }
+    const std::vector<FrameRect>& Rects() const { return rects; }
+
+    int64_t Area() const {
+        int64_t a = 0;
+        for (const FrameRect& r : rects) a += RectArea(r);
+        return a;
+    }
+
+    void Add(FrameRect r) {
+        r = RectIntersect(r, bounds);
+        if (RectEmpty(r)) return;
+
+        // Fold r into existing rects until nothing else merges with it.
+        // Two rects merge when their bounding box wastes no more area than
+        // they cover between them (touching/overlapping neighbours, stacked
+        // rows of a text edit, etc.).
+        bool merged = true;
+        while (merged) {
+            merged = false;
+            for (size_t i = 0; i < rects.size(); i++) {
+                const FrameRect& e = rects[i];
+                if (RectContains(e, r)) return;
+                FrameRect u = RectUnion(e, r);
+                FrameRect x = RectIntersect(e, r);
+                int64_t covered = RectArea(e) + RectArea(r) - (RectEmpty(x) ? 0 : RectArea(x));
+                if (RectContains(r, e) || RectArea(u) <= covered + covered / 4) {
+                    r = u;
+                    rects[i] = rects.back();
+                    rects.pop_back();
+                    merged = true;
+                    break;
+                }
+            }
+        }
+        rects.push_back(r);
+
+        if ((int)rects.size() > kMaxRects) {
+            FrameRect u = rects[0];
+            for (const FrameRect& e : rects) u = RectUnion(u, e);
+            rects.assign(1, u);
+        }
+    }
+
+    void Add(const DirtyRegion& other) {
+        if (IsFull()) return;
+        if (other.IsFull()) { SetFull(); return; }
+        for (const FrameRect& r : other.rects) Add(r);
+    }
+
+private:
+    FrameRect bounds = {0, 0, 0, 0};
+    std::vector<FrameRect> rects;
+};
+
+template <int N>
+class SlotDirtyTracker {
+public:
+    // New slot contents are undefined, so every slot starts fully dirty
+    void Reset(int32_t width, int32_t height) {
+        for (int i = 0; i < N; i++) {
+            pending[i].Reset(width, height);
+            pending[i].SetFull();
+        }
+    }
+
+    void MarkAllFull() {
+        for (int i = 0; i < N; i++) pending[i].SetFull();
+    }
+
+    // Damage of one captured frame (dirty rects + move destinations)
+    void AddFrameDamage(const DirtyRegion& damage) {
+        for (int i = 0; i < N; i++) pending[i].Add(damage);
+    }
+
+    // Region that must be copied to bring a slot up to date. Call Consume()
+    // once the copy has been issued.
+    const DirtyRegion& Pending(int slot) const { return pending[slot]; }
+    void Consume(int slot) { pending[slot].Clear(); }
+
+private:
+    DirtyRegion pending[N];
+};
@@ -0,0 +1,225 @@
+// Dirty-region check (dirty_region.h)
+//
+// Replays the capture loop's bookkeeping on a small frame with random damage
+// streams: every captured frame repaints a few random rects of the source
+// (some partly or wholly outside it, some moved from elsewhere, now and then
+// the whole frame), its damage goes through a DirtyRegion into
+// SlotDirtyTracker, and the slot written copies only its pending region.
+// Slots are skipped the way the capture loop skips them:
+//
+//   mailbox    write slots from a FrameMailbox whose consumer holds its slot
+//              for a random number of frames (3 and 4 slots)
+//   random     a uniformly random slot each frame, so some sit out for long
+//              stretches (4 slots)
+//   scattered  the mailbox with 4 slots and 10-20 specks per frame, so
+//              pending regions overflow kMaxRects and collapse
+//
+// After every copy the slot must equal the source, and its pending region
+// must have covered every pixel that changed since the slot was last
+// written. Also prints how much more than the missed pixels was copied and
+// the longest rect list.
+// Exits with 1 on any failure.
+//
+// Build: cl /O2 /EHsc dirty_region_check.cpp    or    g++ -O2 dirty_region_check.cpp
+//
+// Usage: dirty-region-check [--frames N]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "dirty_region.h"
+#include "frame_mailbox.h"
+
+const int32_t kWidth = 97, kHeight = 61;     // Odd sizes, so rects clip on every edge
+const int kSlots = 4;
+
+struct Rng {
+    uint32_t state = 0x2545F491;
+    uint32_t Next() { state ^= state << 13; state ^= state >> 17; state ^= state << 5; return state; }
+    int Range(int lo, int hi) { return lo + (int)(Next() % (uint32_t)(hi - lo + 1)); }     // Inclusive
+    bool Chance(int percent) { return (int)(Next() % 100) < percent; }
+};
+
+// A random rect, up to a third of the frame (or a speck of up to 3x3), that
+// may hang over any edge
+static FrameRect RandomRect(Rng& rng, bool speck) {
+    int w = rng.Range(1, speck ? 3 : kWidth / 3), h = rng.Range(1, speck ? 3 : kHeight / 3);
+    int x = rng.Range(-w / 2, kWidth - w / 2), y = rng.Range(-h / 2, kHeight - h / 2);
+    return {x, y, x + w, y + h};
+}
+
+enum class SlotPattern { Mailbox, Random };
+
+struct Replay {
+    std::vector<uint32_t> source;
+    std::vector<uint32_t> slots[kSlots];
+    std::vector<uint8_t> missed[kSlots];    // Pixels changed since the slot was last written
+    SlotDirtyTracker<kSlots> tracker;
+    DirtyRegion damage;
+    uint32_t paint = 1;
+
+    // stats
+    uint64_t copies = 0, copiedArea = 0, missedArea = 0, fullCopies = 0;
+    size_t maxRects = 0;
+    bool specks = false;
+
+    Replay() {
+        source.assign((size_t)kWidth * kHeight, 0);
+        for (int s = 0; s < kSlots; s++) {
+            slots[s].assign(source.size(), 0xDEADBEEF);     // Undefined until first written
+            missed[s].assign(source.size(), 1);
+        }
+        tracker.Reset(kWidth, kHeight);
+        damage.Reset(kWidth, kHeight);
+    }
+
+    void Touch(const FrameRect& r) {
+        FrameRect c = RectIntersect(r, {0, 0, kWidth, kHeight});
+        for (int32_t y = c.top; y < c.bottom; y++) {
+            for (int32_t x = c.left; x < c.right; x++) {
+                for (int s = 0; s < kSlots; s++) missed[s][(size_t)y * kWidth + x] = 1;
+            }
+        }
+    }
+
+    void Repaint(const FrameRect& r) {
+        FrameRect c = RectIntersect(r, {0, 0, kWidth, kHeight});
+        paint++;
+        for (int32_t y = c.top; y < c.bottom; y++) {
+            for (int32_t x = c.left; x < c.right; x++) source[(size_t)y * kWidth + x] = paint * 0x9E3779B1u + y * kWidth + x;
+        }
+        Touch(r);
+        damage.Add(r);
+    }
+
+    // Scroll-like move: the destination gets the source block (already in
+    // place in the captured image), only the destination is damage
+    void Move(const FrameRect& dst, int32_t srcX, int32_t srcY) {
+        FrameRect c = RectIntersect(dst, {0, 0, kWidth, kHeight});
+        if (RectEmpty(c)) return;
+        std::vector<uint32_t> before = source;
+        for (int32_t y = c.top; y < c.bottom; y++) {
+            for (int32_t x = c.left; x < c.right; x++) {
+                int32_t sx = srcX + (x - dst.left), sy = srcY + (y - dst.top);
+                if (sx < 0 || sy < 0 || sx >= kWidth || sy >= kHeight) continue;
+                source[(size_t)y * kWidth + x] = before[(size_t)sy * kWidth + sx];
+            }
+        }
+        Touch(dst);
+        damage.Add(dst);
+    }
+
+    // One captured frame: random damage, then the slot is brought up to date
+    void Capture(Rng& rng, int slot, CaseResult* r, uint64_t frame) {
+        damage.Clear();
+        if (rng.Chance(1)) {
+            Repaint({0, 0, kWidth, kHeight});
+            damage.SetFull();
+        } else {
+            int n = specks ? rng.Range(10, 20) : rng.Range(0, 6);
+            for (int k = 0; k < n; k++) {
+                FrameRect rect = RandomRect(rng, specks);
+                if (rng.Chance(15)) {
+                    Move(rect, rect.left + rng.Range(-8, 8), rect.top + rng.Range(-8, 8));
+                } else {
+                    Repaint(rect);
+                }
+            }
+        }
+        tracker.AddFrameDamage(damage);
+
+        const DirtyRegion& pending = tracker.Pending(slot);
+        maxRects = pending.Rects().size() > maxRects ? pending.Rects().size() : maxRects;
+        if ((int)pending.Rects().size() > DirtyRegion::kMaxRects) Fail(r, "pending region over kMaxRects");
+        std::vector<uint8_t> covered(source.size(), 0);
+        for (const FrameRect& p : pending.Rects()) {
+            if (!RectContains({0, 0, kWidth, kHeight}, p) || RectEmpty(p)) {
+                Fail(r, "frame " + std::to_string(frame) + ": pending rect outside the frame or empty");
+                continue;
+            }
+            for (int32_t y = p.top; y < p.bottom; y++) {
+                for (int32_t x = p.left; x < p.right; x++) {
+                    size_t i = (size_t)y * kWidth + x;
+                    if (!covered[i]) copiedArea++;
+                    covered[i] = 1;
+                    slots[slot][i] = source[i];
+                }
+            }
+        }
+        if (pending.IsFull()) fullCopies++;
+        for (size_t i = 0; i < source.size(); i++) {
+            if (missed[slot][i]) {
+                missedArea++;
+                if (!covered[i]) {
+                    Fail(r, "frame " + std::to_string(frame) + ": slot " + std::to_string(slot) + " missed pixel " +
+                         std::to_string(i % kWidth) + "," + std::to_string(i / kWidth));
+                }
+            }
+            missed[slot][i] = 0;
+        }
+        if (slots[slot] != source) Fail(r, "frame " + std::to_string(frame) + ": slot " + std::to_string(slot) + " differs from the source");
+        tracker.Consume(slot);
+        copies++;
+    }
+};
+
+template <int N>
+static CaseResult Check(const char* name, SlotPattern pattern, bool specks, uint64_t frames) {
+    CaseResult r;
+    r.name = name;
+    Replay replay;
+    replay.specks = specks;
+    Rng rng;
+    FrameMailbox<int, N> mailbox;
+    int hold = 0;
+    for (uint64_t f = 0; f < frames && r.pass; f++) {
+        int slot;
+        if (pattern == SlotPattern::Mailbox) {
+            slot = mailbox.GetWriteIndex();
+        } else {
+            slot = rng.Range(0, N - 1);
+        }
+        replay.Capture(rng, slot, &r, f);
+        if (pattern == SlotPattern::Mailbox) {
+            mailbox.PublishFrame();
+            // The render thread keeps its slot for 0-7 captures (a slow
+            // target or a source faster than it)
+            if (hold-- <= 0) {
+                mailbox.AcquireFrame();
+                hold = rng.Range(0, 7);
+            }
+        }
+    }
+    if (r.pass && specks && replay.maxRects < DirtyRegion::kMaxRects) Fail(&r, "pending regions never reached kMaxRects");
+    if (r.pass) {
+        char text[160];
+        snprintf(text, sizeof(text), "%llu copies, %.2fx the missed pixels copied, %.1f%% full, at most %zu rects",
+                 (unsigned long long)replay.copies, replay.missedArea ? (double)replay.copiedArea / replay.missedArea : 0.0,
+                 100.0 * replay.fullCopies / replay.copies, replay.maxRects);
+        r.detail = text;
+    }
+    return r;
+}
+
+int main(int argc, char** argv) {
+    uint64_t frames = 200000;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--frames") && i+1 < argc) frames = strtoull(argv[++i], nullptr, 10);
+        else {
+            fprintf(stderr, "Usage: %s [--frames N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<CaseResult> results;
+    results.push_back(Check<3>("mailbox 3", SlotPattern::Mailbox, false, frames));
+    results.push_back(Check<4>("mailbox 4", SlotPattern::Mailbox, false, frames));
+    results.push_back(Check<4>("random 4", SlotPattern::Random, false, frames));
+    results.push_back(Check<4>("scattered", SlotPattern::Mailbox, true, frames));
+
+    return ReportResults(results, 10);
+}
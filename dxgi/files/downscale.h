@@ -0,0 +1,312 @@
+// Area-filtered downscaling
+//
+// Every destination pixel is the average of the source area it covers, with
+// partly covered source pixels weighted by their coverage: a box filter as
+// wide as the scale factor, so nothing between samples is skipped (a single
+// bilinear tap aliases once the factor passes 2). The capture pack pass does
+// the same per slot pixel on the GPU (g_ComputeShaderPack with DOWNSCALE).
+// BGRA8 images hold sRGB and are averaged in linear light.
+//
+// DownscaleAreaReference integrates each destination pixel on its own in
+// double precision. AreaDownscaler is the fast version: the filter is
+// separable, so it keeps per-axis taps, filters each source row once
+// horizontally and blends the filtered rows vertically, one RGBA pixel per
+// 4-lane vector (SSE2, NEON or scalar). The two agree to within one 8-bit
+// step (or half-float rounding). SeparableResampler is that machinery for
+// any per-axis taps; scaler.h builds them for the render-side kernels.
+//
+// Portable C++17.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#include "color_math.h"
+#include "frame_source.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DOWNSCALE_SIMD_SSE2 1
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#include <immintrin.h>
+#define DOWNSCALE_SIMD_F16C 1
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define DOWNSCALE_SIMD_NEON 1
+#endif
+
+// Destination pixels that read any of the source pixels in r
+inline FrameRect DownscaleRect(const FrameRect& r, int srcW, int srcH, int dstW, int dstH) {
+    FrameRect d;
+    d.left = (int32_t)((int64_t)r.left * dstW / srcW);
+    d.top = (int32_t)((int64_t)r.top * dstH / srcH);
+    d.right = (int32_t)(((int64_t)r.right * dstW + srcW - 1) / srcW);
+    d.bottom = (int32_t)(((int64_t)r.bottom * dstH + srcH - 1) / srcH);
+    return d;
+}
+
+// Per-axis taps: destination i reads count[i] source pixels from first[i],
+// with weights[offset[i]..] summing to 1
+struct FilterTaps {
+    std::vector<int> first, count, offset;
+    std::vector<float> weights;
+    int maxCount = 0;
+};
+
+inline void BuildAreaTaps(int srcSize, int dstSize, FilterTaps* w) {
+    w->first.resize(dstSize);
+    w->count.resize(dstSize);
+    w->offset.resize(dstSize);
+    w->weights.clear();
+    w->maxCount = 0;
+    double scale = (double)srcSize / dstSize;
+    for (int i = 0; i < dstSize; i++) {
+        double a = i * scale, b = (i + 1) * scale;
+        int first = (int)floor(a), last = (int)ceil(b) - 1;
+        if (last >= srcSize) last = srcSize - 1;
+        w->first[i] = first;
+        w->count[i] = last - first + 1;
+        w->offset[i] = (int)w->weights.size();
+        for (int j = first; j <= last; j++) {
+            double cover = (j + 1 < b ? j + 1 : b) - (j > a ? j : a);
+            w->weights.push_back((float)(cover / scale));
+        }
+        if (w->count[i] > w->maxCount) w->maxCount = w->count[i];
+    }
+}
+
+// Straight 2D integration per destination pixel (dst must be smaller or equal on both axes)
+inline void DownscaleAreaReference(FramePixelFormat format, const uint8_t* src, size_t srcPitch, int srcW, int srcH,
+                                   uint8_t* dst, size_t dstPitch, int dstW, int dstH) {
+    double sx = (double)srcW / dstW, sy = (double)srcH / dstH;
+    for (int y = 0; y < dstH; y++) {
+        double ay = y * sy, by = (y + 1) * sy;
+        int y0 = (int)floor(ay), y1 = (int)ceil(by) - 1;
+        if (y1 >= srcH) y1 = srcH - 1;
+        for (int x = 0; x < dstW; x++) {
+            double ax = x * sx, bx = (x + 1) * sx;
+            int x0 = (int)floor(ax), x1 = (int)ceil(bx) - 1;
+            if (x1 >= srcW) x1 = srcW - 1;
+            double sum[4] = {};
+            for (int j = y0; j <= y1; j++) {
+                double wy = (j + 1 < by ? j + 1 : by) - (j > ay ? j : ay);
+                const uint8_t* row = src + (size_t)j * srcPitch;
+                for (int i = x0; i <= x1; i++) {
+                    double w = wy * ((i + 1 < bx ? i + 1 : bx) - (i > ax ? i : ax));
+                    for (int c = 0; c < 4; c++) {
+                        double v;
+                        if (format == FramePixelFormat::BGRA8) {
+                            uint8_t b = row[i * 4 + c];
+                            v = c < 3 ? SrgbDecode(b / 255.0f) : b / 255.0;
+                        } else {
+                            v = HalfToFloat(((const uint16_t*)row)[i * 4 + c]);
+                        }
+                        sum[c] += w * v;
+                    }
+                }
+            }
+            double area = sx * sy;
+            uint8_t* out = dst + (size_t)y * dstPitch;
+            for (int c = 0; c < 4; c++) {
+                float v = (float)(sum[c] / area);
+                if (format == FramePixelFormat::BGRA8) {
+                    out[x * 4 + c] = (uint8_t)(Saturate(c < 3 ? SrgbEncode(Saturate(v)) : v) * 255.0f + 0.5f);
+                } else {
+                    ((uint16_t*)out)[x * 4 + c] = FloatToHalf(v);
+                }
+            }
+        }
+    }
+}
+
+// One RGBA pixel in memory channel order
+#if defined(DOWNSCALE_SIMD_SSE2)
+
+inline const char* DownscaleSimdName() {
+#if defined(DOWNSCALE_SIMD_F16C)
+    return "SSE2+F16C";
+#else
+    return "SSE2";
+#endif
+}
+
+struct Px4 { __m128 v; };
+inline Px4 PxZero() { return {_mm_setzero_ps()}; }
+inline Px4 PxLoad(const float* p) { return {_mm_loadu_ps(p)}; }
+inline void PxStore(float* p, Px4 a) { _mm_storeu_ps(p, a.v); }
+inline Px4 PxMulAdd(Px4 acc, Px4 a, float w) { return {_mm_add_ps(acc.v, _mm_mul_ps(a.v, _mm_set1_ps(w)))}; }
+
+#elif defined(DOWNSCALE_SIMD_NEON)
+
+inline const char* DownscaleSimdName() { return "NEON"; }
+
+struct Px4 { float32x4_t v; };
+inline Px4 PxZero() { return {vdupq_n_f32(0.0f)}; }
+inline Px4 PxLoad(const float* p) { return {vld1q_f32(p)}; }
+inline void PxStore(float* p, Px4 a) { vst1q_f32(p, a.v); }
+inline Px4 PxMulAdd(Px4 acc, Px4 a, float w) { return {vmlaq_n_f32(acc.v, a.v, w)}; }
+
+#else
+
+inline const char* DownscaleSimdName() { return "scalar"; }
+
+struct Px4 { float v[4]; };
+inline Px4 PxZero() { return {{0.0f, 0.0f, 0.0f, 0.0f}}; }
+inline Px4 PxLoad(const float* p) { return {{p[0], p[1], p[2], p[3]}}; }
+inline void PxStore(float* p, Px4 a) { memcpy(p, a.v, sizeof(a.v)); }
+inline Px4 PxMulAdd(Px4 acc, Px4 a, float w) {
+    for (int c = 0; c < 4; c++) acc.v[c] += a.v[c] * w;
+    return acc;
+}
+
+#endif
+
+// Separable filter over per-axis taps. With linearLight BGRA8 is decoded
+// from sRGB before filtering and encoded after, otherwise the stored values
+// are filtered as they are.
+class SeparableResampler {
+public:
+    void Configure(FramePixelFormat f, int sw, int sh, int dw, int dh, const FilterTaps& x, const FilterTaps& y,
+                   bool linear) {
+        format = f;
+        linearLight = linear;
+        srcW = sw; srcH = sh; dstW = dw; dstH = dh;
+        wx = x;
+        wy = y;
+        source.resize((size_t)srcW * 4);
+        rows.resize((size_t)wy.maxCount * dstW * 4);
+        rowIndex.assign(wy.maxCount, -1);
+        acc.resize((size_t)dstW * 4);
+        if (format == FramePixelFormat::BGRA8) {
+            for (int i = 0; i < 256; i++) decode[i] = linearLight ? SrgbDecode(i / 255.0f) : i / 255.0f;
+        }
+        if (format == FramePixelFormat::BGRA8 && linearLight) {
+            encode.resize(kEncodeSize);
+            for (int i = 0; i < kEncodeSize; i++) {
+                encode[i] = (uint8_t)(SrgbEncode((float)i / (kEncodeSize - 1)) * 255.0f + 0.5f);
+            }
+        }
+    }
+
+    void Run(const uint8_t* src, size_t srcPitch, uint8_t* dst, size_t dstPitch) {
+        std::fill(rowIndex.begin(), rowIndex.end(), -1);
+        for (int y = 0; y < dstH; y++) {
+            for (int x = 0; x < dstW; x++) PxStore(&acc[x * 4], PxZero());
+            const float* w = &wy.weights[wy.offset[y]];
+            for (int k = 0; k < wy.count[y]; k++) {
+                const float* row = FilteredRow(src, srcPitch, wy.first[y] + k);
+                for (int x = 0; x < dstW; x++) {
+                    PxStore(&acc[x * 4], PxMulAdd(PxLoad(&acc[x * 4]), PxLoad(&row[x * 4]), w[k]));
+                }
+            }
+            StoreRow(dst + (size_t)y * dstPitch);
+        }
+    }
+
+private:
+    static const int kEncodeSize = 16384;   // Linear -> sRGB table, < 0.1 step error near black
+
+    // Source row j filtered horizontally; rows are kept in a ring since
+    // neighboring destination rows share the source rows at their edges
+    const float* FilteredRow(const uint8_t* src, size_t srcPitch, int j) {
+        int slot = j % wy.maxCount;
+        float* row = &rows[(size_t)slot * dstW * 4];
+        if (rowIndex[slot] == j) return row;
+        rowIndex[slot] = j;
+
+        LoadRow(src + (size_t)j * srcPitch);
+        for (int x = 0; x < dstW; x++) {
+            const float* w = &wx.weights[wx.offset[x]];
+            const float* s = &source[(size_t)wx.first[x] * 4];
+            Px4 sum = PxZero();
+            for (int k = 0; k < wx.count[x]; k++) sum = PxMulAdd(sum, PxLoad(s + k * 4), w[k]);
+            PxStore(&row[x * 4], sum);
+        }
+        return row;
+    }
+
+    void LoadRow(const uint8_t* p) {
+        float* out = source.data();
+        if (format == FramePixelFormat::BGRA8) {
+            for (int x = 0; x < srcW; x++, p += 4, out += 4) {
+                out[0] = decode[p[0]];
+                out[1] = decode[p[1]];
+                out[2] = decode[p[2]];
+                out[3] = p[3] * (1.0f / 255.0f);
+            }
+            return;
+        }
+        const uint16_t* h = (const uint16_t*)p;
+#if defined(DOWNSCALE_SIMD_F16C)
+        for (int x = 0; x < srcW; x++) _mm_storeu_ps(out + x * 4, _mm_cvtph_ps(_mm_loadl_epi64((const __m128i*)(h + x * 4))));
+#elif defined(DOWNSCALE_SIMD_NEON)
+        for (int x = 0; x < srcW; x++) vst1q_f32(out + x * 4, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(h + x * 4))));
+#else
+        for (int i = 0; i < srcW * 4; i++) out[i] = HalfToFloat(h[i]);
+#endif
+    }
+
+    void StoreRow(uint8_t* p) {
+        const float* a = acc.data();
+#if defined(DOWNSCALE_SIMD_SSE2)
+        if (format == FramePixelFormat::BGRA8 && !linearLight) {
+            const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+            for (int x = 0; x < dstW; x++, p += 4, a += 4) {
+                __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(a), zero), one);
+                __m128i i = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+                i = _mm_packs_epi32(i, i);
+                uint32_t packed = (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(i, i));
+                memcpy(p, &packed, 4);
+            }
+            return;
+        }
+#endif
+        if (format == FramePixelFormat::BGRA8) {
+            for (int x = 0; x < dstW; x++, p += 4, a += 4) {
+                for (int c = 0; c < 3; c++) {
+                    p[c] = linearLight ? encode[(int)(Saturate(a[c]) * (kEncodeSize - 1) + 0.5f)]
+                                       : (uint8_t)(Saturate(a[c]) * 255.0f + 0.5f);
+                }
+                p[3] = (uint8_t)(Saturate(a[3]) * 255.0f + 0.5f);
+            }
+            return;
+        }
+        uint16_t* h = (uint16_t*)p;
+#if defined(DOWNSCALE_SIMD_F16C)
+        for (int x = 0; x < dstW; x++) {
+            _mm_storel_epi64((__m128i*)(h + x * 4), _mm_cvtps_ph(_mm_loadu_ps(a + x * 4), _MM_FROUND_TO_NEAREST_INT));
+        }
+#elif defined(DOWNSCALE_SIMD_NEON)
+        for (int x = 0; x < dstW; x++) vst1_u16(h + x * 4, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(a + x * 4))));
+#else
+        for (int i = 0; i < dstW * 4; i++) h[i] = FloatToHalf(a[i]);
+#endif
+    }
+
+    FramePixelFormat format = FramePixelFormat::BGRA8;
+    bool linearLight = true;
+    int srcW = 0, srcH = 0, dstW = 0, dstH = 0;
+    FilterTaps wx, wy;
+    std::vector<float> source;      // One decoded source row
+    std::vector<float> rows;        // Ring of horizontally filtered rows
+    std::vector<int> rowIndex;
+    std::vector<float> acc;         // Destination row being blended
+    float decode[256] = {};
+    std::vector<uint8_t> encode;
+};
+
+class AreaDownscaler : public SeparableResampler {
+public:
+    void Configure(FramePixelFormat f, int sw, int sh, int dw, int dh) {
+        FilterTaps x, y;
+        BuildAreaTaps(sw, dw, &x);
+        BuildAreaTaps(sh, dh, &y);
+        SeparableResampler::Configure(f, sw, sh, dw, dh, x, y, true);
+    }
+};
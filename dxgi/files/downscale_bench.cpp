@@ -0,0 +1,232 @@
+// Capture downscale quality and speed check
+//
+// Downscales a synthetic desktop-like frame (zone plate, one-pixel lines and
+// text-sized checkers, an HDR ramp with specular dots for RGBA16F) to each
+// target size three ways:
+//
+//   bilinear   one tap per pixel from a single mip, what the render pass
+//              did with a full-size slot (filters the stored values)
+//   reference  exact area average (downscale.h, double precision)
+//   area       AreaDownscaler, the separable SIMD version
+//
+// Reports Mpix/s of source consumed and PSNR against the reference (8-bit
+// sRGB for BGRA8, PQ-encoded channels for RGBA16F). Exits with 1 if area
+// differs from the reference by more than one 8-bit step or one half-float
+// ULP.
+//
+// Build: cl /O2 /EHsc /arch:AVX2 downscale_bench.cpp    or    g++ -O2 -mf16c downscale_bench.cpp
+//
+// Usage: downscale-bench [--size WxH] [--target WxH]...
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "downscale.h"
+#include "tonemap.h"
+
+struct Image {
+    FramePixelFormat format;
+    int width = 0, height = 0;
+    size_t pitch = 0;
+    std::vector<uint8_t> pixels;
+
+    void Resize(FramePixelFormat f, int w, int h) {
+        format = f;
+        width = w;
+        height = h;
+        pitch = (size_t)w * FrameBytesPerPixel(f);
+        pixels.assign(pitch * h, 0);
+    }
+
+    // Linear RGB (BGRA8 decoded from sRGB)
+    void Get(int x, int y, float rgb[3]) const {
+        const uint8_t* p = pixels.data() + (size_t)y * pitch + (size_t)x * FrameBytesPerPixel(format);
+        if (format == FramePixelFormat::BGRA8) {
+            for (int c = 0; c < 3; c++) rgb[c] = SrgbDecode(p[2 - c] / 255.0f);
+        } else {
+            for (int c = 0; c < 3; c++) rgb[c] = HalfToFloat(((const uint16_t*)p)[c]);
+        }
+    }
+
+    void Set(int x, int y, const float rgb[3]) {
+        uint8_t* p = pixels.data() + (size_t)y * pitch + (size_t)x * FrameBytesPerPixel(format);
+        if (format == FramePixelFormat::BGRA8) {
+            for (int c = 0; c < 3; c++) p[2 - c] = (uint8_t)(SrgbEncode(Saturate(rgb[c])) * 255.0f + 0.5f);
+            p[3] = 255;
+        } else {
+            uint16_t* h = (uint16_t*)p;
+            for (int c = 0; c < 3; c++) h[c] = FloatToHalf(rgb[c]);
+            h[3] = FloatToHalf(1.0f);
+        }
+    }
+};
+
+// Zone plate on the left half, lines and checkers on the right; for RGBA16F
+// the bottom quarter is a luminance ramp up to 1000 nits with bright dots
+static void MakeTestImage(Image* img) {
+    int w = img->width, h = img->height;
+    bool hdr = img->format == FramePixelFormat::RGBA16F;
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            float rgb[3];
+            if (hdr && y >= h * 3 / 4) {
+                float t = (float)x / w;
+                float v = exp2f(-6.0f + t * 10.5f);     // 1.25 .. ~1000 nits
+                bool dot = (x % 37 == 0) && (y % 29 == 0);
+                rgb[0] = rgb[1] = rgb[2] = dot ? 12.5f : v * (0.6f + 0.4f * ((x >> 3) & 1));
+            } else if (x < w / 2) {
+                float cx = x - w / 4.0f, cy = y - h / 2.0f;
+                float v = 0.5f + 0.5f * cosf((cx * cx + cy * cy) * 3.14159265f / (float)w);
+                rgb[0] = v;
+                rgb[1] = v * 0.8f;
+                rgb[2] = 1.0f - v;
+            } else if (y < h / 2) {
+                bool line = (x % 4 == 0) || (y % 5 == 0);
+                rgb[0] = rgb[1] = rgb[2] = line ? 0.02f : 0.9f;
+            } else {
+                bool check = ((x ^ y) & 1) != 0;
+                rgb[0] = check ? 1.0f : 0.0f;
+                rgb[1] = check ? 0.3f : 0.6f;
+                rgb[2] = 0.1f;
+            }
+            if (hdr && y < h * 3 / 4) for (float& c : rgb) c *= 3.0f;    // SDR white at 240 nits
+            img->Set(x, y, rgb);
+        }
+    }
+}
+
+// One bilinear tap at each destination pixel center, on the stored values
+static void DownscaleBilinear(const Image& src, Image* dst) {
+    int bpp = FrameBytesPerPixel(src.format);
+    for (int y = 0; y < dst->height; y++) {
+        float sy = (y + 0.5f) * src.height / dst->height - 0.5f;
+        int y0 = (int)floorf(sy);
+        float fy = sy - y0;
+        int ya = y0 < 0 ? 0 : y0, yb = y0 + 1 >= src.height ? src.height - 1 : y0 + 1;
+        for (int x = 0; x < dst->width; x++) {
+            float sx = (x + 0.5f) * src.width / dst->width - 0.5f;
+            int x0 = (int)floorf(sx);
+            float fx = sx - x0;
+            int xa = x0 < 0 ? 0 : x0, xb = x0 + 1 >= src.width ? src.width - 1 : x0 + 1;
+            const uint8_t* r0 = src.pixels.data() + (size_t)ya * src.pitch;
+            const uint8_t* r1 = src.pixels.data() + (size_t)yb * src.pitch;
+            uint8_t* out = dst->pixels.data() + (size_t)y * dst->pitch + (size_t)x * bpp;
+            for (int c = 0; c < 4; c++) {
+                float v[4];
+                const uint8_t* taps[4] = {r0 + xa * bpp, r0 + xb * bpp, r1 + xa * bpp, r1 + xb * bpp};
+                for (int k = 0; k < 4; k++) {
+                    v[k] = src.format == FramePixelFormat::BGRA8 ? taps[k][c] / 255.0f : HalfToFloat(((const uint16_t*)taps[k])[c]);
+                }
+                float top = v[0] + (v[1] - v[0]) * fx, bottom = v[2] + (v[3] - v[2]) * fx;
+                float r = top + (bottom - top) * fy;
+                if (src.format == FramePixelFormat::BGRA8) out[c] = (uint8_t)(Saturate(r) * 255.0f + 0.5f);
+                else ((uint16_t*)out)[c] = FloatToHalf(r);
+            }
+        }
+    }
+}
+
+// PSNR of the displayed signal: sRGB, or PQ of each channel for HDR
+static double Psnr(const Image& a, const Image& b) {
+    double sum = 0;
+    for (int y = 0; y < a.height; y++) {
+        for (int x = 0; x < a.width; x++) {
+            float ca[3], cb[3];
+            a.Get(x, y, ca);
+            b.Get(x, y, cb);
+            for (int c = 0; c < 3; c++) {
+                double d;
+                if (a.format == FramePixelFormat::BGRA8) d = SrgbEncode(Saturate(ca[c])) - SrgbEncode(Saturate(cb[c]));
+                else d = PqEncode(ca[c] * 80.0f) - PqEncode(cb[c] * 80.0f);
+                sum += d * d;
+            }
+        }
+    }
+    double mse = sum / ((double)a.width * a.height * 3);
+    return mse > 0 ? 10.0 * log10(1.0 / mse) : 99.0;
+}
+
+// Largest difference in 8-bit steps or half-float ULPs
+static int MaxDifference(const Image& a, const Image& b) {
+    int worst = 0;
+    if (a.format == FramePixelFormat::BGRA8) {
+        for (size_t i = 0; i < a.pixels.size(); i++) worst = std::max(worst, abs((int)a.pixels[i] - (int)b.pixels[i]));
+    } else {
+        const uint16_t* ha = (const uint16_t*)a.pixels.data();
+        const uint16_t* hb = (const uint16_t*)b.pixels.data();
+        for (size_t i = 0; i < a.pixels.size() / 2; i++) worst = std::max(worst, abs((int)ha[i] - (int)hb[i]));
+    }
+    return worst;
+}
+
+template <typename F>
+static double SourceMpixPerSecond(const Image& src, F&& run) {
+    auto t0 = std::chrono::steady_clock::now();
+    int runs = 0;
+    double elapsed;
+    do {
+        run();
+        runs++;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    } while (elapsed < 0.5);
+    return (double)src.width * src.height * runs / elapsed / 1e6;
+}
+
+int main(int argc, char** argv) {
+    int w = 3840, h = 2160;
+    std::vector<std::pair<int, int>> targets;
+    for (int i = 1; i < argc; i++) {
+        int tw, th;
+        if (!strcmp(argv[i], "--size") && i+1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0) { fprintf(stderr, "Invalid size\n"); return 1; }
+        }
+        else if (!strcmp(argv[i], "--target") && i+1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &tw, &th) != 2 || tw <= 0 || th <= 0) { fprintf(stderr, "Invalid target\n"); return 1; }
+            targets.push_back({tw, th});
+        }
+        else { fprintf(stderr, "Usage: %s [--size WxH] [--target WxH]...\n", argv[0]); return 1; }
+    }
+    if (targets.empty()) targets = {{2560, 1440}, {1920, 1080}, {1280, 720}};
+
+    printf("Area downscale, %s\n\n", DownscaleSimdName());
+    printf("%-8s %-22s %12s %12s %14s %10s %10s %9s\n", "format", "size", "ref Mpix/s", "area Mpix/s",
+           "bilin Mpix/s", "bilin PSNR", "area PSNR", "area diff");
+
+    bool ok = true;
+    for (FramePixelFormat f : {FramePixelFormat::BGRA8, FramePixelFormat::RGBA16F}) {
+        Image src;
+        src.Resize(f, w, h);
+        MakeTestImage(&src);
+        for (auto [tw, th] : targets) {
+            if (tw > w || th > h) { printf("%dx%d is not a downscale of %dx%d, skipped\n", tw, th, w, h); continue; }
+            Image ref, area, bilinear;
+            ref.Resize(f, tw, th);
+            area.Resize(f, tw, th);
+            bilinear.Resize(f, tw, th);
+
+            AreaDownscaler scaler;
+            scaler.Configure(f, w, h, tw, th);
+            double refRate = SourceMpixPerSecond(src, [&] {
+                DownscaleAreaReference(f, src.pixels.data(), src.pitch, w, h, ref.pixels.data(), ref.pitch, tw, th);
+            });
+            double areaRate = SourceMpixPerSecond(src, [&] {
+                scaler.Run(src.pixels.data(), src.pitch, area.pixels.data(), area.pitch);
+            });
+            double bilinearRate = SourceMpixPerSecond(src, [&] { DownscaleBilinear(src, &bilinear); });
+
+            int diff = MaxDifference(ref, area);
+            bool failed = diff > 1;
+            if (failed) ok = false;
+            char size[32];
+            snprintf(size, sizeof(size), "%dx%d -> %dx%d", w, h, tw, th);
+            printf("%-8s %-22s %12.0f %12.0f %14.0f %9.1fdB %9.1fdB %9d%s\n", FramePixelFormatName(f), size,
+                   refRate, areaRate, bilinearRate, Psnr(ref, bilinear), Psnr(ref, area), diff, failed ? "  FAILED" : "");
+        }
+    }
+
+    if (!ok) printf("\nFAILED\n");
+    return ok ? 0 : 1;
+}
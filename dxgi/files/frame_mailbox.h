@@ -0,0 +1,104 @@
+// Lock-free single-producer / single-consumer frame mailbox
+//
+// Generalizes the triple buffer to N slots. Every slot index is owned by
+// exactly one party at any time:
+//
+//   producer:  the slot being written + a FIFO of spare slots
+//   mailbox:   the "ready" slot (index + fresh flag, one atomic int)
+//   consumer:  the slot being displayed
+//
+// Publishing swaps the written slot into "ready" and takes back whatever was
+// there; acquiring swaps the displayed slot into "ready" if a fresh frame is
+// waiting. Both hand-offs are a single atomic exchange, so there is no window
+// where the two sides can pick the same slot.
+//
+// With more than 3 slots the producer cycles through its spare FIFO, so a slot
+// that was just given back by the consumer is not rewritten for N-2 frames.
+// That gives in-flight GPU work that sampled it time to drain, which matters
+// when capture and render run on separate devices at high source rates.
+//
+// Portable C++17, no D3D types.
+
+#pragma once
+
+#include <atomic>
+
+template <typename Payload, int N>
+class FrameMailbox {
+    static_assert(N >= 3, "FrameMailbox needs at least 3 slots");
+
+public:
+    Payload slots[N] = {};
+
+    FrameMailbox() { Reset(N); }
+
+    // Not thread-safe: call before the producer and consumer start
+    void Reset(int slotCount) {
+        count = slotCount < 3 ? 3 : (slotCount > N ? N : slotCount);
+        write = 0;
+        spareHead = 0;
+        spareCount = 0;
+        for (int i = 1; i < count - 2; i++) spare[spareCount++] = i;
+        ready.store(count - 2, std::memory_order_relaxed);
+        display = count - 1;
+        hasDisplay = false;
+    }
+
+    int SlotCount() const { return count; }
+
+    // Producer: slot to fill next
+    int GetWriteIndex() const { return write; }
+
+    // Producer: publish the write slot. Returns true if this replaced a frame
+    // the consumer never picked up (i.e. a frame was dropped).
+    bool PublishFrame() {
+        int old = ready.exchange(write | kFresh, std::memory_order_acq_rel);
+        spare[(spareHead + spareCount) % N] = old & kIndexMask;
+        spareCount++;
+        write = spare[spareHead];
+        spareHead = (spareHead + 1) % N;
+        spareCount--;
+        return (old & kFresh) != 0;
+    }
+
+    // Consumer: pick up the newest published frame, if any. Returns the slot to
+    // display (the previous one if nothing new arrived), or -1 before the first
+    // publish. isNew is set when the returned slot was not displayed before.
+    int AcquireFrame(bool* isNew = nullptr) {
+        bool fresh = (ready.load(std::memory_order_relaxed) & kFresh) != 0;
+        if (fresh) {
+            int r = ready.exchange(display, std::memory_order_acq_rel);
+            display = r & kIndexMask;
+            hasDisplay = true;
+        }
+        if (isNew) *isNew = fresh;
+        return hasDisplay ? display : -1;
+    }
+
+    // Consumer: whether AcquireFrame would pick up a new frame
+    bool HasNewFrame() const { return (ready.load(std::memory_order_relaxed) & kFresh) != 0; }
+
+    // Consumer: slot returned by the last AcquireFrame (-1 before the first frame)
+    int DisplayIndex() const { return hasDisplay ? display : -1; }
+
+    // Debug only - racy snapshot of the ready slot
+    int PeekReady() const { return ready.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr int kFresh = 0x100;
+    static constexpr int kIndexMask = 0xFF;
+
+    int count = N;
+
+    // Shared
+    std::atomic<int> ready{0};
+
+    // Producer only
+    int write = 0;
+    int spare[N] = {};
+    int spareHead = 0, spareCount = 0;
+
+    // Consumer only
+    int display = 0;
+    bool hasDisplay = false;
+};
@@ -0,0 +1,156 @@
+// Frame mailbox stress test (frame_mailbox.h)
+//
+// A producer thread publishes --iterations frames into a FrameMailbox as
+// fast as it can, the way the capture thread does; a consumer thread
+// acquires the newest one in a loop, the way the render thread does. Run
+// with 3 and 4 slots. Slot payloads are plain memory, derived from the frame
+// id, and the consumer checks its slot, yields while holding it and checks
+// it again, so a slot the producer rewrites while it is displayed is a torn
+// read. The id must never go backwards, and a frame reported new must be
+// newer than the last one. Every frame is either acquired or reported
+// dropped by PublishFrame, and the last one is always acquired.
+//
+// Prints publish and acquire latency (p50/p99/max, sampled), drops and the
+// share of acquires that found nothing new (stale). Exits with 1 on any
+// torn or backwards read or a miscount.
+//
+// Build it with -fsanitize=thread (g++ / clang) to have the slot ownership
+// checked as well: a payload access the mailbox does not order is a race.
+//
+// Build: cl /O2 /EHsc frame_mailbox_stress.cpp    or    g++ -O2 -pthread frame_mailbox_stress.cpp
+//
+// Usage: frame-mailbox-stress [--iterations N]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "frame_mailbox.h"
+
+// Stands in for a capture slot: the id and a pattern derived from it
+struct StressPayload {
+    static const int kWords = 64;
+    uint64_t id;
+    uint32_t words[kWords];
+};
+
+static uint32_t PatternWord(uint64_t id, int i) {
+    return (uint32_t)(id * 0x9E3779B1u) ^ (uint32_t)(i * 0x85EBCA77u);
+}
+
+static bool PayloadMatches(const StressPayload& p) {
+    for (int i = 0; i < StressPayload::kWords; i++) {
+        if (p.words[i] != PatternWord(p.id, i)) return false;
+    }
+    return true;
+}
+
+// Every kSampleEvery-th call is timed, so timing does not dominate the loop
+const int kSampleEvery = 16;
+
+struct LatencySamples {
+    std::vector<int64_t> ns;
+
+    void Add(std::chrono::steady_clock::time_point t0) {
+        ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count());
+    }
+
+    void Print(const char* name) {
+        std::sort(ns.begin(), ns.end());
+        if (ns.empty()) return;
+        printf("  %-8s %6lld / %6lld / %8lld ns (p50/p99/max)\n", name, (long long)ns[ns.size() / 2],
+               (long long)ns[ns.size() * 99 / 100], (long long)ns.back());
+    }
+};
+
+template <int N>
+static bool Run(uint64_t iterations) {
+    static FrameMailbox<StressPayload, N> mailbox;    // Static: 4 slots of payload are too much stack for TSan builds
+    mailbox.Reset(N);
+    std::atomic<bool> done{false};
+    LatencySamples publishNs, acquireNs;
+    uint64_t dropped = 0;
+
+    uint64_t acquires = 0, fresh = 0, stale = 0, torn = 0, backwards = 0, last = 0;
+    std::thread consumer([&] {
+        for (;;) {
+            bool finished = done.load(std::memory_order_acquire);   // Before the acquire: nothing can follow it
+            bool isNew = false;
+            auto t0 = std::chrono::steady_clock::now();
+            int index = mailbox.AcquireFrame(&isNew);
+            if (acquires++ % kSampleEvery == 0) acquireNs.Add(t0);
+            if (index >= 0) {
+                const StressPayload& p = mailbox.slots[index];
+                uint64_t id = p.id;
+                bool match = PayloadMatches(p);
+                if ((acquires & 7) == 0) std::this_thread::yield();   // Hold the slot across a reschedule, even on one core
+                match = match && p.id == id && PayloadMatches(p);
+                if (!match) torn++;
+                if (isNew) {
+                    fresh++;
+                    if (id <= last) backwards++;
+                } else {
+                    stale++;
+                    if (id != last) backwards++;
+                }
+                last = id;
+            }
+            if (finished && !isNew) break;
+        }
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t id = 1; id <= iterations; id++) {
+        StressPayload& p = mailbox.slots[mailbox.GetWriteIndex()];
+        p.id = id;
+        for (int i = 0; i < StressPayload::kWords; i++) p.words[i] = PatternWord(id, i);
+        auto t0 = std::chrono::steady_clock::now();
+        if (mailbox.PublishFrame()) dropped++;
+        if (id % kSampleEvery == 0) publishNs.Add(t0);
+        if ((id & 3) == 0) std::this_thread::yield();     // Let the consumer in between publishes, even on one core
+    }
+    done.store(true, std::memory_order_release);
+    consumer.join();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    bool ok = torn == 0 && backwards == 0 && fresh + dropped == iterations && last == iterations;
+    printf("%d slots: %llu frames in %.2fs (%.1f M/s), %llu acquired, %llu dropped\n", N, (unsigned long long)iterations,
+           elapsed, iterations / elapsed / 1e6, (unsigned long long)fresh, (unsigned long long)dropped);
+    publishNs.Print("publish");
+    acquireNs.Print("acquire");
+    printf("  %llu acquires, %.1f%% stale, %llu torn, %llu backwards\n", (unsigned long long)acquires,
+           acquires ? 100.0 * stale / acquires : 0.0, (unsigned long long)torn, (unsigned long long)backwards);
+    if (fresh + dropped != iterations) {
+        printf("  FAILED: %llu acquired + %llu dropped != %llu published\n", (unsigned long long)fresh,
+               (unsigned long long)dropped, (unsigned long long)iterations);
+    }
+    if (last != iterations) printf("  FAILED: the last frame seen is %llu, not %llu\n", (unsigned long long)last, (unsigned long long)iterations);
+    if (torn || backwards) printf("  FAILED\n");
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    uint64_t iterations = 5000000;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--iterations") && i+1 < argc) iterations = strtoull(argv[++i], nullptr, 10);
+        else {
+            fprintf(stderr, "Usage: %s [--iterations N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (iterations == 0) {
+        fprintf(stderr, "Need --iterations > 0\n");
+        return 1;
+    }
+
+    bool ok = Run<3>(iterations);
+    printf("\n");
+    ok = Run<4>(iterations) && ok;
+    if (!ok) printf("\nFAILED\n");
+    return ok ? 0 : 1;
+}
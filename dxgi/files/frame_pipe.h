@@ -0,0 +1,480 @@
+// Raw frame output for external encoders (--output-pipe)
+//
+// FramePipe takes captured frames in their slot format, converts them to
+// NV12 (SDR) or P010 (HDR) with YuvConverter and writes them to stdout, a
+// file or a pipe, all on its own thread. Two containers:
+//
+//   y4m    YUV4MPEG2, planar: C420jpeg (8-bit, center-sited chroma, the
+//          2x2 average) or C420p10 (10-bit samples in 16-bit words).
+//          Limited range (XCOLORRANGE=LIMITED). The F rate is nominal:
+//          frames are written as they are captured.
+//   raw    Each frame is a FramePipeHeader followed by the converted frame
+//          exactly as YuvConverter lays it out (pitch-padded NV12 or P010).
+//          The header carries the frame id and capture time, so consumers
+//          can follow the real cadence and see drops.
+//
+// The capture thread never waits: Push copies the frame into one of a fixed
+// pool of buffers and returns. When queueFrames frames are already waiting,
+// the drop policy decides which frame is lost: Oldest replaces the oldest
+// waiting frame (lowest latency), Newest drops the frame being pushed (what
+// the consumer gets stays contiguous up to the gap).
+//
+// Opening the output happens on the writer thread too, so a named pipe
+// nobody reads yet doesn't hold up capture either: frames are dropped by the
+// same policy until the consumer connects. "-" is stdout; the stream takes
+// over its descriptor and stdout is pointed at stderr, so console output
+// can't corrupt it. On Windows a \\.\pipe\ path creates the pipe server that
+// the consumer (e.g. ffmpeg -i \\.\pipe\name) connects to; on POSIX a FIFO
+// from mkfifo works the same way.
+//
+// Portable C++17.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "yuv_convert.h"
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+enum class FramePipeContainer {
+    Y4m,
+    Raw,
+};
+
+inline const char* FramePipeContainerName(FramePipeContainer c) { return c == FramePipeContainer::Y4m ? "y4m" : "raw"; }
+
+inline bool ParseFramePipeContainer(const char* name, FramePipeContainer* c) {
+    if (!strcmp(name, "y4m")) { *c = FramePipeContainer::Y4m; return true; }
+    if (!strcmp(name, "raw")) { *c = FramePipeContainer::Raw; return true; }
+    return false;
+}
+
+// Which frame goes when the queue is full
+enum class FramePipeDrop {
+    Oldest,     // The oldest waiting frame makes room for the new one
+    Newest,     // The new frame is dropped
+};
+
+inline const char* FramePipeDropName(FramePipeDrop d) { return d == FramePipeDrop::Oldest ? "oldest" : "newest"; }
+
+inline bool ParseFramePipeDrop(const char* name, FramePipeDrop* d) {
+    if (!strcmp(name, "oldest")) { *d = FramePipeDrop::Oldest; return true; }
+    if (!strcmp(name, "newest")) { *d = FramePipeDrop::Newest; return true; }
+    return false;
+}
+
+const uint32_t kFramePipeMagic = 0x50495046;    // "FPIP"
+
+// Raw container: precedes every frame. Little-endian, 64 bytes; readers skip
+// headerBytes so fields can be added at the end.
+struct FramePipeHeader {
+    uint32_t magic;
+    uint32_t headerBytes;
+    uint32_t format;            // 1 = NV12, 2 = P010
+    uint32_t width, height;     // Picture size; the frame is padded to 4 columns, 2 rows
+    uint32_t pitch;             // Bytes per row, both planes
+    uint32_t chromaOffset;      // From the end of this header to the CbCr plane
+    uint32_t frameBytes;        // Follow this header
+    uint64_t frameId;           // Counts captured frames, gaps are drops
+    int64_t captureTime;        // Ticks of clockFrequency
+    int64_t sourcePresentTime;  // Same clock, 0 = unknown
+    int64_t clockFrequency;
+};
+
+static_assert(sizeof(FramePipeHeader) == 64, "FramePipeHeader is part of the raw format");
+
+struct FramePipeConfig {
+    FramePipeContainer container = FramePipeContainer::Y4m;
+    YuvSource source = YuvSource::Bgra8;    // Slot layout of the pushed pixels
+    int width = 0, height = 0;
+    double frameRate = 60.0;                // Y4M header only
+    int64_t clockFrequency = 1;             // Raw header
+    int queueFrames = 3;
+    FramePipeDrop drop = FramePipeDrop::Oldest;
+};
+
+// Y4M rate as a fraction (59.94 -> 59940:1000)
+inline void Y4mRate(double hz, uint32_t* num, uint32_t* den) {
+    if (!(hz > 0)) hz = 60.0;
+    if (fabs(hz - lround(hz)) < 1e-3) {
+        *num = (uint32_t)lround(hz);
+        *den = 1;
+    } else {
+        *num = (uint32_t)lround(hz * 1000.0);
+        *den = 1000;
+    }
+}
+
+inline std::string Y4mHeader(YuvFormat format, int width, int height, double hz) {
+    uint32_t num, den;
+    Y4mRate(hz, &num, &den);
+    char text[160];
+    snprintf(text, sizeof(text), "YUV4MPEG2 W%d H%d F%u:%u Ip A1:1 %s XCOLORRANGE=LIMITED\n", width, height, num, den,
+             format == YuvFormat::Nv12 ? "C420jpeg XYSCSS=420JPEG" : "C420p10 XYSCSS=420P10");
+    return text;
+}
+
+// One YuvConverter frame as Y4M planes (Y, Cb, Cr; padding dropped, P010
+// samples shifted down to 10 bits)
+inline void YuvToY4mPlanes(const YuvLayout& l, YuvFormat format, const uint8_t* yuv, std::vector<uint8_t>* out) {
+    int cw = (l.width + 1) / 2, ch = (l.height + 1) / 2;
+    size_t sample = format == YuvFormat::Nv12 ? 1 : 2;
+    out->resize(((size_t)l.width * l.height + (size_t)cw * ch * 2) * sample);
+    uint8_t* dst = out->data();
+    for (int y = 0; y < l.height; y++) {
+        const uint8_t* row = yuv + (size_t)y * l.pitch;
+        if (sample == 1) {
+            memcpy(dst, row, l.width);
+            dst += l.width;
+        } else {
+            for (int x = 0; x < l.width; x++) {
+                uint16_t v = (uint16_t)((row[x * 2] | row[x * 2 + 1] << 8) >> 6);
+                dst[0] = (uint8_t)v;
+                dst[1] = (uint8_t)(v >> 8);
+                dst += 2;
+            }
+        }
+    }
+    for (int c = 0; c < 2; c++) {
+        for (int y = 0; y < ch; y++) {
+            const uint8_t* row = yuv + l.chromaOffset + (size_t)y * l.pitch;
+            for (int x = 0; x < cw; x++) {
+                if (sample == 1) {
+                    *dst++ = row[x * 2 + c];
+                } else {
+                    const uint8_t* p = row + (x * 2 + c) * 2;
+                    uint16_t v = (uint16_t)((p[0] | p[1] << 8) >> 6);
+                    dst[0] = (uint8_t)v;
+                    dst[1] = (uint8_t)(v >> 8);
+                    dst += 2;
+                }
+            }
+        }
+    }
+}
+
+struct FramePipeFrame {
+    uint64_t frameId = 0;
+    int64_t captureTime = 0;
+    int64_t sourcePresentTime = 0;
+};
+
+class FramePipe {
+public:
+    FramePipe() = default;
+    FramePipe(const FramePipe&) = delete;
+    FramePipe& operator=(const FramePipe&) = delete;
+    ~FramePipe() { Close(); }
+
+    // Starts the writer thread, which opens path. Errors after this point
+    // (open, a consumer that went away) show up in Broken() / Error().
+    bool Open(const char* path, const FramePipeConfig& c, std::string* error) {
+        Close();
+        if (!strcmp(path, "-")) {
+            int out = TakeOverStdout(error);
+            return out >= 0 && Start("", out, c, error);
+        }
+        return Start(path, -1, c, error);
+    }
+
+    // A descriptor for the stdout stream, with stdout itself pointed at
+    // stderr from here on. Call before printing anything that would end up
+    // in the stream if the pipe is opened later. -1 on failure.
+    static int TakeOverStdout(std::string* error) {
+        fflush(stdout);
+#if defined(_WIN32)
+        int out = _dup(_fileno(stdout));
+        if (out >= 0) {
+            _setmode(out, _O_BINARY);
+            _dup2(_fileno(stderr), _fileno(stdout));
+        }
+#else
+        int out = dup(fileno(stdout));
+        if (out >= 0) dup2(fileno(stderr), fileno(stdout));
+#endif
+        if (out < 0) *error = std::string("cannot take over stdout: ") + strerror(errno);
+        return out;
+    }
+
+    // Writes to a descriptor the caller opened (and hands over)
+    bool OpenFd(int output, const FramePipeConfig& c, std::string* error) {
+        Close();
+        return Start("", output, c, error);
+    }
+
+    bool IsOpen() const { return writer.joinable(); }
+    YuvFormat Format() const { return format; }
+
+    // Copies the frame (rows of width * bytes per pixel) and returns at once.
+    // False if the frame was dropped or the pipe is broken.
+    bool Push(const FramePipeFrame& frame, const uint8_t* pixels, size_t pitch) {
+        int index;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (broken) return false;
+            if (!spare.empty()) {
+                index = spare.back();
+                spare.pop_back();
+            } else if (config.drop == FramePipeDrop::Oldest && !queue.empty()) {
+                index = queue.front();
+                queue.pop_front();
+                dropped++;
+            } else {
+                dropped++;
+                return false;
+            }
+        }
+        Buffer& b = buffers[index];
+        for (int y = 0; y < config.height; y++) memcpy(b.pixels.data() + y * rowBytes, pixels + y * pitch, rowBytes);
+        b.frame = frame;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(index);
+        }
+        wake.notify_one();
+        return true;
+    }
+
+    uint64_t Written() const { return written.load(std::memory_order_relaxed); }
+    uint64_t Dropped() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return dropped;
+    }
+    bool Broken() const { return broken.load(std::memory_order_acquire); }
+    std::string Error() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return errorText;
+    }
+
+    // drain: write the frames still queued first (a consumer that stopped
+    // reading without closing its end holds this up). Otherwise only the
+    // frame being written is finished.
+    void Close(bool drain = false) {
+        if (!writer.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            if (!drain) {
+                dropped += queue.size();
+                for (int i : queue) spare.push_back(i);
+                queue.clear();
+            }
+        }
+        wake.notify_one();
+        while (opening) {
+            UnblockOpen();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        writer.join();
+    }
+
+private:
+    struct Buffer {
+        std::vector<uint8_t> pixels;
+        FramePipeFrame frame;
+    };
+
+    bool Start(const char* outputPath, int output, const FramePipeConfig& c, std::string* error) {
+        if (c.width <= 0 || c.height <= 0 || c.queueFrames < 1) {
+            *error = "bad frame size or queue length";
+            if (output >= 0) CloseFd(output);
+            return false;
+        }
+#if !defined(_WIN32)
+        signal(SIGPIPE, SIG_IGN);   // A consumer that exits is a write error, not the end of the mirror
+#endif
+        config = c;
+        path = outputPath;
+        fd = output;
+        format = YuvSourceIsHdr(c.source) ? YuvFormat::P010 : YuvFormat::Nv12;
+        converter.Configure(format, c.source, c.width, c.height);
+        rowBytes = (size_t)c.width * YuvSourceBytesPerPixel(c.source);
+        buffers.assign(c.queueFrames + 2, Buffer());  // Queue + one being written + one being filled
+        for (Buffer& b : buffers) b.pixels.resize(rowBytes * c.height);
+        spare.clear();
+        queue.clear();
+        for (int i = 0; i < (int)buffers.size(); i++) spare.push_back(i);
+        written = 0;
+        dropped = 0;
+        broken = false;
+        opening = fd < 0;
+        stopping = false;
+        errorText.clear();
+        writer = std::thread(&FramePipe::WriterThread, this);
+        return true;
+    }
+
+    static void CloseFd(int f) {
+#if defined(_WIN32)
+        _close(f);
+#else
+        close(f);
+#endif
+    }
+
+    void Fail(const std::string& what) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (errorText.empty()) errorText = what;
+        broken.store(true, std::memory_order_release);
+        dropped += queue.size();
+        for (int i : queue) spare.push_back(i);
+        queue.clear();
+    }
+
+    bool OpenOutput() {
+        if (fd >= 0) return true;
+#if defined(_WIN32)
+        if (!_strnicmp(path.c_str(), "\\\\.\\pipe\\", 9)) {
+            HANDLE h = CreateNamedPipeA(path.c_str(), PIPE_ACCESS_OUTBOUND, PIPE_TYPE_BYTE | PIPE_WAIT, 1,
+                                        1 << 20, 0, 0, nullptr);
+            if (h == INVALID_HANDLE_VALUE) {
+                Fail("CreateNamedPipe " + path + " failed (error " + std::to_string(GetLastError()) + ")");
+                return false;
+            }
+            if (!ConnectNamedPipe(h, nullptr) && GetLastError() != ERROR_PIPE_CONNECTED) {
+                CloseHandle(h);
+                Fail("ConnectNamedPipe " + path + " failed (error " + std::to_string(GetLastError()) + ")");
+                return false;
+            }
+            fd = _open_osfhandle((intptr_t)h, 0);
+        } else {
+            fd = _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, 0644);
+        }
+#else
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);   // A FIFO waits here for its reader
+#endif
+        if (fd < 0) {
+            Fail("cannot open " + path + ": " + strerror(errno));
+            return false;
+        }
+        return true;
+    }
+
+    // Close while the writer still waits for a consumer: connect one
+    void UnblockOpen() {
+#if defined(_WIN32)
+        if (!_strnicmp(path.c_str(), "\\\\.\\pipe\\", 9)) {
+            HANDLE h = CreateFileA(path.c_str(), GENERIC_READ, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+            if (h != INVALID_HANDLE_VALUE) CloseHandle(h);
+        }
+#else
+        int r = open(path.c_str(), O_RDONLY | O_NONBLOCK);
+        if (r >= 0) close(r);
+#endif
+    }
+
+    bool WriteAll(const void* data, size_t bytes) {
+        const uint8_t* p = (const uint8_t*)data;
+        while (bytes > 0) {
+#if defined(_WIN32)
+            int n = _write(fd, p, (unsigned)std::min(bytes, (size_t)1 << 30));
+#else
+            ssize_t n = write(fd, p, bytes);
+            if (n < 0 && errno == EINTR) continue;
+#endif
+            if (n <= 0) {
+                Fail(std::string("write failed: ") + strerror(errno));
+                return false;
+            }
+            p += n;
+            bytes -= (size_t)n;
+        }
+        return true;
+    }
+
+    void WriterThread() {
+        bool ok = OpenOutput();
+        opening = false;
+        if (ok && config.container == FramePipeContainer::Y4m) {
+            std::string header = Y4mHeader(format, config.width, config.height, config.frameRate);
+            ok = WriteAll(header.data(), header.size());
+        }
+        std::vector<uint8_t> yuv(converter.layout.size), planes;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (ok) {
+            wake.wait(lock, [this] { return !queue.empty() || stopping; });
+            if (queue.empty()) break;
+            int index = queue.front();
+            queue.pop_front();
+            lock.unlock();
+
+            const Buffer& b = buffers[index];
+            converter.Convert(b.pixels.data(), rowBytes, yuv.data());
+            if (config.container == FramePipeContainer::Y4m) {
+                YuvToY4mPlanes(converter.layout, format, yuv.data(), &planes);
+                ok = WriteAll("FRAME\n", 6) && WriteAll(planes.data(), planes.size());
+            } else {
+                FramePipeHeader h = {};
+                h.magic = kFramePipeMagic;
+                h.headerBytes = sizeof(h);
+                h.format = format == YuvFormat::Nv12 ? 1 : 2;
+                h.width = (uint32_t)config.width;
+                h.height = (uint32_t)config.height;
+                h.pitch = (uint32_t)converter.layout.pitch;
+                h.chromaOffset = (uint32_t)converter.layout.chromaOffset;
+                h.frameBytes = (uint32_t)converter.layout.size;
+                h.frameId = b.frame.frameId;
+                h.captureTime = b.frame.captureTime;
+                h.sourcePresentTime = b.frame.sourcePresentTime;
+                h.clockFrequency = config.clockFrequency;
+                ok = WriteAll(&h, sizeof(h)) && WriteAll(yuv.data(), yuv.size());
+            }
+            if (ok) written.fetch_add(1, std::memory_order_relaxed);
+
+            lock.lock();
+            spare.push_back(index);
+        }
+        if (lock.owns_lock()) lock.unlock();
+        if (fd >= 0) CloseFd(fd);
+        fd = -1;
+    }
+
+    FramePipeConfig config;
+    std::string path;
+    int fd = -1;
+    YuvFormat format = YuvFormat::Nv12;
+    YuvConverter converter;
+    size_t rowBytes = 0;
+
+    std::vector<Buffer> buffers;
+    std::vector<int> spare;     // Buffer indices nobody holds
+    std::deque<int> queue;      // Waiting to be written, oldest first
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::thread writer;
+    bool stopping = false;
+    uint64_t dropped = 0;
+    std::atomic<uint64_t> written{0};
+    std::atomic<bool> broken{false};
+    std::atomic<bool> opening{false};
+    std::string errorText;
+};
@@ -0,0 +1,461 @@
+// Frame pipe (frame_pipe.h) check
+//
+// Drives FramePipe from the synthetic frame source, the way --output-pipe
+// feeds it from the capture thread, and reads back what it wrote:
+//
+//   file           y4m and raw, nv12 and p010, and an odd size, with a queue
+//                  long enough that nothing drops: every frame comes back
+//                  equal to ConvertToYuvReference of the frame pushed.
+//   slow           raw through an OS pipe whose reader takes 6 frame times
+//                  per frame, once per drop policy. Push must never wait and
+//                  frames drop as the policy says (oldest: the last frame
+//                  pushed arrives; newest: the first ones do). What arrives
+//                  is intact and in order.
+//   gone           the reader closes its end: the pipe turns broken and Push
+//                  still returns at once.
+//   no reader      (POSIX) a FIFO nobody opens: every frame drops, and
+//                  Close does not hang.
+//
+// Exits with 1 on any failure.
+//
+// Build: cl /O2 /EHsc /arch:AVX2 frame_pipe_check.cpp    or    g++ -O2 -mavx2 -pthread frame_pipe_check.cpp
+//
+// Usage: frame-pipe-check
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frame_pipe.h"
+#include "frame_source.h"
+
+#if defined(_WIN32)
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+typedef std::map<uint64_t, std::vector<uint8_t>> FrameMap;
+
+static double Seconds(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+}
+
+struct Produced {
+    FrameMap frames;            // Source pixels of every frame pushed, by id
+    std::map<uint64_t, std::pair<int64_t, int64_t>> times;  // Capture and source present time, by id
+    uint64_t pushed = 0;
+    double maxPushMs = 0;
+};
+
+// Pushes synthetic frames for the given time, as the capture thread would
+static void Produce(const SyntheticSourceDesc& d, double seconds, FramePipe* pipe, Produced* out) {
+    SyntheticFrameSource source(d);
+    auto start = std::chrono::steady_clock::now();
+    while (Seconds(start) < seconds) {
+        FrameInfo info;
+        if (source.AcquireFrame(100, &info) != FrameStatus::Ok) continue;
+        FramePipeFrame frame = {++out->pushed, FrameClockNow(), info.lastPresentTime};
+        out->frames[frame.frameId].assign(info.pixels, info.pixels + (size_t)info.pitch * info.height);
+        out->times[frame.frameId] = {frame.captureTime, frame.sourcePresentTime};
+        auto t0 = std::chrono::steady_clock::now();
+        pipe->Push(frame, info.pixels, info.pitch);
+        out->maxPushMs = std::max(out->maxPushMs, Seconds(t0) * 1000.0);
+        source.ReleaseFrame();
+    }
+}
+
+static YuvSource SourceOf(const SyntheticSourceDesc& d) {
+    return d.format == FramePixelFormat::RGBA16F ? YuvSource::Rgba16F : YuvSource::Bgra8;
+}
+
+// What the pipe should have written for one source frame (YuvConverter layout)
+static std::vector<uint8_t> Expected(const SyntheticSourceDesc& d, const std::vector<uint8_t>& pixels) {
+    YuvConverter c;
+    YuvSource s = SourceOf(d);
+    c.Configure(YuvSourceIsHdr(s) ? YuvFormat::P010 : YuvFormat::Nv12, s, d.width, d.height);
+    std::vector<uint8_t> yuv(c.layout.size);
+    ConvertToYuvReference(s, pixels.data(), (size_t)d.width * YuvSourceBytesPerPixel(s), c.layout, c.tables, yuv.data());
+    return yuv;
+}
+
+struct RawFrame {
+    FramePipeHeader header;
+    std::vector<uint8_t> data;
+};
+
+// Splits a raw stream into frames; false if it is malformed
+static bool ParseRaw(const std::vector<uint8_t>& stream, std::vector<RawFrame>* frames, std::string* error) {
+    size_t pos = 0;
+    while (pos < stream.size()) {
+        RawFrame f;
+        if (stream.size() - pos < sizeof(f.header)) { *error = "truncated header"; return false; }
+        memcpy(&f.header, stream.data() + pos, sizeof(f.header));
+        if (f.header.magic != kFramePipeMagic || f.header.headerBytes != sizeof(f.header)) {
+            *error = "bad header";
+            return false;
+        }
+        pos += f.header.headerBytes;
+        if (stream.size() - pos < f.header.frameBytes) { *error = "truncated frame"; return false; }
+        f.data.assign(stream.begin() + pos, stream.begin() + pos + f.header.frameBytes);
+        pos += f.header.frameBytes;
+        frames->push_back(std::move(f));
+    }
+    return true;
+}
+
+// Checks raw frames against the frames pushed: right ids, layout and pixels
+static bool CheckRaw(const SyntheticSourceDesc& d, const Produced& p, const std::vector<RawFrame>& frames,
+                     std::string* error) {
+    YuvSource s = SourceOf(d);
+    YuvLayout l = MakeYuvLayout(YuvSourceIsHdr(s) ? YuvFormat::P010 : YuvFormat::Nv12, d.width, d.height);
+    uint64_t lastId = 0;
+    for (const RawFrame& f : frames) {
+        const FramePipeHeader& h = f.header;
+        if (h.format != (YuvSourceIsHdr(s) ? 2u : 1u) || h.width != d.width || h.height != d.height ||
+            h.pitch != l.pitch || h.chromaOffset != l.chromaOffset || h.frameBytes != l.size) {
+            *error = "header of frame " + std::to_string(h.frameId) + " does not match the layout";
+            return false;
+        }
+        if (h.frameId <= lastId) {
+            *error = "frame " + std::to_string(h.frameId) + " out of order";
+            return false;
+        }
+        lastId = h.frameId;
+        auto times = p.times.find(h.frameId);
+        if (times == p.times.end() || h.captureTime != times->second.first ||
+            h.sourcePresentTime != times->second.second || h.clockFrequency != FrameClockFrequency()) {
+            *error = "times of frame " + std::to_string(h.frameId) + " do not match";
+            return false;
+        }
+        auto it = p.frames.find(h.frameId);
+        if (it == p.frames.end() || f.data != Expected(d, it->second)) {
+            *error = "frame " + std::to_string(h.frameId) + " differs from the reference";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Y4M planes straight from the layout, sample by sample (not through
+// YuvToY4mPlanes, which is what is being checked)
+static std::vector<uint8_t> Y4mPlanes(const YuvLayout& l, YuvFormat format, const std::vector<uint8_t>& yuv) {
+    bool wide = format == YuvFormat::P010;
+    auto sample = [&](size_t offset) {
+        return wide ? (uint32_t)(yuv[offset] | yuv[offset + 1] << 8) >> 6 : (uint32_t)yuv[offset];
+    };
+    std::vector<uint32_t> samples;
+    for (int y = 0; y < l.height; y++) {
+        for (int x = 0; x < l.width; x++) samples.push_back(sample(y * l.pitch + x * (wide ? 2 : 1)));
+    }
+    for (int c = 0; c < 2; c++) {
+        for (int y = 0; y < (l.height + 1) / 2; y++) {
+            for (int x = 0; x < (l.width + 1) / 2; x++) {
+                samples.push_back(sample(l.chromaOffset + y * l.pitch + (x * 2 + c) * (wide ? 2 : 1)));
+            }
+        }
+    }
+    std::vector<uint8_t> out;
+    for (uint32_t v : samples) {
+        out.push_back((uint8_t)v);
+        if (wide) out.push_back((uint8_t)(v >> 8));
+    }
+    return out;
+}
+
+static bool CheckY4m(const SyntheticSourceDesc& d, const Produced& p, const std::vector<uint8_t>& stream,
+                     size_t* count, std::string* error) {
+    YuvSource s = SourceOf(d);
+    YuvFormat format = YuvSourceIsHdr(s) ? YuvFormat::P010 : YuvFormat::Nv12;
+    std::string header = Y4mHeader(format, d.width, d.height, d.refreshHz);
+    if (stream.size() < header.size() || memcmp(stream.data(), header.data(), header.size()) != 0) {
+        *error = "bad stream header";
+        return false;
+    }
+    YuvLayout l = MakeYuvLayout(format, d.width, d.height);
+    size_t pos = header.size();
+    *count = 0;
+    for (auto& frame : p.frames) {
+        if (pos == stream.size()) break;
+        std::vector<uint8_t> planes = Y4mPlanes(l, format, Expected(d, frame.second));
+        if (stream.size() - pos < 6 + planes.size() || memcmp(stream.data() + pos, "FRAME\n", 6) != 0) {
+            *error = "frame " + std::to_string(frame.first) + " truncated or without its FRAME line";
+            return false;
+        }
+        if (memcmp(stream.data() + pos + 6, planes.data(), planes.size()) != 0) {
+            *error = "frame " + std::to_string(frame.first) + " differs from the reference";
+            return false;
+        }
+        pos += 6 + planes.size();
+        ++*count;
+    }
+    if (pos != stream.size()) {
+        *error = "trailing bytes";
+        return false;
+    }
+    return true;
+}
+
+static bool ReadFile(const std::string& path, std::vector<uint8_t>* data) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    uint8_t chunk[65536];
+    size_t n;
+    data->clear();
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) data->insert(data->end(), chunk, chunk + n);
+    fclose(f);
+    return true;
+}
+
+static bool MakePipe(int fds[2]) {
+#if defined(_WIN32)
+    return _pipe(fds, 1 << 16, _O_BINARY) == 0;
+#else
+    return pipe(fds) == 0;
+#endif
+}
+
+static long ReadFd(int fd, uint8_t* p, size_t bytes) {
+#if defined(_WIN32)
+    return _read(fd, p, (unsigned)bytes);
+#else
+    return (long)read(fd, p, bytes);
+#endif
+}
+
+static void CloseFd(int fd) {
+#if defined(_WIN32)
+    _close(fd);
+#else
+    close(fd);
+#endif
+}
+
+// Reads raw frames, sleeping after each; stops at EOF or after maxFrames
+static void SlowReader(int fd, double msPerFrame, size_t maxFrames, std::vector<uint8_t>* stream) {
+    std::vector<uint8_t> buffer(1 << 16);
+    size_t frames = 0, expect = 0;   // Bytes left in the current frame, 0 = a header is next
+    while (frames < maxFrames) {
+        long n = ReadFd(fd, buffer.data(), expect ? std::min(expect, buffer.size()) : sizeof(FramePipeHeader));
+        if (n <= 0) break;
+        stream->insert(stream->end(), buffer.begin(), buffer.begin() + n);
+        if (!expect) {
+            // Headers arrive in one read: the writer sends them with a single write
+            FramePipeHeader h;
+            if ((size_t)n != sizeof(h)) break;
+            memcpy(&h, buffer.data(), sizeof(h));
+            expect = h.frameBytes;
+        } else if ((expect -= (size_t)n) == 0) {
+            frames++;
+            std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(msPerFrame));
+        }
+    }
+    CloseFd(fd);
+}
+
+struct Result {
+    std::string name;
+    uint64_t pushed = 0, received = 0, written = 0, dropped = 0;
+    double maxPushMs = 0;
+    std::string error;          // Empty = pass
+};
+
+static std::string TempPath(const char* suffix) {
+    static int counter = 0;
+    std::string name = "frame-pipe-check-" +
+                       std::to_string(std::chrono::steady_clock::now().time_since_epoch().count() % 1000000000) +
+                       "-" + std::to_string(++counter) + suffix;
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+static SyntheticSourceDesc Desc(uint32_t w, uint32_t h, double hz, FramePixelFormat f, SyntheticMotion m) {
+    SyntheticSourceDesc d;
+    d.width = w;
+    d.height = h;
+    d.refreshHz = hz;
+    d.format = f;
+    d.motion = m;
+    d.barWidth = 16;
+    return d;
+}
+
+static FramePipeConfig Config(const SyntheticSourceDesc& d, FramePipeContainer container, int queue, FramePipeDrop drop) {
+    FramePipeConfig c;
+    c.container = container;
+    c.source = SourceOf(d);
+    c.width = (int)d.width;
+    c.height = (int)d.height;
+    c.frameRate = d.refreshHz;
+    c.clockFrequency = FrameClockFrequency();
+    c.queueFrames = queue;
+    c.drop = drop;
+    return c;
+}
+
+static Result FileCase(const char* name, const SyntheticSourceDesc& d, FramePipeContainer container) {
+    Result r;
+    r.name = name;
+    std::string path = TempPath(container == FramePipeContainer::Y4m ? ".y4m" : ".raw");
+    FramePipe pipe;
+    Produced p;
+    if (!pipe.Open(path.c_str(), Config(d, container, 256, FramePipeDrop::Newest), &r.error)) return r;
+    Produce(d, 0.4, &pipe, &p);
+    pipe.Close(true);
+    r.pushed = p.pushed;
+    r.written = pipe.Written();
+    r.dropped = pipe.Dropped();
+    r.maxPushMs = p.maxPushMs;
+
+    std::vector<uint8_t> stream;
+    if (!ReadFile(path, &stream)) {
+        r.error = "cannot read " + path;
+    } else if (container == FramePipeContainer::Raw) {
+        std::vector<RawFrame> frames;
+        if (ParseRaw(stream, &frames, &r.error) && CheckRaw(d, p, frames, &r.error)) r.received = frames.size();
+    } else {
+        size_t count;
+        if (CheckY4m(d, p, stream, &count, &r.error)) r.received = count;
+    }
+    std::filesystem::remove(path);
+    if (r.error.empty() && (r.dropped || r.received != r.pushed)) r.error = "frames lost writing to a file";
+    return r;
+}
+
+static Result SlowCase(const char* name, FramePipeDrop drop) {
+    Result r;
+    r.name = name;
+    SyntheticSourceDesc d = Desc(320, 180, 240.0, FramePixelFormat::BGRA8, SyntheticMotion::Full);
+    int fds[2];
+    if (!MakePipe(fds)) { r.error = "pipe failed"; return r; }
+    std::vector<uint8_t> stream;
+    std::thread reader(SlowReader, fds[0], 6000.0 / d.refreshHz, (size_t)-1, &stream);
+    FramePipe pipe;
+    Produced p;
+    if (!pipe.OpenFd(fds[1], Config(d, FramePipeContainer::Raw, 3, drop), &r.error)) {
+        CloseFd(fds[0]);
+        reader.join();
+        return r;
+    }
+    Produce(d, 1.0, &pipe, &p);
+    pipe.Close(true);
+    reader.join();
+    r.pushed = p.pushed;
+    r.written = pipe.Written();
+    r.dropped = pipe.Dropped();
+    r.maxPushMs = p.maxPushMs;
+
+    std::vector<RawFrame> frames;
+    if (!ParseRaw(stream, &frames, &r.error) || !CheckRaw(d, p, frames, &r.error)) return r;
+    r.received = frames.size();
+    if (r.written + r.dropped != r.pushed) r.error = "written + dropped != pushed";
+    else if (r.received != r.written) r.error = "received != written";
+    else if (!r.dropped) r.error = "nothing dropped: the reader was not slow enough";
+    else if (r.maxPushMs > 10.0) r.error = "Push waited for the consumer";
+    else if (drop == FramePipeDrop::Oldest && frames.back().header.frameId != r.pushed) r.error = "the newest frame was lost";
+    else if (drop == FramePipeDrop::Newest && frames[0].header.frameId != 1) r.error = "the first frame was lost";
+    return r;
+}
+
+static Result GoneCase() {
+    Result r;
+    r.name = "gone consumer";
+    SyntheticSourceDesc d = Desc(320, 180, 240.0, FramePixelFormat::BGRA8, SyntheticMotion::Full);
+    int fds[2];
+    if (!MakePipe(fds)) { r.error = "pipe failed"; return r; }
+    std::vector<uint8_t> stream;
+    std::thread reader(SlowReader, fds[0], 0.0, (size_t)2, &stream);
+    FramePipe pipe;
+    Produced p;
+    if (!pipe.OpenFd(fds[1], Config(d, FramePipeContainer::Raw, 3, FramePipeDrop::Oldest), &r.error)) {
+        CloseFd(fds[0]);
+        reader.join();
+        return r;
+    }
+    Produce(d, 0.3, &pipe, &p);
+    auto t0 = std::chrono::steady_clock::now();
+    bool broken = pipe.Broken();
+    std::string error = pipe.Error();
+    pipe.Close();
+    double closeMs = Seconds(t0) * 1000.0;
+    reader.join();
+    r.pushed = p.pushed;
+    r.written = pipe.Written();
+    r.dropped = pipe.Dropped();
+    r.maxPushMs = p.maxPushMs;
+    r.received = 2;
+    if (!broken || error.empty()) r.error = "the pipe did not notice";
+    else if (r.maxPushMs > 10.0) r.error = "Push waited";
+    else if (closeMs > 100.0) r.error = "Close waited";
+    return r;
+}
+
+#if !defined(_WIN32)
+static Result NoReaderCase() {
+    Result r;
+    r.name = "no reader (fifo)";
+    SyntheticSourceDesc d = Desc(320, 180, 240.0, FramePixelFormat::BGRA8, SyntheticMotion::Full);
+    std::string path = TempPath(".fifo");
+    if (mkfifo(path.c_str(), 0600) != 0) { r.error = "mkfifo failed"; return r; }
+    FramePipe pipe;
+    Produced p;
+    if (pipe.Open(path.c_str(), Config(d, FramePipeContainer::Y4m, 3, FramePipeDrop::Oldest), &r.error)) {
+        Produce(d, 0.2, &pipe, &p);
+        auto t0 = std::chrono::steady_clock::now();
+        pipe.Close();
+        double closeMs = Seconds(t0) * 1000.0;
+        r.pushed = p.pushed;
+        r.written = pipe.Written();
+        r.dropped = pipe.Dropped();
+        r.maxPushMs = p.maxPushMs;
+        if (r.written || r.dropped != r.pushed) r.error = "frames were written with nobody reading";
+        else if (r.maxPushMs > 10.0) r.error = "Push waited";
+        else if (closeMs > 100.0) r.error = "Close waited";
+    }
+    unlink(path.c_str());
+    return r;
+}
+#endif
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        fprintf(stderr, "Usage: %s\n", argv[0]);
+        return 1;
+    }
+    std::vector<Result> results;
+    results.push_back(FileCase("y4m nv12 320x180", Desc(320, 180, 240.0, FramePixelFormat::BGRA8, SyntheticMotion::Bar),
+                               FramePipeContainer::Y4m));
+    results.push_back(FileCase("y4m p010 320x180", Desc(320, 180, 240.0, FramePixelFormat::RGBA16F, SyntheticMotion::Full),
+                               FramePipeContainer::Y4m));
+    results.push_back(FileCase("y4m nv12 321x179", Desc(321, 179, 240.0, FramePixelFormat::BGRA8, SyntheticMotion::Full),
+                               FramePipeContainer::Y4m));
+    results.push_back(FileCase("raw nv12 321x179", Desc(321, 179, 240.0, FramePixelFormat::BGRA8, SyntheticMotion::Bar),
+                               FramePipeContainer::Raw));
+    results.push_back(FileCase("raw p010 320x180", Desc(320, 180, 240.0, FramePixelFormat::RGBA16F, SyntheticMotion::Bar),
+                               FramePipeContainer::Raw));
+    results.push_back(SlowCase("slow, drop oldest", FramePipeDrop::Oldest));
+    results.push_back(SlowCase("slow, drop newest", FramePipeDrop::Newest));
+    results.push_back(GoneCase());
+#if !defined(_WIN32)
+    results.push_back(NoReaderCase());
+#endif
+
+    printf("%-20s %7s %9s %8s %8s %9s  %s\n", "case", "pushed", "received", "written", "dropped", "max push", "result");
+    bool ok = true;
+    for (const Result& r : results) {
+        printf("%-20s %7llu %9llu %8llu %8llu %6.2f ms  %s\n", r.name.c_str(), (unsigned long long)r.pushed,
+               (unsigned long long)r.received, (unsigned long long)r.written, (unsigned long long)r.dropped,
+               r.maxPushMs, r.error.empty() ? "ok" : ("FAILED: " + r.error).c_str());
+        if (!r.error.empty()) ok = false;
+    }
+
+    if (!ok) printf("\nFAILED\n");
+    return ok ? 0 : 1;
+}
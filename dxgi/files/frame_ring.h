@@ -0,0 +1,373 @@
+// Shared-memory frame ring for local consumers (--frame-server)
+//
+// One writer (dxgi-mirror) publishes frames into a named shared-memory
+// mapping. Any number of readers in other processes attach by name and read
+// the frames in place, without a second duplication session. The mapping
+// holds a header, then N slot headers, then N frames of slotBytes each.
+//
+// Every slot is a seqlock. The writer makes the slot's sequence odd, writes
+// the metadata and pixels, then makes it even again and advances latestId.
+// A reader loads the sequence, reads, and loads it again. The read is valid
+// only if both loads are equal and even. The writer never waits for readers:
+// it cycles through the slots, so a reader has N-1 frame times to finish a
+// frame before it is overwritten. A slow reader loses frames
+// (FrameRingRead::Overwritten), it never sees a torn one.
+//
+// Frame ids count up from 1 with every publish. Dirty rects are relative to
+// the frame before; a reader that skipped an id has to take the whole frame.
+//
+// Backends: a Win32 file mapping ("Local\<name>") or POSIX shm_open
+// ("/<name>"; a name left behind by a writer that crashed is replaced).
+// SharedMemory is the only platform-specific part.
+//
+// Portable C++17.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <atomic>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "frame_source.h"
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const uint32_t kFrameRingMagic = 0x474E5246;    // "FRNG"
+const uint32_t kFrameRingVersion = 1;
+const int kFrameRingMaxDirty = 32;              // More collapse to their bounding box (as DirtyRegion)
+
+// Pixel layouts; the numbers are part of the protocol
+enum class FrameRingFormat : uint32_t {
+    Bgra8 = 1,      // SDR slots
+    Rgba8 = 2,      // sdr8 and downscaled SDR slots
+    Rgba16F = 3,    // scRGB
+    R11G11B10F = 4,
+    Rgb10A2Pq = 5,  // BT.2020 PQ
+};
+
+inline const char* FrameRingFormatName(FrameRingFormat f) {
+    switch (f) {
+        case FrameRingFormat::Bgra8: return "bgra8";
+        case FrameRingFormat::Rgba8: return "rgba8";
+        case FrameRingFormat::Rgba16F: return "rgba16f";
+        case FrameRingFormat::R11G11B10F: return "r11g11b10";
+        case FrameRingFormat::Rgb10A2Pq: return "pq10";
+    }
+    return "?";
+}
+
+// Everything about one frame besides the pixels. Trivially copyable: it is
+// read with memcpy under the slot's seqlock.
+struct FrameRingInfo {
+    uint64_t frameId = 0;
+    int64_t captureTime = 0;            // Writer clock ticks (FrameRingHeader::clockFrequency)
+    int64_t sourcePresentTime = 0;      // 0 = unknown
+    FrameRingFormat format = FrameRingFormat::Bgra8;
+    uint32_t width = 0, height = 0;
+    uint32_t pitch = 0;                 // Bytes per row
+    uint32_t dirtyCount = 0;            // 0 = the whole frame changed
+    uint32_t padding = 0;
+    FrameRect dirty[kFrameRingMaxDirty] = {};
+};
+
+struct FrameRingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t headerBytes;               // Offset of the first frame's pixels
+    uint64_t slotBytes;                 // Pixel capacity of every slot
+    int64_t clockFrequency;             // Ticks per second of the frame times
+    std::atomic<uint64_t> latestId;     // Newest complete frame, 0 before the first
+    std::atomic<uint32_t> closed;       // Set when the writer goes away
+    uint32_t padding;
+};
+
+struct FrameRingSlot {
+    std::atomic<uint64_t> sequence;     // Odd while the writer is in the slot
+    FrameRingInfo info;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the ring needs lock-free 64-bit atomics");
+
+inline size_t FrameRingHeaderBytes(uint32_t slotCount) {
+    size_t bytes = sizeof(FrameRingHeader) + sizeof(FrameRingSlot) * slotCount;
+    return (bytes + 4095) & ~(size_t)4095;  // Frames start page aligned
+}
+
+enum class FrameRingRead {
+    Ok,
+    NotYet,         // Newer than the latest frame
+    Overwritten,    // The writer reused the slot before or while it was read
+    Closed,         // The writer went away
+};
+
+// A named mapping of shared memory
+class SharedMemory {
+public:
+    SharedMemory() = default;
+    SharedMemory(const SharedMemory&) = delete;
+    SharedMemory& operator=(const SharedMemory&) = delete;
+    ~SharedMemory() { Close(); }
+
+    bool Create(const char* name, size_t bytes, std::string* error) {
+        Close();
+#if defined(_WIN32)
+        std::string path = std::string("Local\\") + name;
+        mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)bytes >> 32),
+                                     (DWORD)bytes, path.c_str());
+        if (!mapping) return Fail("CreateFileMapping", error);
+        if (GetLastError() == ERROR_ALREADY_EXISTS) {
+            Close();
+            *error = path + " is in use by another writer";
+            return false;
+        }
+        data = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+        if (!data) return Fail("MapViewOfFile", error);
+#else
+        path = std::string("/") + name;
+        shm_unlink(path.c_str());   // A writer that crashed leaves its name behind
+        int fd = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0) return Fail("shm_open", error);
+        owner = true;
+        if (ftruncate(fd, (off_t)bytes) != 0) {
+            close(fd);
+            return Fail("ftruncate", error);
+        }
+        void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) return Fail("mmap", error);
+        data = (uint8_t*)p;
+#endif
+        size = bytes;
+        return true;
+    }
+
+    // Read-only
+    bool Open(const char* name, std::string* error) {
+        Close();
+#if defined(_WIN32)
+        std::string path = std::string("Local\\") + name;
+        mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, path.c_str());
+        if (!mapping) return Fail("OpenFileMapping", error);
+        data = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!data) return Fail("MapViewOfFile", error);
+        MEMORY_BASIC_INFORMATION mbi;
+        if (!VirtualQuery(data, &mbi, sizeof(mbi))) return Fail("VirtualQuery", error);
+        size = mbi.RegionSize;
+#else
+        std::string p = std::string("/") + name;
+        int fd = shm_open(p.c_str(), O_RDONLY, 0);
+        if (fd < 0) return Fail("shm_open", error);
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            return Fail("fstat", error);
+        }
+        void* m = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (m == MAP_FAILED) return Fail("mmap", error);
+        data = (uint8_t*)m;
+        size = (size_t)st.st_size;
+#endif
+        return true;
+    }
+
+    void Close() {
+#if defined(_WIN32)
+        if (data) UnmapViewOfFile(data);
+        if (mapping) CloseHandle(mapping);
+        mapping = nullptr;
+#else
+        if (data) munmap(data, size);
+        if (owner) shm_unlink(path.c_str());
+        owner = false;
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+    uint8_t* Data() const { return data; }
+    size_t Size() const { return size; }
+
+private:
+    bool Fail(const char* what, std::string* error) {
+#if defined(_WIN32)
+        *error = std::string(what) + " failed (error " + std::to_string(GetLastError()) + ")";
+#else
+        *error = std::string(what) + ": " + strerror(errno);
+#endif
+        Close();
+        return false;
+    }
+
+    uint8_t* data = nullptr;
+    size_t size = 0;
+#if defined(_WIN32)
+    HANDLE mapping = nullptr;
+#else
+    std::string path;           // Writer: unlinked on Close
+    bool owner = false;
+#endif
+};
+
+// The mirror's side. Publishing never blocks.
+class FrameRingWriter {
+public:
+    bool Create(const char* name, uint32_t slotCount, uint64_t slotBytes, int64_t clockFrequency, std::string* error) {
+        if (slotCount < 2) {
+            *error = "a frame ring needs at least 2 slots";
+            return false;
+        }
+        size_t headerBytes = FrameRingHeaderBytes(slotCount);
+        if (!memory.Create(name, headerBytes + slotBytes * slotCount, error)) return false;
+
+        header = new (memory.Data()) FrameRingHeader();
+        header->version = kFrameRingVersion;
+        header->slotCount = slotCount;
+        header->headerBytes = (uint32_t)headerBytes;
+        header->slotBytes = slotBytes;
+        header->clockFrequency = clockFrequency;
+        header->latestId.store(0, std::memory_order_relaxed);
+        header->closed.store(0, std::memory_order_relaxed);
+        slots = (FrameRingSlot*)(header + 1);
+        for (uint32_t i = 0; i < slotCount; i++) new (&slots[i]) FrameRingSlot();
+        // Readers check the magic last
+        std::atomic_thread_fence(std::memory_order_release);
+        header->magic = kFrameRingMagic;
+        nextId = 1;
+        return true;
+    }
+
+    bool IsOpen() const { return header != nullptr; }
+    uint64_t SlotBytes() const { return header ? header->slotBytes : 0; }
+
+    // Pixels of the next frame; fill at most SlotBytes(), then Publish. The
+    // slot is marked as being written from here on.
+    uint8_t* BeginFrame() {
+        FrameRingSlot& s = slots[nextId % header->slotCount];
+        s.sequence.store(s.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        return Pixels(nextId);
+    }
+
+    // Returns the frame's id (info.frameId is set here)
+    uint64_t Publish(const FrameRingInfo& info) {
+        FrameRingSlot& s = slots[nextId % header->slotCount];
+        s.info = info;
+        s.info.frameId = nextId;
+        s.sequence.store(s.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        header->latestId.store(nextId, std::memory_order_release);
+        return nextId++;
+    }
+
+    void Close() {
+        if (header) header->closed.store(1, std::memory_order_release);
+        header = nullptr;
+        slots = nullptr;
+        memory.Close();
+    }
+
+private:
+    uint8_t* Pixels(uint64_t id) const {
+        return memory.Data() + header->headerBytes + header->slotBytes * (id % header->slotCount);
+    }
+
+    SharedMemory memory;
+    FrameRingHeader* header = nullptr;
+    FrameRingSlot* slots = nullptr;
+    uint64_t nextId = 1;
+};
+
+// A consumer's side. Any number of readers, each with its own mapping.
+class FrameRingReader {
+public:
+    bool Open(const char* name, std::string* error) {
+        if (!memory.Open(name, error)) return false;
+        header = (const FrameRingHeader*)memory.Data();
+        if (memory.Size() < sizeof(FrameRingHeader) || header->magic != kFrameRingMagic) {
+            *error = std::string(name) + " is not a frame ring (or its writer is still starting)";
+        } else if (header->version != kFrameRingVersion) {
+            *error = std::string(name) + ": version " + std::to_string(header->version) + ", expected " +
+                     std::to_string(kFrameRingVersion);
+        } else if (memory.Size() < header->headerBytes + header->slotBytes * header->slotCount) {
+            *error = std::string(name) + " is smaller than its header says";
+        } else {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            slots = (const FrameRingSlot*)(header + 1);
+            return true;
+        }
+        header = nullptr;
+        memory.Close();
+        return false;
+    }
+
+    uint32_t SlotCount() const { return header->slotCount; }
+    uint64_t SlotBytes() const { return header->slotBytes; }
+    int64_t ClockFrequency() const { return header->clockFrequency; }
+    bool Closed() const { return header->closed.load(std::memory_order_acquire) != 0; }
+    uint64_t LatestId() const { return header->latestId.load(std::memory_order_acquire); }
+
+    // Zero-copy read: the frame's metadata and its pixels in the mapping.
+    // Whatever was read through the pointer only counts if Validate(id,
+    // sequence) is true afterwards.
+    FrameRingRead Peek(uint64_t id, FrameRingInfo* info, const uint8_t** pixels, uint64_t* sequence) const {
+        if (Closed()) return FrameRingRead::Closed;
+        uint64_t latest = LatestId();
+        if (id == 0 || id > latest) return FrameRingRead::NotYet;
+        if (latest - id >= header->slotCount) return FrameRingRead::Overwritten;
+        const FrameRingSlot& s = slots[id % header->slotCount];
+        *sequence = s.sequence.load(std::memory_order_acquire);
+        if (*sequence & 1) return FrameRingRead::Overwritten;
+        memcpy((void*)info, (const void*)&s.info, sizeof(*info));
+        *pixels = memory.Data() + header->headerBytes + header->slotBytes * (id % header->slotCount);
+        if (!Validate(id, *sequence) || info->frameId != id) return FrameRingRead::Overwritten;
+        return FrameRingRead::Ok;
+    }
+
+    bool Validate(uint64_t id, uint64_t sequence) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slots[id % header->slotCount].sequence.load(std::memory_order_relaxed) == sequence;
+    }
+
+    // Copying read of one frame: pitch * height bytes into pixels
+    FrameRingRead Read(uint64_t id, FrameRingInfo* info, std::vector<uint8_t>* pixels) const {
+        const uint8_t* p;
+        uint64_t sequence;
+        FrameRingRead r = Peek(id, info, &p, &sequence);
+        if (r != FrameRingRead::Ok) return r;
+        size_t bytes = (size_t)info->pitch * info->height;
+        if (bytes > header->slotBytes) return FrameRingRead::Overwritten;  // Metadata of a later frame
+        pixels->resize(bytes);
+        memcpy(pixels->data(), p, bytes);
+        return Validate(id, sequence) ? FrameRingRead::Ok : FrameRingRead::Overwritten;
+    }
+
+    void Close() {
+        header = nullptr;
+        slots = nullptr;
+        memory.Close();
+    }
+
+private:
+    SharedMemory memory;
+    const FrameRingHeader* header = nullptr;
+    const FrameRingSlot* slots = nullptr;
+};
@@ -0,0 +1,234 @@
+// Frame ring stress test (frame_ring.h)
+//
+// One writer thread publishes frames into a ring under a fresh name, as fast
+// as it can or at --fps. --readers threads each open the ring on their own,
+// the way another process does, and read it until the writer closes after
+// --seconds. Even readers take the newest frame with copying reads. Odd
+// readers follow every id zero-copy (Peek, check in place, yield, check
+// again, Validate) and count the frames the writer overtook. Each frame's
+// pixels and metadata are derived from its id, so an accepted frame that
+// does not match is a torn read. Then checks the error paths: a name that
+// does not exist, a mapping that is not a ring, and opening after the
+// writer closed.
+// Exits with 1 on any torn read or failed check.
+//
+// Build: cl /O2 /EHsc frame_ring_stress.cpp    or    g++ -O2 -pthread frame_ring_stress.cpp
+//
+// Usage: frame-ring-stress [--readers N] [--slots N] [--size WxH] [--seconds S] [--fps N]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frame_ring.h"
+
+static uint32_t PixelWord(uint64_t id, size_t i) {
+    return (uint32_t)(id * 0x9E3779B1u) ^ (uint32_t)(i * 0x85EBCA77u);
+}
+
+static void MakeInfo(uint64_t id, uint32_t w, uint32_t h, FrameRingInfo* info) {
+    *info = FrameRingInfo();
+    info->captureTime = (int64_t)id * 1000;
+    info->sourcePresentTime = (int64_t)id * 1000 - 7;
+    info->width = w;
+    info->height = h;
+    info->pitch = w * 4;
+    info->dirtyCount = (uint32_t)(id % (kFrameRingMaxDirty + 1));
+    for (uint32_t k = 0; k < info->dirtyCount; k++) {
+        int32_t x = (int32_t)((id + k) % w), y = (int32_t)((id * 3 + k) % h);
+        info->dirty[k] = {x, y, x + 1, y + 1};
+    }
+}
+
+// Whether a frame the ring accepted is the frame with that id
+static bool FrameMatches(uint64_t id, const FrameRingInfo& info, const uint8_t* pixels) {
+    FrameRingInfo expect;
+    MakeInfo(id, info.width, info.height, &expect);
+    expect.frameId = id;
+    if (memcmp(&info, &expect, sizeof(info)) != 0) return false;
+    size_t words = (size_t)info.pitch / 4 * info.height;
+    for (size_t i = 0; i < words; i++) {
+        uint32_t v;
+        memcpy(&v, pixels + i * 4, 4);
+        if (v != PixelWord(id, i)) return false;
+    }
+    return true;
+}
+
+struct ReaderStats {
+    bool follow = false;
+    bool opened = false;
+    bool sawClose = false;
+    uint64_t frames = 0;        // Accepted and checked
+    uint64_t overwritten = 0;   // Latest readers: reads the writer overtook (retried)
+    uint64_t lost = 0;          // Followers: ids skipped
+    uint64_t torn = 0;
+    std::string error;
+};
+
+static void ReaderThread(const std::string& name, ReaderStats* st) {
+    FrameRingReader ring;
+    if (!ring.Open(name.c_str(), &st->error)) return;
+    st->opened = true;
+    FrameRingInfo info;
+    std::vector<uint8_t> pixels;
+    uint64_t last = 0;
+    for (;;) {
+        if (st->follow) {
+            uint64_t id = last + 1;
+            const uint8_t* p;
+            uint64_t sequence;
+            FrameRingRead r = ring.Peek(id, &info, &p, &sequence);
+            if (r == FrameRingRead::Closed) break;
+            if (r == FrameRingRead::NotYet) { std::this_thread::yield(); continue; }
+            if (r == FrameRingRead::Ok) {
+                // Holding the frame across a yield widens the window for the writer, even on one core
+                bool match = FrameMatches(id, info, p);
+                std::this_thread::yield();
+                match = match && FrameMatches(id, info, p);
+                if (ring.Validate(id, sequence)) {
+                    st->frames++;
+                    if (!match) st->torn++;
+                    last = id;
+                    continue;
+                }
+            }
+            // Overtaken: go on from the newest frame
+            uint64_t latest = ring.LatestId();
+            st->lost += latest - last - 1;
+            last = latest - 1;
+        } else {
+            uint64_t id = ring.LatestId();
+            if (id == last) {
+                if (ring.Closed()) break;
+                std::this_thread::yield();
+                continue;
+            }
+            FrameRingRead r = ring.Read(id, &info, &pixels);
+            if (r == FrameRingRead::Closed) break;
+            if (r == FrameRingRead::Overwritten) { st->overwritten++; continue; }
+            st->frames++;
+            if (!FrameMatches(id, info, pixels.data())) st->torn++;
+            last = id;
+        }
+    }
+    st->sawClose = ring.Closed();
+}
+
+int main(int argc, char** argv) {
+    int readerCount = 4, slots = 3;
+    uint32_t width = 640, height = 360;
+    double seconds = 2.0, fps = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--readers") && i+1 < argc) readerCount = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--slots") && i+1 < argc) slots = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--size") && i+1 < argc && sscanf(argv[++i], "%ux%u", &width, &height) == 2) {}
+        else if (!strcmp(argv[i], "--seconds") && i+1 < argc) seconds = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--fps") && i+1 < argc) fps = atof(argv[++i]);
+        else {
+            fprintf(stderr, "Usage: %s [--readers N] [--slots N] [--size WxH] [--seconds S] [--fps N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (readerCount < 1 || slots < 2 || width == 0 || height == 0 || seconds <= 0) {
+        fprintf(stderr, "Need --readers >= 1, --slots >= 2, a size and --seconds > 0\n");
+        return 1;
+    }
+
+    std::string name = "frame-ring-stress-" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+    size_t frameBytes = (size_t)width * height * 4;
+    FrameRingWriter writer;
+    std::string error;
+    if (!writer.Create(name.c_str(), (uint32_t)slots, frameBytes, 1000000, &error)) {
+        fprintf(stderr, "Cannot create the ring: %s\n", error.c_str());
+        return 1;
+    }
+    printf("%s: %d slots of %ux%u bgra8 (%.1f MB), %d readers, %.1fs%s\n\n", name.c_str(), slots, width, height,
+           frameBytes / 1048576.0, readerCount, seconds, fps > 0 ? "" : ", writer unthrottled");
+
+    std::vector<ReaderStats> stats(readerCount);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < readerCount; r++) {
+        stats[r].follow = r % 2 == 1;
+        readers.emplace_back(ReaderThread, name, &stats[r]);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t published = 0;
+    double elapsed = 0;
+    do {
+        uint64_t id = published + 1;
+        uint8_t* p = writer.BeginFrame();
+        for (size_t i = 0; i < frameBytes / 4; i++) {
+            uint32_t v = PixelWord(id, i);
+            memcpy(p + i * 4, &v, 4);
+        }
+        FrameRingInfo info;
+        MakeInfo(id, width, height, &info);
+        writer.Publish(info);
+        published++;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (fps > 0) {
+            double next = published / fps;
+            if (next > elapsed) std::this_thread::sleep_for(std::chrono::duration<double>(next - elapsed));
+        }
+    } while (elapsed < seconds);
+    writer.Close();
+    for (std::thread& t : readers) t.join();
+
+    bool ok = true;
+    printf("%-10s %-7s %10s %12s %8s %6s\n", "", "mode", "frames", "overwritten", "lost", "torn");
+    printf("%-10s %-7s %10llu   (%.0f fps)\n", "writer", "", (unsigned long long)published, published / elapsed);
+    for (int r = 0; r < readerCount; r++) {
+        const ReaderStats& st = stats[r];
+        char label[32];
+        snprintf(label, sizeof(label), "reader %d", r);
+        if (!st.opened) {
+            printf("%-10s FAILED: %s\n", label, st.error.c_str());
+            ok = false;
+            continue;
+        }
+        printf("%-10s %-7s %10llu %12llu %8llu %6llu", label, st.follow ? "follow" : "latest",
+               (unsigned long long)st.frames, (unsigned long long)st.overwritten, (unsigned long long)st.lost,
+               (unsigned long long)st.torn);
+        if (st.torn || !st.frames || !st.sawClose) {
+            printf("  FAILED%s%s", st.frames ? "" : ", no frames", st.sawClose ? "" : ", missed the close");
+            ok = false;
+        }
+        printf("\n");
+    }
+
+    // Error paths
+    printf("\n");
+    struct Check { const char* name; bool pass; std::string detail; };
+    std::vector<Check> checks;
+    FrameRingReader reader;
+    std::string e;
+    bool opened = reader.Open(name.c_str(), &e);
+    checks.push_back({"after close", !opened, opened ? "(opened)" : e});
+    reader.Close();
+    opened = reader.Open((name + "-missing").c_str(), &e);
+    checks.push_back({"missing", !opened, opened ? "(opened)" : e});
+    reader.Close();
+    SharedMemory other;
+    std::string otherName = name + "-other";
+    if (other.Create(otherName.c_str(), 65536, &e)) {
+        opened = reader.Open(otherName.c_str(), &e);
+        checks.push_back({"not a ring", !opened && e.find("not a frame ring") != std::string::npos, opened ? "(opened)" : e});
+        reader.Close();
+    } else {
+        checks.push_back({"not a ring", false, e});
+    }
+    for (const Check& c : checks) {
+        printf("%-12s %s%s\n", c.name, c.detail.c_str(), c.pass ? "" : "  FAILED");
+        if (!c.pass) ok = false;
+    }
+
+    if (!ok) printf("\nFAILED\n");
+    return ok ? 0 : 1;
+}
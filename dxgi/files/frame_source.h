@@ -0,0 +1,341 @@
+// Frame sources for the capture thread
+// IFrameSource abstracts "give me the next desktop frame" so the capture ->
+// publish -> render pipeline can be driven by something other than a live
+// DXGI duplication (synthetic pattern, raw file replay).
+//
+// Everything in this header is portable C++17; only the clock uses QPC on
+// Windows so timestamps line up with DXGI_OUTDUPL_FRAME_INFO::LastPresentTime.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "pointer_shape.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+// Frame clock - QPC ticks on Windows, steady_clock nanoseconds elsewhere
+inline int64_t FrameClockNow() {
+#ifdef _WIN32
+    LARGE_INTEGER t; QueryPerformanceCounter(&t); return t.QuadPart;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+inline int64_t FrameClockFrequency() {
+#ifdef _WIN32
+    LARGE_INTEGER f; QueryPerformanceFrequency(&f); return f.QuadPart;
+#else
+    return 1000000000;
+#endif
+}
+
+enum class FramePixelFormat {
+    BGRA8,      // DXGI_FORMAT_B8G8R8A8_UNORM
+    RGBA16F,    // DXGI_FORMAT_R16G16B16A16_FLOAT (scRGB)
+};
+
+inline int FrameBytesPerPixel(FramePixelFormat f) {
+    return f == FramePixelFormat::RGBA16F ? 8 : 4;
+}
+
+inline const char* FramePixelFormatName(FramePixelFormat f) {
+    return f == FramePixelFormat::RGBA16F ? "RGBA16F" : "BGRA8";
+}
+
+struct FrameRect { int32_t left, top, right, bottom; };
+struct FrameMoveRect { int32_t srcX, srcY; FrameRect dst; };
+
+enum class FrameStatus { Ok, Timeout, AccessLost, Error };
+
+// Mirrors the parts of DXGI_OUTDUPL_FRAME_INFO the pipeline uses
+struct FrameInfo {
+    int64_t lastPresentTime = 0;        // Frame clock ticks, 0 = image did not change
+    uint32_t accumulatedFrames = 0;
+    uint32_t width = 0, height = 0;
+    FramePixelFormat format = FramePixelFormat::BGRA8;
+
+    // CPU sources fill these, GPU sources leave pixels null
+    const uint8_t* pixels = nullptr;
+    uint32_t pitch = 0;
+
+    // Hardware pointer (position is the shape's top-left in source pixels)
+    int64_t lastPointerUpdateTime = 0;  // 0 = position/visibility unchanged
+    int32_t pointerX = 0, pointerY = 0;
+    bool pointerVisible = false;
+    uint32_t pointerShapeSize = 0;      // > 0 when a new shape is available
+};
+
+// What an acquired update actually carries. Only Image updates need a copy;
+// the duplication also wakes up for pointer moves (LastPresentTime == 0) and
+// for updates with neither image nor pointer changes.
+enum class FrameUpdateKind { Image, PointerOnly, MetadataOnly };
+
+inline FrameUpdateKind ClassifyFrameUpdate(const FrameInfo& info) {
+    if (info.lastPresentTime != 0) return FrameUpdateKind::Image;
+    if (info.lastPointerUpdateTime != 0 || info.pointerShapeSize > 0) return FrameUpdateKind::PointerOnly;
+    return FrameUpdateKind::MetadataOnly;
+}
+
+class IFrameSource {
+public:
+    virtual ~IFrameSource() {}
+
+    // Blocks up to timeoutMs for the next frame. On Ok, the frame stays valid
+    // until ReleaseFrame().
+    virtual FrameStatus AcquireFrame(uint32_t timeoutMs, FrameInfo* info) = 0;
+    virtual void ReleaseFrame() = 0;
+
+    // Regions changed since the previous frame (only valid between Acquire/Release)
+    virtual void GetDirtyRects(std::vector<FrameRect>* rects) = 0;
+    virtual void GetMoveRects(std::vector<FrameMoveRect>* rects) { rects->clear(); }
+
+    // New pointer shape (only when FrameInfo::pointerShapeSize > 0)
+    virtual bool GetPointerShape(std::vector<uint8_t>* buffer, PointerShapeInfo* info) {
+        (void)buffer; (void)info; return false;
+    }
+
+    // Called after AccessLost; returns false if the source cannot recover
+    virtual bool Reinitialize() { return false; }
+
+    virtual const char* Name() const = 0;
+};
+
+// Paces a CPU source at a fixed refresh rate
+class FramePacer {
+public:
+    void Start(double refreshHz) {
+        period = (int64_t)(FrameClockFrequency() / (refreshHz > 0 ? refreshHz : 60.0));
+        next = FrameClockNow() + period;
+    }
+
+    // Waits until the next frame is due. Returns false if that is more than
+    // timeoutMs away (caller reports a timeout, like AcquireNextFrame).
+    bool Wait(uint32_t timeoutMs) {
+        int64_t freq = FrameClockFrequency();
+        int64_t now = FrameClockNow();
+        if (next - now > (int64_t)timeoutMs * freq / 1000) {
+            SleepTicks((int64_t)timeoutMs * freq / 1000);
+            return false;
+        }
+        SleepTicks(next - now);
+        presentTime = next;
+        next += period;
+        // Don't try to catch up after a long stall
+        if (FrameClockNow() - next > period * 4) next = FrameClockNow() + period;
+        return true;
+    }
+
+    int64_t PresentTime() const { return presentTime; }
+
+private:
+    static void SleepTicks(int64_t ticks) {
+        if (ticks <= 0) return;
+        std::this_thread::sleep_for(std::chrono::nanoseconds(
+            (int64_t)((double)ticks * 1e9 / FrameClockFrequency())));
+    }
+
+    int64_t period = 0, next = 0, presentTime = 0;
+};
+
+enum class SyntheticMotion {
+    Static,     // One initial frame, then nothing changes
+    Bar,        // Vertical bar sweeping across the screen
+    Full,       // Every pixel changes every frame (worst case)
+};
+
+struct SyntheticSourceDesc {
+    uint32_t width = 1920, height = 1080;
+    double refreshHz = 60.0;
+    FramePixelFormat format = FramePixelFormat::BGRA8;
+    SyntheticMotion motion = SyntheticMotion::Bar;
+    uint32_t barWidth = 64;
+};
+
+// Deterministic generated frames at a fixed rate
+class SyntheticFrameSource : public IFrameSource {
+public:
+    explicit SyntheticFrameSource(const SyntheticSourceDesc& d) : desc(d) {
+        pitch = desc.width * FrameBytesPerPixel(desc.format);
+        pixels.resize((size_t)pitch * desc.height);
+        for (uint32_t y = 0; y < desc.height; y++) {
+            for (uint32_t x = 0; x < desc.width; x++) WritePixel(x, y, Background(x, y));
+        }
+        pacer.Start(desc.refreshHz);
+    }
+
+    FrameStatus AcquireFrame(uint32_t timeoutMs, FrameInfo* info) override {
+        if (!pacer.Wait(timeoutMs)) return FrameStatus::Timeout;
+
+        dirty.clear();
+        bool changed = frameIndex == 0;
+        if (frameIndex == 0) {
+            dirty.push_back({0, 0, (int32_t)desc.width, (int32_t)desc.height});
+        } else if (desc.motion == SyntheticMotion::Bar) {
+            DrawBar(frameIndex);
+            changed = true;
+        } else if (desc.motion == SyntheticMotion::Full) {
+            FillFrame(frameIndex);
+            dirty.push_back({0, 0, (int32_t)desc.width, (int32_t)desc.height});
+            changed = true;
+        }
+        frameIndex++;
+
+        // A static desktop produces no duplication updates at all
+        if (!changed) return FrameStatus::Timeout;
+
+        info->lastPresentTime = pacer.PresentTime();
+        info->accumulatedFrames = 1;
+        info->width = desc.width;
+        info->height = desc.height;
+        info->format = desc.format;
+        info->pixels = pixels.data();
+        info->pitch = pitch;
+        return FrameStatus::Ok;
+    }
+
+    void ReleaseFrame() override {}
+    void GetDirtyRects(std::vector<FrameRect>* rects) override { *rects = dirty; }
+    const char* Name() const override { return "synthetic"; }
+
+private:
+    // Background is a static gradient so partial updates are visible
+    uint32_t Background(uint32_t x, uint32_t y) const {
+        uint32_t r = x * 255 / (desc.width ? desc.width : 1);
+        uint32_t g = y * 255 / (desc.height ? desc.height : 1);
+        return 0xFF000000u | (r << 16) | (g << 8) | 0x40;
+    }
+
+    void WritePixel(uint32_t x, uint32_t y, uint32_t bgra) {
+        uint8_t* p = pixels.data() + (size_t)y * pitch + (size_t)x * FrameBytesPerPixel(desc.format);
+        if (desc.format == FramePixelFormat::BGRA8) {
+            memcpy(p, &bgra, 4);
+        } else {
+            // 8-bit to half: exact for n/255 is not needed, just monotonic and cheap
+            uint16_t ch[4] = {
+                UnormToHalf((bgra >> 16) & 0xFF), UnormToHalf((bgra >> 8) & 0xFF),
+                UnormToHalf(bgra & 0xFF), UnormToHalf(0xFF)};
+            memcpy(p, ch, 8);
+        }
+    }
+
+    // Half-float for v/255 (v in 0..255); 1.0 = 0x3C00
+    static uint16_t UnormToHalf(uint32_t v) {
+        if (v == 0) return 0;
+        float f = v / 255.0f;
+        uint32_t bits; memcpy(&bits, &f, 4);
+        int32_t exp = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+        uint32_t mant = (bits >> 13) & 0x3FF;
+        if (exp <= 0) return 0;
+        return (uint16_t)((exp << 10) | mant);
+    }
+
+    uint32_t BarX(uint64_t frame) const {
+        uint32_t span = desc.width > desc.barWidth ? desc.width - desc.barWidth : 1;
+        return (uint32_t)((frame * 8) % span);
+    }
+
+    void DrawBar(uint64_t frame) {
+        uint32_t oldX = BarX(frame - 1), newX = BarX(frame);
+        uint32_t bw = desc.barWidth < desc.width ? desc.barWidth : desc.width;
+        for (uint32_t y = 0; y < desc.height; y++) {
+            for (uint32_t x = oldX; x < oldX + bw; x++) WritePixel(x, y, Background(x, y));
+            for (uint32_t x = newX; x < newX + bw; x++) WritePixel(x, y, 0xFFFFFFFFu);
+        }
+        dirty.push_back({(int32_t)oldX, 0, (int32_t)(oldX + bw), (int32_t)desc.height});
+        if (newX != oldX) dirty.push_back({(int32_t)newX, 0, (int32_t)(newX + bw), (int32_t)desc.height});
+    }
+
+    void FillFrame(uint64_t frame) {
+        uint32_t shade = (uint32_t)(frame * 4) & 0xFF;
+        for (uint32_t y = 0; y < desc.height; y++) {
+            for (uint32_t x = 0; x < desc.width; x++) {
+                WritePixel(x, y, 0xFF000000u | (shade << 16) | (((x + y + shade) & 0xFF) << 8) | (255 - shade));
+            }
+        }
+    }
+
+    SyntheticSourceDesc desc;
+    std::vector<uint8_t> pixels;
+    std::vector<FrameRect> dirty;
+    uint32_t pitch = 0;
+    uint64_t frameIndex = 0;
+    FramePacer pacer;
+};
+
+// Replays a file of back-to-back raw frames (no header, rows tightly packed)
+// at a fixed rate, looping at end of file.
+class ReplayFrameSource : public IFrameSource {
+public:
+    ReplayFrameSource(uint32_t w, uint32_t h, FramePixelFormat fmt, double refreshHz)
+        : width(w), height(h), format(fmt), hz(refreshHz) {
+        pitch = width * FrameBytesPerPixel(format);
+        frame.resize((size_t)pitch * height);
+    }
+
+    ~ReplayFrameSource() override { if (file) fclose(file); }
+
+    bool Open(const char* path) {
+        file = fopen(path, "rb");
+        if (!file) return false;
+        if (!ReadNext()) { fclose(file); file = nullptr; return false; }
+        pacer.Start(hz);
+        return true;
+    }
+
+    FrameStatus AcquireFrame(uint32_t timeoutMs, FrameInfo* info) override {
+        if (!file) return FrameStatus::Error;
+        if (!pacer.Wait(timeoutMs)) return FrameStatus::Timeout;
+        if (!first && !ReadNext()) return FrameStatus::Error;
+        first = false;
+
+        info->lastPresentTime = pacer.PresentTime();
+        info->accumulatedFrames = 1;
+        info->width = width;
+        info->height = height;
+        info->format = format;
+        info->pixels = frame.data();
+        info->pitch = pitch;
+        return FrameStatus::Ok;
+    }
+
+    void ReleaseFrame() override {}
+
+    // Raw frames carry no metadata, so every frame is a full update
+    void GetDirtyRects(std::vector<FrameRect>* rects) override {
+        rects->assign(1, FrameRect{0, 0, (int32_t)width, (int32_t)height});
+    }
+
+    const char* Name() const override { return "replay"; }
+
+private:
+    bool ReadNext() {
+        if (fread(frame.data(), 1, frame.size(), file) == frame.size()) return true;
+        // Loop back to the first frame
+        fseek(file, 0, SEEK_SET);
+        return fread(frame.data(), 1, frame.size(), file) == frame.size();
+    }
+
+    uint32_t width, height, pitch = 0;
+    FramePixelFormat format;
+    double hz;
+    FILE* file = nullptr;
+    bool first = true;
+    std::vector<uint8_t> frame;
+    FramePacer pacer;
+};
@@ -0,0 +1,69 @@
+// Fixed-bucket latency histogram
+// Record() is lock-free and can be called from any thread; TakeSummary()
+// reads percentiles and resets, once per stats interval.
+//
+// Buckets are 50us wide up to 100ms, with one overflow bucket. The exact
+// maximum is tracked separately so outliers are not hidden by the overflow.
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+class LatencyHistogram {
+public:
+    static const int kBucketUs = 50;
+    static const int kBuckets = 2000 + 1;   // 0..100ms + overflow
+
+    struct Summary {
+        uint32_t count = 0;
+        double p50 = 0, p95 = 0, p99 = 0, max = 0;  // Milliseconds
+    };
+
+    void Record(int64_t us) {
+        if (us < 0) us = 0;
+        int64_t b = us / kBucketUs;
+        if (b >= kBuckets) b = kBuckets - 1;
+        buckets[b].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        int64_t m = maxUs.load(std::memory_order_relaxed);
+        while (us > m && !maxUs.compare_exchange_weak(m, us, std::memory_order_relaxed)) {}
+    }
+
+    void RecordTicks(int64_t ticks, int64_t ticksPerSecond) {
+        Record(ticks * 1000000 / ticksPerSecond);
+    }
+
+    // Percentiles report the upper edge of the bucket they fall in
+    Summary TakeSummary() {
+        Summary s;
+        s.count = count.exchange(0, std::memory_order_relaxed);
+        s.max = maxUs.exchange(0, std::memory_order_relaxed) / 1000.0;
+
+        uint32_t snapshot[kBuckets];
+        uint32_t total = 0;
+        for (int i = 0; i < kBuckets; i++) {
+            snapshot[i] = buckets[i].exchange(0, std::memory_order_relaxed);
+            total += snapshot[i];
+        }
+        if (total == 0) return s;
+
+        const double pct[3] = {0.50, 0.95, 0.99};
+        double* out[3] = {&s.p50, &s.p95, &s.p99};
+        uint32_t seen = 0;
+        int p = 0;
+        for (int i = 0; i < kBuckets && p < 3; i++) {
+            seen += snapshot[i];
+            while (p < 3 && seen >= pct[p] * total) {
+                double edge = (i + 1) * kBucketUs / 1000.0;
+                *out[p++] = edge < s.max ? edge : s.max;
+            }
+        }
+        return s;
+    }
+
+private:
+    std::atomic<uint32_t> buckets[kBuckets] = {};
+    std::atomic<uint32_t> count{0};
+    std::atomic<int64_t> maxUs{0};
+};
@@ -0,0 +1,143 @@
+// Scene luminance from a log2 histogram, with temporal adaptation
+//
+// The render thread reduces every new HDR frame into a kLuminanceBins
+// histogram of maxRGB luminance on the GPU (g_ComputeShaderHistogram) and
+// reads it back a few frames later. This header is everything after that:
+// the bin layout shared with the shader, the estimate of average and peak
+// luminance, and the smoothing that turns noisy per-frame estimates into a
+// tonemap peak that does not pump. BuildLuminanceHistogram is the CPU
+// version of the reduction (same sampling pattern and bins).
+//
+// Portable C++17.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+#include "color_math.h"
+
+// Bins are uniform in log2(nits); the shader gets these as defines
+const int kLuminanceBins = 128;
+const float kLuminanceMinLog2 = -4.0f;      // 1/16 nit, everything darker lands in bin 0
+const float kLuminanceMaxLog2 = 14.0f;      // 16384 nits, everything brighter in the last bin
+
+inline int LuminanceBin(float nits) {
+    const float binsPerStop = kLuminanceBins / (kLuminanceMaxLog2 - kLuminanceMinLog2);
+    if (!(nits > exp2f(kLuminanceMinLog2))) return 0;
+    int bin = (int)((log2f(nits) - kLuminanceMinLog2) * binsPerStop);
+    return bin < kLuminanceBins - 1 ? bin : kLuminanceBins - 1;
+}
+
+// Lower edge of a bin, in nits (bin == kLuminanceBins gives the top edge)
+inline float LuminanceBinEdge(int bin) {
+    return exp2f(kLuminanceMinLog2 + (kLuminanceMaxLog2 - kLuminanceMinLog2) * bin / kLuminanceBins);
+}
+
+// Sample every step-th pixel in both directions, capped near 512K samples
+inline uint32_t LuminanceSampleStep(uint32_t width, uint32_t height) {
+    uint32_t step = 1;
+    while ((uint64_t)((width + step - 1) / step) * ((height + step - 1) / step) > (1u << 19)) step++;
+    return step;
+}
+
+// CPU version of the histogram shader over an RGBA16F scRGB image
+inline void BuildLuminanceHistogram(const uint8_t* pixels, size_t pitch, uint32_t width, uint32_t height,
+                                    uint32_t step, uint32_t hist[kLuminanceBins]) {
+    memset(hist, 0, sizeof(uint32_t) * kLuminanceBins);
+    for (uint32_t y = 0; y < height; y += step) {
+        const uint16_t* row = (const uint16_t*)(pixels + y * pitch);
+        for (uint32_t x = 0; x < width; x += step) {
+            const uint16_t* p = row + x * 4;
+            float r = HalfToFloat(p[0]), g = HalfToFloat(p[1]), b = HalfToFloat(p[2]);
+            float m = r > g ? r : g;
+            if (b > m) m = b;
+            hist[LuminanceBin(m * 80.0f)]++;
+        }
+    }
+}
+
+struct SceneLuminance {
+    float averageNits = 0;      // Geometric mean
+    float peakNits = 0;         // Upper edge of the bin holding the peak percentile
+    uint32_t samples = 0;
+};
+
+// The peak ignores the brightest (1 - peakPercentile) of the samples so a
+// few stray pixels (cursor, specular sparkle) do not define the scene
+inline SceneLuminance EstimateSceneLuminance(const uint32_t hist[kLuminanceBins], float peakPercentile = 0.999f) {
+    SceneLuminance s;
+    uint64_t total = 0;
+    double logSum = 0;
+    for (int i = 0; i < kLuminanceBins; i++) {
+        total += hist[i];
+        double center = kLuminanceMinLog2 + (kLuminanceMaxLog2 - kLuminanceMinLog2) * (i + 0.5) / kLuminanceBins;
+        logSum += center * hist[i];
+    }
+    s.samples = (uint32_t)total;
+    if (total == 0) return s;
+
+    s.averageNits = (float)exp2(logSum / total);
+    uint64_t seen = 0;
+    for (int i = 0; i < kLuminanceBins; i++) {
+        seen += hist[i];
+        if ((double)seen >= peakPercentile * total) { s.peakNits = LuminanceBinEdge(i + 1); break; }
+    }
+    return s;
+}
+
+// Exponential smoothing in log2 space, frame-rate independent. Brightening
+// follows quickly so new highlights are not clipped for long; darkening
+// follows slowly so the tonemap does not pump on flickering content.
+class LuminanceAdapter {
+public:
+    void Configure(float brightenSeconds, float darkenSeconds) {
+        brighten = brightenSeconds;
+        darken = darkenSeconds;
+    }
+
+    void Reset() { valid = false; }
+
+    void Update(const SceneLuminance& scene, double dtSeconds) {
+        if (scene.samples == 0) return;
+        float peak = log2f(scene.peakNits), avg = log2f(scene.averageNits);
+        if (!valid) {
+            peakLog2 = peak;
+            avgLog2 = avg;
+            valid = true;
+            return;
+        }
+        peakLog2 += (peak - peakLog2) * Alpha(peak > peakLog2, dtSeconds);
+        avgLog2 += (avg - avgLog2) * Alpha(avg > avgLog2, dtSeconds);
+    }
+
+    bool Valid() const { return valid; }
+    float PeakNits() const { return exp2f(peakLog2); }
+    float AverageNits() const { return exp2f(avgLog2); }
+
+private:
+    float Alpha(bool up, double dt) const {
+        double tau = up ? brighten : darken;
+        if (tau <= 0 || dt <= 0) return dt > 0 ? 1.0f : 0.0f;
+        return (float)(1.0 - exp(-dt / tau));
+    }
+
+    float brighten = 0.25f, darken = 2.0f;
+    float peakLog2 = 0, avgLog2 = 0;
+    bool valid = false;
+};
+
+// The adapted peak stays this far above SDR white: at SDR white itself the
+// BT.2390 knee starts at 1 and a dim scene gets a hard clip
+const float kAdaptivePeakMinHeadroom = 1.01f;
+
+// Peak handed to the tonemap: the smoothed scene peak, clamped to
+// [SDR white * kAdaptivePeakMinHeadroom, --peak-nits]
+inline float ClampAdaptivePeak(float scenePeakNits, float sdrWhiteNits, float maxPeakNits) {
+    float floor = sdrWhiteNits * kAdaptivePeakMinHeadroom;
+    if (floor > maxPeakNits) floor = maxPeakNits;
+    if (scenePeakNits > maxPeakNits) scenePeakNits = maxPeakNits;
+    return scenePeakNits > floor ? scenePeakNits : floor;
+}
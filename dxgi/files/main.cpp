@@ -1,9 +1,10 @@
 // DXGI Desktop Mirror - Low-latency display mirroring
 // Capture thread: captures at source refresh rate
 // Render thread: presents with VSync at target refresh rate
-// Supports HDR to SDR tonemapping (maxRGB Reinhard)
+// Supports HDR to SDR tonemapping (selectable operators, analytic or baked into a 3D LUT,
+// optionally following the scene peak measured on the GPU), or HDR passthrough to an HDR target
 //
-// Build: cl /O2 /EHsc main.cpp /link d3d11.lib dxgi.lib d3dcompiler.lib user32.lib winmm.lib
+// Build: cl /O2 /EHsc main.cpp /link d3d11.lib dxgi.lib d3dcompiler.lib user32.lib winmm.lib ws2_32.lib
 
 #define WINVER 0x0A00
 #define _WIN32_WINNT 0x0A00
@@ -12,6 +13,7 @@
 #include <windows.h>
 #include <mmsystem.h>
 #include <d3d11.h>
+#include <d3d11_4.h>
 #include <dxgi1_6.h>
 #include <d3dcompiler.h>
 #include <stdio.h>
@@ -19,12 +21,36 @@
 #include <string.h>
 #include <thread>
 #include <atomic>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "blue_noise_64.h"
+#include "color_lut.h"
+#include "dirty_region.h"
+#include "downscale.h"
+#include "frame_mailbox.h"
+#include "frame_pipe.h"
+#include "frame_ring.h"
+#include "frame_source.h"
+#include "latency_histogram.h"
+#include "luminance_histogram.h"
+#include "pointer_shape.h"
+#include "present_scheduler.h"
+#include "preset.h"
+#include "scaler.h"
+#include "slice_stream.h"
+#include "slot_format.h"
+#include "tonemap.h"
+#include "yuv_convert.h"
 
 #pragma comment(lib, "d3d11.lib")
 #pragma comment(lib, "dxgi.lib")
 #pragma comment(lib, "d3dcompiler.lib")
 #pragma comment(lib, "user32.lib")
 #pragma comment(lib, "winmm.lib")
+#pragma comment(lib, "ws2_32.lib")
 
 // Simple vertex shader - same for SDR and HDR
 const char* g_VertexShader = R"(
@@ -33,51 +59,190 @@ VS_OUTPUT main(float2 pos : POSITION, float2 tex : TEXCOORD0) {
     VS_OUTPUT o; o.pos = float4(pos, 0, 1); o.tex = tex; return o;
 })";
 
-// SDR pixel shader - simple passthrough
+// SDR pixel shader - simple passthrough (also the --scaler horizontal pass)
 const char* g_PixelShaderSDR = R"(
 Texture2D tex : register(t0);
 SamplerState samp : register(s0);
 float4 main(float4 pos : SV_POSITION, float2 uv : TEXCOORD0) : SV_TARGET {
-    return tex.Sample(samp, uv);
+    return SampleSource(tex, samp, uv);
 })";
 
-// SDR pixel shader with gamma correction
-// Used when source monitor is HDR but gives us B8G8R8A8 (linear values in SDR container)
-const char* g_PixelShaderSDRGamma = R"(
-Texture2D tex : register(t0);
-SamplerState samp : register(s0);
+// Prepended to every shader that reads capture slots. With
+// --slot-format pq10 the slot holds BT.2020 PQ (10 bits) and DecodeSlot turns
+// it back into scRGB; the other formats store scRGB and sample as is.
+// slot_format.h has the CPU version (UnpackPq10).
+const char* g_SlotDecode = R"(
+#if SLOT_PQ
+static const float3x3 kSlotBt2020ToBt709 = {
+     1.6604910, -0.5876411, -0.0728499,
+    -0.1245505,  1.1328999, -0.0083494,
+    -0.0181508, -0.1005789,  1.1187297,
+};
 
-float3 lin_to_srgb(float3 lin) {
-    float3 srgb;
-    srgb.r = lin.r <= 0.0031308 ? 12.92 * lin.r : 1.055 * pow(lin.r, 1.0/2.4) - 0.055;
-    srgb.g = lin.g <= 0.0031308 ? 12.92 * lin.g : 1.055 * pow(lin.g, 1.0/2.4) - 0.055;
-    srgb.b = lin.b <= 0.0031308 ? 12.92 * lin.b : 1.055 * pow(lin.b, 1.0/2.4) - 0.055;
-    return srgb;
+float3 SlotPqDecode(float3 e) {
+    float3 p = pow(e, 1.0 / 78.84375);
+    return 10000.0 * pow(max(p - 0.8359375, 0.0) / (18.8515625 - 18.6875 * p), 1.0 / 0.1593017578125);
 }
 
-float4 main(float4 pos : SV_POSITION, float2 uv : TEXCOORD0) : SV_TARGET {
-    float4 color = tex.Sample(samp, uv);
-    color.rgb = saturate(color.rgb);  // Clamp to 0-1
-    color.rgb = lin_to_srgb(color.rgb);
-    return float4(color.rgb, 1.0);
-})";
+float4 DecodeSlot(float4 c) { return float4(mul(kSlotBt2020ToBt709, SlotPqDecode(c.rgb)) / 80.0, 1.0); }
+#else
+float4 DecodeSlot(float4 c) { return c; }
+#endif
+)";
+
+// Follows g_SlotDecode. SampleSource is how the frame shaders read the slot:
+// one sampler tap, decoded. With --scaler bicubic|lanczos3|area it is one
+// axis of the separable filter instead (SCALER = ScalerKernel, scaler.h has
+// the CPU version): SCALER_PASS 1 filters the slot horizontally into the
+// intermediate target, decoding each tap; SCALER_PASS 2 filters that
+// vertically inside the color shader. sharp-bilinear (SCALER 5) stays one
+// tap, moved towards the nearest source pixel center.
+const char* g_SourceSample = R"(
+#ifndef SCALER_PASS
+#define SCALER_PASS 0
+#endif
+#ifndef SCALER
+#define SCALER 1
+#endif
+
+#if SCALER_PASS || SCALER == 5
+cbuffer ScalerConstants : register(b2) {
+    float2 scalerSize;      // Texture this pass reads, in pixels
+    float2 scalerUvScale;   // uv * scale + offset = position in it, in pixels (--crop,
+    float2 scalerUvOffset;  // and the viewport-wide intermediate of the vertical pass)
+    float2 scalerPrescale;  // sharp-bilinear: integer part of the zoom
+    float scalerScale;      // Its pixels per output pixel along the pass axis
+    float scalerStretch;    // Kernel units per pixel: the scale when bicubic/lanczos3 downscale, else 1
+    float scalerSupport;    // Kernel radius times stretch
+    float scalerPadding;
+};
+#endif
+
+#if SCALER_PASS
+
+float ScalerWeight(float x) {
+    x = abs(x);
+#if SCALER == 2
+    // Catmull-Rom
+    if (x < 1.0) return (1.5 * x - 2.5) * x * x + 1.0;
+    if (x < 2.0) return ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;
+    return 0.0;
+#else
+    // Lanczos, 3 lobes
+    if (x < 1e-5) return 1.0;
+    if (x >= 3.0) return 0.0;
+    float px = 3.14159265 * x;
+    return 3.0 * sin(px) * sin(px / 3.0) / (px * px);
+#endif
+}
+
+float4 ScalerTap(Texture2D t, int2 p) {
+    float4 c = t.Load(int3(clamp(p, int2(0, 0), int2(scalerSize) - 1), 0));
+#if SCALER_PASS == 1
+    c = DecodeSlot(c);
+#endif
+    return c;
+}
+
+// Filters along axis (0 = x, 1 = y) for the output pixel uv is in; the other axis maps 1:1
+float4 ScaleAxis(Texture2D t, float2 uv, int axis) {
+    float2 pos = uv * scalerUvScale + scalerUvOffset;
+    int2 p = int2(pos);
+    float4 sum = 0.0;
+    float total = 0.0;
+#if SCALER == 4
+    // Area: each pixel weighted by how much of it [a, b) covers
+    float a = pos[axis] - 0.5 * scalerScale, b = a + scalerScale;
+    int lo = (int)floor(a), hi = (int)ceil(b) - 1;
+    [loop] for (int j = lo; j <= hi; j++) {
+        float w = max(min(j + 1.0, b) - max((float)j, a), 0.0);
+        p[axis] = j;
+        sum += w * ScalerTap(t, p);
+        total += w;
+    }
+#else
+    float c = pos[axis] - 0.5;
+    int lo = (int)floor(c - scalerSupport) + 1, hi = (int)ceil(c + scalerSupport) - 1;
+    [loop] for (int j = lo; j <= hi; j++) {
+        float w = ScalerWeight((j - c) / scalerStretch);
+        p[axis] = j;
+        sum += w * ScalerTap(t, p);
+        total += w;
+    }
+#endif
+    return sum / total;
+}
+#endif
+
+float4 SampleSource(Texture2D t, SamplerState s, float2 uv) {
+#if SCALER_PASS == 1
+    return ScaleAxis(t, uv, 0);
+#elif SCALER_PASS == 2
+    return ScaleAxis(t, uv, 1);     // The intermediate is already decoded
+#elif SCALER == 5
+    // Flat inside each prescaled pixel, a linear ramp one output pixel wide at its edges
+    float2 texel = uv * scalerUvScale + scalerUvOffset;
+    float2 range = 0.5 - 0.5 / scalerPrescale;
+    float2 d = frac(texel) - 0.5;
+    float2 f = (d - clamp(d, -range, range)) * scalerPrescale + 0.5;
+    return DecodeSlot(t.SampleLevel(s, (floor(texel) + f) / scalerSize, 0));
+#else
+    return DecodeSlot(t.SampleLevel(s, uv, 0));    // Level 0: also callable from compute (--render-path)
+#endif
+}
+)";
+
+// Prepended to the shaders that quantize to the SDR swap chain
+// (g_PixelShaderHDR, g_PixelShaderLUT). With DITHER, Dither adds temporal
+// blue noise: +-0.5 output step before quantization, the tile's thresholds
+// rotated by the golden ratio every frame. Exact black and white are left
+// alone so they stay clean.
+const char* g_DitherPrelude = R"(
+#if DITHER
+Texture2D<float> blueNoise : register(t2);
+
+cbuffer DitherConstants : register(b1) {
+    float ditherAmplitude;  // One output step (1/255 or 1/1023)
+    float ditherPhase;      // frac(frame * golden ratio)
+    float2 ditherPadding;
+};
+
+float3 Dither(float3 c, float2 pos) {
+    float n = frac(blueNoise.Load(int3(uint2(pos) % BLUE_NOISE_SIZE, 0)) + ditherPhase);
+    return c + (n - 0.5) * ditherAmplitude * float3(c > 0.0) * float3(c < 1.0);
+}
+#endif
+)";
 
 // HDR to SDR pixel shader with tonemapping
 // Input: scRGB (linear RGB, 1.0 = 80 nits, values can exceed 1.0 for HDR)
 // Output: sRGB (gamma-corrected, 0-1 range)
 //
+// The operator is picked at compile time (TONEMAP_OP, see tonemap.h), its
+// parameters come from the constant buffer (TonemapConstants). tonemap.h has
+// the same math on the CPU.
+//
 // References:
 // - https://knarkowicz.wordpress.com/2016/01/06/aces-filmic-tone-mapping-curve/
 // - https://github.com/obsproject/obs-studio/blob/master/libobs/data/color.effect
+// - ITU-R BT.2390 (EETF), John Hable's Uncharted 2 filmic curve
 const char* g_PixelShaderHDR = R"(
 Texture2D tex : register(t0);
 SamplerState samp : register(s0);
 
 cbuffer Constants : register(b0) {
+    float scale;            // 80 / sdrWhiteNits
     float sdrWhiteNits;
+    float peak;             // Source peak relative to SDR white
+    float exposure;
+    float knee;
+    float kneeSlope;
+    float hableWhiteScale;
+    float padding0;
+    float pqPeak;           // PQ(peak nits)
+    float maxLum;           // PQ(sdrWhiteNits) / pqPeak
+    float ks;               // BT.2390 knee start
     float padding1;
-    float padding2;
-    float padding3;
 };
 
 // sRGB OETF (linear to gamma)
@@ -89,21 +254,63 @@ float3 lin_to_srgb(float3 lin) {
     return srgb;
 }
 
+#if TONEMAP_OP == 0
 // Attempt to match OBS's maxRGB Reinhard tonemapping (simpler, preserves colors better)
-// This is what OBS uses with their default tonemapping
-float3 reinhardMaxRGB(float3 x) {
+// Identity up to SDR white, x / (1 + maxRGB) above it
+float3 Tonemap(float3 x) {
     float maxRGB = max(max(x.r, x.g), x.b);
-    if (maxRGB > 1.0) {
-        float scale = 1.0 / maxRGB;  // Simple Reinhard: x / (1 + x) when maxRGB >> 1
-        scale = maxRGB / (1.0 + maxRGB);  // Proper Reinhard
-        scale /= maxRGB;
-        x *= scale;
+    return maxRGB > 1.0 ? x / (1.0 + maxRGB) : x;
+}
+#elif TONEMAP_OP == 1
+float PqEncode(float nits) {
+    float y = pow(max(nits, 0.0) / 10000.0, 0.1593017578125);
+    return pow((0.8359375 + 18.8515625 * y) / (1.0 + 18.6875 * y), 78.84375);
+}
+
+float PqDecode(float e) {
+    float p = pow(max(e, 0.0), 1.0 / 78.84375);
+    return 10000.0 * pow(max(p - 0.8359375, 0.0) / (18.8515625 - 18.6875 * p), 1.0 / 0.1593017578125);
+}
+
+// BT.2390 EETF on maxRGB, source peak -> SDR white
+float3 Tonemap(float3 x) {
+    float m = max(max(x.r, x.g), x.b);
+    float nits = m * sdrWhiteNits;
+    float e1 = PqEncode(nits) / pqPeak;
+    if (m <= 0.0 || e1 < ks) return x;
+    float e2 = min(e1, 1.0);    // ks = 1 (peak at SDR white): a plain clip
+    if (ks < 1.0) {
+        float t = (e2 - ks) / (1.0 - ks);
+        float t2 = t * t, t3 = t2 * t;
+        e2 = (2.0 * t3 - 3.0 * t2 + 1.0) * ks + (t3 - 2.0 * t2 + t) * (1.0 - ks) + (-2.0 * t3 + 3.0 * t2) * maxLum;
     }
-    return x;
+    return x * (PqDecode(e2 * pqPeak) / nits);
+}
+#elif TONEMAP_OP == 2
+float3 Hable(float3 x) {
+    const float A = 0.15, B = 0.50, C = 0.10, D = 0.20, E = 0.02, F = 0.30;
+    return (x * (A * x + C * B) + D * E) / (x * (A * x + B) + D * F) - E / F;
+}
+
+// Uncharted 2 filmic, source peak -> 1.0
+float3 Tonemap(float3 x) { return Hable(2.0 * exposure * x) * hableWhiteScale; }
+#elif TONEMAP_OP == 3
+// Narkowicz ACES fit
+float3 Tonemap(float3 x) {
+    x *= 0.6 * exposure;
+    return (x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14);
+}
+#else
+// Identity below the knee, maxRGB compressed linearly so the source peak lands on 1.0
+float3 Tonemap(float3 x) {
+    float m = max(max(x.r, x.g), x.b);
+    if (m <= knee) return x;
+    return x * (min(knee + (m - knee) * kneeSlope, 1.0) / m);
 }
+#endif
 
 float4 main(float4 pos : SV_POSITION, float2 uv : TEXCOORD0) : SV_TARGET {
-    float4 color = tex.Sample(samp, uv);
+    float4 color = SampleSource(tex, samp, uv);
 
     // scRGB can have negative values for wide gamut - clamp to 0
     color.rgb = max(color.rgb, 0.0);
@@ -112,12 +319,9 @@ float4 main(float4 pos : SV_POSITION, float2 uv : TEXCOORD0) : SV_TARGET {
     // scRGB: 1.0 = 80 nits (SDR reference white per spec)
     // Windows SDR white slider typically 80-480 nits
     // We need to scale down by the ratio so that "SDR white" maps to 1.0
-    float scale = 80.0 / sdrWhiteNits;
     color.rgb *= scale;
 
-    // Apply maxRGB Reinhard tonemapping for values > 1.0
-    // This preserves SDR content (values <= 1.0) perfectly
-    color.rgb = reinhardMaxRGB(color.rgb);
+    color.rgb = Tonemap(color.rgb);
 
     // Clamp to valid range
     color.rgb = saturate(color.rgb);
@@ -125,59 +329,1231 @@ float4 main(float4 pos : SV_POSITION, float2 uv : TEXCOORD0) : SV_TARGET {
     // Convert linear to sRGB gamma for display
     color.rgb = lin_to_srgb(color.rgb);
 
+#if DITHER
+    color.rgb = Dither(color.rgb, pos.xy);
+#endif
+
     return float4(color.rgb, 1.0);
 })";
 
+// HDR to SDR through a 3D LUT (--color-lut): the whole transform above is
+// baked on the CPU (color_lut.h), the shader only applies the log2 shaper and
+// one lookup. LUT_TETRAHEDRAL selects 4-texel tetrahedral interpolation over
+// the hardware trilinear filter.
+const char* g_PixelShaderLUT = R"(
+Texture2D tex : register(t0);
+Texture3D<float4> lut : register(t1);
+SamplerState samp : register(s0);
+
+cbuffer LutConstants : register(b0) {
+    float shaperMin;    // log2 of the smallest input the LUT resolves
+    float shaperScale;  // 1 / (log2 max - log2 min)
+    float lutSize;
+    float padding;
+};
+
+float3 Shaper(float3 c) {
+    return saturate((log2(max(c, exp2(shaperMin))) - shaperMin) * shaperScale);
+}
+
+#if LUT_TETRAHEDRAL
+float3 LutTexel(int3 i) { return lut.Load(int4(i, 0)).rgb; }
+
+float3 SampleLut(float3 s) {
+    float3 p = s * (lutSize - 1.0);
+    float3 b = min(floor(p), lutSize - 2.0);
+    float3 f = p - b;
+    int3 i = (int3)b;
+    float3 c000 = LutTexel(i);
+    float3 c111 = LutTexel(i + int3(1, 1, 1));
+    if (f.r > f.g) {
+        if (f.g > f.b) {
+            float3 c100 = LutTexel(i + int3(1, 0, 0)), c110 = LutTexel(i + int3(1, 1, 0));
+            return c000 + f.r * (c100 - c000) + f.g * (c110 - c100) + f.b * (c111 - c110);
+        } else if (f.r > f.b) {
+            float3 c100 = LutTexel(i + int3(1, 0, 0)), c101 = LutTexel(i + int3(1, 0, 1));
+            return c000 + f.r * (c100 - c000) + f.b * (c101 - c100) + f.g * (c111 - c101);
+        } else {
+            float3 c001 = LutTexel(i + int3(0, 0, 1)), c101 = LutTexel(i + int3(1, 0, 1));
+            return c000 + f.b * (c001 - c000) + f.r * (c101 - c001) + f.g * (c111 - c101);
+        }
+    } else {
+        if (f.b > f.g) {
+            float3 c001 = LutTexel(i + int3(0, 0, 1)), c011 = LutTexel(i + int3(0, 1, 1));
+            return c000 + f.b * (c001 - c000) + f.g * (c011 - c001) + f.r * (c111 - c011);
+        } else if (f.b > f.r) {
+            float3 c010 = LutTexel(i + int3(0, 1, 0)), c011 = LutTexel(i + int3(0, 1, 1));
+            return c000 + f.g * (c010 - c000) + f.b * (c011 - c010) + f.r * (c111 - c011);
+        } else {
+            float3 c010 = LutTexel(i + int3(0, 1, 0)), c110 = LutTexel(i + int3(1, 1, 0));
+            return c000 + f.g * (c010 - c000) + f.r * (c110 - c010) + f.b * (c111 - c110);
+        }
+    }
+}
+#else
+float3 SampleLut(float3 s) {
+    float3 uvw = (s * (lutSize - 1.0) + 0.5) / lutSize;
+    return lut.SampleLevel(samp, uvw, 0).rgb;
+}
+#endif
+
+float4 main(float4 pos : SV_POSITION, float2 uv : TEXCOORD0) : SV_TARGET {
+    float3 c = SampleLut(Shaper(SampleSource(tex, samp, uv).rgb));
+#if DITHER
+    c = Dither(c, pos.xy);
+#endif
+    return float4(c, 1.0);
+})";
+
+// HDR swap chain output (--output scrgb|hdr10), no tonemapping. SOURCE_SDR
+// places sRGB content at SDR white (also used for the pointer); OUTPUT_PQ
+// converts scRGB to BT.2020 primaries and the PQ curve for HDR10. An HDR
+// source on an scRGB swap chain needs neither and uses the passthrough shader,
+// unless its slots are pq10 (then this shader with OUTPUT_PQ 0 decodes them).
+const char* g_PixelShaderHDROutput = R"(
+Texture2D tex : register(t0);
+SamplerState samp : register(s0);
+
+cbuffer Constants : register(b0) {  // First row of TonemapConstants
+    float scale;
+    float sdrWhiteNits;
+    float2 padding;
+};
+
+float3 srgb_to_lin(float3 c) {
+    return c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+}
+
+float3 PqEncode(float3 nits) {
+    float3 y = pow(max(nits, 0.0) / 10000.0, 0.1593017578125);
+    return pow((0.8359375 + 18.8515625 * y) / (1.0 + 18.6875 * y), 78.84375);
+}
+
+static const float3x3 kBt709ToBt2020 = {
+    0.6274040, 0.3292820, 0.0433136,
+    0.0690970, 0.9195400, 0.0113612,
+    0.0163916, 0.0880132, 0.8955950,
+};
+
+float4 main(float4 pos : SV_POSITION, float2 uv : TEXCOORD0) : SV_TARGET {
+    float4 color = SampleSource(tex, samp, uv);
+#if SOURCE_SDR
+    color.rgb = srgb_to_lin(saturate(color.rgb)) * (sdrWhiteNits / 80.0);
+#endif
+#if OUTPUT_PQ
+    color.rgb = PqEncode(mul(kBt709ToBt2020, color.rgb) * 80.0);
+#endif
+    return color;
+})";
+
+// --render-path compute: appended to a frame shader whose main was renamed
+// FramePixel, and run once per back buffer pixel. Inside the viewport it gets
+// the position and uv the rasterizer would have given it; the bars around
+// get the black the draw path clears to, so nothing else touches the target.
+const char* g_FrameCompute = R"(
+RWTexture2D<float4> frameOutput : register(u0);
+
+cbuffer FrameComputeConstants : register(b4) {
+    float4 frameViewport;   // x, y, width, height
+    float4 frameUv;         // --crop: left, top, right, bottom
+    uint2 frameSize;
+    uint2 framePadding;
+};
+
+[numthreads(8, 8, 1)]
+void main(uint3 id : SV_DispatchThreadID) {
+    if (any(id.xy >= frameSize)) return;
+    float2 pos = id.xy + 0.5;
+    float2 t = (pos - frameViewport.xy) / frameViewport.zw;
+    float4 color = float4(0.0, 0.0, 0.0, 1.0);
+    if (all(t >= 0.0) && all(t < 1.0)) color = FramePixel(float4(pos, 0.0, 1.0), lerp(frameUv.xy, frameUv.zw, t));
+    frameOutput[id.xy] = color;
+}
+)";
+
+// --preset post-processing chain (preset.h). Each draw compiles this prelude
+// and then its passes in order. A pass defines
+//   float4 PassMain(float2 uv, float2 pos)
+// with uv in its input and pos in output pixels (the parameters must keep
+// these names). It reads its input through Source(uv) (sampled per
+// filter_linear) or SourceTexel(int2). The first pass of a draw reads the
+// input texture; a fused pass calls the previous pass at the same uv instead.
+// Also available: SourceSize, OutputSize and OriginalSize (w, h, 1/w, 1/h),
+// FrameCount, PassParams (params<N>) and Original(uv), the color pass output.
+const char* g_ChainPrelude = R"(
+Texture2D chainSource : register(t0);
+Texture2D chainOriginal : register(t1);
+SamplerState chainSampler : register(s0);
+SamplerState chainLinear : register(s1);
+
+cbuffer ChainConstants : register(b3) {
+    float4 OriginalSize;
+    float4 OutputSize;
+    float2 chainOrigin;             // Viewport top-left when drawing into the window
+    uint FrameCount;
+    uint chainPadding;
+    float4 chainSourceSize[8];      // Per pass of the draw
+    float4 chainParams[8];
+};
+
+float4 Original(float2 uv) { return chainOriginal.Sample(chainLinear, uv); }
+)";
+
+// Built-in passes, named in kBuiltinPasses (preset.h). They see the values the
+// color pass wrote: sRGB encoded, like the SDR swap chain.
+struct ChainPassSource { const char* name; const char* hlsl; };
+const ChainPassSource g_ChainPasses[] = {
+    {"stock", R"(
+float4 PassMain(float2 uv, float2 pos) { return Source(uv); }
+)"},
+    // Full brightness at each input line's center, PassParams.x darker halfway between lines
+    {"scanlines", R"(
+float4 PassMain(float2 uv, float2 pos) {
+    float4 c = Source(uv);
+    float d = frac(uv.y * SourceSize.y) - 0.5;
+    float gap = 0.5 - 0.5 * cos(6.28318531 * d);
+    return float4(c.rgb * (1.0 - PassParams.x * gap), c.a);
+}
+)"},
+    // Aperture grille: every third output column keeps one channel, the others lose PassParams.x
+    {"crt-mask", R"(
+float4 PassMain(float2 uv, float2 pos) {
+    float4 c = Source(uv);
+    float3 mask = 1.0 - PassParams.x;
+    mask[(uint)pos.x % 3] = 1.0;
+    return float4(c.rgb * mask, c.a);
+}
+)"},
+    // Contrast adaptive sharpening (after AMD FidelityFX CAS): a negative-lobe
+    // cross filter, weakened where the neighborhood is already contrasty or near clipping
+    {"cas", R"(
+float4 PassMain(float2 uv, float2 pos) {
+    int2 p = int2(uv * SourceSize.xy);
+    float4 e = SourceTexel(p);
+    float3 a = SourceTexel(p + int2(0, -1)).rgb, b = SourceTexel(p + int2(-1, 0)).rgb;
+    float3 c = SourceTexel(p + int2(1, 0)).rgb, d = SourceTexel(p + int2(0, 1)).rgb;
+    float3 mn = min(e.rgb, min(min(a, b), min(c, d)));
+    float3 mx = max(e.rgb, max(max(a, b), max(c, d)));
+    float3 amp = sqrt(saturate(min(mn, 1.0 - mx) / max(mx, 1e-5)));
+    float3 w = -amp / lerp(8.0, 5.0, saturate(PassParams.x));
+    return float4(saturate((e.rgb + w * (a + b + c + d)) / (1.0 + 4.0 * w)), e.a);
+}
+)"},
+};
+
+// Mirrors cbuffer ScalerConstants in g_SourceSample
+struct ScalerConstants {
+    float size[2];
+    float uvScale[2];
+    float uvOffset[2];
+    float prescale[2];
+    float scale;
+    float stretch;
+    float support;
+    float padding;
+};
+
+// Mirrors cbuffer FrameComputeConstants in g_FrameCompute
+struct FrameComputeConstants {
+    float viewport[4];
+    float uv[4];
+    uint32_t size[2];
+    uint32_t padding[2];
+};
+
+// Mirrors cbuffer ChainConstants in g_ChainPrelude
+struct ChainConstants {
+    float originalSize[4];
+    float outputSize[4];
+    float origin[2];
+    uint32_t frameCount;
+    uint32_t padding;
+    float sourceSize[kMaxPresetPasses][4];
+    float params[kMaxPresetPasses][4];
+};
+
+// Mirrors cbuffer DitherConstants in g_DitherPrelude
+struct DitherConstants {
+    float amplitude;
+    float phase;
+    float padding[2];
+};
+
+// Mirrors cbuffer LutConstants in g_PixelShaderLUT
+struct LutConstants {
+    float shaperMin;
+    float shaperScale;
+    float lutSize;
+    float padding;
+};
+
+// Luminance histogram of an HDR frame (--adaptive-peak): maxRGB nits of every
+// step-th pixel into log2 bins, per-group in shared memory, then merged into
+// one buffer. Bin layout comes from luminance_histogram.h as defines.
+const char* g_ComputeShaderHistogram = R"(
+Texture2D<float4> tex : register(t0);
+RWByteAddressBuffer histogram : register(u0);
+
+cbuffer HistogramConstants : register(b0) {
+    uint width;
+    uint height;
+    uint step;
+    uint padding;
+};
+
+groupshared uint bins[BINS];
+
+uint LuminanceBin(float nits) {
+    if (!(nits > exp2(MIN_LOG2))) return 0;
+    return min((uint)((log2(nits) - MIN_LOG2) * (BINS / (MAX_LOG2 - MIN_LOG2))), BINS - 1);
+}
+
+[numthreads(16, 16, 1)]
+void main(uint3 id : SV_DispatchThreadID, uint gi : SV_GroupIndex) {
+    for (uint i = gi; i < BINS; i += 256) bins[i] = 0;
+    GroupMemoryBarrierWithGroupSync();
+
+    uint2 p = id.xy * step;
+    if (p.x < width && p.y < height) {
+        float3 c = DecodeSlot(tex.Load(int3(p, 0))).rgb;
+        InterlockedAdd(bins[LuminanceBin(max(max(c.r, c.g), c.b) * 80.0)], 1);
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    for (uint j = gi; j < BINS; j += 256) {
+        if (bins[j]) histogram.InterlockedAdd(j * 4, bins[j]);
+    }
+})";
+
+// Capture-slot pack (--slot-format, --capture-downscale): fills one region
+// of a slot from the acquired frame, in place of CopySubresourceRegion.
+// R11G11B10 needs no math (the UAV store rounds); PACK_PQ10 encodes BT.2020
+// PQ; PACK_SDR8 is compiled after g_PixelShaderHDR and tonemaps with its
+// Tonemap() and constants. DOWNSCALE averages the source area under each
+// slot pixel (in linear light: SOURCE_SRGB decodes BGRA8 sources first).
+// slot_format.h and downscale.h have the CPU versions.
+const char* g_ComputeShaderPack = R"(
+#if !PACK_SDR8
+Texture2D<float4> tex : register(t0);
+#endif
+RWTexture2D<float4> slot : register(u0);
+
+cbuffer PackConstants : register(b1) {
+    uint2 origin;           // Slot pixels
+    uint2 size;
+    float2 sourceScale;     // Source pixels per slot pixel
+    uint2 sourceSize;
+};
+
+#if SOURCE_SRGB
+float3 PackSrgbDecode(float3 c) { return c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4); }
+float3 PackSrgbEncode(float3 c) { return c <= 0.0031308 ? 12.92 * c : 1.055 * pow(c, 1.0 / 2.4) - 0.055; }
+#endif
+
+float4 LoadSource(int2 p) {
+    float4 c = tex.Load(int3(p, 0));
+#if SOURCE_SRGB
+    c.rgb = PackSrgbDecode(c.rgb);
+#endif
+    return c;
+}
+
+#if DOWNSCALE
+// Box filter over the footprint, partly covered source pixels by coverage
+float4 AreaSample(uint2 p) {
+    float2 a = p * sourceScale, b = a + sourceScale;
+    int2 first = (int2)floor(a);
+    int2 last = min((int2)ceil(b) - 1, (int2)sourceSize - 1);
+    float4 sum = 0;
+    for (int y = first.y; y <= last.y; y++) {
+        float wy = min(b.y, y + 1.0) - max(a.y, (float)y);
+        for (int x = first.x; x <= last.x; x++) {
+            float wx = min(b.x, x + 1.0) - max(a.x, (float)x);
+            sum += (wx * wy) * LoadSource(int2(x, y));
+        }
+    }
+    return sum / (sourceScale.x * sourceScale.y);
+}
+#endif
+
+#if PACK_PQ10
+static const float3x3 kPackBt709ToBt2020 = {
+    0.6274040, 0.3292820, 0.0433136,
+    0.0690970, 0.9195400, 0.0113612,
+    0.0163916, 0.0880132, 0.8955950,
+};
+
+float3 PackPqEncode(float3 nits) {
+    float3 y = pow(max(nits, 0.0) / 10000.0, 0.1593017578125);
+    return pow((0.8359375 + 18.8515625 * y) / (1.0 + 18.6875 * y), 78.84375);
+}
+#endif
+
+[numthreads(8, 8, 1)]
+void pack(uint3 id : SV_DispatchThreadID) {
+    if (any(id.xy >= size)) return;
+    uint2 p = origin + id.xy;
+#if DOWNSCALE
+    float4 c = AreaSample(p);
+#else
+    float4 c = LoadSource(p);
+#endif
+#if SOURCE_SRGB
+    c.rgb = PackSrgbEncode(saturate(c.rgb));
+#elif PACK_PQ10
+    c = float4(PackPqEncode(mul(kPackBt709ToBt2020, c.rgb) * 80.0), 1.0);
+#elif PACK_SDR8
+    c = float4(lin_to_srgb(saturate(Tonemap(max(c.rgb, 0.0) * scale))), 1.0);
+#endif
+    slot[p] = c;
+})";
+
+// Mirrors cbuffer PackConstants in g_ComputeShaderPack
+struct PackConstants {
+    UINT origin[2];
+    UINT size[2];
+    float sourceScale[2];
+    UINT sourceSize[2];
+};
+
+// Capture slot -> NV12 / P010 (--yuv-format), the integer pipeline of
+// yuv_convert.h: one thread per 4x2 block (two chroma samples), into a raw
+// buffer with the encoder layout. Loads go back to the stored bits first
+// (8-bit and 10-bit codes, half-float bits; R11G11B10 values are exact in
+// half), everything after is integer math, so the result matches
+// ConvertToYuvReference byte for byte. YUV_SOURCE: 0 = 8-bit sRGB,
+// 1 = scRGB (FP16 or R11G11B10), 2 = pq10. The PQ code boundaries come
+// from YuvTables in a buffer; LINEAR_MAX and PQ_CODES as defines.
+const char* g_ComputeShaderYuv = R"(
+Texture2D<float4> tex : register(t0);
+Buffer<uint> pqThresholds : register(t1);
+RWByteAddressBuffer yuv : register(u0);
+
+cbuffer YuvConstants : register(b0) {
+    int4 yuvY;              // R', G', B' -> Y' in 1/65536, offset in w
+    int4 yuvCb;             // 2x2 sums -> Cb in 1/262144
+    int4 yuvCr;
+    uint4 toBt2020[3];      // 1/16384
+    uint2 size;             // Slot pixels
+    uint2 blocks;
+    uint pitch;
+    uint chromaOffset;
+    uint outShift;
+    uint padding;
+};
+
+#if YUV_SOURCE == 1
+uint HalfToLinear(uint h) {
+    if (h & 0x8000) return 0;
+    uint e = h >> 10, m = h & 0x3FF;
+    if (e >= 22) return LINEAR_MAX;
+    uint mant = e ? m | 0x400 : m;
+    e = max(e, 1);
+    uint v = e >= 5 ? mant << (e - 5) : (mant + (1u << (4 - e))) >> (5 - e);
+    return min(v, LINEAR_MAX);
+}
+
+uint PqCode(uint light) {
+    uint pos = 0;
+    [unroll] for (uint step = PQ_CODES / 2; step; step >>= 1) {
+        if (pqThresholds[pos + step - 1] <= light) pos += step;
+    }
+    return pos;
+}
+#endif
+
+int3 LoadPixel(uint2 p) {
+    float4 c = tex.Load(int3(min(p, size - 1), 0));
+#if YUV_SOURCE == 0
+    return (int3)round(c.rgb * 255.0);
+#elif YUV_SOURCE == 2
+    uint3 v = (uint3)round(c.rgb * 1023.0);
+    return (int3)((v << 2) | (v >> 8));
+#else
+    uint3 light = uint3(HalfToLinear(f32tof16(c.r)), HalfToLinear(f32tof16(c.g)), HalfToLinear(f32tof16(c.b)));
+    int3 rgb;
+    [unroll] for (int r = 0; r < 3; r++) {
+        uint3 k = toBt2020[r].xyz;
+        uint3 split = (light >> 14) * k + (((light & 0x3FFF) * k) >> 14);
+        rgb[r] = (int)PqCode(split.x + split.y + split.z);
+    }
+    return rgb;
+#endif
+}
+
+// Same order of operations as YuvLuma / YuvChroma (int32, arithmetic shifts)
+uint Luma(int3 c) { return (uint)((yuvY.x * c.r + yuvY.y * c.g + yuvY.z * c.b + yuvY.w) >> 16) << outShift; }
+uint Chroma(int4 k, int3 sum) { return (uint)((k.x * sum.r + k.y * sum.g + k.z * sum.b + k.w) >> 18) << outShift; }
+
+[numthreads(8, 8, 1)]
+void main(uint3 id : SV_DispatchThreadID) {
+    if (any(id.xy >= blocks)) return;
+    uint2 base = id.xy * uint2(4, 2);
+    uint luma[2][4];
+    uint chroma[4];
+    [unroll] for (uint pair = 0; pair < 2; pair++) {
+        int3 sum = 0;
+        [unroll] for (uint j = 0; j < 2; j++) {
+            [unroll] for (uint i = 0; i < 2; i++) {
+                int3 c = LoadPixel(base + uint2(pair * 2 + i, j));
+                luma[j][pair * 2 + i] = Luma(c);
+                sum += c;
+            }
+        }
+        chroma[pair * 2] = Chroma(yuvCb, sum);
+        chroma[pair * 2 + 1] = Chroma(yuvCr, sum);
+    }
+
+#if YUV_P010
+    uint lumaAddress = base.y * pitch + base.x * 2;
+    uint chromaAddress = chromaOffset + id.y * pitch + base.x * 2;
+    [unroll] for (uint row = 0; row < 2; row++) {
+        yuv.Store2(lumaAddress + row * pitch, uint2(luma[row][0] | luma[row][1] << 16, luma[row][2] | luma[row][3] << 16));
+    }
+    yuv.Store2(chromaAddress, uint2(chroma[0] | chroma[1] << 16, chroma[2] | chroma[3] << 16));
+#else
+    uint lumaAddress = base.y * pitch + base.x;
+    uint chromaAddress = chromaOffset + id.y * pitch + base.x;
+    [unroll] for (uint row = 0; row < 2; row++) {
+        yuv.Store(lumaAddress + row * pitch, luma[row][0] | luma[row][1] << 8 | luma[row][2] << 16 | luma[row][3] << 24);
+    }
+    yuv.Store(chromaAddress, chroma[0] | chroma[1] << 8 | chroma[2] << 16 | chroma[3] << 24);
+#endif
+})";
+
+// Mirrors cbuffer YuvConstants in g_ComputeShaderYuv
+struct YuvConstants {
+    int32_t y[4];
+    int32_t cb[4];
+    int32_t cr[4];
+    uint32_t toBt2020[3][4];
+    uint32_t size[2];
+    uint32_t blocks[2];
+    uint32_t pitch;
+    uint32_t chromaOffset;
+    uint32_t outShift;
+    uint32_t padding;
+};
+
 struct Vertex { float x, y, u, v; };
 Vertex g_Quad[] = {{-1,1,0,0}, {1,1,1,0}, {-1,-1,0,1}, {1,-1,1,1}};
 
-// Triple buffer for lock-free producer/consumer
-struct TripleBuffer {
-    ID3D11Texture2D* textures[3] = {nullptr, nullptr, nullptr};
-    ID3D11ShaderResourceView* srvs[3] = {nullptr, nullptr, nullptr};
+// Capture slots, handed from capture to render thread through a lock-free mailbox
+// (3 slots by default, --buffers 4 for high refresh sources)
+const int kMaxCaptureSlots = 4;
 
-    std::atomic<int> writeIdx{0};
-    std::atomic<int> readyIdx{-1};
-    std::atomic<int> displayIdx{-1};
+struct CaptureSlot {
+    ID3D11Texture2D* texture = nullptr;
+    ID3D11ShaderResourceView* srv = nullptr;
 
-    void PublishFrame() {
-        int completed = writeIdx.load(std::memory_order_relaxed);
-        int oldReady = readyIdx.exchange(completed, std::memory_order_acq_rel);
+    // Set by the capture thread before publishing (frame clock / QPC ticks)
+    int64_t captureTime = 0;            // AcquireNextFrame returned
+    int64_t sourcePresentTime = 0;      // DXGI_OUTDUPL_FRAME_INFO::LastPresentTime
 
-        if (oldReady >= 0 && oldReady != displayIdx.load(std::memory_order_acquire)) {
-            writeIdx.store(oldReady, std::memory_order_relaxed);
+    // --device-mode fence: GPU-side ordering between the two devices
+    UINT64 copyFenceValue = 0;          // Capture signals when the copy into this slot is done
+    UINT64 readFenceValue = 0;          // Render signals when its last draw from this slot is done
+};
+
+// How the capture and render devices share slots
+enum class DeviceMode {
+    Legacy,     // Two devices, D3D11_RESOURCE_MISC_SHARED handles, Flush after each copy
+    Single,     // One multithread-protected device, no sharing, no Flush
+    Fence,      // Two devices, NT handle textures, ID3D11Fence in both directions
+};
+
+// Hardware pointer, published by the capture thread through its own small
+// mailbox so pointer moves never touch the capture slots
+struct PointerState {
+    int32_t x = 0, y = 0;               // Shape top-left in source pixels
+    bool visible = false;
+    uint64_t shapeId = 0;               // Bumped on every shape change
+    std::shared_ptr<const PointerImage> shape;
+};
+
+struct PointerLayer {
+    ID3D11Texture2D* texture = nullptr;
+    ID3D11ShaderResourceView* srv = nullptr;
+};
+
+// How the render loop paces presents
+enum class PresentMode {
+    VSync,      // Render + Present(1, 0) back to back
+    Waitable,   // Frame latency waitable object, latch the newest frame just before vblank
+    Tearing,    // Present(0, ALLOW_TEARING) as soon as a frame is captured (VRR targets)
+};
+
+// How the frame reaches the back buffer (--render-path)
+enum class RenderPath {
+    Draw,       // Clear, then a quad over the viewport through the frame pixel shader
+    Compute,    // One dispatch of the same shader over the whole target (bars included) into a UAV
+};
+
+void Fatal(const char* msg, HRESULT hr = 0);
+
+// GPU time of the render pass. Queries are read back a few frames late with
+// DONOTFLUSH so measuring never stalls the render loop.
+struct GpuTimer {
+    static const int kFrames = 4;
+    ID3D11Query* disjoint[kFrames] = {};
+    ID3D11Query* begin[kFrames] = {};
+    ID3D11Query* end[kFrames] = {};
+    bool pending[kFrames] = {};
+    bool active = false;
+    int next = 0;
+    double totalMs = 0;
+
+    void Init(ID3D11Device* device) {
+        D3D11_QUERY_DESC dj = {D3D11_QUERY_TIMESTAMP_DISJOINT, 0};
+        D3D11_QUERY_DESC ts = {D3D11_QUERY_TIMESTAMP, 0};
+        for (int i = 0; i < kFrames; i++) {
+            device->CreateQuery(&dj, &disjoint[i]);
+            device->CreateQuery(&ts, &begin[i]);
+            device->CreateQuery(&ts, &end[i]);
+        }
+    }
+
+    void Begin(ID3D11DeviceContext* ctx) {
+        Collect(ctx);
+        active = disjoint[next] && !pending[next];
+        if (!active) return;    // Ring full, skip timing this frame
+        ctx->Begin(disjoint[next]);
+        ctx->End(begin[next]);
+    }
+
+    void End(ID3D11DeviceContext* ctx) {
+        if (!active) return;
+        ctx->End(end[next]);
+        ctx->End(disjoint[next]);
+        pending[next] = true;
+        next = (next + 1) % kFrames;
+    }
+
+    void Collect(ID3D11DeviceContext* ctx) {
+        for (int i = 0; i < kFrames; i++) {
+            if (!pending[i]) continue;
+            D3D11_QUERY_DATA_TIMESTAMP_DISJOINT dj;
+            UINT64 t0, t1;
+            if (ctx->GetData(disjoint[i], &dj, sizeof(dj), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK) continue;
+            if (ctx->GetData(begin[i], &t0, sizeof(t0), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK) continue;
+            if (ctx->GetData(end[i], &t1, sizeof(t1), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK) continue;
+            pending[i] = false;
+            if (!dj.Disjoint && dj.Frequency) totalMs += (double)(t1 - t0) * 1000.0 / dj.Frequency;
+        }
+    }
+
+    double TakeMs() { double t = totalMs; totalMs = 0; return t; }
+
+    // Waits until every query in flight has been read (--render-bench)
+    void Drain(ID3D11DeviceContext* ctx) {
+        ctx->Flush();
+        for (;;) {
+            Collect(ctx);
+            bool busy = false;
+            for (bool p : pending) busy |= p;
+            if (!busy) return;
+            Sleep(0);
+        }
+    }
+
+    void Release() {
+        for (int i = 0; i < kFrames; i++) {
+            if (disjoint[i]) { disjoint[i]->Release(); disjoint[i] = nullptr; }
+            if (begin[i]) { begin[i]->Release(); begin[i] = nullptr; }
+            if (end[i]) { end[i]->Release(); end[i] = nullptr; }
+            pending[i] = false;
+        }
+    }
+};
+
+// Scene luminance of HDR frames (--adaptive-peak). Each new frame is reduced
+// into a histogram on the GPU and copied to a staging ring; Collect maps the
+// copies with DO_NOT_WAIT a few frames later, so the render loop never waits
+// for the readback. A full ring skips measuring rather than blocking.
+struct LuminanceMeter {
+    static const int kFrames = 4;
+    ID3D11ComputeShader* cs = nullptr;
+    ID3D11Buffer* cb = nullptr;
+    ID3D11Buffer* histogram = nullptr;
+    ID3D11UnorderedAccessView* uav = nullptr;
+    ID3D11Buffer* staging[kFrames] = {};
+    int64_t captureTime[kFrames] = {};  // Of the measured frame, for frame-rate independent smoothing
+    bool pending[kFrames] = {};
+    int next = 0;
+    UINT width = 0, height = 0, step = 1;
+    int64_t lastTime = 0;
+    SceneLuminance scene;               // Latest raw measurement
+    LuminanceAdapter adapter;
+
+    void Init(ID3D11Device* device) {
+        D3D11_BUFFER_DESC bd = {};
+        bd.ByteWidth = kLuminanceBins * sizeof(uint32_t);
+        bd.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+        bd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+        HRESULT hr = device->CreateBuffer(&bd, nullptr, &histogram);
+        if (FAILED(hr)) Fatal("CreateBuffer (histogram)", hr);
+
+        D3D11_UNORDERED_ACCESS_VIEW_DESC ud = {};
+        ud.Format = DXGI_FORMAT_R32_TYPELESS;
+        ud.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+        ud.Buffer.NumElements = kLuminanceBins;
+        ud.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_RAW;
+        device->CreateUnorderedAccessView(histogram, &ud, &uav);
+
+        bd.BindFlags = 0;
+        bd.MiscFlags = 0;
+        bd.Usage = D3D11_USAGE_STAGING;
+        bd.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+        for (int i = 0; i < kFrames; i++) device->CreateBuffer(&bd, nullptr, &staging[i]);
+
+        D3D11_BUFFER_DESC cbd = {};
+        cbd.ByteWidth = 16;
+        cbd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+        device->CreateBuffer(&cbd, nullptr, &cb);
+    }
+
+    void Measure(ID3D11DeviceContext* ctx, ID3D11Texture2D* texture, ID3D11ShaderResourceView* srv, int64_t time) {
+        if (pending[next]) return;  // GPU is far behind, skip this frame
+
+        D3D11_TEXTURE2D_DESC td;
+        texture->GetDesc(&td);
+        if (td.Width != width || td.Height != height) {
+            width = td.Width;
+            height = td.Height;
+            step = LuminanceSampleStep(width, height);
+            UINT c[4] = {width, height, step, 0};
+            ctx->UpdateSubresource(cb, 0, nullptr, c, 0, 0);
+        }
+
+        UINT zero[4] = {};
+        ctx->ClearUnorderedAccessViewUint(uav, zero);
+        ctx->CSSetShader(cs, 0, 0);
+        ctx->CSSetConstantBuffers(0, 1, &cb);
+        ctx->CSSetShaderResources(0, 1, &srv);
+        ctx->CSSetUnorderedAccessViews(0, 1, &uav, nullptr);
+        UINT cols = (width + step - 1) / step, rows = (height + step - 1) / step;
+        ctx->Dispatch((cols + 15) / 16, (rows + 15) / 16, 1);
+
+        ID3D11ShaderResourceView* nullSrv = nullptr;
+        ID3D11UnorderedAccessView* nullUav = nullptr;
+        ctx->CSSetShaderResources(0, 1, &nullSrv);
+        ctx->CSSetUnorderedAccessViews(0, 1, &nullUav, nullptr);
+
+        ctx->CopyResource(staging[next], histogram);
+        captureTime[next] = time;
+        pending[next] = true;
+        next = (next + 1) % kFrames;
+    }
+
+    // Oldest first; stops at the first copy the GPU has not finished.
+    // Returns true if the adapter moved.
+    bool Collect(ID3D11DeviceContext* ctx, int64_t ticksPerSecond) {
+        bool updated = false;
+        for (int k = 0; k < kFrames; k++) {
+            int i = (next + k) % kFrames;
+            if (!pending[i]) continue;
+            D3D11_MAPPED_SUBRESOURCE mapped;
+            if (ctx->Map(staging[i], 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped) != S_OK) break;
+            scene = EstimateSceneLuminance((const uint32_t*)mapped.pData);
+            ctx->Unmap(staging[i], 0);
+            pending[i] = false;
+
+            double dt = lastTime ? (double)(captureTime[i] - lastTime) / ticksPerSecond : 0.0;
+            lastTime = captureTime[i];
+            adapter.Update(scene, dt);
+            updated = true;
+        }
+        return updated;
+    }
+
+    void Release() {
+        for (int i = 0; i < kFrames; i++) {
+            if (staging[i]) { staging[i]->Release(); staging[i] = nullptr; }
+            pending[i] = false;
+        }
+        if (uav) { uav->Release(); uav = nullptr; }
+        if (histogram) { histogram->Release(); histogram = nullptr; }
+        if (cb) { cb->Release(); cb = nullptr; }
+        if (cs) { cs->Release(); cs = nullptr; }
+    }
+};
+
+int64_t CopyDirtyRegion(ID3D11Texture2D* dst, ID3D11Texture2D* tex, const FrameInfo& info,
+                        const DirtyRegion& region);
+
+// Capture side of --slot-format and --capture-downscale: the pending region
+// of a slot is converted from the acquired frame by g_ComputeShaderPack, one
+// dispatch per rect (mapped to slot pixels when downscaling). The acquired
+// texture is read through an SRV when it has one; CPU frames and textures
+// without BIND_SHADER_RESOURCE are first copied into a native scratch.
+struct SlotPacker {
+    ID3D11ComputeShader* cs = nullptr;
+    ID3D11Buffer* cb = nullptr;             // PackConstants
+    ID3D11Buffer* cbTonemap = nullptr;      // sdr8: TonemapConstants on the capture device
+    ID3D11UnorderedAccessView* uav[kMaxCaptureSlots] = {};
+    ID3D11Texture2D* scratch = nullptr;
+    ID3D11ShaderResourceView* scratchSrv = nullptr;
+    ID3D11Texture2D* sourceTex = nullptr;   // Acquired texture sourceSrv was made for (kept alive by it)
+    ID3D11ShaderResourceView* sourceSrv = nullptr;
+    UINT sourceWidth = 0, sourceHeight = 0;
+    UINT slotWidth = 0, slotHeight = 0;
+
+    void Init(ID3D11Device* device, ID3D11Texture2D** slots, int count, DXGI_FORMAT sourceFormat,
+              UINT width, UINT height, UINT slotW, UINT slotH, bool needScratch) {
+        sourceWidth = width;
+        sourceHeight = height;
+        slotWidth = slotW;
+        slotHeight = slotH;
+        for (int i = 0; i < count; i++) {
+            HRESULT hr = device->CreateUnorderedAccessView(slots[i], nullptr, &uav[i]);
+            if (FAILED(hr)) Fatal("CreateUnorderedAccessView (capture slot)", hr);
+        }
+
+        D3D11_BUFFER_DESC bd = {};
+        bd.ByteWidth = sizeof(PackConstants);
+        bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+        device->CreateBuffer(&bd, nullptr, &cb);
+
+        if (needScratch) {
+            D3D11_TEXTURE2D_DESC td = {};
+            td.Width = width;
+            td.Height = height;
+            td.MipLevels = td.ArraySize = 1;
+            td.Format = sourceFormat;
+            td.SampleDesc.Count = 1;
+            td.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+            HRESULT hr = device->CreateTexture2D(&td, nullptr, &scratch);
+            if (FAILED(hr)) Fatal("CreateTexture2D (pack scratch)", hr);
+            device->CreateShaderResourceView(scratch, nullptr, &scratchSrv);
+        }
+    }
+
+    ID3D11ShaderResourceView* SourceView(ID3D11Device* device, ID3D11Texture2D* tex) {
+        if (tex != sourceTex) {
+            if (sourceSrv) { sourceSrv->Release(); sourceSrv = nullptr; }
+            sourceTex = tex;
+            device->CreateShaderResourceView(tex, nullptr, &sourceSrv);
+        }
+        return sourceSrv;
+    }
+
+    // Same region rules and return value as CopyDirtyRegion
+    int64_t Pack(ID3D11Device* device, ID3D11DeviceContext* ctx, int slotIdx, ID3D11Texture2D* tex,
+                 const FrameInfo& info, const DirtyRegion& region) {
+        if (region.Empty()) return 0;
+
+        ID3D11ShaderResourceView* srv;
+        if (scratch) {
+            CopyDirtyRegion(scratch, tex, info, region);
+            srv = scratchSrv;
         } else {
-            int disp = displayIdx.load(std::memory_order_acquire);
-            int ready = readyIdx.load(std::memory_order_acquire);
-            for (int i = 0; i < 3; i++) {
-                if (i != ready && i != disp) {
-                    writeIdx.store(i, std::memory_order_relaxed);
-                    break;
+            srv = SourceView(device, tex);
+        }
+
+        ctx->CSSetShader(cs, 0, 0);
+        ID3D11Buffer* cbs[2] = {cbTonemap, cb};
+        ctx->CSSetConstantBuffers(0, 2, cbs);
+        ctx->CSSetShaderResources(0, 1, &srv);
+        ctx->CSSetUnorderedAccessViews(0, 1, &uav[slotIdx], nullptr);
+
+        int64_t frameArea = (int64_t)info.width * info.height;
+        int64_t packed;
+        if (region.IsFull() || region.Area() * 4 > frameArea * 3) {
+            Dispatch(ctx, FrameRect{0, 0, (int32_t)slotWidth, (int32_t)slotHeight});
+            packed = frameArea;
+        } else {
+            for (const FrameRect& r : region.Rects()) {
+                Dispatch(ctx, DownscaleRect(r, sourceWidth, sourceHeight, slotWidth, slotHeight));
+            }
+            packed = region.Area();
+        }
+
+        ID3D11ShaderResourceView* nullSrv = nullptr;
+        ID3D11UnorderedAccessView* nullUav = nullptr;
+        ctx->CSSetShaderResources(0, 1, &nullSrv);
+        ctx->CSSetUnorderedAccessViews(0, 1, &nullUav, nullptr);
+        return packed;
+    }
+
+    void Dispatch(ID3D11DeviceContext* ctx, const FrameRect& r) {
+        UINT w = (UINT)(r.right - r.left), h = (UINT)(r.bottom - r.top);
+        PackConstants pc = {{(UINT)r.left, (UINT)r.top}, {w, h},
+                            {(float)sourceWidth / slotWidth, (float)sourceHeight / slotHeight},
+                            {sourceWidth, sourceHeight}};
+        ctx->UpdateSubresource(cb, 0, nullptr, &pc, 0, 0);
+        ctx->Dispatch((w + 7) / 8, (h + 7) / 8, 1);
+    }
+
+    void Release() {
+        for (ID3D11UnorderedAccessView*& v : uav) {
+            if (v) { v->Release(); v = nullptr; }
+        }
+        if (sourceSrv) { sourceSrv->Release(); sourceSrv = nullptr; }
+        sourceTex = nullptr;
+        if (scratchSrv) { scratchSrv->Release(); scratchSrv = nullptr; }
+        if (scratch) { scratch->Release(); scratch = nullptr; }
+        if (cbTonemap) { cbTonemap->Release(); cbTonemap = nullptr; }
+        if (cb) { cb->Release(); cb = nullptr; }
+        if (cs) { cs->Release(); cs = nullptr; }
+    }
+};
+
+// --scaler bicubic|lanczos3|area on the render device: the horizontal pass
+// draws the slot into an FP16 target as wide as the viewport and as tall as
+// the slot, the frame shader then filters that vertically (SCALER_PASS 2).
+// Built with the first frame drawn (InitScaler).
+struct RenderScaler {
+    ID3D11PixelShader* ps = nullptr;        // Horizontal pass (passthrough with SCALER_PASS 1)
+    ID3D11Texture2D* texture = nullptr;
+    ID3D11RenderTargetView* rtv = nullptr;
+    ID3D11ShaderResourceView* srv = nullptr;
+    ID3D11Buffer* cb[2] = {};               // ScalerConstants: horizontal, vertical
+    UINT width = 0, height = 0;
+
+    // Leaves the render target unbound and the vertical constants at b2;
+    // returns the intermediate for the frame shader
+    ID3D11ShaderResourceView* Horizontal(ID3D11DeviceContext* ctx, ID3D11ShaderResourceView* slotSrv) {
+        D3D11_VIEWPORT vp = {0, 0, (float)width, (float)height, 0, 1};
+        ctx->OMSetRenderTargets(1, &rtv, nullptr);
+        ctx->RSSetViewports(1, &vp);
+        ctx->PSSetShader(ps, 0, 0);
+        ctx->PSSetConstantBuffers(2, 1, &cb[0]);
+        ctx->PSSetShaderResources(0, 1, &slotSrv);
+        ctx->Draw(4, 0);
+
+        ID3D11ShaderResourceView* nullSrv = nullptr;
+        ctx->PSSetShaderResources(0, 1, &nullSrv);
+        ctx->OMSetRenderTargets(0, nullptr, nullptr);
+        ctx->PSSetConstantBuffers(2, 1, &cb[1]);
+        return srv;
+    }
+
+    void Release() {
+        for (ID3D11Buffer*& b : cb) {
+            if (b) { b->Release(); b = nullptr; }
+        }
+        if (srv) { srv->Release(); srv = nullptr; }
+        if (rtv) { rtv->Release(); rtv = nullptr; }
+        if (texture) { texture->Release(); texture = nullptr; }
+        if (ps) { ps->Release(); ps = nullptr; }
+    }
+};
+
+// FP16 texture drawn into and then sampled
+struct RenderTarget {
+    ID3D11Texture2D* texture = nullptr;
+    ID3D11RenderTargetView* rtv = nullptr;
+    ID3D11ShaderResourceView* srv = nullptr;
+    UINT width = 0, height = 0;
+
+    HRESULT Create(ID3D11Device* device, UINT w, UINT h) {
+        D3D11_TEXTURE2D_DESC td = {};
+        td.Width = width = w;
+        td.Height = height = h;
+        td.MipLevels = td.ArraySize = 1;
+        td.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+        td.SampleDesc.Count = 1;
+        td.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+        HRESULT hr = device->CreateTexture2D(&td, nullptr, &texture);
+        if (FAILED(hr)) return hr;
+        device->CreateRenderTargetView(texture, nullptr, &rtv);
+        return device->CreateShaderResourceView(texture, nullptr, &srv);
+    }
+
+    void Release() {
+        if (srv) { srv->Release(); srv = nullptr; }
+        if (rtv) { rtv->Release(); rtv = nullptr; }
+        if (texture) { texture->Release(); texture = nullptr; }
+    }
+};
+
+// --preset on the render device: the color pass draws the (cropped) slot 1:1
+// into original, then every draw of the plan runs its fused passes into a
+// pool target, the last one into the window. Built with the first frame
+// drawn (InitChain).
+struct RenderChain {
+    Preset preset;
+    ChainPlan plan;
+    std::vector<ID3D11PixelShader*> ps;     // Per draw
+    RenderTarget original;
+    std::vector<RenderTarget> pool;         // plan.targetWidth/Height
+    ID3D11Buffer* cb = nullptr;             // ChainConstants, rewritten per draw
+    ID3D11SamplerState* samplerPoint = nullptr;  // filter_linear = false
+    uint32_t frameCount = 0;
+
+    // Leaves the window bound as the render target, at the viewport
+    void Run(ID3D11DeviceContext* ctx, ID3D11RenderTargetView* window, const D3D11_VIEWPORT& viewport,
+             ID3D11SamplerState* linear) {
+        for (size_t i = 0; i < plan.draws.size(); i++) {
+            const ChainDraw& d = plan.draws[i];
+            bool last = d.output < 0;
+
+            ChainConstants c = {};
+            float sizes[3][2] = {{(float)original.width, (float)original.height}, {(float)d.width, (float)d.height},
+                                 {(float)d.inputWidth, (float)d.inputHeight}};
+            float* dst[3] = {c.originalSize, c.outputSize, c.sourceSize[0]};
+            for (int k = 0; k < 3; k++) {
+                dst[k][0] = sizes[k][0];
+                dst[k][1] = sizes[k][1];
+                dst[k][2] = 1.0f / sizes[k][0];
+                dst[k][3] = 1.0f / sizes[k][1];
+            }
+            for (int k = d.firstPass; k <= d.lastPass; k++) {
+                int j = k - d.firstPass;
+                if (j > 0) memcpy(c.sourceSize[j], c.outputSize, sizeof(c.outputSize));  // Fused: same size as the output
+                memcpy(c.params[j], preset.passes[k].params, sizeof(c.params[j]));
+            }
+            if (last) {
+                c.origin[0] = viewport.TopLeftX;
+                c.origin[1] = viewport.TopLeftY;
+            }
+            c.frameCount = frameCount;
+            D3D11_MAPPED_SUBRESOURCE mapped;
+            if (SUCCEEDED(ctx->Map(cb, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped))) {
+                memcpy(mapped.pData, &c, sizeof(c));
+                ctx->Unmap(cb, 0);
+            }
+
+            D3D11_VIEWPORT vp = {0, 0, (float)d.width, (float)d.height, 0, 1};
+            ctx->OMSetRenderTargets(1, last ? &window : &pool[d.output].rtv, nullptr);
+            ctx->RSSetViewports(1, last ? &viewport : &vp);
+            ID3D11ShaderResourceView* srvs[2] = {d.input < 0 ? original.srv : pool[d.input].srv, original.srv};
+            ID3D11SamplerState* samplers[2] = {preset.passes[d.firstPass].filterLinear ? linear : samplerPoint, linear};
+            ctx->PSSetShaderResources(0, 2, srvs);
+            ctx->PSSetSamplers(0, 2, samplers);
+            ctx->PSSetConstantBuffers(3, 1, &cb);
+            ctx->PSSetShader(ps[i], 0, 0);
+            ctx->Draw(4, 0);
+
+            ID3D11ShaderResourceView* nullSrvs[2] = {};
+            ctx->PSSetShaderResources(0, 2, nullSrvs);
+        }
+        frameCount++;
+    }
+
+    void Release() {
+        for (ID3D11PixelShader* p : ps) p->Release();
+        ps.clear();
+        for (RenderTarget& t : pool) t.Release();
+        pool.clear();
+        original.Release();
+        if (cb) { cb->Release(); cb = nullptr; }
+        if (samplerPoint) { samplerPoint->Release(); samplerPoint = nullptr; }
+    }
+};
+
+// --yuv-format on the render device: every new frame is converted from its
+// capture slot into a raw buffer in the encoder layout (yuv_convert.h) by
+// g_ComputeShaderYuv. Built with the first frame drawn (InitYuvStage), when
+// the slot format is known.
+struct YuvStage {
+    ID3D11ComputeShader* cs = nullptr;
+    ID3D11Buffer* cb = nullptr;                         // YuvConstants
+    ID3D11Buffer* thresholds = nullptr;                 // tables.pqThresholds (P010)
+    ID3D11ShaderResourceView* thresholdsSrv = nullptr;
+    ID3D11Buffer* output = nullptr;                     // layout.size bytes, NV12 or P010
+    ID3D11UnorderedAccessView* uav = nullptr;
+    YuvSource source = YuvSource::Bgra8;
+    YuvLayout layout;
+    YuvTables tables;
+    GpuTimer timer;
+    int64_t pixels = 0;                                 // Converted since the last status line
+
+    void Convert(ID3D11DeviceContext* ctx, ID3D11ShaderResourceView* slotSrv) {
+        ID3D11ShaderResourceView* srvs[2] = {slotSrv, thresholdsSrv};
+        timer.Begin(ctx);
+        ctx->CSSetShader(cs, 0, 0);
+        ctx->CSSetConstantBuffers(0, 1, &cb);
+        ctx->CSSetShaderResources(0, 2, srvs);
+        ctx->CSSetUnorderedAccessViews(0, 1, &uav, nullptr);
+        UINT blocksX = layout.paddedWidth / 4, blocksY = layout.paddedHeight / 2;
+        ctx->Dispatch((blocksX + 7) / 8, (blocksY + 7) / 8, 1);
+        timer.End(ctx);
+        pixels += (int64_t)layout.width * layout.height;
+
+        ID3D11ShaderResourceView* nullSrvs[2] = {};
+        ID3D11UnorderedAccessView* nullUav = nullptr;
+        ctx->CSSetShaderResources(0, 2, nullSrvs);
+        ctx->CSSetUnorderedAccessViews(0, 1, &nullUav, nullptr);
+    }
+
+    void Release() {
+        timer.Release();
+        if (uav) { uav->Release(); uav = nullptr; }
+        if (output) { output->Release(); output = nullptr; }
+        if (thresholdsSrv) { thresholdsSrv->Release(); thresholdsSrv = nullptr; }
+        if (thresholds) { thresholds->Release(); thresholds = nullptr; }
+        if (cb) { cb->Release(); cb = nullptr; }
+        if (cs) { cs->Release(); cs = nullptr; }
+    }
+};
+
+// Capture slots -> CPU for --frame-server, --output-pipe and --stream. Each
+// published frame is copied into a staging ring on the capture device;
+// Collect maps the copies with DO_NOT_WAIT on later passes of the capture
+// loop, so Map never waits on the copy just issued, and hands them to the
+// shared-memory ring, the pipe and the network stream. A full staging ring
+// drops the frame, and its damage goes out with the next one so ring
+// readers' dirty rects stay complete.
+struct SlotReadback {
+    static const int kFrames = 4;
+    ID3D11Texture2D* staging[kFrames] = {};
+    FrameRingInfo info[kFrames];
+    uint64_t frameId[kFrames] = {};     // Pipe frame ids: every frame queued or dropped counts
+    bool pending[kFrames] = {};
+    int next = 0;
+    uint64_t frameCount = 0;
+    DirtyRegion carried;                // Slot pixels changed since the last queued frame
+    FrameRingWriter ring;               // --frame-server
+    FramePipe pipe;                     // --output-pipe
+    SliceSender stream;                 // --stream
+    FrameRingFormat format = FrameRingFormat::Bgra8;
+    UINT width = 0, height = 0, rowBytes = 0;
+    std::atomic<int> served{0};         // Published to the ring since the last status line
+    std::atomic<int> dropped{0};        // Staging ring full
+    static_assert(DirtyRegion::kMaxRects <= kFrameRingMaxDirty, "a frame's dirty rects must fit its ring slot");
+
+    bool Init(ID3D11Device* device, const D3D11_TEXTURE2D_DESC& slot, UINT bytesPerPixel) {
+        D3D11_TEXTURE2D_DESC td = {};
+        td.Width = slot.Width;
+        td.Height = slot.Height;
+        td.MipLevels = 1;
+        td.ArraySize = 1;
+        td.Format = slot.Format;
+        td.SampleDesc.Count = 1;
+        td.Usage = D3D11_USAGE_STAGING;
+        td.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+        for (int i = 0; i < kFrames; i++) {
+            if (FAILED(device->CreateTexture2D(&td, nullptr, &staging[i]))) return false;
+        }
+        width = slot.Width;
+        height = slot.Height;
+        rowBytes = slot.Width * bytesPerPixel;
+        carried.Reset(width, height);
+        carried.SetFull();              // Readers start from a whole frame
+        return true;
+    }
+
+    bool IsOpen() const { return staging[0] != nullptr; }
+
+    bool Pending() const {
+        for (bool p : pending) if (p) return true;
+        return false;
+    }
+
+    // After the copy into the slot, on the capture context. damage is in
+    // source pixels (sourceW x sourceH), the slot may be downscaled.
+    void Queue(ID3D11DeviceContext* ctx, ID3D11Texture2D* slotTexture, const DirtyRegion& damage,
+               UINT sourceW, UINT sourceH, int64_t captureTime, int64_t sourcePresentTime) {
+        for (const FrameRect& r : damage.Rects()) carried.Add(DownscaleRect(r, sourceW, sourceH, width, height));
+        frameCount++;
+        if (pending[next]) {            // Readback is far behind, drop this frame
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        ctx->CopyResource(staging[next], slotTexture);
+
+        FrameRingInfo& fi = info[next];
+        fi = FrameRingInfo();
+        fi.captureTime = captureTime;
+        fi.sourcePresentTime = sourcePresentTime;
+        fi.format = format;
+        fi.width = width;
+        fi.height = height;
+        fi.pitch = rowBytes;
+        if (!carried.IsFull()) {
+            for (const FrameRect& r : carried.Rects()) fi.dirty[fi.dirtyCount++] = r;
+        }
+        carried.Clear();
+        frameId[next] = frameCount;
+        pending[next] = true;
+        next = (next + 1) % kFrames;
+    }
+
+    // Oldest first; stops at the first copy the GPU has not finished
+    void Collect(ID3D11DeviceContext* ctx) {
+        for (int k = 0; k < kFrames; k++) {
+            int i = (next + k) % kFrames;
+            if (!pending[i]) continue;
+            D3D11_MAPPED_SUBRESOURCE mapped;
+            if (ctx->Map(staging[i], 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped) != S_OK) break;
+            const uint8_t* src = (const uint8_t*)mapped.pData;
+            if (ring.IsOpen()) {
+                uint8_t* dst = ring.BeginFrame();
+                for (UINT y = 0; y < height; y++) {
+                    memcpy(dst + (size_t)y * rowBytes, src + (size_t)y * mapped.RowPitch, rowBytes);
                 }
+                ring.Publish(info[i]);
+                served.fetch_add(1, std::memory_order_relaxed);
             }
+            if (pipe.IsOpen()) pipe.Push({frameId[i], info[i].captureTime, info[i].sourcePresentTime}, src, mapped.RowPitch);
+            if (stream.IsOpen()) stream.Push({frameId[i], info[i].captureTime}, src, mapped.RowPitch);
+            ctx->Unmap(staging[i], 0);
+            pending[i] = false;
         }
     }
 
-    int AcquireFrame() {
-        int ready = readyIdx.exchange(-1, std::memory_order_acq_rel);
-        if (ready >= 0) {
-            displayIdx.store(ready, std::memory_order_release);
+    void Release() {
+        for (int i = 0; i < kFrames; i++) {
+            if (staging[i]) { staging[i]->Release(); staging[i] = nullptr; }
+            pending[i] = false;
         }
-        return displayIdx.load(std::memory_order_acquire);
+        stream.Close();
+        pipe.Close();
+        ring.Close();
     }
+};
 
-    int GetWriteIndex() { return writeIdx.load(std::memory_order_relaxed); }
+// Swap chain format (--output)
+enum class OutputMode {
+    Sdr,        // B8G8R8A8, HDR sources are tonemapped
+    Sdr10,      // R10G10B10A2 in sRGB, HDR sources are tonemapped
+    Scrgb,      // R16G16B16A16_FLOAT, linear BT.709 (1.0 = 80 nits), HDR slots are drawn as is
+    Hdr10,      // R10G10B10A2, BT.2020 + PQ
 };
 
+inline bool IsHdrOutput(OutputMode m) { return m == OutputMode::Scrgb || m == OutputMode::Hdr10; }
+
+class DxgiFrameSource;
+
 struct {
     int sourceMonitor = 0;
     int targetMonitor = 1;
-    bool preserveAspect = true;
+    ViewportFit fit = ViewportFit::Aspect;     // --stretch, --integer-scale exact
     bool tonemap = true;  // HDR to SDR tonemapping (can be disabled with --no-tonemap)
-    float sdrWhiteNits = 240.0f;  // SDR white level in nits (matches OBS default)
+    TonemapParams tonemapParams;  // Operator, SDR white (240 nits matches OBS default), source peak
+    int lutSize = 0;              // HDR tonemapping through an N^3 LUT (--color-lut), 0 = analytic shader
+    LutInterpolation lutInterp = LutInterpolation::Tetrahedral;
+    std::string lutCacheDir;      // Empty = system temp directory
+    bool adaptivePeak = false;    // Tonemap peak follows the measured scene peak, up to peakNits
+    float adaptedPeakNits = 0;    // Peak the HDR constants currently use (render thread)
     bool debug = false;   // Debug output
+    bool dirtyRects = true;  // Copy only changed regions into capture slots (--full-copy disables)
+    bool showPointer = true; // Composite the hardware cursor (--no-cursor disables)
+    DeviceMode deviceMode = DeviceMode::Legacy;
+    PresentMode presentMode = PresentMode::VSync;
+    RenderPath renderPath = RenderPath::Draw;
+    bool renderBench = false;       // --render-bench: time both render paths offscreen, then exit
+    OutputMode outputMode = OutputMode::Sdr;
+    bool outputAuto = false;        // --output auto: HDR10 target -> scRGB, otherwise SDR
+    bool dither = true;             // Blue-noise dither after tonemapping (--no-dither disables)
+    uint32_t ditherFrame = 0;
+    SlotFormat slotFormat = SlotFormat::Native;    // Capture slot storage for HDR sources (--slot-format)
+    bool captureDownscale = false;  // Area-downscale into target-sized slots at capture (--capture-downscale)
+    ScalerKernel scalerKernel = ScalerKernel::Bilinear;    // Slot -> viewport filter (--scaler)
+    bool allowTearing = false;      // Tearing mode and the system supports it
+    int idleTimeoutMs = 0;          // > 0: skip redraws without new content, block after this long idle
+    double latchMarginMs = 2.0;     // Waitable mode: acquire the frame this long before vblank
     std::atomic<bool> running{true};
 
+    // Frame source (--synthetic / --replay replace the monitor source)
+    bool useSynthetic = false;
+    SyntheticSourceDesc synthetic;
+    const char* replayPath = nullptr;
+    UINT replayWidth = 0, replayHeight = 0;
+    double replayHz = 60.0;
+    FramePixelFormat cpuSourceFormat = FramePixelFormat::BGRA8;
+
     HWND hwnd = nullptr;
     int windowWidth = 0, windowHeight = 0;
 
@@ -187,33 +1563,113 @@ struct {
     IDXGISwapChain1* swapChain = nullptr;
     ID3D11RenderTargetView* rtv = nullptr;
 
+    // Waitable present mode
+    HANDLE frameLatencyWaitable = nullptr;
+
+    // Set by the capture thread after each publish (frame or pointer)
+    HANDLE frameReadyEvent = nullptr;
+    IDXGIOutput* targetOutput = nullptr;    // For WaitForVBlank while idle
+    PresentScheduler scheduler;
+    bool haveFrameStats = false;
+    DXGI_FRAME_STATISTICS lastFrameStats = {};
+
     ID3D11VertexShader* vs = nullptr;
     ID3D11PixelShader* psSDR = nullptr;
-    ID3D11PixelShader* psSDRGamma = nullptr;  // For HDR monitor giving SDR format
+    ID3D11PixelShader* psOutputSDR = nullptr; // SDR source (and pointer) into an HDR swap chain
+    ID3D11PixelShader* psOutputHDR = nullptr; // HDR source into an HDR10 swap chain
     ID3D11PixelShader* psHDR = nullptr;
+    ID3D11PixelShader* psFrameSDR = nullptr;        // psSDR / psOutputSDR for the frame: the vertical
+    ID3D11PixelShader* psFrameOutputSDR = nullptr;  // pass with a two-pass --scaler, else the same shaders
+    RenderScaler scaler;
+    RenderChain chain;                  // --preset, empty without
+    bool convertYuv = false;            // --yuv-format: convert each new frame for an encoder
+    YuvFormat yuvFormat = YuvFormat::Nv12;
+    bool yuvCheck = false;              // --yuv-check: compare one conversion with the CPU, then exit
+    YuvStage yuv;
+    const char* frameServerName = nullptr;  // --frame-server: publish captured frames to shared memory
+    const char* outputPipePath = nullptr;   // --output-pipe: write captured frames for an encoder ("-" = stdout)
+    int outputPipeStdout = -1;              // --output-pipe -: the real stdout (stdout goes to stderr)
+    FramePipeConfig pipeConfig;             // Container, queue and drop policy from the command line
+    std::string streamHost;                 // --stream HOST:PORT: send captured frames to a remote slice-receive
+    int streamPort = 0;
+    SliceStreamConfig streamConfig;         // Slice rows, FEC, refresh and MTU from the command line
+    SlotReadback readback;                  // All of the above
+    std::vector<std::pair<ID3D11PixelShader*, ID3D11ComputeShader*>> frameCompute;  // Frame shader -> compute variant
+    ID3D11UnorderedAccessView* frameUav = nullptr;  // Set: compute path, into the back buffer or frameTarget
+    ID3D11Texture2D* frameTarget = nullptr;         // Back buffer without UAV usage: dispatch here, then copy
+    ID3D11Buffer* cbFrameCompute = nullptr;         // FrameComputeConstants, built with the first dispatch
     ID3D11InputLayout* layout = nullptr;
     ID3D11Buffer* vb = nullptr;
-    ID3D11Buffer* cbHDR = nullptr;  // Constant buffer for HDR shader
+    ID3D11Buffer* vbFrame = nullptr;    // g_Quad with the texture coordinates of --crop
+    ID3D11Buffer* cbHDR = nullptr;  // TonemapConstants for the HDR shader (dynamic with --adaptive-peak)
+    ID3D11PixelShader* psLUT = nullptr;
+    ID3D11Texture3D* lutTexture = nullptr;
+    ID3D11ShaderResourceView* lutSrv = nullptr;
+    ID3D11Buffer* cbLUT = nullptr;
+    ID3D11Texture2D* blueNoiseTexture = nullptr;
+    ID3D11ShaderResourceView* blueNoiseSrv = nullptr;
+    ID3D11Buffer* cbDither = nullptr;
     ID3D11SamplerState* sampler = nullptr;
+    ID3D11SamplerState* samplerPoint = nullptr; // --scaler nearest
+
+    // Pointer compositing (render thread)
+    ID3D11BlendState* blendOver = nullptr;      // Premultiplied alpha
+    ID3D11BlendState* blendInvert = nullptr;    // dst = 1 - dst where src is white
+    PointerLayer pointerColor, pointerInvert;
+    UINT pointerWidth = 0, pointerHeight = 0;
+    uint64_t pointerShapeId = 0;
+    PointerState pointerShown;
 
-    // Capture thread resources
+    // Capture thread resources (same objects as device/context in single mode)
     ID3D11Device* capDevice = nullptr;
     ID3D11DeviceContext* capContext = nullptr;
-    IDXGIOutputDuplication* duplication = nullptr;
-
-    TripleBuffer buffer;
+    SlotPacker packer;                      // --slot-format with an HDR source
+
+    // --device-mode single
+    ID3D11Multithread* multithread = nullptr;
+
+    // --device-mode fence
+    ID3D11DeviceContext4* context4 = nullptr;
+    ID3D11DeviceContext4* capContext4 = nullptr;
+    ID3D11Fence* copyFence = nullptr;       // Render device view of the capture's copy fence
+    ID3D11Fence* capCopyFence = nullptr;
+    ID3D11Fence* readFence = nullptr;       // Render device signals after sampling a slot
+    ID3D11Fence* capReadFence = nullptr;
+    UINT64 readFenceValue = 0;              // Render thread only
+    IFrameSource* source = nullptr;
+    DxgiFrameSource* dxgiSource = nullptr;  // Same object as source when capturing a monitor
+
+    FrameMailbox<CaptureSlot, kMaxCaptureSlots> buffer;
+    FrameMailbox<PointerState, 3> pointer;
+    int bufferCount = 3;
 
     RECT sourceRect = {}, targetRect = {};
+    RECT crop = {};                     // Part of the source drawn, relative to it (--crop, default all)
     D3D11_VIEWPORT viewport = {};
 
     // Source format info (detected from first captured frame)
     bool sourceIsHDR = false;           // True if actual captured format is HDR (R16G16B16A16_FLOAT)
     bool sourceReportedHDR = false;     // True if monitor reported HDR capability
+    bool slotsPacked = false;           // HDR source in a compact --slot-format: packed, not copied
+    bool slotsHDR = false;              // Slots hold HDR (scRGB or pq10), false for SDR sources and sdr8
     DXGI_FORMAT sourceFormat = DXGI_FORMAT_B8G8R8A8_UNORM;
     std::atomic<bool> bufferInitialized{false};
 
     // Stats
+    GpuTimer renderTimer;
+    GpuTimer copyTimer;                 // Capture device: copy or pack of each frame
+    LuminanceMeter luminance;
+    LatencyHistogram captureLatency;    // Capture -> Present
+    LatencyHistogram sourceLatency;     // Source present -> Present
     std::atomic<int> captureCount{0};
+    std::atomic<int> imageUpdates{0};       // Updates by class (see ClassifyFrameUpdate)
+    std::atomic<int> pointerUpdates{0};
+    std::atomic<int> metadataUpdates{0};
+    std::atomic<int64_t> copiedPixels{0};   // Pixels copied into slots
+    std::atomic<int64_t> copyTicks{0};      // Capture thread CPU time issuing copy + sync
+    std::atomic<int> copyCount{0};
+    std::atomic<int64_t> copyGpuUs{0};      // GPU time of those copies (copyTimer)
+    std::atomic<int64_t> capturedPixels{0}; // Pixels a full copy per frame would have moved
     std::atomic<UINT64> captureFrameId{0};
     UINT64 lastRenderedId = 0;
 
@@ -222,7 +1678,21 @@ struct {
 
 void Cleanup();
 
-void Fatal(const char* msg, HRESULT hr = 0) {
+const char* DeviceModeName(DeviceMode m) {
+    switch (m) {
+        case DeviceMode::Single: return "single";
+        case DeviceMode::Fence: return "fence";
+        default: return "legacy";
+    }
+}
+
+// Serializes immediate context use between threads in single device mode
+struct DeviceLock {
+    DeviceLock() { if (g.multithread) g.multithread->Enter(); }
+    ~DeviceLock() { if (g.multithread) g.multithread->Leave(); }
+};
+
+void Fatal(const char* msg, HRESULT hr) {
     if (hr) fprintf(stderr, "FATAL: %s (0x%08X)\n", msg, (unsigned)hr);
     else fprintf(stderr, "FATAL: %s\n", msg);
     Cleanup();
@@ -259,6 +1729,43 @@ bool GetMonitorRect(int idx, RECT* rect) {
     return info.index == 0 || (rect->right - rect->left) > 0;
 }
 int GetMonitorCount() { return GetSystemMetrics(SM_CMONITORS); }
+
+double GetMonitorRefreshHz(const RECT& rect) {
+    MONITORINFOEXA mi = {}; mi.cbSize = sizeof(mi);
+    GetMonitorInfoA(MonitorFromRect(&rect, MONITOR_DEFAULTTONEAREST), &mi);
+    DEVMODEA dm = {}; dm.dmSize = sizeof(dm);
+    if (EnumDisplaySettingsA(mi.szDevice, ENUM_CURRENT_SETTINGS, &dm) && dm.dmDisplayFrequency > 1) {
+        return (double)dm.dmDisplayFrequency;
+    }
+    return 60.0;
+}
+
+// DXGI description of the output covering rect (HDR state, luminance range)
+bool GetOutputDesc1(IDXGIFactory2* factory, const RECT& rect, DXGI_OUTPUT_DESC1* desc) {
+    IDXGIFactory1* factory1;
+    if (FAILED(factory->QueryInterface(&factory1))) return false;
+    bool found = false;
+    IDXGIAdapter1* adapter;
+    for (UINT a = 0; !found && factory1->EnumAdapters1(a, &adapter) != DXGI_ERROR_NOT_FOUND; a++) {
+        IDXGIOutput* output;
+        for (UINT o = 0; !found && adapter->EnumOutputs(o, &output) != DXGI_ERROR_NOT_FOUND; o++) {
+            DXGI_OUTPUT_DESC od;
+            output->GetDesc(&od);
+            if (EqualRect(&od.DesktopCoordinates, &rect)) {
+                IDXGIOutput6* output6;
+                if (SUCCEEDED(output->QueryInterface(&output6))) {
+                    found = SUCCEEDED(output6->GetDesc1(desc));
+                    output6->Release();
+                }
+            }
+            output->Release();
+        }
+        adapter->Release();
+    }
+    factory1->Release();
+    return found;
+}
+
 void PrintMonitors() {
     printf("Available monitors:\n");
     for (int i = 0; i < GetMonitorCount(); i++) {
@@ -285,22 +1792,76 @@ void CreateWindow_() {
         WS_POPUP | WS_VISIBLE, g.targetRect.left, g.targetRect.top,
         g.windowWidth, g.windowHeight, nullptr, nullptr, GetModuleHandle(nullptr), nullptr);
 
-    float srcW = (float)(g.sourceRect.right - g.sourceRect.left);
-    float srcH = (float)(g.sourceRect.bottom - g.sourceRect.top);
-    float dstW = (float)g.windowWidth, dstH = (float)g.windowHeight;
+    // Whole pixels, so target-sized slots (--capture-downscale) are drawn 1:1
+    ViewportRect v = FitViewport(g.fit, g.crop.right - g.crop.left, g.crop.bottom - g.crop.top,
+                                 g.windowWidth, g.windowHeight);
+    g.viewport = {v.x, v.y, v.width, v.height, 0, 1};
+}
+
+// Creates a shared fence on the first device and opens it on the second
+void CreateSharedFence(ID3D11Device* owner, ID3D11Device* other, ID3D11Fence** ownerFence, ID3D11Fence** otherFence) {
+    ID3D11Device5 *owner5 = nullptr, *other5 = nullptr;
+    HRESULT hr = owner->QueryInterface(&owner5);
+    if (SUCCEEDED(hr)) hr = other->QueryInterface(&other5);
+    if (FAILED(hr)) Fatal("ID3D11Device5 not supported (use --device-mode legacy)", hr);
+
+    hr = owner5->CreateFence(0, D3D11_FENCE_FLAG_SHARED, __uuidof(ID3D11Fence), (void**)ownerFence);
+    if (FAILED(hr)) Fatal("CreateFence", hr);
+
+    HANDLE handle = nullptr;
+    hr = (*ownerFence)->CreateSharedHandle(nullptr, GENERIC_ALL, nullptr, &handle);
+    if (FAILED(hr)) Fatal("Fence CreateSharedHandle", hr);
+    hr = other5->OpenSharedFence(handle, __uuidof(ID3D11Fence), (void**)otherFence);
+    CloseHandle(handle);
+    if (FAILED(hr)) Fatal("OpenSharedFence", hr);
+
+    owner5->Release();
+    other5->Release();
+}
+
+void InitFences() {
+    HRESULT hr = g.context->QueryInterface(&g.context4);
+    if (SUCCEEDED(hr)) hr = g.capContext->QueryInterface(&g.capContext4);
+    if (FAILED(hr)) Fatal("ID3D11DeviceContext4 not supported (use --device-mode legacy)", hr);
+
+    CreateSharedFence(g.capDevice, g.device, &g.capCopyFence, &g.copyFence);
+    CreateSharedFence(g.device, g.capDevice, &g.readFence, &g.capReadFence);
+}
 
-    if (g.preserveAspect) {
-        float srcAspect = srcW / srcH, dstAspect = dstW / dstH;
-        if (srcAspect > dstAspect) {
-            float h = dstW / srcAspect;
-            g.viewport = {0, (dstH-h)/2, dstW, h, 0, 1};
-        } else {
-            float w = dstH * srcAspect;
-            g.viewport = {(dstW-w)/2, 0, w, dstH, 0, 1};
-        }
-    } else {
-        g.viewport = {0, 0, dstW, dstH, 0, 1};
+// Swap chain format per --output. The compute path stores through a UAV,
+// which B8G8R8A8 does not support, so its 8-bit output is R8G8B8A8.
+DXGI_FORMAT BackBufferFormat(bool uav) {
+    switch (g.outputMode) {
+        case OutputMode::Sdr: return uav ? DXGI_FORMAT_R8G8B8A8_UNORM : DXGI_FORMAT_B8G8R8A8_UNORM;
+        case OutputMode::Scrgb: return DXGI_FORMAT_R16G16B16A16_FLOAT;
+        default: return DXGI_FORMAT_R10G10B10A2_UNORM;
+    }
+}
+
+// --render-path compute: the UAV goes on the back buffer when the swap chain
+// was created with UAV usage. Otherwise Render dispatches into an
+// intermediate of the same size and format and copies it over (one CopyResource).
+void InitFrameTarget(ID3D11Texture2D* backBuffer, bool uavUsage) {
+    D3D11_TEXTURE2D_DESC td;
+    backBuffer->GetDesc(&td);
+    UINT support = 0;
+    g.device->CheckFormatSupport(td.Format, &support);
+    if (!(support & D3D11_FORMAT_SUPPORT_TYPED_UNORDERED_ACCESS_VIEW)) {
+        Fatal("No UAV support for the swap chain format (use --render-path draw)");
+    }
+    if (uavUsage && SUCCEEDED(g.device->CreateUnorderedAccessView(backBuffer, nullptr, &g.frameUav))) {
+        printf("  Render path: compute, into the back buffer\n");
+        return;
     }
+
+    td.Usage = D3D11_USAGE_DEFAULT;
+    td.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+    td.CPUAccessFlags = td.MiscFlags = 0;
+    HRESULT hr = g.device->CreateTexture2D(&td, nullptr, &g.frameTarget);
+    if (FAILED(hr)) Fatal("CreateTexture2D (frame target)", hr);
+    hr = g.device->CreateUnorderedAccessView(g.frameTarget, nullptr, &g.frameUav);
+    if (FAILED(hr)) Fatal("CreateUnorderedAccessView (frame target)", hr);
+    printf("  Render path: compute, through an intermediate (no UAV back buffers)\n");
 }
 
 void InitD3D() {
@@ -313,36 +1874,205 @@ void InitD3D() {
         D3D11_SDK_VERSION, &g.device, &flOut, &g.context);
     if (FAILED(hr)) Fatal("D3D11CreateDevice (render)", hr);
 
-    hr = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr,
-        D3D11_CREATE_DEVICE_BGRA_SUPPORT, fl, 2,
-        D3D11_SDK_VERSION, &g.capDevice, &flOut, &g.capContext);
-    if (FAILED(hr)) Fatal("D3D11CreateDevice (capture)", hr);
+    if (g.deviceMode == DeviceMode::Single) {
+        // Capture thread shares the immediate context; the device lock makes that safe
+        hr = g.context->QueryInterface(&g.multithread);
+        if (FAILED(hr)) Fatal("ID3D11Multithread not supported (use --device-mode legacy)", hr);
+        g.multithread->SetMultithreadProtected(TRUE);
+        g.capDevice = g.device; g.capDevice->AddRef();
+        g.capContext = g.context; g.capContext->AddRef();
+    } else {
+        hr = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr,
+            D3D11_CREATE_DEVICE_BGRA_SUPPORT, fl, 2,
+            D3D11_SDK_VERSION, &g.capDevice, &flOut, &g.capContext);
+        if (FAILED(hr)) Fatal("D3D11CreateDevice (capture)", hr);
+    }
+
+    if (g.deviceMode == DeviceMode::Fence) InitFences();
 
     IDXGIDevice* dxgiDev; g.device->QueryInterface(&dxgiDev);
     IDXGIAdapter* adapter; dxgiDev->GetAdapter(&adapter); dxgiDev->Release();
     IDXGIFactory2* factory; adapter->GetParent(__uuidof(IDXGIFactory2), (void**)&factory);
     adapter->Release();
 
+    // HDR output only when Windows runs the target in HDR mode
+    DXGI_OUTPUT_DESC1 targetDesc = {};
+    bool targetHDR = GetOutputDesc1(factory, g.targetRect, &targetDesc) &&
+                     targetDesc.ColorSpace == DXGI_COLOR_SPACE_RGB_FULL_G2084_NONE_P2020;
+    if (g.outputAuto) {
+        g.outputMode = targetHDR ? OutputMode::Scrgb : OutputMode::Sdr;
+    } else if (IsHdrOutput(g.outputMode) && !targetHDR) {
+        printf("  Target is not in HDR mode, falling back to SDR output\n");
+        g.outputMode = OutputMode::Sdr;
+    }
+    if (targetHDR) {
+        printf("  Target HDR: %.0f-%.0f nits, output %s\n", targetDesc.MinLuminance, targetDesc.MaxLuminance,
+               g.outputMode == OutputMode::Scrgb ? "scRGB (FP16)" :
+               g.outputMode == OutputMode::Hdr10 ? "HDR10 (R10G10B10A2 PQ)" :
+               g.outputMode == OutputMode::Sdr10 ? "SDR 10-bit" : "SDR");
+    }
+
+    // --render-path compute asks for UAV back buffers (InitFrameTarget)
+    bool compute = g.renderPath == RenderPath::Compute;
     DXGI_SWAP_CHAIN_DESC1 scd = {};
     scd.Width = g.windowWidth; scd.Height = g.windowHeight;
-    scd.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+    scd.Format = BackBufferFormat(compute);
     scd.SampleDesc.Count = 1;
-    scd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+    scd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT | (compute ? DXGI_USAGE_UNORDERED_ACCESS : 0);
     scd.BufferCount = 2;
     scd.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
+    if (g.presentMode == PresentMode::Waitable) scd.Flags |= DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
+
+    if (g.presentMode == PresentMode::Tearing) {
+        BOOL allowTearing = FALSE;
+        IDXGIFactory5* factory5;
+        if (SUCCEEDED(factory->QueryInterface(&factory5))) {
+            if (FAILED(factory5->CheckFeatureSupport(DXGI_FEATURE_PRESENT_ALLOW_TEARING,
+                                                     &allowTearing, sizeof(allowTearing)))) {
+                allowTearing = FALSE;
+            }
+            factory5->Release();
+        }
+        if (allowTearing) {
+            scd.Flags |= DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING;
+        } else {
+            printf("  Tearing not supported, falling back to event-driven VSync\n");
+        }
+        g.allowTearing = allowTearing != FALSE;
+    }
 
     hr = factory->CreateSwapChainForHwnd(g.device, g.hwnd, &scd, nullptr, nullptr, &g.swapChain);
+    if (FAILED(hr) && compute) {
+        scd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+        hr = factory->CreateSwapChainForHwnd(g.device, g.hwnd, &scd, nullptr, nullptr, &g.swapChain);
+    }
     factory->Release();
     if (FAILED(hr)) Fatal("CreateSwapChain", hr);
 
+    // Sdr10 keeps the default color space of R10G10B10A2 (G22 P709)
+    if (IsHdrOutput(g.outputMode)) {
+        DXGI_COLOR_SPACE_TYPE cs = g.outputMode == OutputMode::Scrgb ? DXGI_COLOR_SPACE_RGB_FULL_G10_NONE_P709
+                                                                     : DXGI_COLOR_SPACE_RGB_FULL_G2084_NONE_P2020;
+        IDXGISwapChain3* sc3;
+        hr = g.swapChain->QueryInterface(&sc3);
+        if (SUCCEEDED(hr)) {
+            UINT support = 0;
+            hr = sc3->CheckColorSpaceSupport(cs, &support);
+            if (SUCCEEDED(hr) && !(support & DXGI_SWAP_CHAIN_COLOR_SPACE_SUPPORT_FLAG_PRESENT)) hr = DXGI_ERROR_UNSUPPORTED;
+            if (SUCCEEDED(hr)) hr = sc3->SetColorSpace1(cs);
+            sc3->Release();
+        }
+        if (FAILED(hr)) Fatal("SetColorSpace1 (use --output sdr)", hr);
+    }
+
+    if (g.presentMode == PresentMode::Waitable) {
+        IDXGISwapChain2* sc2;
+        hr = g.swapChain->QueryInterface(&sc2);
+        if (FAILED(hr)) Fatal("IDXGISwapChain2 not supported (use --present-mode vsync)", hr);
+        sc2->SetMaximumFrameLatency(1);
+        g.frameLatencyWaitable = sc2->GetFrameLatencyWaitableObject();
+        sc2->Release();
+
+        double hz = GetMonitorRefreshHz(g.targetRect);
+        double maxMarginMs = PresentScheduler::MaxMarginMs(hz);
+        if (g.latchMarginMs > maxMarginMs) {
+            char msg[160];
+            snprintf(msg, sizeof(msg), "--latch-margin %.1fms is above %.2fms, 3/4 of the %.2fms refresh period",
+                     g.latchMarginMs, maxMarginMs, 1000.0 / hz);
+            Fatal(msg);
+        }
+        g.scheduler.Configure(FrameClockFrequency(), hz, g.latchMarginMs);
+        if (g.debug) printf("[DEBUG] Waitable swap chain, target %.2fHz, margin %.1fms\n", hz, g.latchMarginMs);
+    }
+
     ID3D11Texture2D* bb;
     g.swapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (void**)&bb);
     g.device->CreateRenderTargetView(bb, nullptr, &g.rtv);
+    if (compute) InitFrameTarget(bb, (scd.BufferUsage & DXGI_USAGE_UNORDERED_ACCESS) != 0);
     bb->Release();
 }
 
+// Shaders that read slots get the slot decode and SampleSource in front
+// (SLOT_PQ, SCALER and SCALER_PASS pick the variant)
+std::string WithSourceSample(const char* shader) {
+    return std::string(g_SlotDecode) + g_SourceSample + shader;
+}
+
+ID3D11PixelShader* CompilePixelShader(const char* shader, const char* name, const D3D_SHADER_MACRO* defines) {
+    ID3DBlob *blob, *err;
+    std::string source = WithSourceSample(shader);
+    HRESULT hr = D3DCompile(source.c_str(), source.size(), name, defines, 0, "main", "ps_5_0", 0, 0, &blob, &err);
+    if (FAILED(hr)) {
+        if (err) fprintf(stderr, "%s compile error: %s\n", name, (char*)err->GetBufferPointer());
+        Fatal("Pixel shader compile");
+    }
+    ID3D11PixelShader* ps = nullptr;
+    g.device->CreatePixelShader(blob->GetBufferPointer(), blob->GetBufferSize(), 0, &ps);
+    blob->Release();
+    return ps;
+}
+
+// A shader the frame may be drawn with. With --render-path compute (or
+// --render-bench) its compute variant is built too and registered in
+// g.frameCompute: main becomes FramePixel, called by g_FrameCompute.
+ID3D11PixelShader* CompileFrameShader(const char* shader, const char* name, const D3D_SHADER_MACRO* defines) {
+    ID3D11PixelShader* ps = CompilePixelShader(shader, name, defines);
+    if (g.renderPath != RenderPath::Compute && !g.renderBench) return ps;
+
+    ID3DBlob *blob, *err;
+    std::string source = "#define main FramePixel\n" + WithSourceSample(shader) + "\n#undef main\n" + g_FrameCompute;
+    HRESULT hr = D3DCompile(source.c_str(), source.size(), name, defines, 0, "main", "cs_5_0", 0, 0, &blob, &err);
+    if (FAILED(hr)) {
+        if (err) fprintf(stderr, "%s (compute) compile error: %s\n", name, (char*)err->GetBufferPointer());
+        Fatal("Frame compute shader compile");
+    }
+    ID3D11ComputeShader* cs = nullptr;
+    g.device->CreateComputeShader(blob->GetBufferPointer(), blob->GetBufferSize(), 0, &cs);
+    blob->Release();
+    g.frameCompute.push_back({ps, cs});
+    return ps;
+}
+
+// Slot pack compute shader, on the capture device. Built with the first
+// frame, once it is known whether the source is SDR or HDR.
+void InitPackShader(bool sdrSource, bool downscale) {
+    HRESULT hr; ID3DBlob *blob, *err;
+    SlotFormat f = sdrSource ? SlotFormat::Native : g.slotFormat;
+    char tonemapOp[8];
+    snprintf(tonemapOp, sizeof(tonemapOp), "%d", (int)g.tonemapParams.op);
+    D3D_SHADER_MACRO defines[] = {{"PACK_PQ10", f == SlotFormat::Pq10 ? "1" : "0"}, {"PACK_SDR8", f == SlotFormat::Sdr8 ? "1" : "0"},
+                                  {"SOURCE_SRGB", sdrSource ? "1" : "0"}, {"DOWNSCALE", downscale ? "1" : "0"},
+                                  {"TONEMAP_OP", tonemapOp}, {"DITHER", "0"}, {"SLOT_PQ", "0"}, {nullptr, nullptr}};
+    std::string source = f == SlotFormat::Sdr8 ? WithSourceSample(g_PixelShaderHDR) : std::string();
+    source += g_ComputeShaderPack;
+    hr = D3DCompile(source.c_str(), source.size(), "CS_Pack", defines, 0, "pack", "cs_5_0", 0, 0, &blob, &err);
+    if (FAILED(hr)) {
+        if (err) fprintf(stderr, "CS Pack compile error: %s\n", (char*)err->GetBufferPointer());
+        Fatal("CS Pack compile");
+    }
+    g.capDevice->CreateComputeShader(blob->GetBufferPointer(), blob->GetBufferSize(), 0, &g.packer.cs);
+    blob->Release();
+
+    if (f == SlotFormat::Sdr8) {
+        TonemapConstants tc = ComputeTonemapConstants(g.tonemapParams);
+        D3D11_BUFFER_DESC cbd = {};
+        cbd.Usage = D3D11_USAGE_IMMUTABLE;
+        cbd.ByteWidth = sizeof(TonemapConstants);
+        cbd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+        D3D11_SUBRESOURCE_DATA cbData = {&tc};
+        g.capDevice->CreateBuffer(&cbd, &cbData, &g.packer.cbTonemap);
+    }
+}
+
 void InitShaders() {
     HRESULT hr; ID3DBlob *blob, *err;
+    const char* slotPq = g.slotFormat == SlotFormat::Pq10 ? "1" : "0";
+
+    // With a two-pass --scaler the frame shaders do the vertical pass
+    bool twoPass = ScalerIsSeparable(g.scalerKernel);
+    char scaler[8];
+    snprintf(scaler, sizeof(scaler), "%d", (int)g.scalerKernel);
+    const char* framePass = twoPass ? "2" : "0";
 
     // Vertex shader (shared)
     hr = D3DCompile(g_VertexShader, strlen(g_VertexShader), "VS", 0, 0, "main", "vs_5_0", 0, 0, &blob, &err);
@@ -357,48 +2087,275 @@ void InitShaders() {
     blob->Release();
 
     // SDR pixel shader (passthrough)
-    hr = D3DCompile(g_PixelShaderSDR, strlen(g_PixelShaderSDR), "PS_SDR", 0, 0, "main", "ps_5_0", 0, 0, &blob, &err);
-    if (FAILED(hr)) Fatal("PS SDR compile");
-    g.device->CreatePixelShader(blob->GetBufferPointer(), blob->GetBufferSize(), 0, &g.psSDR);
-    blob->Release();
+    D3D_SHADER_MACRO sdrDefines[] = {{"SLOT_PQ", "0"}, {nullptr, nullptr}};
+    g.psSDR = CompileFrameShader(g_PixelShaderSDR, "PS_SDR", sdrDefines);
+
+    // HDR pixel shader (with tonemapping), one variant per operator
+    char tonemapOp[8], noiseSize[8];
+    snprintf(tonemapOp, sizeof(tonemapOp), "%d", (int)g.tonemapParams.op);
+    snprintf(noiseSize, sizeof(noiseSize), "%d", kBlueNoiseSize);
+    const char* dither = g.dither ? "1" : "0";
+    D3D_SHADER_MACRO hdrDefines[] = {{"TONEMAP_OP", tonemapOp}, {"DITHER", dither}, {"BLUE_NOISE_SIZE", noiseSize},
+                                     {"SLOT_PQ", slotPq}, {"SCALER", scaler}, {"SCALER_PASS", framePass}, {nullptr, nullptr}};
+    std::string hdrSource = std::string(g_DitherPrelude) + g_PixelShaderHDR;
+    g.psHDR = CompileFrameShader(hdrSource.c_str(), "PS_HDR", hdrDefines);
+
+    // HDR swap chain shaders (psOutputHDR also decodes pq10 slots for --no-tonemap)
+    if (IsHdrOutput(g.outputMode) || g.slotFormat == SlotFormat::Pq10) {
+        const char* pq = g.outputMode == OutputMode::Hdr10 ? "1" : "0";
+        D3D_SHADER_MACRO sdrDefines[] = {{"SOURCE_SDR", "1"}, {"OUTPUT_PQ", pq}, {"SLOT_PQ", "0"}, {nullptr, nullptr}};
+        D3D_SHADER_MACRO hdrDefines[] = {{"SOURCE_SDR", "0"}, {"OUTPUT_PQ", pq}, {"SLOT_PQ", slotPq},
+                                         {"SCALER", scaler}, {"SCALER_PASS", framePass}, {nullptr, nullptr}};
+        g.psOutputSDR = CompileFrameShader(g_PixelShaderHDROutput, "PS_HDR_Output_SDR", sdrDefines);
+        g.psOutputHDR = CompileFrameShader(g_PixelShaderHDROutput, "PS_HDR_Output", hdrDefines);
+    }
 
-    // SDR pixel shader with gamma correction (for HDR monitor giving SDR format)
-    hr = D3DCompile(g_PixelShaderSDRGamma, strlen(g_PixelShaderSDRGamma), "PS_SDR_Gamma", 0, 0, "main", "ps_5_0", 0, 0, &blob, &err);
-    if (FAILED(hr)) {
-        if (err) fprintf(stderr, "PS SDR Gamma compile error: %s\n", (char*)err->GetBufferPointer());
-        Fatal("PS SDR Gamma compile");
+    // The pointer keeps the single-tap shaders; the frame gets its own vertical-pass
+    // (or sharp-bilinear) variants
+    if (!ScalerIsHardware(g.scalerKernel)) {
+        const char* pq = g.outputMode == OutputMode::Hdr10 ? "1" : "0";
+        D3D_SHADER_MACRO frameDefines[] = {{"SOURCE_SDR", "1"}, {"OUTPUT_PQ", pq}, {"SLOT_PQ", "0"},
+                                           {"SCALER", scaler}, {"SCALER_PASS", framePass}, {nullptr, nullptr}};
+        g.psFrameSDR = CompileFrameShader(g_PixelShaderSDR, "PS_Frame_SDR", frameDefines);
+        if (g.psOutputSDR) g.psFrameOutputSDR = CompileFrameShader(g_PixelShaderHDROutput, "PS_Frame_Output_SDR", frameDefines);
+    } else {
+        g.psFrameSDR = g.psSDR;
+        g.psFrameSDR->AddRef();
+        g.psFrameOutputSDR = g.psOutputSDR;
+        if (g.psFrameOutputSDR) g.psFrameOutputSDR->AddRef();
     }
-    g.device->CreatePixelShader(blob->GetBufferPointer(), blob->GetBufferSize(), 0, &g.psSDRGamma);
-    blob->Release();
 
-    // HDR pixel shader (with tonemapping)
-    hr = D3DCompile(g_PixelShaderHDR, strlen(g_PixelShaderHDR), "PS_HDR", 0, 0, "main", "ps_5_0", 0, 0, &blob, &err);
-    if (FAILED(hr)) {
-        if (err) fprintf(stderr, "PS HDR compile error: %s\n", (char*)err->GetBufferPointer());
-        Fatal("PS HDR compile");
+    // LUT pixel shader (the LUT itself is built when the first HDR frame is drawn)
+    if (g.lutSize > 0) {
+        const char* tetrahedral = g.lutInterp == LutInterpolation::Tetrahedral ? "1" : "0";
+        D3D_SHADER_MACRO lutDefines[] = {{"LUT_TETRAHEDRAL", tetrahedral}, {"DITHER", dither}, {"BLUE_NOISE_SIZE", noiseSize},
+                                         {"SLOT_PQ", slotPq}, {"SCALER", scaler}, {"SCALER_PASS", framePass}, {nullptr, nullptr}};
+        std::string lutSource = std::string(g_DitherPrelude) + g_PixelShaderLUT;
+        g.psLUT = CompileFrameShader(lutSource.c_str(), "PS_LUT", lutDefines);
+    }
+
+    // Luminance histogram compute shader
+    if (g.adaptivePeak) {
+        char bins[16], minLog2[16], maxLog2[16];
+        snprintf(bins, sizeof(bins), "%d", kLuminanceBins);
+        snprintf(minLog2, sizeof(minLog2), "%.1f", kLuminanceMinLog2);
+        snprintf(maxLog2, sizeof(maxLog2), "%.1f", kLuminanceMaxLog2);
+        D3D_SHADER_MACRO defines[] = {{"BINS", bins}, {"MIN_LOG2", minLog2}, {"MAX_LOG2", maxLog2}, {"SLOT_PQ", slotPq}, {nullptr, nullptr}};
+        std::string histogramSource = WithSourceSample(g_ComputeShaderHistogram);
+        hr = D3DCompile(histogramSource.c_str(), histogramSource.size(), "CS_Histogram", defines, 0, "main", "cs_5_0", 0, 0, &blob, &err);
+        if (FAILED(hr)) {
+            if (err) fprintf(stderr, "CS Histogram compile error: %s\n", (char*)err->GetBufferPointer());
+            Fatal("CS Histogram compile");
+        }
+        g.device->CreateComputeShader(blob->GetBufferPointer(), blob->GetBufferSize(), 0, &g.luminance.cs);
+        blob->Release();
+        g.luminance.Init(g.device);
     }
-    g.device->CreatePixelShader(blob->GetBufferPointer(), blob->GetBufferSize(), 0, &g.psHDR);
-    blob->Release();
 
     D3D11_BUFFER_DESC bd = {}; bd.Usage = D3D11_USAGE_IMMUTABLE;
     bd.ByteWidth = sizeof(g_Quad); bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
     D3D11_SUBRESOURCE_DATA sd = {g_Quad};
     g.device->CreateBuffer(&bd, &sd, &g.vb);
 
+    // The frame quad samples only the --crop rectangle of the slot
+    float srcW = (float)(g.sourceRect.right - g.sourceRect.left);
+    float srcH = (float)(g.sourceRect.bottom - g.sourceRect.top);
+    Vertex frameQuad[4];
+    for (int i = 0; i < 4; i++) {
+        frameQuad[i] = g_Quad[i];
+        frameQuad[i].u = (g_Quad[i].u ? g.crop.right : g.crop.left) / srcW;
+        frameQuad[i].v = (g_Quad[i].v ? g.crop.bottom : g.crop.top) / srcH;
+    }
+    sd.pSysMem = frameQuad;
+    g.device->CreateBuffer(&bd, &sd, &g.vbFrame);
+
     D3D11_SAMPLER_DESC sampd = {}; sampd.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
     sampd.AddressU = sampd.AddressV = sampd.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
     g.device->CreateSamplerState(&sampd, &g.sampler);
+    if (g.scalerKernel == ScalerKernel::Nearest) {
+        sampd.Filter = D3D11_FILTER_MIN_MAG_MIP_POINT;
+        g.device->CreateSamplerState(&sampd, &g.samplerPoint);
+    }
 
-    // Constant buffer for HDR shader (sdrWhiteNits value)
+    // Constant buffer for HDR shader (fixed for the run unless the peak adapts)
+    TonemapConstants tc = ComputeTonemapConstants(g.tonemapParams);
+    g.adaptedPeakNits = g.tonemapParams.peakNits;
     D3D11_BUFFER_DESC cbd = {};
-    cbd.Usage = D3D11_USAGE_DYNAMIC;
-    cbd.ByteWidth = 16;  // 4 floats (16 bytes, minimum cbuffer size)
+    cbd.Usage = g.adaptivePeak ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_IMMUTABLE;
+    cbd.CPUAccessFlags = g.adaptivePeak ? D3D11_CPU_ACCESS_WRITE : 0;
+    cbd.ByteWidth = sizeof(TonemapConstants);
     cbd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-    cbd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-    g.device->CreateBuffer(&cbd, nullptr, &g.cbHDR);
+    D3D11_SUBRESOURCE_DATA cbData = {&tc};
+    g.device->CreateBuffer(&cbd, &cbData, &g.cbHDR);
+
+    // Blue-noise tile for dithering the tonemapped output (blue_noise_64.h)
+    if (g.dither) {
+        D3D11_TEXTURE2D_DESC td = {};
+        td.Width = td.Height = kBlueNoiseSize;
+        td.MipLevels = td.ArraySize = 1;
+        td.Format = DXGI_FORMAT_R8_UNORM;
+        td.SampleDesc.Count = 1;
+        td.Usage = D3D11_USAGE_IMMUTABLE;
+        td.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+        D3D11_SUBRESOURCE_DATA noise = {kBlueNoise, (UINT)kBlueNoiseSize};
+        hr = g.device->CreateTexture2D(&td, &noise, &g.blueNoiseTexture);
+        if (FAILED(hr)) Fatal("CreateTexture2D (blue noise)", hr);
+        g.device->CreateShaderResourceView(g.blueNoiseTexture, nullptr, &g.blueNoiseSrv);
+
+        D3D11_BUFFER_DESC dbd = {};
+        dbd.Usage = D3D11_USAGE_DYNAMIC;
+        dbd.ByteWidth = sizeof(DitherConstants);
+        dbd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+        dbd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        g.device->CreateBuffer(&dbd, nullptr, &g.cbDither);
+    }
+
+    // Pointer blend states
+    D3D11_BLEND_DESC bld = {};
+    D3D11_RENDER_TARGET_BLEND_DESC& rt = bld.RenderTarget[0];
+    rt.BlendEnable = TRUE;
+    rt.SrcBlend = D3D11_BLEND_ONE;
+    rt.DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+    rt.BlendOp = D3D11_BLEND_OP_ADD;
+    rt.SrcBlendAlpha = D3D11_BLEND_ONE;
+    rt.DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+    rt.BlendOpAlpha = D3D11_BLEND_OP_ADD;
+    rt.RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+    g.device->CreateBlendState(&bld, &g.blendOver);
+
+    // src*(1-dst) + dst*(1-src): white inverts, black leaves dst untouched
+    rt.SrcBlend = D3D11_BLEND_INV_DEST_COLOR;
+    rt.DestBlend = D3D11_BLEND_INV_SRC_COLOR;
+    rt.SrcBlendAlpha = D3D11_BLEND_ZERO;
+    rt.DestBlendAlpha = D3D11_BLEND_ONE;
+    g.device->CreateBlendState(&bld, &g.blendInvert);
+
+    g.renderTimer.Init(g.device);
 }
 
-void InitDuplication() {
+// Desktop duplication of the source monitor
+class DxgiFrameSource : public IFrameSource {
+public:
+    ~DxgiFrameSource() override {
+        ReleaseFrame();
+        if (duplication) duplication->Release();
+    }
+
+    bool Init();
+
+    FrameStatus AcquireFrame(uint32_t timeoutMs, FrameInfo* info) override {
+        IDXGIResource* res = nullptr;
+        HRESULT hr = duplication->AcquireNextFrame(timeoutMs, &dxgiInfo, &res);
+        if (hr == DXGI_ERROR_WAIT_TIMEOUT) return FrameStatus::Timeout;
+        if (hr == DXGI_ERROR_ACCESS_LOST) return FrameStatus::AccessLost;
+        if (FAILED(hr)) {
+            if (g.debug) printf("[DEBUG] AcquireNextFrame failed: 0x%08X\n", (unsigned)hr);
+            return FrameStatus::Error;
+        }
+        acquired = true;
+
+        hr = res->QueryInterface(&frameTex);
+        res->Release();
+        if (FAILED(hr)) {
+            if (g.debug) printf("[DEBUG] QueryInterface for texture failed: 0x%08X\n", (unsigned)hr);
+            frameTex = nullptr;
+        }
+
+        info->lastPresentTime = dxgiInfo.LastPresentTime.QuadPart;
+        info->accumulatedFrames = dxgiInfo.AccumulatedFrames;
+        info->pixels = nullptr;
+        info->pitch = 0;
+        info->lastPointerUpdateTime = dxgiInfo.LastMouseUpdateTime.QuadPart;
+        info->pointerX = dxgiInfo.PointerPosition.Position.x;
+        info->pointerY = dxgiInfo.PointerPosition.Position.y;
+        info->pointerVisible = dxgiInfo.PointerPosition.Visible != FALSE;
+        info->pointerShapeSize = dxgiInfo.PointerShapeBufferSize;
+        if (frameTex) {
+            D3D11_TEXTURE2D_DESC td; frameTex->GetDesc(&td);
+            info->width = td.Width;
+            info->height = td.Height;
+            info->format = td.Format == DXGI_FORMAT_R16G16B16A16_FLOAT ?
+                FramePixelFormat::RGBA16F : FramePixelFormat::BGRA8;
+        }
+        return FrameStatus::Ok;
+    }
+
+    void ReleaseFrame() override {
+        if (frameTex) { frameTex->Release(); frameTex = nullptr; }
+        if (acquired) { duplication->ReleaseFrame(); acquired = false; }
+    }
+
+    void GetDirtyRects(std::vector<FrameRect>* rects) override {
+        rects->clear();
+        UINT size = dxgiInfo.TotalMetadataBufferSize;
+        if (!acquired || size == 0) return;
+        if (metadata.size() < size) metadata.resize(size);
+        UINT needed = 0;
+        if (FAILED(duplication->GetFrameDirtyRects(size, (RECT*)metadata.data(), &needed))) return;
+        const RECT* r = (const RECT*)metadata.data();
+        for (UINT i = 0; i < needed / sizeof(RECT); i++) {
+            rects->push_back({r[i].left, r[i].top, r[i].right, r[i].bottom});
+        }
+    }
+
+    void GetMoveRects(std::vector<FrameMoveRect>* rects) override {
+        rects->clear();
+        UINT size = dxgiInfo.TotalMetadataBufferSize;
+        if (!acquired || size == 0) return;
+        if (metadata.size() < size) metadata.resize(size);
+        UINT needed = 0;
+        if (FAILED(duplication->GetFrameMoveRects(size, (DXGI_OUTDUPL_MOVE_RECT*)metadata.data(), &needed))) return;
+        const DXGI_OUTDUPL_MOVE_RECT* m = (const DXGI_OUTDUPL_MOVE_RECT*)metadata.data();
+        for (UINT i = 0; i < needed / sizeof(DXGI_OUTDUPL_MOVE_RECT); i++) {
+            rects->push_back({m[i].SourcePoint.x, m[i].SourcePoint.y,
+                {m[i].DestinationRect.left, m[i].DestinationRect.top,
+                 m[i].DestinationRect.right, m[i].DestinationRect.bottom}});
+        }
+    }
+
+    bool GetPointerShape(std::vector<uint8_t>* buffer, PointerShapeInfo* shape) override {
+        UINT size = dxgiInfo.PointerShapeBufferSize;
+        if (!acquired || size == 0) return false;
+        buffer->resize(size);
+        DXGI_OUTDUPL_POINTER_SHAPE_INFO si;
+        UINT needed = 0;
+        HRESULT hr = duplication->GetFramePointerShape(size, buffer->data(), &needed, &si);
+        if (FAILED(hr)) {
+            if (g.debug) printf("[DEBUG] GetFramePointerShape failed: 0x%08X\n", (unsigned)hr);
+            return false;
+        }
+        buffer->resize(needed);
+        shape->type = (PointerShapeType)si.Type;
+        shape->width = si.Width;
+        shape->height = si.Height;
+        shape->pitch = si.Pitch;
+        shape->hotX = si.HotSpot.x;
+        shape->hotY = si.HotSpot.y;
+        return true;
+    }
+
+    bool Reinitialize() override {
+        ReleaseFrame();
+        if (duplication) { duplication->Release(); duplication = nullptr; }
+        Sleep(100);
+        return Init();
+    }
+
+    const char* Name() const override { return "dxgi"; }
+
+    // Acquired desktop texture (valid until ReleaseFrame)
+    ID3D11Texture2D* Texture() { return frameTex; }
+    const DXGI_OUTDUPL_FRAME_INFO& DxgiInfo() const { return dxgiInfo; }
+
+private:
+    IDXGIOutputDuplication* duplication = nullptr;
+    DXGI_OUTDUPL_FRAME_INFO dxgiInfo = {};
+    ID3D11Texture2D* frameTex = nullptr;
+    bool acquired = false;
+    std::vector<BYTE> metadata;
+};
+
+bool DxgiFrameSource::Init() {
     HRESULT hr;
     IDXGIDevice* dxgiDev; g.capDevice->QueryInterface(&dxgiDev);
     IDXGIAdapter* adapter; dxgiDev->GetAdapter(&adapter); dxgiDev->Release();
@@ -429,17 +2386,17 @@ void InitDuplication() {
 
     hr = output->QueryInterface(&out6);
     if (SUCCEEDED(hr)) {
-        hr = out6->DuplicateOutput1(g.capDevice, 0, _countof(supportedFormats), supportedFormats, &g.duplication);
+        hr = out6->DuplicateOutput1(g.capDevice, 0, _countof(supportedFormats), supportedFormats, &duplication);
         out6->Release();
         if (SUCCEEDED(hr)) {
             if (g.debug) printf("[DEBUG] Using IDXGIOutput6::DuplicateOutput1 (HDR supported)\n");
         }
     }
 
-    if (!g.duplication) {
+    if (!duplication) {
         hr = output->QueryInterface(&out5);
         if (SUCCEEDED(hr)) {
-            hr = out5->DuplicateOutput1(g.capDevice, 0, _countof(supportedFormats), supportedFormats, &g.duplication);
+            hr = out5->DuplicateOutput1(g.capDevice, 0, _countof(supportedFormats), supportedFormats, &duplication);
             out5->Release();
             if (SUCCEEDED(hr)) {
                 if (g.debug) printf("[DEBUG] Using IDXGIOutput5::DuplicateOutput1 (HDR supported)\n");
@@ -447,11 +2404,11 @@ void InitDuplication() {
         }
     }
 
-    if (!g.duplication) {
+    if (!duplication) {
         // Fall back to old method (no HDR support)
         hr = output->QueryInterface(&out1);
         if (SUCCEEDED(hr)) {
-            hr = out1->DuplicateOutput(g.capDevice, &g.duplication);
+            hr = out1->DuplicateOutput(g.capDevice, &duplication);
             out1->Release();
             if (SUCCEEDED(hr)) {
                 if (g.debug) printf("[DEBUG] Using IDXGIOutput1::DuplicateOutput (no HDR support)\n");
@@ -460,9 +2417,9 @@ void InitDuplication() {
     }
 
     output->Release();
-    if (FAILED(hr) || !g.duplication) Fatal("DuplicateOutput", hr);
+    if (FAILED(hr) || !duplication) Fatal("DuplicateOutput", hr);
 
-    DXGI_OUTDUPL_DESC dd; g.duplication->GetDesc(&dd);
+    DXGI_OUTDUPL_DESC dd; duplication->GetDesc(&dd);
 
     g.sourceReportedHDR = (dd.ModeDesc.Format == DXGI_FORMAT_R16G16B16A16_FLOAT);
 
@@ -471,12 +2428,24 @@ void InitDuplication() {
     printf("  Resolution: %ux%u @ %.2fHz\n",
            dd.ModeDesc.Width, dd.ModeDesc.Height,
            (float)dd.ModeDesc.RefreshRate.Numerator / dd.ModeDesc.RefreshRate.Denominator);
+    return true;
+}
+
+DXGI_FORMAT SlotDxgiFormat(SlotFormat f, DXGI_FORMAT native) {
+    switch (f) {
+        case SlotFormat::R11G11B10: return DXGI_FORMAT_R11G11B10_FLOAT;
+        case SlotFormat::Pq10: return DXGI_FORMAT_R10G10B10A2_UNORM;
+        case SlotFormat::Sdr8: return DXGI_FORMAT_R8G8B8A8_UNORM;
+        default: return native;
+    }
 }
 
-void InitTripleBuffer(DXGI_FORMAT format, UINT width, UINT height) {
+// packed: slots are written by the pack compute shader instead of copies
+void InitCaptureSlots(DXGI_FORMAT format, UINT width, UINT height, bool packed) {
     if (g.debug) {
-        printf("[DEBUG] InitTripleBuffer: %ux%u, Format=%d\n", width, height, (int)format);
+        printf("[DEBUG] InitCaptureSlots: %d x %ux%u, Format=%d\n", g.bufferCount, width, height, (int)format);
     }
+    g.buffer.Reset(g.bufferCount);
 
     D3D11_TEXTURE2D_DESC td = {};
     td.Width = width;
@@ -486,172 +2455,936 @@ void InitTripleBuffer(DXGI_FORMAT format, UINT width, UINT height) {
     td.Format = format;
     td.SampleDesc.Count = 1;
     td.Usage = D3D11_USAGE_DEFAULT;
-    td.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-    td.MiscFlags = D3D11_RESOURCE_MISC_SHARED;
+    td.BindFlags = D3D11_BIND_SHADER_RESOURCE | (packed ? D3D11_BIND_UNORDERED_ACCESS : 0);
+    switch (g.deviceMode) {
+        case DeviceMode::Legacy: td.MiscFlags = D3D11_RESOURCE_MISC_SHARED; break;
+        case DeviceMode::Single: td.MiscFlags = 0; break;
+        case DeviceMode::Fence: td.MiscFlags = D3D11_RESOURCE_MISC_SHARED | D3D11_RESOURCE_MISC_SHARED_NTHANDLE; break;
+    }
 
     DXGI_FORMAT srvFormat = format;
 
-    for (int i = 0; i < 3; i++) {
-        HRESULT hr = g.device->CreateTexture2D(&td, nullptr, &g.buffer.textures[i]);
-        if (FAILED(hr)) Fatal("CreateTexture2D (triple buffer)", hr);
+    for (int i = 0; i < g.bufferCount; i++) {
+        CaptureSlot& slot = g.buffer.slots[i];
+        HRESULT hr = g.device->CreateTexture2D(&td, nullptr, &slot.texture);
+        if (FAILED(hr)) Fatal("CreateTexture2D (capture slot)", hr);
 
         D3D11_SHADER_RESOURCE_VIEW_DESC srvd = {};
         srvd.Format = srvFormat;
         srvd.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
         srvd.Texture2D.MipLevels = 1;
-        hr = g.device->CreateShaderResourceView(g.buffer.textures[i], &srvd, &g.buffer.srvs[i]);
-        if (FAILED(hr)) Fatal("CreateSRV (triple buffer)", hr);
+        hr = g.device->CreateShaderResourceView(slot.texture, &srvd, &slot.srv);
+        if (FAILED(hr)) Fatal("CreateSRV (capture slot)", hr);
+    }
+
+    if (g.debug) {
+        printf("[DEBUG] Capture slots created successfully\n");
+    }
+}
+
+// Pushes pointer position/shape changes to the render thread
+void PublishPointer(const FrameInfo& info, PointerState* current, std::vector<uint8_t>* shapeBuffer) {
+    if (info.lastPointerUpdateTime != 0) {
+        current->x = info.pointerX;
+        current->y = info.pointerY;
+        current->visible = info.pointerVisible;
+    }
+
+    if (info.pointerShapeSize > 0) {
+        PointerShapeInfo si;
+        auto image = std::make_shared<PointerImage>();
+        if (g.source->GetPointerShape(shapeBuffer, &si) &&
+            DecodePointerShape(shapeBuffer->data(), shapeBuffer->size(), si, image.get())) {
+            current->shape = image;
+            current->shapeId++;
+        }
+    }
+
+    g.pointer.slots[g.pointer.GetWriteIndex()] = *current;
+    g.pointer.PublishFrame();
+    if (g.frameReadyEvent) SetEvent(g.frameReadyEvent);
+}
+
+DXGI_FORMAT ToDxgiFormat(FramePixelFormat f) {
+    return f == FramePixelFormat::RGBA16F ? DXGI_FORMAT_R16G16B16A16_FLOAT : DXGI_FORMAT_B8G8R8A8_UNORM;
+}
+
+// Gives the capture device its own view of each slot texture
+void OpenCaptureSlots(ID3D11Texture2D** out) {
+    for (int i = 0; i < g.bufferCount; i++) {
+        ID3D11Texture2D* slotTex = g.buffer.slots[i].texture;
+        HRESULT hr = S_OK;
+
+        if (g.deviceMode == DeviceMode::Single) {
+            out[i] = slotTex;
+            out[i]->AddRef();
+        } else if (g.deviceMode == DeviceMode::Legacy) {
+            IDXGIResource* bufRes;
+            slotTex->QueryInterface(&bufRes);
+            HANDLE sharedHandle;
+            bufRes->GetSharedHandle(&sharedHandle);
+            bufRes->Release();
+
+            hr = g.capDevice->OpenSharedResource(sharedHandle,
+                __uuidof(ID3D11Texture2D), (void**)&out[i]);
+        } else {
+            IDXGIResource1* bufRes;
+            ID3D11Device1* capDevice1;
+            slotTex->QueryInterface(&bufRes);
+            HANDLE sharedHandle = nullptr;
+            hr = bufRes->CreateSharedHandle(nullptr, DXGI_SHARED_RESOURCE_READ | DXGI_SHARED_RESOURCE_WRITE,
+                                            nullptr, &sharedHandle);
+            bufRes->Release();
+            if (FAILED(hr)) Fatal("CreateSharedHandle", hr);
+
+            g.capDevice->QueryInterface(&capDevice1);
+            hr = capDevice1->OpenSharedResource1(sharedHandle, __uuidof(ID3D11Texture2D), (void**)&out[i]);
+            capDevice1->Release();
+            CloseHandle(sharedHandle);
+        }
+        if (FAILED(hr)) Fatal("OpenSharedResource", hr);
+    }
+}
+
+// Brings a slot up to date by copying only the pending region from the
+// acquired frame. Falls back to one CopyResource when most of the frame changed.
+// Returns the number of pixels copied.
+int64_t CopyDirtyRegion(ID3D11Texture2D* dst, ID3D11Texture2D* tex, const FrameInfo& info,
+                        const DirtyRegion& region) {
+    if (region.Empty()) return 0;
+
+    int64_t frameArea = (int64_t)info.width * info.height;
+    if (region.IsFull() || region.Area() * 4 > frameArea * 3) {
+        if (tex) {
+            g.capContext->CopyResource(dst, tex);
+        } else {
+            g.capContext->UpdateSubresource(dst, 0, nullptr, info.pixels, info.pitch, 0);
+        }
+        return frameArea;
+    }
+
+    int bpp = FrameBytesPerPixel(info.format);
+    for (const FrameRect& r : region.Rects()) {
+        D3D11_BOX box = {(UINT)r.left, (UINT)r.top, 0, (UINT)r.right, (UINT)r.bottom, 1};
+        if (tex) {
+            g.capContext->CopySubresourceRegion(dst, 0, r.left, r.top, 0, tex, 0, &box);
+        } else {
+            const uint8_t* src = info.pixels + (size_t)r.top * info.pitch + (size_t)r.left * bpp;
+            g.capContext->UpdateSubresource(dst, 0, &box, src, info.pitch, 0);
+        }
+    }
+    return region.Area();
+}
+
+// Capture slot texture format -> yuv_convert.h layout
+bool YuvSourceForSlot(DXGI_FORMAT format, YuvSource* s) {
+    switch (format) {
+        case DXGI_FORMAT_B8G8R8A8_UNORM: *s = YuvSource::Bgra8; return true;
+        case DXGI_FORMAT_R8G8B8A8_UNORM: *s = YuvSource::Rgba8; return true;
+        case DXGI_FORMAT_R16G16B16A16_FLOAT: *s = YuvSource::Rgba16F; return true;
+        case DXGI_FORMAT_R11G11B10_FLOAT: *s = YuvSource::R11G11B10; return true;
+        case DXGI_FORMAT_R10G10B10A2_UNORM: *s = YuvSource::Pq10; return true;
+        default: return false;
+    }
+}
+
+// Capture slot texture format -> frame_ring.h layout
+bool FrameRingFormatForSlot(DXGI_FORMAT format, FrameRingFormat* f, UINT* bytesPerPixel) {
+    *bytesPerPixel = 4;
+    switch (format) {
+        case DXGI_FORMAT_B8G8R8A8_UNORM: *f = FrameRingFormat::Bgra8; return true;
+        case DXGI_FORMAT_R8G8B8A8_UNORM: *f = FrameRingFormat::Rgba8; return true;
+        case DXGI_FORMAT_R16G16B16A16_FLOAT: *f = FrameRingFormat::Rgba16F; *bytesPerPixel = 8; return true;
+        case DXGI_FORMAT_R11G11B10_FLOAT: *f = FrameRingFormat::R11G11B10F; return true;
+        case DXGI_FORMAT_R10G10B10A2_UNORM: *f = FrameRingFormat::Rgb10A2Pq; return true;
+        default: return false;
+    }
+}
+
+// Staging ring and sinks for --frame-server / --output-pipe / --stream, for
+// the slot size and format (frames go out as the slots hold them:
+// downscaled, packed, uncropped)
+void InitSlotReadback(ID3D11Texture2D* slotTexture, UINT sourceWidth, UINT sourceHeight) {
+    D3D11_TEXTURE2D_DESC sd;
+    slotTexture->GetDesc(&sd);
+    SlotReadback& rb = g.readback;
+    UINT bpp;
+    if (!FrameRingFormatForSlot(sd.Format, &rb.format, &bpp)) Fatal("--frame-server / --output-pipe / --stream: unsupported capture slot format");
+    if (!rb.Init(g.capDevice, sd, bpp)) Fatal("CreateTexture2D (readback staging)");
+
+    std::string error;
+    if (g.frameServerName) {
+        if (!rb.ring.Create(g.frameServerName, SlotReadback::kFrames, (uint64_t)rb.rowBytes * rb.height,
+                            FrameClockFrequency(), &error)) {
+            fprintf(stderr, "--frame-server: %s\n", error.c_str());
+            Fatal("--frame-server: cannot create the shared-memory ring");
+        }
+        printf("  Frame server: \"%s\", %d x %ux%u %s, %.1f MB\n", g.frameServerName, SlotReadback::kFrames,
+               rb.width, rb.height, FrameRingFormatName(rb.format),
+               (double)rb.rowBytes * rb.height * SlotReadback::kFrames / 1048576.0);
+    }
+
+    if (g.outputPipePath) {
+        FramePipeConfig c = g.pipeConfig;
+        if (!YuvSourceForSlot(sd.Format, &c.source)) Fatal("--output-pipe: unsupported capture slot format");
+        c.width = (int)sd.Width;
+        c.height = (int)sd.Height;
+        c.frameRate = g.useSynthetic ? g.synthetic.refreshHz : g.replayPath ? g.replayHz : GetMonitorRefreshHz(g.sourceRect);
+        c.clockFrequency = FrameClockFrequency();
+        bool ok = g.outputPipeStdout >= 0 ? rb.pipe.OpenFd(g.outputPipeStdout, c, &error)
+                                          : rb.pipe.Open(g.outputPipePath, c, &error);
+        g.outputPipeStdout = -1;    // The pipe owns it now
+        if (!ok) {
+            fprintf(stderr, "--output-pipe: %s\n", error.c_str());
+            Fatal("--output-pipe: cannot start the frame pipe");
+        }
+        printf("  Output pipe: %s, %s %ux%u (from %s slots, %ux%u source), %.2f Hz nominal, queue %d, drop %s\n",
+               !strcmp(g.outputPipePath, "-") ? "stdout" : g.outputPipePath,
+               FramePipeContainerName(c.container), sd.Width, sd.Height, YuvSourceName(c.source),
+               sourceWidth, sourceHeight, c.frameRate, c.queueFrames, FramePipeDropName(c.drop));
+    }
+
+    if (!g.streamHost.empty()) {
+        if (rb.format != FrameRingFormat::Bgra8 && rb.format != FrameRingFormat::Rgba8) {
+            Fatal("--stream needs SDR capture slots (SDR source or --slot-format sdr8)");
+        }
+        SliceStreamConfig c = g.streamConfig;
+        c.width = (int)sd.Width;
+        c.height = (int)sd.Height;
+        c.rgba = rb.format == FrameRingFormat::Rgba8;
+        c.sliceRows = std::min(c.sliceRows, c.height);
+        if (!rb.stream.Open(g.streamHost.c_str(), g.streamPort, c, &error)) {
+            fprintf(stderr, "--stream: %s\n", error.c_str());
+            Fatal("--stream: cannot start the slice stream");
+        }
+        printf("  Stream: %s:%d, %ux%u in %d slices of %d rows, FEC %s, refresh every %d frames, MTU %d\n",
+               g.streamHost.c_str(), g.streamPort, sd.Width, sd.Height, rb.stream.SliceCount(), c.sliceRows,
+               c.fecGroup ? ("1 per " + std::to_string(c.fecGroup)).c_str() : "off", c.refreshFrames, c.mtu);
+    }
+}
+
+// Capture thread
+void CaptureThreadFunc() {
+    ID3D11Texture2D* sharedTex[kMaxCaptureSlots] = {};
+    bool buffersOpened = false;
+    int debugCounter = 0;
+
+    SlotDirtyTracker<kMaxCaptureSlots> slotDirty;
+    DirtyRegion frameDamage;
+    std::vector<FrameRect> dirtyRects;
+    std::vector<FrameMoveRect> moveRects;
+
+    PointerState pointer;
+    std::vector<uint8_t> pointerShapeBuffer;
+    UINT64 copyFenceValue = 0;
+
+    while (g.running) {
+        // Frames waiting in the readback ring are collected on the next pass,
+        // so don't sleep long on a static desktop while any are in flight
+        bool readbackPending = g.readback.Pending();
+        if (readbackPending) {
+            DeviceLock lock;
+            g.readback.Collect(g.capContext);
+            readbackPending = g.readback.Pending();
+        }
+
+        FrameInfo info;
+        FrameStatus status = g.source->AcquireFrame(readbackPending ? 2 : 100, &info);
+        int64_t acquireTime = FrameClockNow();
+
+        if (status == FrameStatus::Timeout) {
+            if (g.debug && (++debugCounter % 10 == 0)) {
+                printf("[DEBUG] AcquireNextFrame timeout\n");
+            }
+            continue;
+        }
+
+        if (status == FrameStatus::AccessLost) {
+            if (g.debug) printf("[DEBUG] Access lost, reinitializing...\n");
+            if (!g.source->Reinitialize()) Fatal("Frame source lost");
+            slotDirty.MarkAllFull();
+            continue;
+        }
+
+        if (status != FrameStatus::Ok) {
+            continue;
+        }
+
+        if (g.showPointer && (info.lastPointerUpdateTime != 0 || info.pointerShapeSize > 0)) {
+            PublishPointer(info, &pointer, &pointerShapeBuffer);
+        }
+
+        // Only image updates need a copy; pointer moves went out through the pointer mailbox
+        FrameUpdateKind kind = ClassifyFrameUpdate(info);
+        switch (kind) {
+            case FrameUpdateKind::Image: g.imageUpdates.fetch_add(1, std::memory_order_relaxed); break;
+            case FrameUpdateKind::PointerOnly: g.pointerUpdates.fetch_add(1, std::memory_order_relaxed); break;
+            case FrameUpdateKind::MetadataOnly: g.metadataUpdates.fetch_add(1, std::memory_order_relaxed); break;
+        }
+        bool hasNewContent = kind == FrameUpdateKind::Image ||
+                             !buffersOpened;  // Always process first frame
+
+        // GPU sources hand us a texture, CPU sources (synthetic/replay) a pixel pointer
+        ID3D11Texture2D* tex = g.dxgiSource ? g.dxgiSource->Texture() : nullptr;
+        bool haveFrame = tex != nullptr || info.pixels != nullptr;
+
+        if (hasNewContent && haveFrame) {
+            // On first frame, detect actual format and initialize buffers
+            if (!buffersOpened) {
+                DXGI_FORMAT format = ToDxgiFormat(info.format);
+                if (tex) {
+                    D3D11_TEXTURE2D_DESC td;
+                    tex->GetDesc(&td);
+                    format = td.Format;
+                }
+
+                printf("  Actual format: %s (DXGI_FORMAT=%d)\n",
+                       format == DXGI_FORMAT_R16G16B16A16_FLOAT ? "HDR (R16G16B16A16_FLOAT)" :
+                       format == DXGI_FORMAT_B8G8R8A8_UNORM ? "SDR (B8G8R8A8_UNORM)" : "Other",
+                       (int)format);
+
+                // Update global format info
+                g.sourceFormat = format;
+                g.sourceIsHDR = (format == DXGI_FORMAT_R16G16B16A16_FLOAT);
+                g.slotsHDR = g.sourceIsHDR && g.slotFormat != SlotFormat::Sdr8;
+
+                // Capture downscale: slots at the size they are drawn at, when that is smaller
+                UINT slotW = info.width, slotH = info.height;
+                if (g.captureDownscale) {
+                    // With --crop, the slot size that draws the crop at the viewport size
+                    UINT vw = (UINT)lround((double)g.viewport.Width * info.width / (g.crop.right - g.crop.left));
+                    UINT vh = (UINT)lround((double)g.viewport.Height * info.height / (g.crop.bottom - g.crop.top));
+                    bool supported = g.sourceIsHDR || format == DXGI_FORMAT_B8G8R8A8_UNORM;
+                    if (supported && vw <= info.width && vh <= info.height && (vw < info.width || vh < info.height)) {
+                        slotW = vw;
+                        slotH = vh;
+                        printf("  Capture downscale: %ux%u -> %ux%u (area filter)\n", info.width, info.height, slotW, slotH);
+                    } else {
+                        printf("  Capture downscale: off (target is not smaller than the source)\n");
+                    }
+                }
+                bool downscale = slotW != info.width || slotH != info.height;
+                g.slotsPacked = (g.sourceIsHDR && g.slotFormat != SlotFormat::Native) || downscale;
+
+                if (IsHdrOutput(g.outputMode)) {
+                    printf("  Processing: %s (%s output, no tonemapping)\n",
+                           g.sourceIsHDR ? "HDR passthrough" : "SDR at SDR white",
+                           g.outputMode == OutputMode::Scrgb ? "scRGB" : "HDR10");
+                } else if (g.sourceIsHDR) {
+                    if (g.tonemap) {
+                        printf("  Processing: %s tonemapping (HDR to SDR, sdrWhite=%.0f nits, peak=%s%.0f nits, %s)\n",
+                               TonemapOperatorName(g.tonemapParams.op), g.tonemapParams.sdrWhiteNits,
+                               g.adaptivePeak ? "adaptive up to " : "", g.tonemapParams.peakNits,
+                               g.lutSize > 0 ? "3D LUT" : g.slotsHDR ? "analytic" : "analytic at capture");
+                    } else {
+                        printf("  Processing: None (--no-tonemap, HDR values may clip)\n");
+                    }
+                } else {
+                    printf("  Processing: Passthrough (SDR)\n");
+                }
+
+                if (g.sourceIsHDR || downscale) {
+                    int nativeBpp = g.sourceIsHDR ? SlotFormatBytesPerPixel(SlotFormat::Native) : 4;
+                    int slotBpp = g.sourceIsHDR ? SlotFormatBytesPerPixel(g.slotFormat) : 4;
+                    double nativeMB = (double)info.width * info.height * nativeBpp / 1048576.0;
+                    double slotMB = (double)slotW * slotH * slotBpp / 1048576.0;
+                    printf("  Capture slots: %d x %ux%u %s, %.1f MB (native %.1f MB)\n", g.bufferCount, slotW, slotH,
+                           g.sourceIsHDR ? SlotFormatName(g.slotFormat) : "rgba8", slotMB * g.bufferCount, nativeMB * g.bufferCount);
+                }
+                if (!g.sourceIsHDR && g.slotFormat != SlotFormat::Native) {
+                    printf("  Capture slots: --slot-format only applies to HDR sources\n");
+                }
+
+                // Initialize capture slots with actual format (packed SDR slots are RGBA8: BGRA has no typed UAV store)
+                DXGI_FORMAT slotFormat = format;
+                if (g.slotsPacked) slotFormat = g.sourceIsHDR ? SlotDxgiFormat(g.slotFormat, format) : DXGI_FORMAT_R8G8B8A8_UNORM;
+                InitCaptureSlots(slotFormat, slotW, slotH, g.slotsPacked);
+
+                OpenCaptureSlots(sharedTex);
+                g.copyTimer.Init(g.capDevice);
+                if (g.slotsPacked) {
+                    bool sampleable = false;
+                    if (tex) {
+                        D3D11_TEXTURE2D_DESC td;
+                        tex->GetDesc(&td);
+                        sampleable = (td.BindFlags & D3D11_BIND_SHADER_RESOURCE) != 0;
+                    }
+                    InitPackShader(!g.sourceIsHDR, downscale);
+                    g.packer.Init(g.capDevice, sharedTex, g.bufferCount, format, info.width, info.height,
+                                  slotW, slotH, !sampleable);
+                }
+                if (g.frameServerName || g.outputPipePath || !g.streamHost.empty()) InitSlotReadback(sharedTex[0], info.width, info.height);
+
+                slotDirty.Reset(info.width, info.height);
+                frameDamage.Reset(info.width, info.height);
+                buffersOpened = true;
+
+                if (g.debug) {
+                    printf("[DEBUG] Buffers initialized with actual format\n");
+                }
+            }
+
+            int writeIdx = g.buffer.GetWriteIndex();
+            CaptureSlot& slot = g.buffer.slots[writeIdx];
+            slot.captureTime = acquireTime;
+            slot.sourcePresentTime = info.lastPresentTime;
+
+            // Damage of this frame: dirty rects plus move destinations (the acquired
+            // image already has the moved pixels in place, so copying the destination
+            // is enough). A new image without metadata is a full update.
+            frameDamage.Clear();
+            if (g.dirtyRects) {
+                g.source->GetDirtyRects(&dirtyRects);
+                g.source->GetMoveRects(&moveRects);
+                for (const FrameRect& r : dirtyRects) frameDamage.Add(r);
+                for (const FrameMoveRect& m : moveRects) frameDamage.Add(m.dst);
+                if (frameDamage.Empty() && info.lastPresentTime != 0) frameDamage.SetFull();
+            } else {
+                frameDamage.SetFull();
+            }
+            slotDirty.AddFrameDamage(frameDamage);
+
+            int64_t copyStart = FrameClockNow();
+            int64_t copied;
+            {
+                DeviceLock lock;
+
+                // Don't overwrite the slot before the render device finished sampling it
+                if (g.deviceMode == DeviceMode::Fence) g.capContext4->Wait(g.capReadFence, slot.readFenceValue);
+
+                g.copyTimer.Begin(g.capContext);
+                if (g.slotsPacked) {
+                    copied = g.packer.Pack(g.capDevice, g.capContext, writeIdx, tex, info, slotDirty.Pending(writeIdx));
+                } else {
+                    copied = CopyDirtyRegion(sharedTex[writeIdx], tex, info, slotDirty.Pending(writeIdx));
+                }
+                g.copyTimer.End(g.capContext);
+                slotDirty.Consume(writeIdx);
+                if (g.readback.IsOpen()) {
+                    g.readback.Queue(g.capContext, sharedTex[writeIdx], frameDamage, info.width, info.height,
+                                     acquireTime, info.lastPresentTime);
+                }
+
+                if (g.deviceMode == DeviceMode::Fence) {
+                    slot.copyFenceValue = ++copyFenceValue;
+                    g.capContext4->Signal(g.capCopyFence, copyFenceValue);
+                }
+                // Submit so the other device can see the copy (and the fence signal).
+                // A single device orders the copy before the draw on its own.
+                if (g.deviceMode != DeviceMode::Single) g.capContext->Flush();
+            }
+            g.copyTicks.fetch_add(FrameClockNow() - copyStart, std::memory_order_relaxed);
+            g.copyCount.fetch_add(1, std::memory_order_relaxed);
+            g.copyGpuUs.fetch_add((int64_t)(g.copyTimer.TakeMs() * 1000.0), std::memory_order_relaxed);
+
+            g.copiedPixels.fetch_add(copied, std::memory_order_relaxed);
+            g.capturedPixels.fetch_add((int64_t)info.width * info.height, std::memory_order_relaxed);
+
+            g.captureFrameId.fetch_add(1, std::memory_order_relaxed);
+            g.buffer.PublishFrame();
+            g.captureCount.fetch_add(1, std::memory_order_relaxed);
+            if (g.frameReadyEvent) SetEvent(g.frameReadyEvent);
+
+            // Signal buffer ready AFTER first frame is copied and published
+            if (!g.bufferInitialized.load(std::memory_order_relaxed)) {
+                g.bufferInitialized.store(true, std::memory_order_release);
+            }
+        }
+
+        g.source->ReleaseFrame();
+    }
+
+    for (int i = 0; i < kMaxCaptureSlots; i++) {
+        if (sharedTex[i]) sharedTex[i]->Release();
+    }
+}
+
+void ReleasePointerLayer(PointerLayer* layer) {
+    if (layer->srv) { layer->srv->Release(); layer->srv = nullptr; }
+    if (layer->texture) { layer->texture->Release(); layer->texture = nullptr; }
+}
+
+void UploadPointerLayer(PointerLayer* layer, const std::vector<uint32_t>& pixels, UINT w, UINT h) {
+    if (!layer->texture) {
+        D3D11_TEXTURE2D_DESC td = {};
+        td.Width = w;
+        td.Height = h;
+        td.MipLevels = 1;
+        td.ArraySize = 1;
+        td.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+        td.SampleDesc.Count = 1;
+        td.Usage = D3D11_USAGE_DEFAULT;
+        td.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+        HRESULT hr = g.device->CreateTexture2D(&td, nullptr, &layer->texture);
+        if (FAILED(hr)) { if (g.debug) printf("[DEBUG] Pointer texture failed: 0x%08X\n", (unsigned)hr); return; }
+        g.device->CreateShaderResourceView(layer->texture, nullptr, &layer->srv);
+    }
+    g.context->UpdateSubresource(layer->texture, 0, nullptr, pixels.data(), w * 4, 0);
+}
+
+// Draws the pointer as a small quad on top of the frame (viewport = pointer rect)
+void RenderPointer() {
+    int idx = g.pointer.AcquireFrame();
+    if (idx >= 0) g.pointerShown = g.pointer.slots[idx];
+
+    const PointerState& ptr = g.pointerShown;
+    if (!ptr.visible || !ptr.shape) return;
+
+    const PointerImage& img = *ptr.shape;
+    if (ptr.shapeId != g.pointerShapeId) {
+        if (img.width != g.pointerWidth || img.height != g.pointerHeight) {
+            ReleasePointerLayer(&g.pointerColor);
+            ReleasePointerLayer(&g.pointerInvert);
+            g.pointerWidth = img.width;
+            g.pointerHeight = img.height;
+        }
+        UploadPointerLayer(&g.pointerColor, img.color, img.width, img.height);
+        if (!img.invert.empty()) UploadPointerLayer(&g.pointerInvert, img.invert, img.width, img.height);
+        g.pointerShapeId = ptr.shapeId;
+    }
+    if (!g.pointerColor.srv) return;
+
+    // Over the border cut by --crop it would land on the black bars
+    if (ptr.x < g.crop.left || ptr.y < g.crop.top || ptr.x >= g.crop.right || ptr.y >= g.crop.bottom) return;
+
+    float sx = g.viewport.Width / (float)(g.crop.right - g.crop.left);
+    float sy = g.viewport.Height / (float)(g.crop.bottom - g.crop.top);
+    D3D11_VIEWPORT vp = {g.viewport.TopLeftX + (ptr.x - g.crop.left) * sx, g.viewport.TopLeftY + (ptr.y - g.crop.top) * sy,
+                         img.width * sx, img.height * sy, 0, 1};
+    g.context->RSSetViewports(1, &vp);
+    g.context->PSSetShader(IsHdrOutput(g.outputMode) ? g.psOutputSDR : g.psSDR, 0, 0);
+
+    g.context->OMSetBlendState(g.blendOver, nullptr, 0xFFFFFFFF);
+    g.context->PSSetShaderResources(0, 1, &g.pointerColor.srv);
+    g.context->Draw(4, 0);
+
+    // Inverts in the swap chain's own encoding; above 1.0 in scRGB that clips to black
+    if (!img.invert.empty() && g.pointerInvert.srv) {
+        g.context->PSSetShader(g.psSDR, 0, 0);
+        g.context->OMSetBlendState(g.blendInvert, nullptr, 0xFFFFFFFF);
+        g.context->PSSetShaderResources(0, 1, &g.pointerInvert.srv);
+        g.context->Draw(4, 0);
+    }
+
+    g.context->OMSetBlendState(nullptr, nullptr, 0xFFFFFFFF);
+    g.context->RSSetViewports(1, &g.viewport);
+}
+
+// Builds (or loads from the cache) the HDR -> SDR LUT and uploads it
+void InitColorLut() {
+    const TonemapParams& params = g.tonemapParams;
+
+    std::string dir = g.lutCacheDir;
+    if (dir.empty()) {
+        char temp[MAX_PATH];
+        DWORD n = GetTempPathA(MAX_PATH, temp);
+        if (n > 0 && n < MAX_PATH) dir = temp;
+    }
+    uint64_t key = ColorLutKey(params, g.lutSize);
+    std::string path = ColorLutCachePath(dir, key);
+
+    LARGE_INTEGER t0, t1, freq;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t0);
+    ColorLut lut;
+    bool cached = LoadColorLut(path, key, g.lutSize, &lut);
+    if (!cached) {
+        BuildColorLut(params, g.lutSize, &lut);
+        if (!SaveColorLut(path, key, lut) && g.debug) printf("[DEBUG] Cannot write LUT cache %s\n", path.c_str());
     }
-
+    QueryPerformanceCounter(&t1);
+    printf("  Color LUT: %d^3 %s, %s in %.1fms\n", g.lutSize,
+           g.lutInterp == LutInterpolation::Tetrahedral ? "tetrahedral" : "trilinear",
+           cached ? "loaded" : "built", (double)(t1.QuadPart - t0.QuadPart) * 1000.0 / freq.QuadPart);
     if (g.debug) {
-        printf("[DEBUG] Triple buffer created successfully\n");
+        LutAccuracy acc = MeasureColorLutAccuracy(params, lut, g.lutInterp);
+        printf("[DEBUG] LUT vs analytic: dE max %.2f p99 %.2f mean %.3f (worst at %.4g %.4g %.4g)\n",
+               acc.maxDeltaE, acc.p99DeltaE, acc.meanDeltaE,
+               acc.worstInput[0], acc.worstInput[1], acc.worstInput[2]);
     }
+
+    D3D11_TEXTURE3D_DESC td = {};
+    td.Width = td.Height = td.Depth = g.lutSize;
+    td.MipLevels = 1;
+    td.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+    td.Usage = D3D11_USAGE_IMMUTABLE;
+    td.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    D3D11_SUBRESOURCE_DATA sd = {lut.texels.data(), (UINT)(g.lutSize * 8), (UINT)(g.lutSize * g.lutSize * 8)};
+    HRESULT hr = g.device->CreateTexture3D(&td, &sd, &g.lutTexture);
+    if (FAILED(hr)) Fatal("CreateTexture3D (LUT)", hr);
+    g.device->CreateShaderResourceView(g.lutTexture, nullptr, &g.lutSrv);
+
+    LutConstants lc = {lut.minLog2, 1.0f / (lut.maxLog2 - lut.minLog2), (float)g.lutSize, 0.0f};
+    D3D11_BUFFER_DESC cbd = {};
+    cbd.Usage = D3D11_USAGE_IMMUTABLE;
+    cbd.ByteWidth = sizeof(LutConstants);
+    cbd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    D3D11_SUBRESOURCE_DATA cbData = {&lc};
+    g.device->CreateBuffer(&cbd, &cbData, &g.cbLUT);
 }
 
-// Capture thread
-void CaptureThreadFunc() {
-    ID3D11Texture2D* sharedTex[3] = {nullptr, nullptr, nullptr};
-    bool buffersOpened = false;
-    int debugCounter = 0;
+// Builds the --scaler constants (and the horizontal pass of the two-pass
+// kernels) for the slot size with the first frame drawn, when it is known
+// what the slots hold (SLOT_PQ of the horizontal pass)
+void InitScaler(ID3D11Texture2D* slotTexture) {
+    D3D11_TEXTURE2D_DESC sd;
+    slotTexture->GetDesc(&sd);
+    UINT w = (UINT)g.viewport.Width, h = (UINT)g.viewport.Height;
+    RenderScaler& sc = g.scaler;
 
-    while (g.running) {
-        DXGI_OUTDUPL_FRAME_INFO info;
-        IDXGIResource* res = nullptr;
+    // --crop in slot pixels (slots are smaller than the source with --capture-downscale)
+    float srcW = (float)(g.sourceRect.right - g.sourceRect.left);
+    float srcH = (float)(g.sourceRect.bottom - g.sourceRect.top);
+    float cropX = g.crop.left * sd.Width / srcW, cropW = (g.crop.right - g.crop.left) * sd.Width / srcW;
+    float cropH = (g.crop.bottom - g.crop.top) * sd.Height / srcH;
+
+    // Horizontal pass: full quad into the intermediate, reading the crop's columns.
+    // Vertical pass and sharp-bilinear: the frame quad, whose uv covers the crop
+    ScalerConstants c[2] = {};
+    double scales[2] = {cropW / w, cropH / h};
+    if (ScalerIsSeparable(g.scalerKernel)) {
+        sc.width = w;
+        sc.height = sd.Height;
+
+        char scaler[8];
+        snprintf(scaler, sizeof(scaler), "%d", (int)g.scalerKernel);
+        const char* slotPq = g.slotsHDR && g.slotFormat == SlotFormat::Pq10 ? "1" : "0";
+        D3D_SHADER_MACRO defines[] = {{"SLOT_PQ", slotPq}, {"SCALER", scaler}, {"SCALER_PASS", "1"}, {nullptr, nullptr}};
+        sc.ps = CompilePixelShader(g_PixelShaderSDR, "PS_Scale_Horizontal", defines);
+
+        D3D11_TEXTURE2D_DESC td = {};
+        td.Width = sc.width;
+        td.Height = sc.height;
+        td.MipLevels = td.ArraySize = 1;
+        td.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+        td.SampleDesc.Count = 1;
+        td.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+        HRESULT hr = g.device->CreateTexture2D(&td, nullptr, &sc.texture);
+        if (FAILED(hr)) Fatal("CreateTexture2D (scaler)", hr);
+        g.device->CreateRenderTargetView(sc.texture, nullptr, &sc.rtv);
+        g.device->CreateShaderResourceView(sc.texture, nullptr, &sc.srv);
+
+        c[0].size[0] = (float)sd.Width;
+        c[0].uvScale[0] = cropW;
+        c[0].uvOffset[0] = cropX;
+        c[1].size[0] = (float)w;
+        c[1].uvScale[0] = w * srcW / (g.crop.right - g.crop.left);
+        c[1].uvOffset[0] = -g.crop.left / srcW * c[1].uvScale[0];
+        for (int i = 0; i < 2; i++) {
+            double stretch = ScalerStretch(g.scalerKernel, scales[i]);
+            c[i].size[1] = c[i].uvScale[1] = (float)sd.Height;     // Rows map 1:1 into the intermediate
+            c[i].prescale[0] = c[i].prescale[1] = 1.0f;
+            c[i].scale = (float)scales[i];
+            c[i].stretch = (float)stretch;
+            c[i].support = (float)(ScalerKernelRadius(g.scalerKernel) * stretch);
+        }
 
-        HRESULT hr = g.duplication->AcquireNextFrame(100, &info, &res);
+        FilterTaps tx, ty;
+        BuildScalerTaps(g.scalerKernel, (int)lroundf(cropW), w, &tx);
+        BuildScalerTaps(g.scalerKernel, (int)lroundf(cropH), h, &ty);
+        printf("  Scaler: %s %.0fx%.0f -> %ux%u in two passes, %.1f taps per pixel\n", ScalerKernelName(g.scalerKernel),
+               cropW, cropH, w, h, (double)tx.weights.size() / w + (double)ty.weights.size() / h);
+    } else {
+        c[1].size[0] = c[1].uvScale[0] = (float)sd.Width;
+        c[1].size[1] = c[1].uvScale[1] = (float)sd.Height;
+        c[1].prescale[0] = (float)SharpBilinearPrescale(scales[0]);
+        c[1].prescale[1] = (float)SharpBilinearPrescale(scales[1]);
+        printf("  Scaler: %s %.0fx%.0f -> %ux%u, nearest to %.0fx%.0f then bilinear\n", ScalerKernelName(g.scalerKernel),
+               cropW, cropH, w, h, cropW * c[1].prescale[0], cropH * c[1].prescale[1]);
+    }
 
-        if (hr == DXGI_ERROR_WAIT_TIMEOUT) {
-            if (g.debug && (++debugCounter % 10 == 0)) {
-                printf("[DEBUG] AcquireNextFrame timeout\n");
+    for (int i = 0; i < 2; i++) {
+        if (i == 0 && !sc.ps) continue;
+        D3D11_BUFFER_DESC cbd = {};
+        cbd.Usage = D3D11_USAGE_IMMUTABLE;
+        cbd.ByteWidth = sizeof(ScalerConstants);
+        cbd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+        D3D11_SUBRESOURCE_DATA cbData = {&c[i]};
+        g.device->CreateBuffer(&cbd, &cbData, &sc.cb[i]);
+    }
+}
+
+// One shader per chain draw: its passes in order, each fused pass reading the
+// one before it through the Source/SourceTexel macros
+std::string ChainDrawSource(const Preset& preset, const ChainDraw& d) {
+    std::string s = g_ChainPrelude;
+    char buf[256];
+    for (int k = d.firstPass; k <= d.lastPass; k++) {
+        int j = k - d.firstPass;
+        const PresetPass& p = preset.passes[k];
+        snprintf(buf, sizeof(buf), "#define PassMain PassMain%d\n#define SourceSize chainSourceSize[%d]\n"
+                 "#define PassParams chainParams[%d]\n", j, j, j);
+        s += buf;
+        if (j == 0) {
+            s += "#define Source(uv) chainSource.Sample(chainSampler, uv)\n"
+                 "#define SourceTexel(p) chainSource.Load(int3(clamp(p, int2(0, 0), int2(SourceSize.xy) - 1), 0))\n";
+        } else {
+            snprintf(buf, sizeof(buf), "#define Source(uv) PassMain%d(uv, pos)\n"
+                     "#define SourceTexel(p) PassMain%d((float2(p) + 0.5) * SourceSize.zw, float2(p) + 0.5)\n", j - 1, j - 1);
+            s += buf;
+        }
+        if (p.builtin) {
+            for (const ChainPassSource& b : g_ChainPasses) {
+                if (p.shader == b.name) s += b.hlsl;
             }
-            continue;
+        } else {
+            s += p.source;
         }
+        s += "\n#undef PassMain\n#undef SourceSize\n#undef PassParams\n#undef Source\n#undef SourceTexel\n";
+    }
+    snprintf(buf, sizeof(buf), "float4 main(float4 pos : SV_POSITION, float2 uv : TEXCOORD0) : SV_TARGET {\n"
+             "    return PassMain%d(uv, pos.xy - chainOrigin);\n}\n", d.lastPass - d.firstPass);
+    return s + buf;
+}
 
-        if (hr == DXGI_ERROR_ACCESS_LOST) {
-            if (g.debug) printf("[DEBUG] Access lost, reinitializing...\n");
-            if (g.duplication) { g.duplication->Release(); g.duplication = nullptr; }
-            Sleep(100);
-            InitDuplication();
-            continue;
-        }
+// Builds the --preset chain for the slot size with the first frame drawn:
+// Original is the crop at slot resolution
+void InitChain(ID3D11Texture2D* slotTexture) {
+    D3D11_TEXTURE2D_DESC sd;
+    slotTexture->GetDesc(&sd);
+    float srcW = (float)(g.sourceRect.right - g.sourceRect.left);
+    float srcH = (float)(g.sourceRect.bottom - g.sourceRect.top);
+    UINT ow = (UINT)lroundf((g.crop.right - g.crop.left) * sd.Width / srcW);
+    UINT oh = (UINT)lroundf((g.crop.bottom - g.crop.top) * sd.Height / srcH);
+
+    RenderChain& ch = g.chain;
+    ch.plan = PlanChain(ch.preset, ow, oh, (int)g.viewport.Width, (int)g.viewport.Height);
+    HRESULT hr = ch.original.Create(g.device, ow, oh);
+    if (FAILED(hr)) Fatal("CreateTexture2D (preset)", hr);
+    ch.pool.resize(ch.plan.targetWidth.size());
+    for (size_t i = 0; i < ch.pool.size(); i++) {
+        hr = ch.pool[i].Create(g.device, ch.plan.targetWidth[i], ch.plan.targetHeight[i]);
+        if (FAILED(hr)) Fatal("CreateTexture2D (preset)", hr);
+    }
 
+    for (size_t i = 0; i < ch.plan.draws.size(); i++) {
+        std::string source = ChainDrawSource(ch.preset, ch.plan.draws[i]);
+        char name[32];
+        snprintf(name, sizeof(name), "PS_Chain_%zu", i);
+        ID3DBlob *blob, *err;
+        hr = D3DCompile(source.c_str(), source.size(), name, 0, 0, "main", "ps_5_0", 0, 0, &blob, &err);
         if (FAILED(hr)) {
-            if (g.debug) printf("[DEBUG] AcquireNextFrame failed: 0x%08X\n", (unsigned)hr);
-            continue;
+            if (err) fprintf(stderr, "%s (%s) compile error: %s\n", name, ch.preset.path.c_str(), (char*)err->GetBufferPointer());
+            Fatal("Preset shader compile");
         }
+        ID3D11PixelShader* ps = nullptr;
+        g.device->CreatePixelShader(blob->GetBufferPointer(), blob->GetBufferSize(), 0, &ps);
+        blob->Release();
+        ch.ps.push_back(ps);
+    }
 
-        // Check for new frame content
-        bool hasNewContent = (info.LastPresentTime.QuadPart != 0) ||
-                             (info.AccumulatedFrames > 0) ||
-                             !buffersOpened;  // Always process first frame
-
-        if (hasNewContent) {
-            ID3D11Texture2D* tex;
-            hr = res->QueryInterface(&tex);
-
-            if (SUCCEEDED(hr)) {
-                // On first frame, detect actual format and initialize buffers
-                if (!buffersOpened) {
-                    D3D11_TEXTURE2D_DESC td;
-                    tex->GetDesc(&td);
-
-                    printf("  Actual format: %s (DXGI_FORMAT=%d)\n",
-                           td.Format == DXGI_FORMAT_R16G16B16A16_FLOAT ? "HDR (R16G16B16A16_FLOAT)" :
-                           td.Format == DXGI_FORMAT_B8G8R8A8_UNORM ? "SDR (B8G8R8A8_UNORM)" : "Other",
-                           (int)td.Format);
-
-                    // Update global format info
-                    g.sourceFormat = td.Format;
-                    g.sourceIsHDR = (td.Format == DXGI_FORMAT_R16G16B16A16_FLOAT);
-
-                    if (g.sourceIsHDR) {
-                        if (g.tonemap) {
-                            printf("  Processing: maxRGB Reinhard tonemapping (HDR to SDR, sdrWhite=%.0f nits)\n", g.sdrWhiteNits);
-                        } else {
-                            printf("  Processing: None (--no-tonemap, HDR values may clip)\n");
-                        }
-                    } else {
-                        printf("  Processing: Passthrough (SDR)\n");
-                    }
-
-                    // Initialize triple buffer with actual format
-                    InitTripleBuffer(td.Format, td.Width, td.Height);
-
-                    // Open shared handles
-                    for (int i = 0; i < 3; i++) {
-                        IDXGIResource* bufRes;
-                        g.buffer.textures[i]->QueryInterface(&bufRes);
-                        HANDLE sharedHandle;
-                        bufRes->GetSharedHandle(&sharedHandle);
-                        bufRes->Release();
+    D3D11_BUFFER_DESC cbd = {};
+    cbd.Usage = D3D11_USAGE_DYNAMIC;
+    cbd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    cbd.ByteWidth = sizeof(ChainConstants);
+    cbd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    g.device->CreateBuffer(&cbd, nullptr, &ch.cb);
 
-                        hr = g.capDevice->OpenSharedResource(sharedHandle,
-                            __uuidof(ID3D11Texture2D), (void**)&sharedTex[i]);
-                        if (FAILED(hr)) Fatal("OpenSharedResource", hr);
-                    }
+    D3D11_SAMPLER_DESC sampd = {}; sampd.Filter = D3D11_FILTER_MIN_MAG_MIP_POINT;
+    sampd.AddressU = sampd.AddressV = sampd.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+    g.device->CreateSamplerState(&sampd, &ch.samplerPoint);
 
-                    buffersOpened = true;
+    printf("  Preset: %s, %zu passes in %zu draws from %ux%u, %zu intermediate targets\n", ch.preset.path.c_str(),
+           ch.preset.passes.size(), ch.plan.draws.size(), ow, oh, ch.pool.size());
+}
 
-                    if (g.debug) {
-                        printf("[DEBUG] Buffers initialized with actual format\n");
-                    }
-                }
+// Rewrites the HDR constants for the adapted peak, clamped to just above SDR
+// white and at most --peak-nits (ClampAdaptivePeak)
+void UpdateAdaptivePeak() {
+    TonemapParams p = g.tonemapParams;
+    float peak = ClampAdaptivePeak(g.luminance.adapter.PeakNits(), p.sdrWhiteNits, p.peakNits);
+    if (fabsf(peak - g.adaptedPeakNits) < 0.005f * peak) return;   // Below visible change
+    p.peakNits = g.adaptedPeakNits = peak;
+
+    TonemapConstants tc = ComputeTonemapConstants(p);
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    if (SUCCEEDED(g.context->Map(g.cbHDR, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped))) {
+        memcpy(mapped.pData, &tc, sizeof(tc));
+        g.context->Unmap(g.cbHDR, 0);
+    }
+}
 
-                int writeIdx = g.buffer.GetWriteIndex();
-                g.capContext->CopyResource(sharedTex[writeIdx], tex);
-                g.capContext->Flush();
+// New noise phase every frame; one step of the back buffer's precision
+void UpdateDither() {
+    DitherConstants dc = {};
+    dc.amplitude = g.outputMode == OutputMode::Sdr10 ? 1.0f / 1023.0f : 1.0f / 255.0f;
+    dc.phase = (float)fmod(++g.ditherFrame * 0.6180339887, 1.0);
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    if (SUCCEEDED(g.context->Map(g.cbDither, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped))) {
+        memcpy(mapped.pData, &dc, sizeof(dc));
+        g.context->Unmap(g.cbDither, 0);
+    }
+    g.context->PSSetConstantBuffers(1, 1, &g.cbDither);
+    g.context->PSSetShaderResources(2, 1, &g.blueNoiseSrv);
+}
 
-                g.captureFrameId.fetch_add(1, std::memory_order_relaxed);
-                g.buffer.PublishFrame();
-                g.captureCount.fetch_add(1, std::memory_order_relaxed);
+// FrameComputeConstants for the current viewport, --crop and target size
+void InitFrameCompute() {
+    float srcW = (float)(g.sourceRect.right - g.sourceRect.left);
+    float srcH = (float)(g.sourceRect.bottom - g.sourceRect.top);
+    FrameComputeConstants fc = {{g.viewport.TopLeftX, g.viewport.TopLeftY, g.viewport.Width, g.viewport.Height},
+                                {g.crop.left / srcW, g.crop.top / srcH, g.crop.right / srcW, g.crop.bottom / srcH},
+                                {(uint32_t)g.windowWidth, (uint32_t)g.windowHeight}};
+    D3D11_BUFFER_DESC bd = {};
+    bd.Usage = D3D11_USAGE_IMMUTABLE;
+    bd.ByteWidth = sizeof(fc);
+    bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    D3D11_SUBRESOURCE_DATA sd = {&fc};
+    HRESULT hr = g.device->CreateBuffer(&bd, &sd, &g.cbFrameCompute);
+    if (FAILED(hr)) Fatal("CreateBuffer (frame compute)", hr);
+}
 
-                // Signal buffer ready AFTER first frame is copied and published
-                if (!g.bufferInitialized.load(std::memory_order_relaxed)) {
-                    g.bufferInitialized.store(true, std::memory_order_release);
-                }
+// --render-path compute: ps's compute variant over the whole target, with the
+// constants, textures and sampler Render bound for the draw (b0-b2, t0-t2, s0).
+// Leaves the window bound as render target for the pointer.
+void DispatchFrame(ID3D11PixelShader* ps) {
+    ID3D11ComputeShader* cs = nullptr;
+    for (const auto& variant : g.frameCompute) {
+        if (variant.first == ps) cs = variant.second;
+    }
+    if (!g.cbFrameCompute) InitFrameCompute();
+
+    ID3D11Buffer* cbs[3];
+    ID3D11ShaderResourceView* srvs[3];
+    ID3D11SamplerState* sampler;
+    g.context->PSGetConstantBuffers(0, 3, cbs);
+    g.context->PSGetShaderResources(0, 3, srvs);
+    g.context->PSGetSamplers(0, 1, &sampler);
+    g.context->CSSetConstantBuffers(0, 3, cbs);
+    g.context->CSSetShaderResources(0, 3, srvs);
+    g.context->CSSetSamplers(0, 1, &sampler);
+    for (ID3D11Buffer* b : cbs) { if (b) b->Release(); }
+    for (ID3D11ShaderResourceView* v : srvs) { if (v) v->Release(); }
+    if (sampler) sampler->Release();
+
+    g.context->CSSetConstantBuffers(4, 1, &g.cbFrameCompute);
+    g.context->CSSetUnorderedAccessViews(0, 1, &g.frameUav, nullptr);
+    g.context->CSSetShader(cs, 0, 0);
+    g.context->Dispatch((g.windowWidth + 7) / 8, (g.windowHeight + 7) / 8, 1);
+
+    ID3D11UnorderedAccessView* nullUav = nullptr;
+    ID3D11ShaderResourceView* nullSrvs[3] = {};
+    g.context->CSSetUnorderedAccessViews(0, 1, &nullUav, nullptr);
+    g.context->CSSetShaderResources(0, 3, nullSrvs);
+    if (g.frameTarget) {
+        ID3D11Resource* backBuffer;
+        g.rtv->GetResource(&backBuffer);
+        g.context->CopyResource(backBuffer, g.frameTarget);
+        backBuffer->Release();
+    }
+    g.context->OMSetRenderTargets(1, &g.rtv, nullptr);
+    g.context->RSSetViewports(1, &g.viewport);
+}
 
-                tex->Release();
-            } else {
-                if (g.debug) printf("[DEBUG] QueryInterface for texture failed: 0x%08X\n", (unsigned)hr);
-            }
-        }
+// Compiles the --yuv-format shader for the slot format and sizes its
+// buffers for the slot (the whole capture, --crop is a drawing option)
+void InitYuvStage(ID3D11Texture2D* slotTexture) {
+    D3D11_TEXTURE2D_DESC sd;
+    slotTexture->GetDesc(&sd);
+    YuvStage& st = g.yuv;
+    if (!YuvSourceForSlot(sd.Format, &st.source)) Fatal("--yuv-format: unsupported capture slot format");
+    bool p010 = g.yuvFormat == YuvFormat::P010;
+    if (p010 && !YuvSourceIsHdr(st.source)) Fatal("--yuv-format p010 needs HDR capture slots (HDR source, not --slot-format sdr8)");
+    if (!p010 && YuvSourceIsHdr(st.source)) Fatal("--yuv-format nv12 needs SDR capture slots (SDR source or --slot-format sdr8)");
+    st.layout = MakeYuvLayout(g.yuvFormat, sd.Width, sd.Height);
+    st.tables.Init(g.yuvFormat);
 
-        res->Release();
-        g.duplication->ReleaseFrame();
+    HRESULT hr; ID3DBlob *blob, *err;
+    char source[8], linearMax[16], pqCodes[16];
+    snprintf(source, sizeof(source), "%d", p010 ? (st.source == YuvSource::Pq10 ? 2 : 1) : 0);
+    snprintf(linearMax, sizeof(linearMax), "%uu", kYuvLinearMax);
+    snprintf(pqCodes, sizeof(pqCodes), "%du", kYuvPqCodes);
+    D3D_SHADER_MACRO defines[] = {{"YUV_SOURCE", source}, {"YUV_P010", p010 ? "1" : "0"}, {"LINEAR_MAX", linearMax},
+                                  {"PQ_CODES", pqCodes}, {nullptr, nullptr}};
+    hr = D3DCompile(g_ComputeShaderYuv, strlen(g_ComputeShaderYuv), "CS_Yuv", defines, 0, "main", "cs_5_0", 0, 0, &blob, &err);
+    if (FAILED(hr)) {
+        if (err) fprintf(stderr, "CS Yuv compile error: %s\n", (char*)err->GetBufferPointer());
+        Fatal("CS Yuv compile");
     }
+    g.device->CreateComputeShader(blob->GetBufferPointer(), blob->GetBufferSize(), 0, &st.cs);
+    blob->Release();
 
-    for (int i = 0; i < 3; i++) {
-        if (sharedTex[i]) sharedTex[i]->Release();
-    }
+    const YuvLayout& l = st.layout;
+    YuvConstants yc = {};
+    memcpy(yc.y, st.tables.y, sizeof(yc.y));
+    memcpy(yc.cb, st.tables.cb, sizeof(yc.cb));
+    memcpy(yc.cr, st.tables.cr, sizeof(yc.cr));
+    for (int r = 0; r < 3; r++) memcpy(yc.toBt2020[r], kYuvBt709ToBt2020[r], sizeof(kYuvBt709ToBt2020[r]));
+    yc.size[0] = l.width;
+    yc.size[1] = l.height;
+    yc.blocks[0] = l.paddedWidth / 4;
+    yc.blocks[1] = l.paddedHeight / 2;
+    yc.pitch = (uint32_t)l.pitch;
+    yc.chromaOffset = (uint32_t)l.chromaOffset;
+    yc.outShift = st.tables.outShift;
+    D3D11_BUFFER_DESC bd = {};
+    bd.Usage = D3D11_USAGE_IMMUTABLE;
+    bd.ByteWidth = sizeof(yc);
+    bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    D3D11_SUBRESOURCE_DATA data = {&yc};
+    hr = g.device->CreateBuffer(&bd, &data, &st.cb);
+    if (FAILED(hr)) Fatal("CreateBuffer (yuv constants)", hr);
+
+    // NV12 never reads the table; a single entry keeps the binding valid
+    static const uint32_t kNoThresholds[1] = {};
+    const uint32_t* table = p010 ? st.tables.pqThresholds.data() : kNoThresholds;
+    bd.ByteWidth = (UINT)((p010 ? st.tables.pqThresholds.size() : 1) * sizeof(uint32_t));
+    bd.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    data.pSysMem = table;
+    hr = g.device->CreateBuffer(&bd, &data, &st.thresholds);
+    if (FAILED(hr)) Fatal("CreateBuffer (yuv PQ table)", hr);
+    D3D11_SHADER_RESOURCE_VIEW_DESC srvd = {};
+    srvd.Format = DXGI_FORMAT_R32_UINT;
+    srvd.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+    srvd.Buffer.NumElements = bd.ByteWidth / sizeof(uint32_t);
+    g.device->CreateShaderResourceView(st.thresholds, &srvd, &st.thresholdsSrv);
+
+    bd = {};
+    bd.ByteWidth = (UINT)l.size;
+    bd.BindFlags = D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_SHADER_RESOURCE;
+    bd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+    hr = g.device->CreateBuffer(&bd, nullptr, &st.output);
+    if (FAILED(hr)) Fatal("CreateBuffer (yuv output)", hr);
+    D3D11_UNORDERED_ACCESS_VIEW_DESC ud = {};
+    ud.Format = DXGI_FORMAT_R32_TYPELESS;
+    ud.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+    ud.Buffer.NumElements = (UINT)(l.size / 4);
+    ud.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_RAW;
+    hr = g.device->CreateUnorderedAccessView(st.output, &ud, &st.uav);
+    if (FAILED(hr)) Fatal("CreateUnorderedAccessView (yuv output)", hr);
+    st.timer.Init(g.device);
+
+    printf("  YUV: %s (%s limited) %dx%d from %s slots, %.1f MB per frame\n", YuvFormatName(g.yuvFormat),
+           p010 ? "BT.2020 PQ" : "BT.709", l.width, l.height, YuvSourceName(st.source), l.size / 1048576.0);
 }
 
 static int s_renderDebugCounter = 0;
 static bool s_firstRenderDone = false;
 
-void Render() {
+// Returns the slot that was drawn (-1 if none); newFrame is set when that slot
+// had not been drawn before
+int Render(bool* newFrame) {
+    *newFrame = false;
     if (!g.bufferInitialized.load(std::memory_order_acquire)) {
         if (g.debug && (++s_renderDebugCounter % 60 == 0)) {
             printf("[DEBUG] Render: buffer not initialized\n");
         }
-        return;
+        return -1;
     }
 
-    int readIdx = g.buffer.AcquireFrame();
+    int readIdx = g.buffer.AcquireFrame(newFrame);
     if (readIdx < 0) {
         if (g.debug && (++s_renderDebugCounter % 60 == 0)) {
-            printf("[DEBUG] Render: no frame available (readIdx=%d, writeIdx=%d, readyIdx=%d, displayIdx=%d)\n",
-                   readIdx,
-                   g.buffer.writeIdx.load(),
-                   g.buffer.readyIdx.load(),
-                   g.buffer.displayIdx.load());
+            printf("[DEBUG] Render: no frame available (readIdx=%d, ready=0x%x)\n",
+                   readIdx, g.buffer.PeekReady());
         }
-        return;
+        return -1;
     }
 
-    ID3D11ShaderResourceView* srv = g.buffer.srvs[readIdx];
+    ID3D11ShaderResourceView* srv = g.buffer.slots[readIdx].srv;
     if (!srv) {
         if (g.debug) printf("[DEBUG] Render: SRV is null for readIdx=%d\n", readIdx);
-        return;
+        return -1;
     }
 
     if (g.debug && !s_firstRenderDone) {
@@ -660,45 +3393,318 @@ void Render() {
         s_firstRenderDone = true;
     }
 
-    float black[] = {0,0,0,1};
-    g.context->OMSetRenderTargets(1, &g.rtv, nullptr);
-    g.context->ClearRenderTargetView(g.rtv, black);
-    g.context->RSSetViewports(1, &g.viewport);
+    CaptureSlot& slot = g.buffer.slots[readIdx];
+    bool slotsPq = g.slotsHDR && g.slotFormat == SlotFormat::Pq10;
+    bool tonemapping = g.slotsHDR && g.tonemap && !IsHdrOutput(g.outputMode);
 
     g.context->VSSetShader(g.vs, 0, 0);
+    UINT stride = sizeof(Vertex), offset = 0;
+    g.context->IASetVertexBuffers(0, 1, &g.vb, &stride, &offset);
+    g.context->IASetInputLayout(g.layout);
+    g.context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
 
-    // Select pixel shader based on source format:
-    // - sourceIsHDR (actual R16G16B16A16_FLOAT): use HDR tonemapping shader
-    // - SDR source: use passthrough shader
-    if (g.sourceIsHDR && g.tonemap) {
-        // Update HDR constant buffer with sdrWhiteNits value
-        D3D11_MAPPED_SUBRESOURCE mapped;
-        if (SUCCEEDED(g.context->Map(g.cbHDR, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped))) {
-            float* data = (float*)mapped.pData;
-            data[0] = g.sdrWhiteNits;
-            data[1] = 0.0f;  // padding
-            data[2] = 0.0f;
-            data[3] = 0.0f;
-            g.context->Unmap(g.cbHDR, 0);
-        }
+    // Fence mode: wait (on the GPU) for the capture device's copy into this slot
+    if (g.deviceMode == DeviceMode::Fence) g.context4->Wait(g.copyFence, slot.copyFenceValue);
+
+    // Adaptive peak: the constants follow measurements of earlier frames
+    if (g.adaptivePeak && tonemapping) {
+        if (g.luminance.Collect(g.context, FrameClockFrequency())) UpdateAdaptivePeak();
+        if (*newFrame) g.luminance.Measure(g.context, slot.texture, srv, slot.captureTime);
+    }
+
+    // Two-pass --scaler: the frame shader below reads the horizontally filtered intermediate
+    if (!ScalerIsHardware(g.scalerKernel)) {
+        if (!g.scaler.cb[1]) InitScaler(slot.texture);
+        if (g.scaler.ps) srv = g.scaler.Horizontal(g.context, srv);
+        else g.context->PSSetConstantBuffers(2, 1, &g.scaler.cb[1]);
+    }
+    g.context->IASetVertexBuffers(0, 1, &g.vbFrame, &stride, &offset);
+
+    // The compute path writes the bars itself, and needs the target unbound for its UAV
+    float black[] = {0,0,0,1};
+    if (!g.frameUav) g.context->ClearRenderTargetView(g.rtv, black);
+    if (!g.chain.preset.passes.empty()) {
+        // --preset: the color pass draws the crop 1:1 into the chain's Original
+        if (!g.chain.cb) InitChain(slot.texture);
+        D3D11_VIEWPORT vp = {0, 0, (float)g.chain.original.width, (float)g.chain.original.height, 0, 1};
+        g.context->OMSetRenderTargets(1, &g.chain.original.rtv, nullptr);
+        g.context->RSSetViewports(1, &vp);
+    } else if (g.frameUav) {
+        g.context->OMSetRenderTargets(0, nullptr, nullptr);
+    } else {
+        g.context->OMSetRenderTargets(1, &g.rtv, nullptr);
+        g.context->RSSetViewports(1, &g.viewport);
+    }
+
+    // Select pixel shader based on slot contents and output:
+    // - HDR swap chain: scRGB slots as is (or PQ encoded), SDR slots placed at SDR white
+    // - slotsHDR (R16G16B16A16_FLOAT or a compact HDR --slot-format): use HDR tonemapping shader
+    // - SDR source or sdr8 slots (tonemapped at capture): use passthrough shader
+    ID3D11PixelShader* frameShader;
+    if (tonemapping && g.dither) UpdateDither();
+    if (IsHdrOutput(g.outputMode)) {
         g.context->PSSetConstantBuffers(0, 1, &g.cbHDR);
-        g.context->PSSetShader(g.psHDR, 0, 0);
+        if (!g.slotsHDR) frameShader = g.psFrameOutputSDR;
+        else if (g.outputMode == OutputMode::Hdr10 || slotsPq) frameShader = g.psOutputHDR;
+        else frameShader = g.psFrameSDR;
+    } else if (tonemapping && g.psLUT) {
+        if (!g.lutSrv) InitColorLut();
+        g.context->PSSetConstantBuffers(0, 1, &g.cbLUT);
+        g.context->PSSetShaderResources(1, 1, &g.lutSrv);
+        frameShader = g.psLUT;
+    } else if (tonemapping) {
+        g.context->PSSetConstantBuffers(0, 1, &g.cbHDR);
+        frameShader = g.psHDR;
     } else {
-        g.context->PSSetShader(g.psSDR, 0, 0);
+        frameShader = slotsPq ? g.psOutputHDR : g.psFrameSDR;
     }
 
     g.context->PSSetShaderResources(0, 1, &srv);
-    g.context->PSSetSamplers(0, 1, &g.sampler);
+    g.context->PSSetSamplers(0, 1, g.samplerPoint ? &g.samplerPoint : &g.sampler);
+    if (g.frameUav) {
+        DispatchFrame(frameShader);
+    } else {
+        g.context->PSSetShader(frameShader, 0, 0);
+        g.context->Draw(4, 0);
+    }
 
-    UINT stride = sizeof(Vertex), offset = 0;
-    g.context->IASetVertexBuffers(0, 1, &g.vb, &stride, &offset);
-    g.context->IASetInputLayout(g.layout);
-    g.context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+    // --yuv-format: each frame once, from the slot as captured (not the scaled or cropped image)
+    if (g.convertYuv && *newFrame) {
+        if (!g.yuv.cs) InitYuvStage(slot.texture);
+        g.yuv.Convert(g.context, slot.srv);
+    }
 
-    g.context->Draw(4, 0);
+    if (g.deviceMode == DeviceMode::Fence) {
+        slot.readFenceValue = ++g.readFenceValue;
+        g.context4->Signal(g.readFence, g.readFenceValue);
+    }
+
+    g.context->IASetVertexBuffers(0, 1, &g.vb, &stride, &offset);
+    if (g.chain.cb) g.chain.Run(g.context, g.rtv, g.viewport, g.sampler);
+    if (g.samplerPoint || g.chain.cb) g.context->PSSetSamplers(0, 1, &g.sampler);
+    if (g.showPointer) RenderPointer();
 
     ID3D11ShaderResourceView* null = nullptr;
     g.context->PSSetShaderResources(0, 1, &null);
+    return readIdx;
+}
+
+// Waitable mode: block until the swap chain can take a frame, then sleep until
+// just before the predicted vblank so Render() picks the newest capture slot
+void WaitForLatch() {
+    WaitForSingleObjectEx(g.frameLatencyWaitable, 1000, TRUE);
+    int64_t now = FrameClockNow();
+
+    // Without frame statistics (composed windows), the wake-up is our vblank estimate
+    if (!g.haveFrameStats) g.scheduler.OnVBlank(now);
+
+    SleepUntilTicks(g.scheduler.LatchTime(now));
+}
+
+// Feeds real vblank times and missed presents back into the scheduler
+void ObservePresentStats() {
+    DXGI_FRAME_STATISTICS st;
+    if (FAILED(g.swapChain->GetFrameStatistics(&st))) {
+        g.haveFrameStats = false;
+        return;
+    }
+    g.haveFrameStats = true;
+    if (st.PresentCount == g.lastFrameStats.PresentCount) return;
+
+    g.scheduler.OnVBlank(st.SyncQPCTime.QuadPart);
+    if (g.lastFrameStats.PresentCount != 0) {
+        // More vblanks than presents between two samples means a present was late
+        UINT presents = st.PresentCount - g.lastFrameStats.PresentCount;
+        UINT refreshes = st.PresentRefreshCount - g.lastFrameStats.PresentRefreshCount;
+        g.scheduler.OnPresentResult(refreshes > presents);
+    }
+    g.lastFrameStats = st;
+}
+
+// Idle mode: keep the target's cadence without presenting
+void WaitForTargetVBlank() {
+    if (!g.targetOutput && FAILED(g.swapChain->GetContainingOutput(&g.targetOutput))) {
+        g.targetOutput = nullptr;
+        Sleep(1);
+        return;
+    }
+    g.targetOutput->WaitForVBlank();
+}
+
+// --render-bench: GPU time of Render() per frame on the draw and the compute
+// path, into offscreen targets of common window sizes, with the source,
+// --output, --scaler, --crop and fit as given. The compute path writes its
+// target through a UAV, as with UAV back buffers. Every frame is timed on
+// its own (Drain), the pointer is left out.
+void RunRenderBench() {
+    const int kSizes[][2] = {{1920, 1080}, {2560, 1440}, {3840, 2160}};
+    const int kWarmup = 30, kFrames = 300;
+    ID3D11RenderTargetView* windowRtv = g.rtv;
+    ID3D11UnorderedAccessView* windowUav = g.frameUav;
+    ID3D11Texture2D* windowTarget = g.frameTarget;
+    g.frameTarget = nullptr;
+    g.showPointer = false;
+
+    printf("\n%-11s %9s %9s   (GPU ms per frame, %d frames)\n", "Target", "draw", "compute", kFrames);
+    for (const auto& size : kSizes) {
+        D3D11_TEXTURE2D_DESC td = {};
+        td.Width = size[0];
+        td.Height = size[1];
+        td.MipLevels = td.ArraySize = 1;
+        td.Format = BackBufferFormat(true);
+        td.SampleDesc.Count = 1;
+        td.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_UNORDERED_ACCESS;
+        ID3D11Texture2D* target;
+        ID3D11UnorderedAccessView* uav;
+        HRESULT hr = g.device->CreateTexture2D(&td, nullptr, &target);
+        if (FAILED(hr)) Fatal("CreateTexture2D (render bench)", hr);
+        g.device->CreateRenderTargetView(target, nullptr, &g.rtv);
+        hr = g.device->CreateUnorderedAccessView(target, nullptr, &uav);
+        if (FAILED(hr)) Fatal("CreateUnorderedAccessView (render bench)", hr);
+
+        // Everything sized by the window is rebuilt with the next frame
+        g.windowWidth = size[0];
+        g.windowHeight = size[1];
+        ViewportRect v = FitViewport(g.fit, g.crop.right - g.crop.left, g.crop.bottom - g.crop.top, size[0], size[1]);
+        g.viewport = {v.x, v.y, v.width, v.height, 0, 1};
+        g.scaler.Release();
+        if (g.cbFrameCompute) { g.cbFrameCompute->Release(); g.cbFrameCompute = nullptr; }
+
+        double ms[2];
+        for (int path = 0; path < 2; path++) {
+            g.frameUav = path ? uav : nullptr;
+            for (int i = 0; i < kWarmup + kFrames; i++) {
+                if (i == kWarmup) g.renderTimer.TakeMs();
+                bool newFrame;
+                DeviceLock lock;
+                g.renderTimer.Begin(g.context);
+                Render(&newFrame);
+                g.renderTimer.End(g.context);
+                g.renderTimer.Drain(g.context);
+            }
+            ms[path] = g.renderTimer.TakeMs() / kFrames;
+        }
+        printf("%4dx%-6d %9.3f %9.3f\n", size[0], size[1], ms[0], ms[1]);
+
+        uav->Release();
+        g.rtv->Release();
+        target->Release();
+    }
+
+    g.rtv = windowRtv;
+    g.frameUav = windowUav;
+    g.frameTarget = windowTarget;
+}
+
+// --yuv-check: renders until a new frame has been converted, reads its slot
+// and the shader's output back and compares them byte for byte with
+// ConvertToYuvReference of the same pixels. Then reports Mpix/s of both
+// paths on that frame: the shader (GPU time, every dispatch on its own) and
+// YuvConverter on the read-back pixels (AVX2 when built with /arch:AVX2).
+// Returns false if any byte differs.
+bool RunYuvCheck() {
+    int readIdx = -1;
+    bool newFrame = false;
+    for (int i = 0; i < 500 && g.running; i++) {
+        {
+            DeviceLock lock;
+            readIdx = Render(&newFrame);
+        }
+        if (readIdx >= 0 && newFrame) break;
+        Sleep(10);
+    }
+    if (readIdx < 0 || !newFrame) Fatal("--yuv-check: no new frame to convert");
+
+    DeviceLock lock;
+    const CaptureSlot& slot = g.buffer.slots[readIdx];
+    YuvStage& st = g.yuv;
+    const YuvLayout& l = st.layout;
+    D3D11_TEXTURE2D_DESC td;
+    slot.texture->GetDesc(&td);
+    td.Usage = D3D11_USAGE_STAGING;
+    td.BindFlags = 0;
+    td.MiscFlags = 0;
+    td.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    ID3D11Texture2D* slotCopy;
+    HRESULT hr = g.device->CreateTexture2D(&td, nullptr, &slotCopy);
+    if (FAILED(hr)) Fatal("CreateTexture2D (yuv check)", hr);
+    D3D11_BUFFER_DESC bd = {};
+    bd.ByteWidth = (UINT)l.size;
+    bd.Usage = D3D11_USAGE_STAGING;
+    bd.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    ID3D11Buffer* outputCopy;
+    hr = g.device->CreateBuffer(&bd, nullptr, &outputCopy);
+    if (FAILED(hr)) Fatal("CreateBuffer (yuv check)", hr);
+    g.context->CopyResource(slotCopy, slot.texture);
+    g.context->CopyResource(outputCopy, st.output);
+
+    size_t srcPitch = (size_t)l.width * YuvSourceBytesPerPixel(st.source);
+    std::vector<uint8_t> pixels(srcPitch * l.height), gpu(l.size), ref(l.size);
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    hr = g.context->Map(slotCopy, 0, D3D11_MAP_READ, 0, &mapped);
+    if (FAILED(hr)) Fatal("Map (yuv check slot)", hr);
+    for (int y = 0; y < l.height; y++) memcpy(&pixels[y * srcPitch], (uint8_t*)mapped.pData + (size_t)y * mapped.RowPitch, srcPitch);
+    g.context->Unmap(slotCopy, 0);
+    hr = g.context->Map(outputCopy, 0, D3D11_MAP_READ, 0, &mapped);
+    if (FAILED(hr)) Fatal("Map (yuv check output)", hr);
+    memcpy(gpu.data(), mapped.pData, l.size);
+    g.context->Unmap(outputCopy, 0);
+    outputCopy->Release();
+    slotCopy->Release();
+
+    ConvertToYuvReference(st.source, pixels.data(), srcPitch, l, st.tables, ref.data());
+    size_t mismatch = 0, first = 0;
+    for (size_t i = 0; i < l.size; i++) {
+        if (gpu[i] != ref[i] && !mismatch++) first = i;
+    }
+    printf("\nYUV check: %s %dx%d from %s slots\n", YuvFormatName(g.yuvFormat), l.width, l.height, YuvSourceName(st.source));
+    if (mismatch) {
+        bool chroma = first >= l.chromaOffset;
+        size_t offset = chroma ? first - l.chromaOffset : first;
+        printf("  GPU vs reference: FAILED, %zu bytes differ, first in the %s plane at row %zu, byte %zu\n", mismatch,
+               chroma ? "chroma" : "luma", offset / l.pitch, offset % l.pitch);
+    } else {
+        printf("  GPU vs reference: bit-exact\n");
+    }
+
+    const int kRuns = 100;
+    st.timer.Drain(g.context);
+    st.timer.TakeMs();
+    for (int i = 0; i < kRuns; i++) {
+        st.Convert(g.context, slot.srv);
+        st.timer.Drain(g.context);
+    }
+    double gpuMs = st.timer.TakeMs();
+    st.pixels = 0;
+
+    YuvConverter converter;
+    converter.Configure(g.yuvFormat, st.source, l.width, l.height);
+    LARGE_INTEGER freq, t0, t1;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t0);
+    int cpuRuns = 0;
+    double cpuSeconds;
+    do {
+        converter.Convert(pixels.data(), srcPitch, ref.data());
+        cpuRuns++;
+        QueryPerformanceCounter(&t1);
+        cpuSeconds = (double)(t1.QuadPart - t0.QuadPart) / freq.QuadPart;
+    } while (cpuSeconds < 0.3);
+
+    double framePixels = (double)l.width * l.height;
+    printf("  GPU (compute shader): %.1f Mpix/s\n", gpuMs > 0 ? framePixels * kRuns / (gpuMs * 1000.0) : 0.0);
+    printf("  CPU (%s): %.1f Mpix/s\n", YuvSimdName(), framePixels * cpuRuns / cpuSeconds / 1e6);
+    return mismatch == 0;
+}
+
+// CPU time (user + kernel) used by the whole process, in seconds
+double ProcessCpuSeconds() {
+    FILETIME created, exited, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user)) return 0.0;
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime; k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime; u.HighPart = user.dwHighDateTime;
+    return (double)(k.QuadPart + u.QuadPart) / 1e7;
 }
 
 void Cleanup() {
@@ -708,47 +3714,174 @@ void Cleanup() {
     if (g.captureThread.joinable()) {
         g.captureThread.join();
     }
-
-    // Release triple buffer (may not be initialized if we exit early)
-    if (g.bufferInitialized.load(std::memory_order_acquire)) {
-        for (int i = 0; i < 3; i++) {
-            if (g.buffer.srvs[i]) { g.buffer.srvs[i]->Release(); g.buffer.srvs[i] = nullptr; }
-            if (g.buffer.textures[i]) { g.buffer.textures[i]->Release(); g.buffer.textures[i] = nullptr; }
-        }
+    g.packer.Release();
+    g.copyTimer.Release();
+    g.readback.Release();
+
+    // Release capture slots (may not be initialized if we exit early)
+    for (int i = 0; i < kMaxCaptureSlots; i++) {
+        CaptureSlot& slot = g.buffer.slots[i];
+        if (slot.srv) { slot.srv->Release(); slot.srv = nullptr; }
+        if (slot.texture) { slot.texture->Release(); slot.texture = nullptr; }
     }
 
     // Release capture resources
-    if (g.duplication) { g.duplication->Release(); g.duplication = nullptr; }
+    if (g.source) { delete g.source; g.source = nullptr; g.dxgiSource = nullptr; }
+    if (g.capReadFence) { g.capReadFence->Release(); g.capReadFence = nullptr; }
+    if (g.readFence) { g.readFence->Release(); g.readFence = nullptr; }
+    if (g.capCopyFence) { g.capCopyFence->Release(); g.capCopyFence = nullptr; }
+    if (g.copyFence) { g.copyFence->Release(); g.copyFence = nullptr; }
+    if (g.capContext4) { g.capContext4->Release(); g.capContext4 = nullptr; }
+    if (g.context4) { g.context4->Release(); g.context4 = nullptr; }
+    if (g.multithread) { g.multithread->Release(); g.multithread = nullptr; }
     if (g.capContext) { g.capContext->Release(); g.capContext = nullptr; }
     if (g.capDevice) { g.capDevice->Release(); g.capDevice = nullptr; }
 
     // Release render resources
+    ReleasePointerLayer(&g.pointerColor);
+    ReleasePointerLayer(&g.pointerInvert);
+    g.pointerShown = PointerState();
+    for (PointerState& p : g.pointer.slots) p = PointerState();
+    if (g.blendInvert) { g.blendInvert->Release(); g.blendInvert = nullptr; }
+    if (g.blendOver) { g.blendOver->Release(); g.blendOver = nullptr; }
+    if (g.samplerPoint) { g.samplerPoint->Release(); g.samplerPoint = nullptr; }
     if (g.sampler) { g.sampler->Release(); g.sampler = nullptr; }
+    g.chain.Release();
+    g.scaler.Release();
+    g.yuv.Release();
+    for (auto& variant : g.frameCompute) variant.second->Release();
+    g.frameCompute.clear();
+    if (g.cbFrameCompute) { g.cbFrameCompute->Release(); g.cbFrameCompute = nullptr; }
+    if (g.frameUav) { g.frameUav->Release(); g.frameUav = nullptr; }
+    if (g.frameTarget) { g.frameTarget->Release(); g.frameTarget = nullptr; }
     if (g.cbHDR) { g.cbHDR->Release(); g.cbHDR = nullptr; }
+    if (g.cbLUT) { g.cbLUT->Release(); g.cbLUT = nullptr; }
+    if (g.cbDither) { g.cbDither->Release(); g.cbDither = nullptr; }
+    if (g.blueNoiseSrv) { g.blueNoiseSrv->Release(); g.blueNoiseSrv = nullptr; }
+    if (g.blueNoiseTexture) { g.blueNoiseTexture->Release(); g.blueNoiseTexture = nullptr; }
+    if (g.lutSrv) { g.lutSrv->Release(); g.lutSrv = nullptr; }
+    if (g.lutTexture) { g.lutTexture->Release(); g.lutTexture = nullptr; }
+    if (g.psLUT) { g.psLUT->Release(); g.psLUT = nullptr; }
+    if (g.vbFrame) { g.vbFrame->Release(); g.vbFrame = nullptr; }
     if (g.vb) { g.vb->Release(); g.vb = nullptr; }
     if (g.layout) { g.layout->Release(); g.layout = nullptr; }
     if (g.psHDR) { g.psHDR->Release(); g.psHDR = nullptr; }
-    if (g.psSDRGamma) { g.psSDRGamma->Release(); g.psSDRGamma = nullptr; }
+    if (g.psFrameOutputSDR) { g.psFrameOutputSDR->Release(); g.psFrameOutputSDR = nullptr; }
+    if (g.psFrameSDR) { g.psFrameSDR->Release(); g.psFrameSDR = nullptr; }
+    if (g.psOutputSDR) { g.psOutputSDR->Release(); g.psOutputSDR = nullptr; }
+    if (g.psOutputHDR) { g.psOutputHDR->Release(); g.psOutputHDR = nullptr; }
     if (g.psSDR) { g.psSDR->Release(); g.psSDR = nullptr; }
     if (g.vs) { g.vs->Release(); g.vs = nullptr; }
     if (g.rtv) { g.rtv->Release(); g.rtv = nullptr; }
+    if (g.frameLatencyWaitable) { CloseHandle(g.frameLatencyWaitable); g.frameLatencyWaitable = nullptr; }
+    if (g.frameReadyEvent) { CloseHandle(g.frameReadyEvent); g.frameReadyEvent = nullptr; }
+    if (g.targetOutput) { g.targetOutput->Release(); g.targetOutput = nullptr; }
+    g.renderTimer.Release();
+    g.luminance.Release();
     if (g.swapChain) { g.swapChain->Release(); g.swapChain = nullptr; }
     if (g.context) { g.context->Release(); g.context = nullptr; }
     if (g.device) { g.device->Release(); g.device = nullptr; }
     if (g.hwnd) { DestroyWindow(g.hwnd); g.hwnd = nullptr; }
 }
 
+void InitFrameSource() {
+    if (g.useSynthetic) {
+        g.source = new SyntheticFrameSource(g.synthetic);
+    } else if (g.replayPath) {
+        auto* replay = new ReplayFrameSource(g.replayWidth, g.replayHeight, g.cpuSourceFormat, g.replayHz);
+        g.source = replay;
+        if (!replay->Open(g.replayPath)) Fatal("Cannot read replay file");
+    } else {
+        g.dxgiSource = new DxgiFrameSource();
+        g.source = g.dxgiSource;
+        g.dxgiSource->Init();
+    }
+}
+
 void PrintUsage(const char* prog) {
     printf("DXGI Desktop Mirror\n\n");
     printf("Usage: %s [options]\n\n", prog);
     printf("  --source N     Source monitor (default: 0)\n");
     printf("  --target N     Target monitor (default: 1)\n");
     printf("  --stretch      Stretch to fill (ignore aspect ratio)\n");
+    printf("  --integer-scale M  Pixel art (emulators): exact draws at the largest integer multiple that\n");
+    printf("                 fits, centered, with nearest sampling; sharp fills the window with\n");
+    printf("                 sharp-bilinear (nearest to that multiple, bilinear for the rest)\n");
+    printf("  --preset FILE  Post-processing chain (scanlines, CRT mask, sharpening or HLSL files) drawn\n");
+    printf("                 from the source at its own size; replaces --scaler and dithering\n");
+    printf("  --crop X,Y,W,H Draw only this rectangle of the source (source pixels), e.g. to cut\n");
+    printf("                 an emulator's borders before scaling\n");
+    printf("  --output M     sdr (8-bit, HDR sources tonemapped), sdr10 (10-bit, tonemapped),\n");
+    printf("                 auto (scrgb if the target is in HDR mode, otherwise sdr),\n");
+    printf("                 scrgb (FP16 linear) or hdr10 (10-bit PQ); HDR outputs skip tonemapping\n");
+    printf("                 (default: sdr)\n");
+    printf("  --no-dither    Do not blue-noise dither the tonemapped output\n");
     printf("  --no-tonemap   Disable HDR to SDR tonemapping\n");
     printf("  --sdr-white N  SDR white level in nits for HDR tonemapping (default: 240)\n");
     printf("                 Check Windows Settings > Display > HDR > SDR content brightness\n");
+    printf("  --tonemap OP   reinhard, bt2390, hable, aces or knee (default: reinhard)\n");
+    printf("  --peak-nits N  Source peak brightness for bt2390, hable and knee, above --sdr-white (default: 1000)\n");
+    printf("  --tonemap-knee F  knee: start of the compression, relative to SDR white (default: 0.75)\n");
+    printf("  --tonemap-exposure F  hable/aces: input multiplier (default: 1.0)\n");
+    printf("  --adaptive-peak  bt2390/hable/knee: follow the scene peak measured on the GPU,\n");
+    printf("                 between just above SDR white and --peak-nits\n");
+    printf("  --color-lut N  Tonemap HDR through an N^3 LUT (33 or 65) instead of per-pixel math\n");
+    printf("  --lut-interp M tetrahedral or trilinear (default: tetrahedral)\n");
+    printf("  --lut-cache DIR  Where built LUTs are cached (default: temp directory)\n");
+    printf("  --buffers N    Capture slots, 3 or 4 (default: 3, use 4 for 240Hz sources)\n");
+    printf("  --slot-format F  HDR capture slots: native (RGBA16F), r11g11b10 (float, clips wide gamut),\n");
+    printf("                 pq10 (10-bit BT.2020 PQ) or sdr8 (tonemapped at capture); the compact\n");
+    printf("                 formats halve slot memory and copy bandwidth (default: native)\n");
+    printf("  --capture-downscale  When the target is smaller, area-filter frames down to the\n");
+    printf("                 target size at capture, so slots, copies and drawing move less data\n");
+    printf("  --scaler K     Filter from slot to window: nearest, bilinear (one hardware tap),\n");
+    printf("                 bicubic (Catmull-Rom), lanczos3 or area (box, no aliasing when\n");
+    printf("                 downscaling); the last three run in two separable passes; sharp-bilinear\n");
+    printf("                 keeps pixel art crisp at non-integer sizes (default: bilinear)\n");
+    printf("  --full-copy    Copy whole frames instead of dirty/move rects\n");
+    printf("  --no-cursor    Do not draw the mouse pointer\n");
+    printf("  --present-mode M vsync (Present right after render), waitable (frame latency\n");
+    printf("                   waitable object + late frame selection) or tearing (present each\n");
+    printf("                   captured frame immediately, for VRR targets) (default: vsync)\n");
+    printf("  --render-path P  draw (clear + quad) or compute (one dispatch writes the whole back buffer,\n");
+    printf("                   bars included, through a UAV) (default: draw)\n");
+    printf("  --render-bench   Time both render paths at 1080p, 1440p and 4K (offscreen), then exit\n");
+    printf("  --yuv-format F   Convert each new frame for a video encoder: nv12 (BT.709 limited, SDR\n");
+    printf("                   slots) or p010 (BT.2020 PQ limited, HDR slots), on the GPU\n");
+    printf("  --yuv-check      Compare one converted frame with the CPU reference, report Mpix/s\n");
+    printf("                   of the GPU and CPU conversion, then exit\n");
+    printf("  --frame-server NAME  Publish each captured frame (slot format, with its dirty rects) to\n");
+    printf("                   the shared-memory ring NAME for other processes (frame_ring.h)\n");
+    printf("  --output-pipe P  Write each captured frame as NV12 (SDR) or P010 (HDR) to P: - for stdout,\n");
+    printf("                   a file, a FIFO or \\\\.\\pipe\\NAME (created for the encoder to connect to)\n");
+    printf("  --pipe-format F  y4m (YUV4MPEG2) or raw (frames with a header: id, capture time) (default: y4m)\n");
+    printf("  --pipe-drop D    With a full queue, drop the oldest queued frame or the newest (default: oldest)\n");
+    printf("  --pipe-queue N   Frames waiting for the consumer before frames drop (default: 3)\n");
+    printf("  --stream HOST:PORT  Send changed slices of each captured frame over UDP to slice-receive\n");
+    printf("                   on another machine (SDR slots; slice_stream.h)\n");
+    printf("  --stream-slice N   Rows per slice (default: 16)\n");
+    printf("  --stream-fec N     One XOR parity packet per N data packets, 0 = off (default: 0)\n");
+    printf("  --stream-refresh N Resend every slice at least once per N frames, 0 = changed only (default: 60)\n");
+    printf("  --stream-mtu N     Datagram size in bytes (default: 1400)\n");
+    printf("  --latch-margin MS  Waitable mode: pick the frame this long before vblank, at most 3/4 of a refresh period (default: 2.0)\n");
+    printf("  --idle-timeout MS  Don't redraw unchanged frames; after MS without new frames, sleep\n");
+    printf("                   until the next capture (default: 0 = always redraw)\n");
+    printf("  --device-mode M  legacy (two devices, shared handles + Flush), single (one device)\n");
+    printf("                   or fence (two devices, NT handles + ID3D11Fence) (default: legacy)\n");
     printf("  --debug        Enable debug output\n");
     printf("  --list         List monitors\n");
+    printf("\nTest sources (replace --source, for benchmarking without a live desktop):\n");
+    printf("  --synthetic WxH@HZ    Generated test pattern, e.g. 1920x1080@60\n");
+    printf("  --synthetic-motion M  static, bar or full (default: bar)\n");
+    printf("  --replay FILE WxH@HZ  Replay back-to-back raw frames from FILE (loops)\n");
+    printf("  --source-format F     sdr (BGRA8) or hdr (RGBA16F) for --synthetic/--replay (default: sdr)\n");
+}
+
+// Parses "1920x1080@60" (the @HZ part is optional)
+bool ParseMode(const char* s, UINT* w, UINT* h, double* hz) {
+    if (sscanf(s, "%ux%u@%lf", w, h, hz) >= 2 && *w > 0 && *h > 0 && *hz > 0) return true;
+    fprintf(stderr, "Invalid mode: %s (expected WxH@HZ)\n", s);
+    return false;
 }
 
 int main(int argc, char** argv) {
@@ -757,36 +3890,276 @@ int main(int argc, char** argv) {
     // Install console control handler for graceful CTRL+C shutdown
     SetConsoleCtrlHandler(ConsoleCtrlHandler, TRUE);
 
+    bool scalerSet = false, integerScale = false;
+    ScalerKernel integerKernel = ScalerKernel::Nearest;
     for (int i = 1; i < argc; i++) {
         if (!strcmp(argv[i], "--source") && i+1 < argc) g.sourceMonitor = atoi(argv[++i]);
         else if (!strcmp(argv[i], "--target") && i+1 < argc) g.targetMonitor = atoi(argv[++i]);
-        else if (!strcmp(argv[i], "--stretch")) g.preserveAspect = false;
+        else if (!strcmp(argv[i], "--stretch")) g.fit = ViewportFit::Stretch;
         else if (!strcmp(argv[i], "--no-tonemap")) g.tonemap = false;
-        else if (!strcmp(argv[i], "--sdr-white") && i+1 < argc) g.sdrWhiteNits = (float)atof(argv[++i]);
+        else if (!strcmp(argv[i], "--no-dither")) g.dither = false;
+        else if (!strcmp(argv[i], "--output") && i+1 < argc) {
+            const char* m = argv[++i];
+            g.outputAuto = !strcmp(m, "auto");
+            if (!strcmp(m, "sdr") || g.outputAuto) g.outputMode = OutputMode::Sdr;
+            else if (!strcmp(m, "sdr10")) g.outputMode = OutputMode::Sdr10;
+            else if (!strcmp(m, "scrgb")) g.outputMode = OutputMode::Scrgb;
+            else if (!strcmp(m, "hdr10")) g.outputMode = OutputMode::Hdr10;
+            else { fprintf(stderr, "Unknown output: %s\n", m); return 1; }
+        }
+        else if (!strcmp(argv[i], "--sdr-white") && i+1 < argc) g.tonemapParams.sdrWhiteNits = (float)atof(argv[++i]);
+        else if (!strcmp(argv[i], "--tonemap") && i+1 < argc) {
+            const char* m = argv[++i];
+            if (!ParseTonemapOperator(m, &g.tonemapParams.op)) { fprintf(stderr, "Unknown tonemap operator: %s\n", m); return 1; }
+        }
+        else if (!strcmp(argv[i], "--peak-nits") && i+1 < argc) g.tonemapParams.peakNits = (float)atof(argv[++i]);
+        else if (!strcmp(argv[i], "--tonemap-knee") && i+1 < argc) g.tonemapParams.knee = (float)atof(argv[++i]);
+        else if (!strcmp(argv[i], "--tonemap-exposure") && i+1 < argc) g.tonemapParams.exposure = (float)atof(argv[++i]);
+        else if (!strcmp(argv[i], "--adaptive-peak")) g.adaptivePeak = true;
+        else if (!strcmp(argv[i], "--color-lut") && i+1 < argc) {
+            g.lutSize = atoi(argv[++i]);
+            if (g.lutSize < 2 || g.lutSize > 129) { fprintf(stderr, "--color-lut must be 2..129 (33 or 65 recommended)\n"); return 1; }
+        }
+        else if (!strcmp(argv[i], "--lut-interp") && i+1 < argc) {
+            const char* m = argv[++i];
+            if (!strcmp(m, "tetrahedral")) g.lutInterp = LutInterpolation::Tetrahedral;
+            else if (!strcmp(m, "trilinear")) g.lutInterp = LutInterpolation::Trilinear;
+            else { fprintf(stderr, "Unknown LUT interpolation: %s\n", m); return 1; }
+        }
+        else if (!strcmp(argv[i], "--lut-cache") && i+1 < argc) g.lutCacheDir = argv[++i];
         else if (!strcmp(argv[i], "--debug")) g.debug = true;
+        else if (!strcmp(argv[i], "--full-copy")) g.dirtyRects = false;
+        else if (!strcmp(argv[i], "--capture-downscale")) g.captureDownscale = true;
+        else if (!strcmp(argv[i], "--scaler") && i+1 < argc) {
+            const char* k = argv[++i];
+            if (!ParseScalerKernel(k, &g.scalerKernel)) { fprintf(stderr, "Unknown scaler: %s\n", k); return 1; }
+            scalerSet = true;
+        }
+        else if (!strcmp(argv[i], "--integer-scale") && i+1 < argc) {
+            const char* m = argv[++i];
+            if (!strcmp(m, "exact")) { g.fit = ViewportFit::Integer; integerKernel = ScalerKernel::Nearest; }
+            else if (!strcmp(m, "sharp")) integerKernel = ScalerKernel::SharpBilinear;
+            else { fprintf(stderr, "Unknown integer scale mode: %s\n", m); return 1; }
+            integerScale = true;
+        }
+        else if (!strcmp(argv[i], "--preset") && i+1 < argc) {
+            std::string error;
+            if (!LoadPreset(argv[++i], &g.chain.preset, &error)) { fprintf(stderr, "--preset: %s\n", error.c_str()); return 1; }
+        }
+        else if (!strcmp(argv[i], "--crop") && i+1 < argc) {
+            int x, y, w, h;
+            if (sscanf(argv[++i], "%d,%d,%d,%d", &x, &y, &w, &h) != 4 || x < 0 || y < 0 || w <= 0 || h <= 0) {
+                fprintf(stderr, "--crop expects X,Y,W,H in source pixels\n"); return 1;
+            }
+            g.crop = {x, y, x + w, y + h};
+        }
+        else if (!strcmp(argv[i], "--no-cursor")) g.showPointer = false;
+        else if (!strcmp(argv[i], "--present-mode") && i+1 < argc) {
+            const char* m = argv[++i];
+            if (!strcmp(m, "vsync")) g.presentMode = PresentMode::VSync;
+            else if (!strcmp(m, "waitable")) g.presentMode = PresentMode::Waitable;
+            else if (!strcmp(m, "tearing")) g.presentMode = PresentMode::Tearing;
+            else { fprintf(stderr, "Unknown present mode: %s\n", m); return 1; }
+        }
+        else if (!strcmp(argv[i], "--render-path") && i+1 < argc) {
+            const char* m = argv[++i];
+            if (!strcmp(m, "draw")) g.renderPath = RenderPath::Draw;
+            else if (!strcmp(m, "compute")) g.renderPath = RenderPath::Compute;
+            else { fprintf(stderr, "Unknown render path: %s\n", m); return 1; }
+        }
+        else if (!strcmp(argv[i], "--render-bench")) g.renderBench = true;
+        else if (!strcmp(argv[i], "--yuv-format") && i+1 < argc) {
+            const char* f = argv[++i];
+            if (!ParseYuvFormat(f, &g.yuvFormat)) { fprintf(stderr, "Unknown YUV format: %s\n", f); return 1; }
+            g.convertYuv = true;
+        }
+        else if (!strcmp(argv[i], "--yuv-check")) g.yuvCheck = true;
+        else if (!strcmp(argv[i], "--frame-server") && i+1 < argc) g.frameServerName = argv[++i];
+        else if (!strcmp(argv[i], "--output-pipe") && i+1 < argc) g.outputPipePath = argv[++i];
+        else if (!strcmp(argv[i], "--pipe-format") && i+1 < argc) {
+            const char* f = argv[++i];
+            if (!ParseFramePipeContainer(f, &g.pipeConfig.container)) { fprintf(stderr, "Unknown pipe format: %s\n", f); return 1; }
+        }
+        else if (!strcmp(argv[i], "--pipe-drop") && i+1 < argc) {
+            const char* d = argv[++i];
+            if (!ParseFramePipeDrop(d, &g.pipeConfig.drop)) { fprintf(stderr, "Unknown drop policy: %s\n", d); return 1; }
+        }
+        else if (!strcmp(argv[i], "--pipe-queue") && i+1 < argc) {
+            g.pipeConfig.queueFrames = atoi(argv[++i]);
+            if (g.pipeConfig.queueFrames < 1) { fprintf(stderr, "--pipe-queue needs at least 1 frame\n"); return 1; }
+        }
+        else if (!strcmp(argv[i], "--stream") && i+1 < argc) {
+            const char* target = argv[++i];
+            const char* colon = strrchr(target, ':');
+            g.streamPort = colon ? atoi(colon + 1) : 0;
+            if (!colon || colon == target || g.streamPort < 1 || g.streamPort > 65535) {
+                fprintf(stderr, "--stream needs HOST:PORT, got %s\n", target); return 1;
+            }
+            g.streamHost.assign(target, colon - target);
+        }
+        else if (!strcmp(argv[i], "--stream-slice") && i+1 < argc) {
+            g.streamConfig.sliceRows = atoi(argv[++i]);
+            if (g.streamConfig.sliceRows < 1 || g.streamConfig.sliceRows > 1024) { fprintf(stderr, "--stream-slice must be 1..1024 rows\n"); return 1; }
+        }
+        else if (!strcmp(argv[i], "--stream-fec") && i+1 < argc) {
+            g.streamConfig.fecGroup = atoi(argv[++i]);
+            if (g.streamConfig.fecGroup < 0 || g.streamConfig.fecGroup > 255) { fprintf(stderr, "--stream-fec must be 0..255\n"); return 1; }
+        }
+        else if (!strcmp(argv[i], "--stream-refresh") && i+1 < argc) {
+            g.streamConfig.refreshFrames = atoi(argv[++i]);
+            if (g.streamConfig.refreshFrames < 0) { fprintf(stderr, "--stream-refresh cannot be negative\n"); return 1; }
+        }
+        else if (!strcmp(argv[i], "--stream-mtu") && i+1 < argc) {
+            g.streamConfig.mtu = atoi(argv[++i]);
+            if (g.streamConfig.mtu < 256 || g.streamConfig.mtu > 65000) { fprintf(stderr, "--stream-mtu must be 256..65000\n"); return 1; }
+        }
+        else if (!strcmp(argv[i], "--latch-margin") && i+1 < argc) {
+            g.latchMarginMs = atof(argv[++i]);
+            if (g.latchMarginMs < 0) { fprintf(stderr, "--latch-margin cannot be negative\n"); return 1; }
+        }
+        else if (!strcmp(argv[i], "--idle-timeout") && i+1 < argc) g.idleTimeoutMs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--device-mode") && i+1 < argc) {
+            const char* m = argv[++i];
+            if (!strcmp(m, "legacy")) g.deviceMode = DeviceMode::Legacy;
+            else if (!strcmp(m, "single")) g.deviceMode = DeviceMode::Single;
+            else if (!strcmp(m, "fence")) g.deviceMode = DeviceMode::Fence;
+            else { fprintf(stderr, "Unknown device mode: %s\n", m); return 1; }
+        }
+        else if (!strcmp(argv[i], "--buffers") && i+1 < argc) {
+            g.bufferCount = atoi(argv[++i]);
+            if (g.bufferCount < 3 || g.bufferCount > kMaxCaptureSlots) {
+                fprintf(stderr, "--buffers must be 3..%d\n", kMaxCaptureSlots); return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "--slot-format") && i+1 < argc) {
+            const char* f = argv[++i];
+            if (!ParseSlotFormat(f, &g.slotFormat)) { fprintf(stderr, "Unknown slot format: %s\n", f); return 1; }
+        }
+        else if (!strcmp(argv[i], "--synthetic") && i+1 < argc) {
+            if (!ParseMode(argv[++i], &g.synthetic.width, &g.synthetic.height, &g.synthetic.refreshHz)) return 1;
+            g.useSynthetic = true;
+        }
+        else if (!strcmp(argv[i], "--synthetic-motion") && i+1 < argc) {
+            const char* m = argv[++i];
+            if (!strcmp(m, "static")) g.synthetic.motion = SyntheticMotion::Static;
+            else if (!strcmp(m, "bar")) g.synthetic.motion = SyntheticMotion::Bar;
+            else if (!strcmp(m, "full")) g.synthetic.motion = SyntheticMotion::Full;
+            else { fprintf(stderr, "Unknown motion: %s\n", m); return 1; }
+        }
+        else if (!strcmp(argv[i], "--replay") && i+2 < argc) {
+            g.replayPath = argv[++i];
+            if (!ParseMode(argv[++i], &g.replayWidth, &g.replayHeight, &g.replayHz)) return 1;
+        }
+        else if (!strcmp(argv[i], "--source-format") && i+1 < argc) {
+            const char* f = argv[++i];
+            if (!strcmp(f, "sdr")) g.cpuSourceFormat = FramePixelFormat::BGRA8;
+            else if (!strcmp(f, "hdr")) g.cpuSourceFormat = FramePixelFormat::RGBA16F;
+            else { fprintf(stderr, "Unknown source format: %s\n", f); return 1; }
+        }
         else if (!strcmp(argv[i], "--list")) { PrintMonitors(); return 0; }
         else if (!strcmp(argv[i], "--help") || !strcmp(argv[i], "-h")) { PrintUsage(argv[0]); return 0; }
         else { fprintf(stderr, "Unknown: %s\n", argv[i]); return 1; }
     }
 
+    // --integer-scale picks the filter unless --scaler does
+    if (integerScale && !scalerSet) g.scalerKernel = integerKernel;
+    if (!g.chain.preset.passes.empty()) {
+        // The passes do the scaling; dither noise from the color pass would be scaled up with the source
+        if (scalerSet || g.scalerKernel == ScalerKernel::SharpBilinear) {
+            fprintf(stderr, "--preset scales in its passes and cannot be combined with --scaler or --integer-scale sharp\n"); return 1;
+        }
+        if ((g.outputMode != OutputMode::Sdr && g.outputMode != OutputMode::Sdr10) || g.outputAuto) {
+            fprintf(stderr, "--preset needs --output sdr or sdr10\n"); return 1;
+        }
+        if (g.renderPath == RenderPath::Compute || g.renderBench) {
+            fprintf(stderr, "--preset draws its passes and cannot be combined with --render-path compute or --render-bench\n"); return 1;
+        }
+        g.dither = false;
+    }
+
+    if (g.yuvCheck && !g.convertYuv) { fprintf(stderr, "--yuv-check needs --yuv-format\n"); return 1; }
+    if (g.yuvCheck && g.renderBench) { fprintf(stderr, "--yuv-check and --render-bench are exclusive\n"); return 1; }
+    if (g.outputPipePath && !strcmp(g.outputPipePath, "-")) {
+        // The frame stream keeps the real stdout; everything printed from here on goes to stderr
+        std::string error;
+        g.outputPipeStdout = FramePipe::TakeOverStdout(&error);
+        if (g.outputPipeStdout < 0) { fprintf(stderr, "--output-pipe: %s\n", error.c_str()); return 1; }
+    }
+
+    bool monitorSource = !g.useSynthetic && !g.replayPath;
+    if (g.useSynthetic && g.replayPath) { fprintf(stderr, "--synthetic and --replay are exclusive\n"); return 1; }
+    if (g.adaptivePeak) {
+        TonemapOperator op = g.tonemapParams.op;
+        if (op == TonemapOperator::Reinhard || op == TonemapOperator::Aces) {
+            fprintf(stderr, "--adaptive-peak needs an operator with a peak (bt2390, hable or knee)\n"); return 1;
+        }
+        if (g.lutSize > 0) { fprintf(stderr, "--adaptive-peak cannot be combined with --color-lut\n"); return 1; }
+    }
+    if (g.tonemapParams.op == TonemapOperator::Bt2390 || g.tonemapParams.op == TonemapOperator::Hable ||
+        g.tonemapParams.op == TonemapOperator::Knee) {
+        if (g.tonemapParams.peakNits <= g.tonemapParams.sdrWhiteNits) {
+            fprintf(stderr, "--peak-nits must be above --sdr-white for bt2390, hable and knee\n"); return 1;
+        }
+    }
+    if (g.slotFormat == SlotFormat::Sdr8) {
+        // Tonemapped at capture with the analytic operator and fixed constants
+        if (!g.tonemap || g.outputMode != OutputMode::Sdr || g.outputAuto) {
+            fprintf(stderr, "--slot-format sdr8 needs tonemapping to --output sdr\n"); return 1;
+        }
+        if (g.adaptivePeak || g.lutSize > 0) {
+            fprintf(stderr, "--slot-format sdr8 cannot be combined with --adaptive-peak or --color-lut\n"); return 1;
+        }
+    }
+
     int mc = GetMonitorCount();
-    if (g.sourceMonitor < 0 || g.sourceMonitor >= mc) { fprintf(stderr, "Invalid source\n"); return 1; }
+    if (monitorSource && (g.sourceMonitor < 0 || g.sourceMonitor >= mc)) { fprintf(stderr, "Invalid source\n"); return 1; }
     if (g.targetMonitor < 0 || g.targetMonitor >= mc) { fprintf(stderr, "Invalid target\n"); return 1; }
-    if (g.sourceMonitor == g.targetMonitor) { fprintf(stderr, "Source == target\n"); return 1; }
+    if (monitorSource && g.sourceMonitor == g.targetMonitor) { fprintf(stderr, "Source == target\n"); return 1; }
 
-    GetMonitorRect(g.sourceMonitor, &g.sourceRect);
+    if (monitorSource) {
+        GetMonitorRect(g.sourceMonitor, &g.sourceRect);
+    } else if (g.useSynthetic) {
+        g.synthetic.format = g.cpuSourceFormat;
+        g.sourceRect = {0, 0, (LONG)g.synthetic.width, (LONG)g.synthetic.height};
+    } else {
+        g.sourceRect = {0, 0, (LONG)g.replayWidth, (LONG)g.replayHeight};
+    }
     GetMonitorRect(g.targetMonitor, &g.targetRect);
 
+    LONG sourceW = g.sourceRect.right - g.sourceRect.left, sourceH = g.sourceRect.bottom - g.sourceRect.top;
+    if (g.crop.right == 0) {
+        g.crop = {0, 0, sourceW, sourceH};
+    } else if (g.crop.right > sourceW || g.crop.bottom > sourceH) {
+        fprintf(stderr, "--crop is outside the %ldx%ld source\n", sourceW, sourceH); return 1;
+    }
+
     printf("DXGI Desktop Mirror\n");
-    printf("  Source: %d (%dx%d)\n", g.sourceMonitor,
-           g.sourceRect.right-g.sourceRect.left, g.sourceRect.bottom-g.sourceRect.top);
+    if (g.useSynthetic) {
+        printf("  Source: synthetic %ux%u @ %.2fHz %s\n", g.synthetic.width, g.synthetic.height,
+               g.synthetic.refreshHz, FramePixelFormatName(g.synthetic.format));
+    } else if (g.replayPath) {
+        printf("  Source: replay %s %ux%u @ %.2fHz %s\n", g.replayPath, g.replayWidth, g.replayHeight,
+               g.replayHz, FramePixelFormatName(g.cpuSourceFormat));
+    } else {
+        printf("  Source: %d (%dx%d)\n", g.sourceMonitor,
+               g.sourceRect.right-g.sourceRect.left, g.sourceRect.bottom-g.sourceRect.top);
+    }
     printf("  Target: %d (%dx%d)\n", g.targetMonitor,
            g.targetRect.right-g.targetRect.left, g.targetRect.bottom-g.targetRect.top);
-    printf("  Output: VSync\n");
+    printf("  Output: %s\n", g.presentMode == PresentMode::Waitable ? "VSync (waitable, late latch)" :
+                          g.presentMode == PresentMode::Tearing ? "Tearing (present on capture)" : "VSync");
+    printf("  Device mode: %s\n", DeviceModeName(g.deviceMode));
 
     CreateWindow_();
+    if (g.crop.right - g.crop.left != sourceW || g.crop.bottom - g.crop.top != sourceH) {
+        printf("  Crop: %ldx%ld at %ld,%ld\n", g.crop.right - g.crop.left, g.crop.bottom - g.crop.top, g.crop.left, g.crop.top);
+    }
+    if (integerScale) {
+        printf("  Integer scale: %s, %.0fx%.0f at %.0f,%.0f\n", ScalerKernelName(g.scalerKernel),
+               g.viewport.Width, g.viewport.Height, g.viewport.TopLeftX, g.viewport.TopLeftY);
+    }
     InitD3D();
-    InitDuplication();
+    InitFrameSource();
     InitShaders();
 
     // Triple buffer is initialized by capture thread on first frame
@@ -794,6 +4167,10 @@ int main(int argc, char** argv) {
 
     timeBeginPeriod(1);
 
+    if (g.presentMode == PresentMode::Tearing || g.idleTimeoutMs > 0) {
+        g.frameReadyEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);  // Auto-reset
+    }
+
     g.captureThread = std::thread(CaptureThreadFunc);
 
     // Wait for first frame to initialize buffers (with timeout)
@@ -818,13 +4195,28 @@ int main(int argc, char** argv) {
         return 0;
     }
 
+    if (g.renderBench) {
+        RunRenderBench();
+        Cleanup();
+        return 0;
+    }
+    if (g.yuvCheck) {
+        bool ok = RunYuvCheck();
+        Cleanup();
+        return ok ? 0 : 1;
+    }
+
     printf("\nPress ESC to exit (or CTRL+C).\n\n");
 
     LARGE_INTEGER freq, lastStat, now;
     QueryPerformanceFrequency(&freq);
     QueryPerformanceCounter(&lastStat);
 
-    int outCount = 0, uniqCount = 0, dupCount = 0;
+    int outCount = 0, uniqCount = 0, dupCount = 0, idleCount = 0;
+    uint64_t pipeWritten = 0, pipeDropped = 0;  // --output-pipe totals at the last status line
+    uint64_t streamBytes = 0, streamSlices = 0, streamDropped = 0;  // --stream totals at the last status line
+    int64_t lastActivity = FrameClockNow();
+    double lastCpuSeconds = ProcessCpuSeconds();
 
     MSG msg;
     while (g.running) {
@@ -834,11 +4226,128 @@ int main(int argc, char** argv) {
         }
         if (!g.running) break;
 
-        Render();
-        g.swapChain->Present(1, 0);
+        // Stats first, so idle waits and event timeouts still report every second
+        QueryPerformanceCounter(&now);
+        double statElapsed = (double)(now.QuadPart - lastStat.QuadPart) / freq.QuadPart;
+        if (statElapsed >= 1.0) {
+            int capCount = g.captureCount.exchange(0, std::memory_order_relaxed);
+            int imgUpd = g.imageUpdates.exchange(0, std::memory_order_relaxed);
+            int ptrUpd = g.pointerUpdates.exchange(0, std::memory_order_relaxed);
+            int metaUpd = g.metadataUpdates.exchange(0, std::memory_order_relaxed);
+            int dropCount = capCount > outCount ? capCount - outCount : 0;
+            int64_t copiedPx = g.copiedPixels.exchange(0, std::memory_order_relaxed);
+            int64_t capturedPx = g.capturedPixels.exchange(0, std::memory_order_relaxed);
+            int copyPct = capturedPx ? (int)(copiedPx * 100 / capturedPx) : 0;
+            int64_t copyTicks = g.copyTicks.exchange(0, std::memory_order_relaxed);
+            int copies = g.copyCount.exchange(0, std::memory_order_relaxed);
+            double copyMs = copies ? (double)copyTicks * 1000.0 / freq.QuadPart / copies : 0.0;
+            double copyGpuMs = g.copyGpuUs.exchange(0, std::memory_order_relaxed) / 1000.0 / statElapsed;
+            double cpuSeconds = ProcessCpuSeconds();
+            double cpuPct = (cpuSeconds - lastCpuSeconds) * 100.0 / statElapsed;
+            double gpuMs = g.renderTimer.TakeMs() / statElapsed;
+            lastCpuSeconds = cpuSeconds;
+            LatencyHistogram::Summary capLat = g.captureLatency.TakeSummary();
+            LatencyHistogram::Summary srcLat = g.sourceLatency.TakeSummary();
+            printf("\rOut:%3d Cap:%3d Uniq:%3d Dup:%3d Drop:%3d Idle:%3d Copy:%3d%% %.2fms %.2fms/s Img/Ptr/Meta:%3d/%3d/%3d  "
+                   "Cap>Pres %4.1f/%4.1f/%4.1f/%4.1f  Src>Pres %4.1f/%4.1f/%4.1f/%4.1f ms  CPU:%4.1f%% GPU:%5.2fms/s",
+                   outCount, capCount, uniqCount, dupCount, dropCount, idleCount, copyPct, copyMs, copyGpuMs, imgUpd, ptrUpd, metaUpd,
+                   capLat.p50, capLat.p95, capLat.p99, capLat.max,
+                   srcLat.p50, srcLat.p95, srcLat.p99, srcLat.max, cpuPct, gpuMs);
+            if (g.adaptivePeak && g.luminance.adapter.Valid()) {
+                printf("  Lum avg/peak %.0f/%.0f nits -> %.0f", g.luminance.adapter.AverageNits(),
+                       g.luminance.adapter.PeakNits(), g.adaptedPeakNits);
+            }
+            if (g.presentMode == PresentMode::Waitable) {
+                printf("  Latch %.1fms Miss:%2d", g.scheduler.MarginMs(), g.scheduler.TakeMisses());
+            }
+            if (g.yuv.cs) {
+                double yuvMs = g.yuv.timer.TakeMs();
+                printf("  YUV:%5.0fMpix/s", yuvMs > 0 ? g.yuv.pixels / (yuvMs * 1000.0) : 0.0);
+                g.yuv.pixels = 0;
+            }
+            if (g.readback.IsOpen()) {
+                printf("  Readback skip:%3d", g.readback.dropped.exchange(0, std::memory_order_relaxed));
+                if (g.frameServerName) printf(" Served:%3d", g.readback.served.exchange(0, std::memory_order_relaxed));
+                if (g.outputPipePath) {
+                    FramePipe& pipe = g.readback.pipe;
+                    uint64_t written = pipe.Written(), dropped = pipe.Dropped();
+                    if (pipe.Broken()) {
+                        printf(" Pipe: %s", pipe.Error().c_str());
+                    } else {
+                        printf(" Pipe:%3d Drop:%3d", (int)(written - pipeWritten), (int)(dropped - pipeDropped));
+                    }
+                    pipeWritten = written;
+                    pipeDropped = dropped;
+                }
+                if (!g.streamHost.empty()) {
+                    SliceSender& stream = g.readback.stream;
+                    uint64_t bytes = stream.bytesSent, slices = stream.slicesSent, dropped = stream.framesDropped;
+                    printf(" Stream:%6.1fMbit/s Slices:%5d Drop:%3d", (bytes - streamBytes) * 8 / statElapsed / 1e6,
+                           (int)(slices - streamSlices), (int)(dropped - streamDropped));
+                    streamBytes = bytes;
+                    streamSlices = slices;
+                    streamDropped = dropped;
+                }
+            }
+            printf("   ");
+            fflush(stdout);
+            outCount = uniqCount = dupCount = idleCount = 0;
+            lastStat = now;
+        }
+
+        // Idle mode: with nothing new to show, leave the last presented frame on
+        // screen instead of redrawing it. Follow the target's vblanks for a while,
+        // then block until the capture thread publishes.
+        if (g.idleTimeoutMs > 0 && g.presentMode != PresentMode::Tearing) {
+            bool pending = g.buffer.HasNewFrame() || g.pointer.HasNewFrame();
+            if (!pending && g.lastRenderedId != 0) {
+                idleCount++;
+                if (FrameClockNow() - lastActivity > (int64_t)g.idleTimeoutMs * freq.QuadPart / 1000) {
+                    MsgWaitForMultipleObjects(1, &g.frameReadyEvent, FALSE, 100, QS_ALLINPUT);
+                } else {
+                    WaitForTargetVBlank();
+                }
+                continue;
+            }
+            lastActivity = FrameClockNow();
+        }
+
+        if (g.presentMode == PresentMode::Waitable) WaitForLatch();
+
+        // Tearing mode: sleep until the capture thread publishes, waking for window messages too
+        if (g.presentMode == PresentMode::Tearing) {
+            DWORD r = MsgWaitForMultipleObjects(1, &g.frameReadyEvent, FALSE, 100, QS_ALLINPUT);
+            if (r != WAIT_OBJECT_0) continue;
+        }
+
+        bool newFrame;
+        int slot;
+        {
+            DeviceLock lock;
+            g.renderTimer.Begin(g.context);
+            slot = Render(&newFrame);
+            g.renderTimer.End(g.context);
+        }
+        if (g.presentMode == PresentMode::Tearing) {
+            g.swapChain->Present(g.allowTearing ? 0 : 1, g.allowTearing ? DXGI_PRESENT_ALLOW_TEARING : 0);
+        } else {
+            g.swapChain->Present(1, 0);
+        }
+
+        if (g.presentMode == PresentMode::Waitable) ObservePresentStats();
 
         outCount++;
 
+        // Latency of each frame on its first present
+        if (slot >= 0 && newFrame) {
+            int64_t presentTime = FrameClockNow();
+            const CaptureSlot& shown = g.buffer.slots[slot];
+            g.captureLatency.RecordTicks(presentTime - shown.captureTime, freq.QuadPart);
+            if (shown.sourcePresentTime != 0) {
+                g.sourceLatency.RecordTicks(presentTime - shown.sourcePresentTime, freq.QuadPart);
+            }
+        }
+
         UINT64 currentFrameId = g.captureFrameId.load(std::memory_order_relaxed);
         if (currentFrameId != g.lastRenderedId) {
             uniqCount++;
@@ -846,18 +4355,6 @@ int main(int argc, char** argv) {
         } else {
             dupCount++;
         }
-
-        QueryPerformanceCounter(&now);
-        double statElapsed = (double)(now.QuadPart - lastStat.QuadPart) / freq.QuadPart;
-        if (statElapsed >= 1.0) {
-            int capCount = g.captureCount.exchange(0, std::memory_order_relaxed);
-            int dropCount = capCount > outCount ? capCount - outCount : 0;
-            printf("\rOut:%3d Cap:%3d Uniq:%3d Dup:%3d Drop:%3d   ",
-                   outCount, capCount, uniqCount, dupCount, dropCount);
-            fflush(stdout);
-            outCount = uniqCount = dupCount = 0;
-            lastStat = now;
-        }
     }
 
     timeEndPeriod(1);
@@ -0,0 +1,232 @@
+// Capture -> render pipeline bench at controlled rates (frame_source.h)
+//
+// The desktop-free version of the mirror's two loops: a capture thread pulls
+// frames from a SyntheticFrameSource, copies them into a FrameMailbox slot
+// and publishes; the render thread wakes up at the target rate (FramePacer),
+// acquires the newest slot and reads it. Counters are kept the way main.cpp
+// keeps them and printed once per second in its status line format:
+//
+//   Out   consumer iterations (the target rate)
+//   Cap   frames published (the source rate)
+//   Uniq  iterations that saw a new capture, Dup the ones that did not
+//   Drop  Cap - Out when positive
+//
+// Without --source-hz / --target-hz it runs a set of rate pairs (equal,
+// faster and slower source, non-integer ratios). Each run is checked against
+// the ideal per-second counts (Out = target, Cap = source, Uniq = the lower
+// of the two, Dup and Drop the differences) within --tolerance percent, the
+// first second left out as warm-up. Uniq only follows the capture counter,
+// so the frames the mailbox actually handed over as new must match it, and
+// their ids must only go up. Cap>Pres is the time from publish to the first
+// acquire of each frame. Exits with 1 if a run is off.
+//
+// Build: cl /O2 /EHsc pipeline_bench.cpp    or    g++ -O2 -pthread pipeline_bench.cpp
+//
+// Usage: pipeline-bench [--source-hz F] [--target-hz F] [--seconds S] [--slots 3|4] [--size WxH]
+//                       [--motion static|bar|full] [--tolerance PCT]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "frame_mailbox.h"
+#include "frame_source.h"
+#include "latency_histogram.h"
+
+// Stands in for CaptureSlot: the copied image and when it was published
+struct BenchSlot {
+    std::vector<uint8_t> pixels;
+    uint64_t captureId = 0;
+    int64_t publishTime = 0;
+};
+
+struct BenchConfig {
+    double sourceHz = 60.0, targetHz = 60.0;
+    int seconds = 3;
+    int slots = 3;
+    uint32_t width = 1280, height = 720;
+    SyntheticMotion motion = SyntheticMotion::Bar;
+    double tolerance = 10.0;    // Percent of the ideal per-second counts
+};
+
+struct Counts {
+    double out = 0, cap = 0, uniq = 0, dup = 0, drop = 0, fresh = 0;
+};
+
+static bool Near(double got, double expect, double tolerancePct, double rate) {
+    double slack = rate * tolerancePct / 100.0;
+    return got >= expect - slack - 1.0 && got <= expect + slack + 1.0;    // +-1: a frame on the second's edge
+}
+
+static bool Run(const BenchConfig& c) {
+    static FrameMailbox<BenchSlot, 4> mailbox;
+    mailbox.Reset(c.slots);
+    size_t frameBytes = (size_t)c.width * c.height * 4;
+    for (BenchSlot& s : mailbox.slots) {
+        s.pixels.assign(frameBytes, 0);
+        s.captureId = 0;
+    }
+
+    std::atomic<bool> running{true};
+    std::atomic<uint64_t> captureFrameId{0};
+    std::atomic<int> captureCount{0};
+
+    std::thread capture([&] {
+        SyntheticSourceDesc desc;
+        desc.width = c.width;
+        desc.height = c.height;
+        desc.refreshHz = c.sourceHz;
+        desc.motion = c.motion;
+        SyntheticFrameSource source(desc);
+        while (running.load(std::memory_order_relaxed)) {
+            FrameInfo info;
+            if (source.AcquireFrame(100, &info) != FrameStatus::Ok) continue;
+            BenchSlot& slot = mailbox.slots[mailbox.GetWriteIndex()];
+            // Full copy: the slot may be several frames behind (dirty_region.h
+            // is what the mirror uses to copy less)
+            for (uint32_t y = 0; y < info.height; y++) {
+                memcpy(slot.pixels.data() + (size_t)y * info.width * 4, info.pixels + (size_t)y * info.pitch, info.width * 4);
+            }
+            source.ReleaseFrame();
+            slot.captureId = captureFrameId.fetch_add(1, std::memory_order_relaxed) + 1;
+            slot.publishTime = FrameClockNow();
+            mailbox.PublishFrame();
+            captureCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+
+    printf("%.6g Hz source -> %.6g Hz target, %d slots, %ux%u %s\n", c.sourceHz, c.targetHz, c.slots, c.width, c.height,
+           c.motion == SyntheticMotion::Full ? "full" : (c.motion == SyntheticMotion::Bar ? "bar" : "static"));
+
+    const int64_t freq = FrameClockFrequency();
+    FramePacer pacer;
+    pacer.Start(c.targetHz);
+    LatencyHistogram latency;
+    int outCount = 0, uniqCount = 0, dupCount = 0, freshCount = 0;
+    uint64_t lastRenderedId = 0, lastShownId = 0, backwards = 0, checksum = 0;
+    Counts total;
+    int measured = 0;
+    int64_t lastStat = FrameClockNow();
+    for (int second = 0; second <= c.seconds;) {
+        int64_t now = FrameClockNow();
+        double statElapsed = (double)(now - lastStat) / freq;
+        if (statElapsed >= 1.0) {
+            int capCount = captureCount.exchange(0, std::memory_order_relaxed);
+            int dropCount = capCount > outCount ? capCount - outCount : 0;
+            LatencyHistogram::Summary lat = latency.TakeSummary();
+            printf("  Out:%3d Cap:%3d Uniq:%3d Dup:%3d Drop:%3d  Cap>Pres %4.1f/%4.1f/%4.1f/%4.1f ms%s\n", outCount, capCount,
+                   uniqCount, dupCount, dropCount, lat.p50, lat.p95, lat.p99, lat.max, second == 0 ? "  (warm-up)" : "");
+            if (second > 0) {
+                total.out += outCount / statElapsed;
+                total.cap += capCount / statElapsed;
+                total.uniq += uniqCount / statElapsed;
+                total.dup += dupCount / statElapsed;
+                total.drop += dropCount / statElapsed;
+                total.fresh += freshCount / statElapsed;
+                measured++;
+            }
+            outCount = uniqCount = dupCount = freshCount = 0;
+            lastStat = now;
+            second++;
+            continue;
+        }
+
+        if (!pacer.Wait(100)) continue;
+        bool isNew = false;
+        int index = mailbox.AcquireFrame(&isNew);
+        if (index >= 0) {
+            const BenchSlot& slot = mailbox.slots[index];
+            if (isNew) {
+                latency.RecordTicks(FrameClockNow() - slot.publishTime, freq);
+                if (slot.captureId <= lastShownId) backwards++;
+                lastShownId = slot.captureId;
+                freshCount++;
+            } else if (slot.captureId != lastShownId) {
+                backwards++;    // The displayed slot was rewritten
+            }
+            for (size_t i = 0; i < frameBytes; i += 4096) checksum += slot.pixels[i];    // "Draw": touch every page
+        }
+        outCount++;
+
+        // As main.cpp: a new capture since the last iteration, whichever slot it is in
+        uint64_t currentFrameId = captureFrameId.load(std::memory_order_relaxed);
+        if (currentFrameId != lastRenderedId) {
+            uniqCount++;
+            lastRenderedId = currentFrameId;
+        } else {
+            dupCount++;
+        }
+    }
+    running.store(false, std::memory_order_relaxed);
+    capture.join();
+
+    Counts avg = {total.out / measured, total.cap / measured, total.uniq / measured, total.dup / measured,
+                  total.drop / measured, total.fresh / measured};
+    double shown = c.motion == SyntheticMotion::Static ? 0.0 : c.sourceHz;     // A static source publishes once
+    double lower = shown < c.targetHz ? shown : c.targetHz;
+    Counts ideal = {c.targetHz, shown, lower, c.targetHz - lower, shown > c.targetHz ? shown - c.targetHz : 0.0, lower};
+    double rate = c.sourceHz > c.targetHz ? c.sourceHz : c.targetHz;
+    bool ok = Near(avg.out, ideal.out, c.tolerance, rate) && Near(avg.cap, ideal.cap, c.tolerance, rate) &&
+              Near(avg.uniq, ideal.uniq, c.tolerance, rate) && Near(avg.dup, ideal.dup, c.tolerance, rate) &&
+              Near(avg.drop, ideal.drop, c.tolerance, rate) && Near(avg.fresh, avg.uniq, c.tolerance, rate) && backwards == 0;
+    printf("  avg Out:%5.1f Cap:%5.1f Uniq:%5.1f Dup:%5.1f Drop:%5.1f  New:%5.1f\n", avg.out, avg.cap, avg.uniq, avg.dup,
+           avg.drop, avg.fresh);
+    printf("  ideal   %5.1f     %5.1f      %5.1f     %5.1f      %5.1f      %5.1f  %s(%llu backwards, checksum %llu)\n\n",
+           ideal.out, ideal.cap, ideal.uniq, ideal.dup, ideal.drop, ideal.fresh, ok ? "ok  " : "FAILED ",
+           (unsigned long long)backwards, (unsigned long long)checksum);
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    BenchConfig base;
+    double sourceHz = 0, targetHz = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--source-hz") && i+1 < argc) sourceHz = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--target-hz") && i+1 < argc) targetHz = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--seconds") && i+1 < argc) base.seconds = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--slots") && i+1 < argc) base.slots = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--tolerance") && i+1 < argc) base.tolerance = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--size") && i+1 < argc) {
+            if (sscanf(argv[++i], "%ux%u", &base.width, &base.height) != 2) base.width = 0;
+        } else if (!strcmp(argv[i], "--motion") && i+1 < argc) {
+            const char* m = argv[++i];
+            if (!strcmp(m, "static")) base.motion = SyntheticMotion::Static;
+            else if (!strcmp(m, "bar")) base.motion = SyntheticMotion::Bar;
+            else if (!strcmp(m, "full")) base.motion = SyntheticMotion::Full;
+            else { fprintf(stderr, "Unknown motion: %s\n", m); return 1; }
+        } else {
+            fprintf(stderr, "Usage: %s [--source-hz F] [--target-hz F] [--seconds S] [--slots 3|4] [--size WxH]\n"
+                            "       [--motion static|bar|full] [--tolerance PCT]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (base.width == 0 || base.height == 0 || base.seconds < 1 || base.slots < 3 || base.slots > 4 ||
+        sourceHz < 0 || targetHz < 0 || sourceHz > 1000 || targetHz > 1000) {
+        fprintf(stderr, "Need --size WxH > 0, --seconds >= 1, --slots 3 or 4 and rates in (0, 1000] Hz\n");
+        return 1;
+    }
+
+    std::vector<BenchConfig> runs;
+    if (sourceHz > 0 || targetHz > 0) {
+        BenchConfig c = base;
+        if (sourceHz > 0) c.sourceHz = sourceHz;
+        if (targetHz > 0) c.targetHz = targetHz;
+        runs.push_back(c);
+    } else {
+        const double pairs[][2] = {{60, 60}, {120, 60}, {30, 60}, {50, 60}, {144, 60}, {60, 144}};
+        for (const double* p : pairs) {
+            BenchConfig c = base;
+            c.sourceHz = p[0];
+            c.targetHz = p[1];
+            runs.push_back(c);
+        }
+    }
+
+    bool ok = true;
+    for (const BenchConfig& c : runs) ok = Run(c) && ok;
+    if (!ok) printf("FAILED\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,185 @@
+// Hardware pointer shapes
+//
+// The duplication surface does not contain the hardware cursor, so the
+// pointer is captured separately (GetFramePointerShape) and composited on
+// top. DecodePointerShape turns the three DXGI shape types into two BGRA
+// layers that map onto plain blending:
+//
+//   color   premultiplied BGRA, drawn with "over" (ONE, INV_SRC_ALPHA)
+//   invert  XOR mask, destination is inverted where it is non-zero
+//
+// BlendPointer composites a decoded pointer into a BGRA8 CPU image (exact
+// XOR), with an SSE2 path for the "over" step.
+//
+// Portable C++17.
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define POINTER_SHAPE_SSE2 1
+#endif
+
+// Values match DXGI_OUTDUPL_POINTER_SHAPE_TYPE
+enum class PointerShapeType : uint32_t {
+    Monochrome = 1,     // 1bpp AND mask followed by 1bpp XOR mask (height is doubled)
+    Color = 2,          // 32bpp BGRA, straight alpha
+    MaskedColor = 4,    // 32bpp BGR, alpha byte 0 = replace, 0xFF = XOR
+};
+
+struct PointerShapeInfo {
+    PointerShapeType type = PointerShapeType::Color;
+    uint32_t width = 0, height = 0, pitch = 0;  // As reported by DXGI
+    int32_t hotX = 0, hotY = 0;
+};
+
+struct PointerImage {
+    uint32_t width = 0, height = 0;
+    int32_t hotX = 0, hotY = 0;
+    std::vector<uint32_t> color;    // Premultiplied BGRA
+    std::vector<uint32_t> invert;   // BGRA XOR mask (empty if the shape never inverts)
+};
+
+inline uint32_t PremultiplyBGRA(uint32_t p) {
+    uint32_t a = p >> 24;
+    if (a == 255) return p;
+    if (a == 0) return 0;
+    uint32_t b = ((p & 0xFF) * a + 127) / 255;
+    uint32_t g = (((p >> 8) & 0xFF) * a + 127) / 255;
+    uint32_t r = (((p >> 16) & 0xFF) * a + 127) / 255;
+    return (a << 24) | (r << 16) | (g << 8) | b;
+}
+
+inline bool DecodePointerShape(const uint8_t* data, size_t size, const PointerShapeInfo& info,
+                               PointerImage* out) {
+    uint32_t w = info.width;
+    uint32_t h = info.type == PointerShapeType::Monochrome ? info.height / 2 : info.height;
+    size_t rowBytes = info.type == PointerShapeType::Monochrome ? ((size_t)w + 7) / 8 : (size_t)w * 4;
+    size_t needed = (size_t)info.pitch * info.height;
+    if (w == 0 || h == 0 || info.pitch < rowBytes || size < needed) return false;
+
+    out->width = w;
+    out->height = h;
+    out->hotX = info.hotX;
+    out->hotY = info.hotY;
+    out->color.assign((size_t)w * h, 0);
+    out->invert.clear();
+
+    bool anyInvert = false;
+    std::vector<uint32_t> invert((size_t)w * h, 0);
+
+    if (info.type == PointerShapeType::Monochrome) {
+        for (uint32_t y = 0; y < h; y++) {
+            const uint8_t* andRow = data + (size_t)y * info.pitch;
+            const uint8_t* xorRow = data + (size_t)(y + h) * info.pitch;
+            for (uint32_t x = 0; x < w; x++) {
+                uint8_t bit = (uint8_t)(0x80 >> (x & 7));
+                bool andBit = (andRow[x / 8] & bit) != 0;
+                bool xorBit = (xorRow[x / 8] & bit) != 0;
+                size_t i = (size_t)y * w + x;
+                if (!andBit) {
+                    out->color[i] = xorBit ? 0xFFFFFFFFu : 0xFF000000u;
+                } else if (xorBit) {
+                    invert[i] = 0xFFFFFFFFu;
+                    anyInvert = true;
+                }
+            }
+        }
+    } else if (info.type == PointerShapeType::Color) {
+        for (uint32_t y = 0; y < h; y++) {
+            const uint8_t* row = data + (size_t)y * info.pitch;
+            for (uint32_t x = 0; x < w; x++) {
+                uint32_t p; memcpy(&p, row + x * 4, 4);
+                out->color[(size_t)y * w + x] = PremultiplyBGRA(p);
+            }
+        }
+    } else if (info.type == PointerShapeType::MaskedColor) {
+        for (uint32_t y = 0; y < h; y++) {
+            const uint8_t* row = data + (size_t)y * info.pitch;
+            for (uint32_t x = 0; x < w; x++) {
+                uint32_t p; memcpy(&p, row + x * 4, 4);
+                size_t i = (size_t)y * w + x;
+                if ((p >> 24) == 0) {
+                    out->color[i] = p | 0xFF000000u;
+                } else if (p & 0x00FFFFFFu) {
+                    invert[i] = p | 0xFF000000u;
+                    anyInvert = true;
+                }
+            }
+        }
+    } else {
+        return false;
+    }
+
+    if (anyInvert) out->invert.swap(invert);
+    return true;
+}
+
+// dst * (255 - a) / 255, rounded the same way in both paths
+inline uint32_t BlendOverScalar(uint32_t src, uint32_t dst) {
+    uint32_t inv = 255 - (src >> 24);
+    uint32_t out = 0;
+    for (int c = 0; c < 32; c += 8) {
+        uint32_t t = ((dst >> c) & 0xFF) * inv + 128;
+        t = (t + (t >> 8)) >> 8;
+        uint32_t v = ((src >> c) & 0xFF) + t;
+        out |= (v > 255 ? 255 : v) << c;
+    }
+    return out;
+}
+
+#ifdef POINTER_SHAPE_SSE2
+// Four premultiplied pixels over four destination pixels
+inline __m128i BlendOver4(__m128i src, __m128i dst) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i c255 = _mm_set1_epi16(255);
+    const __m128i c128 = _mm_set1_epi16(128);
+
+    __m128i srcLo = _mm_unpacklo_epi8(src, zero), srcHi = _mm_unpackhi_epi8(src, zero);
+    __m128i dstLo = _mm_unpacklo_epi8(dst, zero), dstHi = _mm_unpackhi_epi8(dst, zero);
+
+    // Broadcast alpha (word 3 of each pixel) to all four channels
+    __m128i aLo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(srcLo, 0xFF), 0xFF);
+    __m128i aHi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(srcHi, 0xFF), 0xFF);
+
+    __m128i tLo = _mm_add_epi16(_mm_mullo_epi16(dstLo, _mm_sub_epi16(c255, aLo)), c128);
+    __m128i tHi = _mm_add_epi16(_mm_mullo_epi16(dstHi, _mm_sub_epi16(c255, aHi)), c128);
+    tLo = _mm_srli_epi16(_mm_add_epi16(tLo, _mm_srli_epi16(tLo, 8)), 8);
+    tHi = _mm_srli_epi16(_mm_add_epi16(tHi, _mm_srli_epi16(tHi, 8)), 8);
+
+    return _mm_packus_epi16(_mm_add_epi16(srcLo, tLo), _mm_add_epi16(srcHi, tHi));
+}
+#endif
+
+// Composites the pointer with its top-left at (x, y) into a BGRA8 image
+inline void BlendPointer(uint8_t* dst, uint32_t dstPitch, uint32_t dstWidth, uint32_t dstHeight,
+                         const PointerImage& ptr, int32_t x, int32_t y) {
+    int32_t x0 = x < 0 ? 0 : x, y0 = y < 0 ? 0 : y;
+    int32_t x1 = x + (int32_t)ptr.width, y1 = y + (int32_t)ptr.height;
+    if (x1 > (int32_t)dstWidth) x1 = (int32_t)dstWidth;
+    if (y1 > (int32_t)dstHeight) y1 = (int32_t)dstHeight;
+    if (x0 >= x1 || y0 >= y1) return;
+
+    for (int32_t py = y0; py < y1; py++) {
+        uint32_t* row = (uint32_t*)(dst + (size_t)py * dstPitch);
+        const uint32_t* src = ptr.color.data() + (size_t)(py - y) * ptr.width + (x0 - x);
+        int32_t px = x0;
+#ifdef POINTER_SHAPE_SSE2
+        for (; px + 4 <= x1; px += 4, src += 4) {
+            __m128i s = _mm_loadu_si128((const __m128i*)src);
+            __m128i d = _mm_loadu_si128((const __m128i*)(row + px));
+            _mm_storeu_si128((__m128i*)(row + px), BlendOver4(s, d));
+        }
+#endif
+        for (; px < x1; px++, src++) row[px] = BlendOverScalar(*src, row[px]);
+
+        if (!ptr.invert.empty()) {
+            const uint32_t* inv = ptr.invert.data() + (size_t)(py - y) * ptr.width + (x0 - x);
+            for (px = x0; px < x1; px++, inv++) row[px] ^= (*inv & 0x00FFFFFFu);
+        }
+    }
+}
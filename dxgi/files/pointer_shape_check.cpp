@@ -0,0 +1,322 @@
+// Pointer shape check (pointer_shape.h)
+//
+//   monochrome   a hand-drawn shape with every AND / XOR combination
+//                (transparent, black, white, invert), 10 pixels wide so the
+//                last byte of each mask row is partial, with garbage in the
+//                pitch padding: decoded layers against the drawing.
+//   color        straight-alpha pixels against hand-computed premultiplied
+//                values.
+//   masked       replace, XOR and no-op pixels against the expected layers.
+//   malformed    short buffers, pitches below the row width, zero sizes and
+//                unknown types are rejected.
+//   over         BlendOverScalar against exact rounding, and the SSE2
+//                BlendOver4 against it, for every alpha, source and
+//                destination byte.
+//   blend        BlendPointer against a per-pixel reference, with the pointer
+//                hanging off every edge and odd widths, so both the SIMD and
+//                the scalar tail run and the padding stays untouched.
+//
+// Exits with 1 on any failure.
+//
+// Build: cl /O2 /EHsc pointer_shape_check.cpp    or    g++ -O2 pointer_shape_check.cpp
+//
+// Usage: pointer-shape-check
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "pointer_shape.h"
+
+static std::string Hex(uint32_t v) {
+    char text[16];
+    snprintf(text, sizeof(text), "%08X", v);
+    return text;
+}
+
+// Compares decoded layers with the expected ones; an expected invert layer
+// of all zero means the decoder must leave it empty
+static void CompareLayers(CaseResult* r, const PointerImage& img, const std::vector<uint32_t>& color,
+                          const std::vector<uint32_t>& invert, uint32_t w) {
+    bool anyInvert = false;
+    for (uint32_t v : invert) anyInvert = anyInvert || v != 0;
+    if (img.color.size() != color.size()) { Fail(r, "color layer size"); return; }
+    if (img.invert.size() != (anyInvert ? invert.size() : 0)) { Fail(r, "invert layer " + std::string(anyInvert ? "missing" : "not empty")); return; }
+    for (size_t i = 0; i < color.size(); i++) {
+        std::string at = " at " + std::to_string(i % w) + "," + std::to_string(i / w);
+        if (img.color[i] != color[i]) { Fail(r, "color " + Hex(img.color[i]) + ", expected " + Hex(color[i]) + at); return; }
+        if (anyInvert && img.invert[i] != invert[i]) { Fail(r, "invert " + Hex(img.invert[i]) + ", expected " + Hex(invert[i]) + at); return; }
+    }
+}
+
+static CaseResult CheckMonochrome() {
+    CaseResult r;
+    r.name = "monochrome";
+    // . transparent (AND 1, XOR 0)   B black (0, 0)   W white (0, 1)   I invert (1, 1)
+    const char* drawing[] = {
+        "B.........",
+        "BB........",
+        "BWB......I",
+        "BWWB....II",
+        "BWWWB..III",
+        "BBBBBB.III",
+        "..........",
+    };
+    const uint32_t w = 10, h = 7, pitch = 4;    // 2 bytes of mask per row, 2 of padding
+    std::vector<uint8_t> data(pitch * h * 2, 0xA5);     // Garbage everywhere the masks don't set
+    std::vector<uint32_t> color(w * h, 0), invert(w * h, 0);
+    for (uint32_t y = 0; y < h; y++) {
+        uint8_t* andRow = &data[y * pitch];
+        uint8_t* xorRow = &data[(y + h) * pitch];
+        andRow[0] = xorRow[0] = 0;
+        andRow[1] = xorRow[1] = 0x25;   // Bits past the width: garbage
+        for (uint32_t x = 0; x < w; x++) {
+            char c = drawing[y][x];
+            bool andBit = c == '.' || c == 'I', xorBit = c == 'W' || c == 'I';
+            uint8_t bit = (uint8_t)(0x80 >> (x & 7));
+            if (andBit) andRow[x / 8] |= bit;
+            if (xorBit) xorRow[x / 8] |= bit;
+            if (c == 'B') color[y * w + x] = 0xFF000000u;
+            if (c == 'W') color[y * w + x] = 0xFFFFFFFFu;
+            if (c == 'I') invert[y * w + x] = 0xFFFFFFFFu;
+        }
+    }
+    PointerShapeInfo info;
+    info.type = PointerShapeType::Monochrome;
+    info.width = w;
+    info.height = h * 2;
+    info.pitch = pitch;
+    info.hotX = 1;
+    info.hotY = 2;
+    PointerImage img;
+    if (!DecodePointerShape(data.data(), data.size(), info, &img)) { Fail(&r, "not decoded"); return r; }
+    if (img.width != w || img.height != h || img.hotX != 1 || img.hotY != 2) Fail(&r, "size or hot spot");
+    CompareLayers(&r, img, color, invert, w);
+
+    // Without any invert pixel the invert layer stays empty
+    for (uint32_t y = 0; y < h; y++) {
+        for (uint32_t x = 0; x < w; x++) {
+            uint8_t bit = (uint8_t)(0x80 >> (x & 7));
+            if (drawing[y][x] == 'I') data[(y + h) * pitch + x / 8] &= (uint8_t)~bit;
+            if (drawing[y][x] == 'I') invert[y * w + x] = 0;
+        }
+    }
+    if (!DecodePointerShape(data.data(), data.size(), info, &img)) Fail(&r, "not decoded without invert");
+    else CompareLayers(&r, img, color, invert, w);
+    if (r.pass) r.detail = "AND/XOR combinations, partial mask bytes and padding";
+    return r;
+}
+
+static CaseResult CheckColor() {
+    CaseResult r;
+    r.name = "color";
+    // Straight alpha in, premultiplied out ((c * a + 127) / 255 per channel)
+    const uint32_t in[] = {0xFF123456, 0x00FFFFFF, 0x80FF8040, 0x01FFFFFF, 0xFE808080, 0x40000000};
+    const uint32_t expect[] = {0xFF123456, 0x00000000, 0x80804020, 0x01010101, 0xFE7F7F7F, 0x40000000};
+    const uint32_t w = 3, h = 2, pitch = 16;
+    std::vector<uint8_t> data(pitch * h, 0xEE);
+    for (uint32_t i = 0; i < w * h; i++) memcpy(&data[(i / w) * pitch + (i % w) * 4], &in[i], 4);
+    PointerShapeInfo info;
+    info.type = PointerShapeType::Color;
+    info.width = w;
+    info.height = h;
+    info.pitch = pitch;
+    PointerImage img;
+    if (!DecodePointerShape(data.data(), data.size(), info, &img)) { Fail(&r, "not decoded"); return r; }
+    CompareLayers(&r, img, std::vector<uint32_t>(expect, expect + w * h), std::vector<uint32_t>(w * h, 0), w);
+    if (r.pass) r.detail = "premultiplied, no invert layer";
+    return r;
+}
+
+static CaseResult CheckMasked() {
+    CaseResult r;
+    r.name = "masked";
+    // Alpha byte 0: replace with the opaque color; any other: XOR with the
+    // color (black XOR is a no-op)
+    const uint32_t in[] = {0x00123456, 0xFF000000, 0xFFFFFFFF, 0x00000000, 0xFF00FF00, 0x00FFFFFF, 0x80123456, 0x01000000};
+    const uint32_t color[] = {0xFF123456, 0, 0, 0xFF000000, 0, 0xFFFFFFFF, 0, 0};
+    const uint32_t invert[] = {0, 0, 0xFFFFFFFF, 0, 0xFF00FF00, 0, 0xFF123456, 0};
+    const uint32_t w = 2, h = 4, pitch = 8;
+    std::vector<uint8_t> data(pitch * h);
+    memcpy(data.data(), in, sizeof(in));
+    PointerShapeInfo info;
+    info.type = PointerShapeType::MaskedColor;
+    info.width = w;
+    info.height = h;
+    info.pitch = pitch;
+    PointerImage img;
+    if (!DecodePointerShape(data.data(), data.size(), info, &img)) { Fail(&r, "not decoded"); return r; }
+    CompareLayers(&r, img, std::vector<uint32_t>(color, color + w * h), std::vector<uint32_t>(invert, invert + w * h), w);
+    if (r.pass) r.detail = "replace, XOR and no-op pixels";
+    return r;
+}
+
+static CaseResult CheckMalformed() {
+    CaseResult r;
+    r.name = "malformed";
+    std::vector<uint8_t> data(4 * 4 * 4, 0);
+    PointerImage img;
+    PointerShapeInfo info;
+    info.width = 4;
+    info.height = 4;
+    info.pitch = 16;
+    info.type = PointerShapeType::Color;
+    if (DecodePointerShape(data.data(), data.size() - 1, info, &img)) Fail(&r, "short color buffer accepted");
+    info.type = PointerShapeType::Monochrome;
+    info.pitch = 1;
+    info.height = 1;    // Half a row of AND mask, no XOR mask
+    if (DecodePointerShape(data.data(), data.size(), info, &img)) Fail(&r, "monochrome shape of height 1 accepted");
+    info.height = 8;
+    if (DecodePointerShape(data.data(), 7, info, &img)) Fail(&r, "short monochrome buffer accepted");
+    info.type = (PointerShapeType)3;
+    info.pitch = 16;
+    info.height = 4;
+    if (DecodePointerShape(data.data(), data.size(), info, &img)) Fail(&r, "unknown type accepted");
+    info.type = PointerShapeType::Color;
+    info.width = 0;
+    if (DecodePointerShape(data.data(), data.size(), info, &img)) Fail(&r, "zero width accepted");
+    // Rows narrower than the width: the buffer covers pitch * height, the
+    // decoder would read past it
+    info.width = 4;
+    info.pitch = 12;
+    size_t size = (size_t)info.pitch * info.height;
+    if (DecodePointerShape(data.data(), size, info, &img)) Fail(&r, "color pitch below width * 4 accepted");
+    info.type = PointerShapeType::MaskedColor;
+    if (DecodePointerShape(data.data(), size, info, &img)) Fail(&r, "masked color pitch below width * 4 accepted");
+    info.type = PointerShapeType::Monochrome;
+    info.width = 16;
+    info.pitch = 1;
+    info.height = 8;
+    size = (size_t)info.pitch * info.height;
+    if (DecodePointerShape(data.data(), size, info, &img)) Fail(&r, "monochrome pitch below the mask row accepted");
+    if (r.pass) r.detail = "short buffers, short pitches, zero sizes and unknown types rejected";
+    return r;
+}
+
+static CaseResult CheckOver() {
+    CaseResult r;
+    r.name = "over";
+    // Scalar against exact rounding of d * (255 - a) / 255, one channel at a time
+    for (uint32_t a = 0; a < 256 && r.pass; a++) {
+        for (uint32_t d = 0; d < 256; d++) {
+            uint32_t t = (d * (255 - a) * 2 + 255) / 510;
+            uint32_t out = BlendOverScalar(a << 24, d);
+            if ((out & 0xFF) != t) {
+                Fail(&r, "scalar: a " + std::to_string(a) + " d " + std::to_string(d) + " gives " + std::to_string(out & 0xFF));
+                break;
+            }
+        }
+    }
+#ifdef POINTER_SHAPE_SSE2
+    // SSE2 against scalar: every alpha, source and destination byte, with
+    // the source also above alpha (not premultiplied) to exercise the clamp
+    uint64_t compared = 0;
+    for (uint32_t a = 0; a < 256 && r.pass; a++) {
+        for (uint32_t s = 0; s < 256 && r.pass; s++) {
+            uint32_t src = a << 24 | s << 16 | (s ^ 0x5A) << 8 | (255 - s);
+            for (uint32_t d = 0; d < 256; d += 4) {
+                uint32_t dst[4], out[4];
+                for (int k = 0; k < 4; k++) {
+                    uint32_t v = d + k;
+                    dst[k] = (v ^ 0x33) << 24 | v << 16 | (255 - v) << 8 | (v * 7 & 0xFF);
+                }
+                __m128i vs = _mm_set1_epi32((int)src);
+                _mm_storeu_si128((__m128i*)out, BlendOver4(vs, _mm_loadu_si128((const __m128i*)dst)));
+                for (int k = 0; k < 4; k++) {
+                    compared++;
+                    if (out[k] != BlendOverScalar(src, dst[k])) {
+                        Fail(&r, "SSE2 " + Hex(out[k]) + ", scalar " + Hex(BlendOverScalar(src, dst[k])) + " for " +
+                             Hex(src) + " over " + Hex(dst[k]));
+                        break;
+                    }
+                }
+                if (!r.pass) break;
+            }
+        }
+    }
+    if (r.pass) r.detail = "scalar exact, SSE2 equal to scalar for " + std::to_string(compared) + " pixels";
+#else
+    if (r.pass) r.detail = "scalar exact (no SSE2 in this build)";
+#endif
+    return r;
+}
+
+static uint32_t Random(uint32_t* state) {
+    *state ^= *state << 13; *state ^= *state >> 17; *state ^= *state << 5;
+    return *state;
+}
+
+static CaseResult CheckBlend() {
+    CaseResult r;
+    r.name = "blend";
+    uint32_t rng = 0x1234567;
+    const uint32_t dw = 37, dh = 23, dpitch = dw * 4 + 12;     // Padding after each row must stay as is
+    int placements = 0;
+    const uint32_t sizes[][2] = {{1, 1}, {3, 5}, {7, 4}, {16, 16}, {32, 32}, {13, 29}};
+    for (const uint32_t* size : sizes) {
+        PointerImage ptr;
+        ptr.width = size[0];
+        ptr.height = size[1];
+        ptr.color.resize(ptr.width * ptr.height);
+        for (uint32_t& p : ptr.color) {
+            uint32_t straight = Random(&rng);
+            if ((straight >> 24) < 64) straight &= 0x00FFFFFF;          // Some fully transparent
+            else if ((straight >> 24) > 192) straight |= 0xFF000000;    // Some opaque
+            p = PremultiplyBGRA(straight);
+        }
+        bool withInvert = size[0] % 2 == 1;
+        if (withInvert) {
+            ptr.invert.resize(ptr.color.size());
+            for (uint32_t& p : ptr.invert) p = Random(&rng) % 3 == 0 ? Random(&rng) | 0xFF000000u : 0;
+        }
+        const int32_t xs[] = {-(int32_t)ptr.width, -(int32_t)ptr.width + 1, -2, 0, 5, (int32_t)dw - (int32_t)ptr.width,
+                              (int32_t)dw - 3, (int32_t)dw};
+        const int32_t ys[] = {-(int32_t)ptr.height + 1, -1, 0, 9, (int32_t)dh - 2, (int32_t)dh};
+        for (int32_t x : xs) {
+            for (int32_t y : ys) {
+                std::vector<uint8_t> dst(dpitch * dh);
+                for (uint8_t& b : dst) b = (uint8_t)Random(&rng);
+                std::vector<uint8_t> expect = dst;
+                for (int32_t py = 0; py < (int32_t)dh; py++) {
+                    for (int32_t px = 0; px < (int32_t)dw; px++) {
+                        int32_t sx = px - x, sy = py - y;
+                        if (sx < 0 || sy < 0 || sx >= (int32_t)ptr.width || sy >= (int32_t)ptr.height) continue;
+                        uint32_t d;
+                        memcpy(&d, &expect[py * dpitch + px * 4], 4);
+                        d = BlendOverScalar(ptr.color[sy * ptr.width + sx], d);
+                        if (withInvert) d ^= ptr.invert[sy * ptr.width + sx] & 0x00FFFFFFu;
+                        memcpy(&expect[py * dpitch + px * 4], &d, 4);
+                    }
+                }
+                BlendPointer(dst.data(), dpitch, dw, dh, ptr, x, y);
+                placements++;
+                if (dst != expect) {
+                    Fail(&r, std::to_string(ptr.width) + "x" + std::to_string(ptr.height) + " pointer at " +
+                         std::to_string(x) + "," + std::to_string(y) + " differs from the reference");
+                    return r;
+                }
+            }
+        }
+    }
+    r.detail = std::to_string(placements) + " placements equal to the reference";
+    return r;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        fprintf(stderr, "Usage: %s\n", argv[0]);
+        return 1;
+    }
+    std::vector<CaseResult> results;
+    results.push_back(CheckMonochrome());
+    results.push_back(CheckColor());
+    results.push_back(CheckMasked());
+    results.push_back(CheckMalformed());
+    results.push_back(CheckOver());
+    results.push_back(CheckBlend());
+
+    return ReportResults(results, 12);
+}
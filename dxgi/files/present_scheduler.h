@@ -0,0 +1,106 @@
+// Late-latching present scheduler
+//
+// Predicts the next vblank from observed vblank timestamps and tells the
+// render loop how long it can wait before acquiring the newest captured
+// frame: latch = next vblank - margin. The margin adapts - it grows quickly
+// when a present misses its vblank and decays slowly back towards the
+// configured value while presents land on time.
+//
+// No clock of its own: every call takes the current time in ticks, so the
+// same code runs against QPC in the mirror and a simulated clock in tests.
+//
+// Portable C++17.
+
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "frame_source.h"
+
+class PresentScheduler {
+public:
+    // Largest margin at a refresh rate: 3/4 of the period, the most a miss can grow it to
+    static double MaxMarginMs(double refreshHz) { return 750.0 / (refreshHz > 0 ? refreshHz : 60.0); }
+
+    // The margin is clamped to [0, MaxMarginMs]
+    void Configure(int64_t ticksPerSecond, double refreshHz, double marginMs) {
+        freq = ticksPerSecond;
+        period = (int64_t)(freq / (refreshHz > 0 ? refreshHz : 60.0));
+        maxMargin = period * 3 / 4;
+        baseMargin = margin = std::min(std::max(MsToTicks(marginMs), (int64_t)0), maxMargin);
+        lastVBlank = 0;
+    }
+
+    // A vblank was observed at time t (frame statistics or waitable wake-up)
+    void OnVBlank(int64_t t) {
+        if (lastVBlank != 0 && t > lastVBlank) {
+            int64_t delta = t - lastVBlank;
+            int64_t n = (delta + period / 2) / period;   // Vblanks elapsed
+            if (n >= 1 && n <= 8) {
+                // Slow EMA so a noisy observation cannot drag the phase around
+                int64_t observed = delta / n;
+                period += (observed - period) / 16;
+            }
+        }
+        lastVBlank = t;
+    }
+
+    // Whether the last present made its vblank
+    void OnPresentResult(bool missed) {
+        if (missed) {
+            misses++;
+            margin += MsToTicks(0.5);
+            if (margin > maxMargin) margin = maxMargin;
+        } else if (margin > baseMargin) {
+            margin -= MsToTicks(0.01);
+            if (margin < baseMargin) margin = baseMargin;
+        }
+    }
+
+    // First predicted vblank after now
+    int64_t NextVBlank(int64_t now) const {
+        if (lastVBlank == 0) return now + period;
+        if (now < lastVBlank) return lastVBlank;
+        int64_t n = (now - lastVBlank) / period + 1;
+        return lastVBlank + n * period;
+    }
+
+    // When to acquire the newest frame for the upcoming vblank. If that moment
+    // has already passed, latch immediately.
+    int64_t LatchTime(int64_t now) const {
+        int64_t t = NextVBlank(now) - margin;
+        return t > now ? t : now;
+    }
+
+    int64_t Period() const { return period; }
+    double MarginMs() const { return (double)margin * 1000.0 / freq; }
+    int TakeMisses() { int m = misses; misses = 0; return m; }
+
+private:
+    int64_t MsToTicks(double ms) const { return (int64_t)(ms * freq / 1000.0); }
+
+    int64_t freq = 1;
+    int64_t period = 1;
+    int64_t margin = 0, baseMargin = 0, maxMargin = 0;
+    int64_t lastVBlank = 0;
+    int misses = 0;
+};
+
+// Sleeps until the frame clock reaches t: coarse sleep, then spin the last
+// stretch (OS sleeps are only ~1ms accurate even with timeBeginPeriod(1))
+inline void SleepUntilTicks(int64_t t) {
+    const int64_t freq = FrameClockFrequency();
+    const int64_t spin = freq * 3 / 2000;   // 1.5ms
+    for (;;) {
+        int64_t now = FrameClockNow();
+        if (now >= t) return;
+        if (t - now > spin) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
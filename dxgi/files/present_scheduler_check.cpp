@@ -0,0 +1,237 @@
+// Present scheduler (present_scheduler.h) check on a simulated clock
+//
+// Drives PresentScheduler the way the waitable render loop does, against a
+// display whose vblanks are known exactly. Each frame the loop wakes up a
+// little after a vblank and the scheduler sees an observation of it: the
+// wake-up time itself, or with frame statistics the vblank's own timestamp.
+// Then it is asked for the latch time, and the frame is rendered for a set
+// cost from there. It made its vblank if it finished by the true one.
+//
+//   steady     configured at 60 Hz, the display runs at 59.94 Hz, observed
+//              at wake-up (0.1-0.5 ms late): the period converges and no
+//              frame misses after the warm-up.
+//   gaps       frame statistics, one in 8 missing: the period and the
+//              prediction hold.
+//   overrun    the render cost exceeds the margin: the margin grows until
+//              the misses stop, then decays back to the configured value
+//              once the cost drops.
+//   cap        a cost longer than the period: the margin stops at 3/4 of it.
+//   clamp      a configured margin of two periods or a negative one is
+//              clamped by Configure, the upper one to MaxMarginMs (the
+//              bound main checks --latch-margin against).
+//
+// Prints the period error, the vblank prediction error (p50/p99/max), the
+// misses and the margin for each case. Exits with 1 on any failure.
+//
+// Build: cl /O2 /EHsc present_scheduler_check.cpp    or    g++ -O2 present_scheduler_check.cpp
+//
+// Usage: present-scheduler-check
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "present_scheduler.h"
+
+const int64_t kFreq = 10000000;     // Simulated ticks per second (QPC's usual rate)
+
+static double TicksToMs(int64_t t) { return (double)t * 1000.0 / kFreq; }
+static int64_t MsToTicks(double ms) { return (int64_t)llround(ms * kFreq / 1000.0); }
+
+struct Display {
+    double refreshHz = 59.94;
+    double wakeMinMs = 0.1;     // The loop wakes up wakeMinMs..wakeMaxMs after each vblank
+    double wakeMaxMs = 0.5;
+    bool frameStats = false;    // Observe the vblank's timestamp instead of the wake-up
+    double statsJitterMs = 0.02;
+    int skipEvery = 0;          // Frame statistics: lose every n-th one, 0 = none
+};
+
+// One simulated run; the render cost can change per frame
+struct Simulation {
+    PresentScheduler scheduler;
+    Display display;
+    int64_t truePeriod = 0;
+    int64_t frame = 0;          // Vblanks elapsed
+    uint32_t rng = 0x9E3779B9;
+    std::vector<double> predictionErrorMs;
+    int misses = 0;
+
+    Simulation(const Display& d, double configuredHz, double marginMs) : display(d) {
+        truePeriod = (int64_t)llround(kFreq / d.refreshHz);
+        scheduler.Configure(kFreq, configuredHz, marginMs);
+    }
+
+    int64_t VBlank(int64_t n) const { return kFreq + n * truePeriod; }
+
+    double Uniform() {
+        rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+        return (rng >> 8) * (1.0 / (1 << 24));
+    }
+
+    // Runs frames with the given render cost; returns the misses among them
+    int Run(int frames, double costMs) {
+        int before = misses;
+        for (int k = 0; k < frames; k++, frame++) {
+            int64_t now = VBlank(frame) + MsToTicks(display.wakeMinMs + Uniform() * (display.wakeMaxMs - display.wakeMinMs));
+            if (!display.frameStats) {
+                scheduler.OnVBlank(now);
+            } else if (display.skipEvery == 0 || frame % display.skipEvery != 0) {
+                scheduler.OnVBlank(VBlank(frame) + MsToTicks((Uniform() * 2.0 - 1.0) * display.statsJitterMs));
+            }
+            int64_t target = VBlank(frame + 1);
+            int64_t predicted = scheduler.NextVBlank(now);
+            if (frame >= 64) predictionErrorMs.push_back(fabs(TicksToMs(predicted - target)));
+            int64_t done = scheduler.LatchTime(now) + MsToTicks(costMs);
+            bool missed = done > target;
+            if (missed) misses++;
+            scheduler.OnPresentResult(missed);
+        }
+        return misses - before;
+    }
+
+    double PeriodErrorMs() const { return fabs(TicksToMs(scheduler.Period() - truePeriod)); }
+
+    std::string Describe() {
+        std::vector<double> e = predictionErrorMs;
+        std::sort(e.begin(), e.end());
+        double p50 = e.empty() ? 0 : e[e.size() / 2], p99 = e.empty() ? 0 : e[e.size() * 99 / 100];
+        double max = e.empty() ? 0 : e.back();
+        char text[160];
+        snprintf(text, sizeof(text), "period error %.3f ms, prediction %.2f/%.2f/%.2f ms, %d misses, margin %.2f ms",
+                 PeriodErrorMs(), p50, p99, max, misses, scheduler.MarginMs());
+        return text;
+    }
+};
+
+// The prediction can be off by the error of the last observation plus the
+// period error accumulated since it
+static void CheckPrediction(CaseResult* r, Simulation& sim, double slackMs) {
+    double max = 0;
+    for (double e : sim.predictionErrorMs) max = std::max(max, e);
+    double observationMs = sim.display.frameStats ? sim.display.statsJitterMs : sim.display.wakeMaxMs;
+    if (max > observationMs + slackMs) {
+        Fail(r, "vblank prediction off by " + std::to_string(max) + " ms");
+    }
+}
+
+static CaseResult CheckSteady() {
+    CaseResult r;
+    r.name = "steady";
+    Simulation sim(Display(), 60.0, 2.0);
+    sim.Run(120, 1.0);
+    sim.misses = 0;
+    int misses = sim.Run(1200, 1.0);
+    if (sim.PeriodErrorMs() > 0.1) Fail(&r, "period did not converge: " + sim.Describe());
+    if (misses) Fail(&r, std::to_string(misses) + " misses with 1 ms of slack: " + sim.Describe());
+    CheckPrediction(&r, sim, 0.15);
+    if (r.pass) r.detail = sim.Describe();
+    return r;
+}
+
+static CaseResult CheckGaps() {
+    CaseResult r;
+    r.name = "gaps";
+    Display d;
+    d.frameStats = true;
+    d.skipEvery = 8;
+    Simulation sim(d, 60.0, 2.0);
+    sim.Run(120, 1.0);
+    sim.misses = 0;
+    int misses = sim.Run(1200, 1.0);
+    if (sim.PeriodErrorMs() > 0.1) Fail(&r, "period did not converge: " + sim.Describe());
+    if (misses) Fail(&r, std::to_string(misses) + " misses with 1 ms of slack: " + sim.Describe());
+    CheckPrediction(&r, sim, 0.1);      // Two periods of error after a lost observation
+    if (r.pass) r.detail = sim.Describe();
+    return r;
+}
+
+static CaseResult CheckOverrun() {
+    CaseResult r;
+    r.name = "overrun";
+    Simulation sim(Display(), 60.0, 2.0);
+    sim.Run(120, 1.0);
+    // 3 ms of rendering against a 2 ms margin: the first frames miss, then
+    // the margin settles a little above the cost, missing now and then as
+    // it decays back under it
+    int firstSecond = sim.Run(60, 3.0);
+    int settled = sim.Run(600, 3.0);
+    double grownMs = sim.scheduler.MarginMs();
+    if (firstSecond == 0) Fail(&r, "no misses with the cost above the margin");
+    if (settled > 600 / 20) Fail(&r, std::to_string(settled) + " of 600 frames missed after the margin grew");
+    if (grownMs < 3.0) Fail(&r, "margin only grew to " + std::to_string(grownMs) + " ms");
+    // Back to 1 ms: 0.01 ms of decay per frame on time
+    int after = sim.Run(300, 1.0);
+    if (after) Fail(&r, std::to_string(after) + " misses after the cost dropped");
+    if (fabs(sim.scheduler.MarginMs() - 2.0) > 0.001) {
+        Fail(&r, "margin did not decay back to 2 ms: " + std::to_string(sim.scheduler.MarginMs()));
+    }
+    if (r.pass) {
+        char text[160];
+        snprintf(text, sizeof(text), "%d misses in the first second, %d in the next 600 frames at %.2f ms, back to %.2f ms",
+                 firstSecond, settled, grownMs, sim.scheduler.MarginMs());
+        r.detail = text;
+    }
+    return r;
+}
+
+static CaseResult CheckCap() {
+    CaseResult r;
+    r.name = "cap";
+    Simulation sim(Display(), 60.0, 2.0);
+    sim.Run(120, 1.0);
+    double maxMs = 0;
+    for (int k = 0; k < 300; k++) {
+        sim.Run(1, 20.0);
+        maxMs = std::max(maxMs, sim.scheduler.MarginMs());
+    }
+    double capMs = TicksToMs(sim.scheduler.Period()) * 3 / 4;
+    if (maxMs > capMs + 0.001) Fail(&r, "margin reached " + std::to_string(maxMs) + " ms, cap " + std::to_string(capMs));
+    if (maxMs < capMs - 0.5) Fail(&r, "margin stopped at " + std::to_string(maxMs) + " ms, below the cap");
+    if (r.pass) {
+        char text[96];
+        snprintf(text, sizeof(text), "margin held at %.2f ms (3/4 of %.2f ms)", maxMs, TicksToMs(sim.scheduler.Period()));
+        r.detail = text;
+    }
+    return r;
+}
+
+static CaseResult CheckClamp() {
+    CaseResult r;
+    r.name = "clamp";
+    PresentScheduler s;
+    const double hz[] = {60.0, 144.0, 0.0};     // 0: unknown, taken as 60
+    for (double h : hz) {
+        double periodMs = 1000.0 / (h > 0 ? h : 60.0);
+        s.Configure(kFreq, h, periodMs * 2);
+        if (s.MarginMs() > periodMs * 3 / 4 + 0.001) Fail(&r, "margin of two periods kept at " + std::to_string(h) + " Hz");
+        if (fabs(s.MarginMs() - PresentScheduler::MaxMarginMs(h)) > 0.001) Fail(&r, "MaxMarginMs differs from the clamp");
+        s.Configure(kFreq, h, -1.0);
+        if (s.MarginMs() != 0.0) Fail(&r, "negative margin kept at " + std::to_string(h) + " Hz");
+        s.Configure(kFreq, h, 2.0);
+        if (fabs(s.MarginMs() - 2.0) > 0.001) Fail(&r, "2 ms margin changed at " + std::to_string(h) + " Hz");
+        int64_t now = kFreq * 5;
+        if (s.LatchTime(now) < now || s.LatchTime(now) > s.NextVBlank(now)) Fail(&r, "latch outside [now, next vblank]");
+    }
+    if (r.pass) r.detail = "margins outside [0, 3/4 period] clamped";
+    return r;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        fprintf(stderr, "Usage: %s\n", argv[0]);
+        return 1;
+    }
+    std::vector<CaseResult> results;
+    results.push_back(CheckSteady());
+    results.push_back(CheckGaps());
+    results.push_back(CheckOverrun());
+    results.push_back(CheckCap());
+    results.push_back(CheckClamp());
+
+    return ReportResults(results, 10);
+}
@@ -0,0 +1,331 @@
+// Post-processing presets (--preset): a chain of pixel shader passes drawn
+// after the color pass, e.g. sharpening, scanlines and a CRT mask for
+// emulator output.
+//
+// A preset is a text file of key = value lines, '#' starts a comment. The
+// keys follow RetroArch's .slangp where they overlap:
+//
+//   shaders = 3
+//   shader0 = cas               built-in pass, or an HLSL file (relative to the preset)
+//   scale_type0 = source        source (default), viewport or absolute
+//   scale0 = 1.0                or scale_x0 / scale_y0; pixels for absolute
+//   filter_linear0 = false      how the pass samples its input (default: true)
+//   params0 = 0.6, 0.2          up to four floats (PassParams in the shader)
+//   pointwise0 = true           reads its input only at its own pixel
+//
+// The last pass draws into the window, so it is viewport-scaled at 1.0.
+// Built-in passes (kBuiltinPasses) know whether they are pointwise and have
+// default parameters; their HLSL lives in main.cpp (g_ChainPasses).
+//
+// PlanChain turns a preset into draws for concrete sizes. A pointwise pass
+// at the same size as the pass before it is fused into that draw (the
+// shader calls the previous pass instead of sampling a texture), so it
+// costs no extra render target round-trip. Intermediate targets come from a
+// pool: a draw writes a target of its size that nothing still reads.
+//
+// Portable C++17.
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+
+const int kMaxPresetPasses = 8;
+
+enum class PassScaleType {
+    Source,     // Relative to the pass's input
+    Viewport,   // Relative to the window's viewport
+    Absolute,   // In pixels
+};
+
+struct BuiltinPass {
+    const char* name;
+    bool pointwise;
+    float params[4];
+    const char* description;
+};
+
+const BuiltinPass kBuiltinPasses[] = {
+    {"stock", true, {}, "passthrough (rescale with its filter)"},
+    {"scanlines", true, {0.5f, 0.0f, 0.0f, 0.0f}, "darkens between input lines; x = depth"},
+    {"crt-mask", true, {0.3f, 0.0f, 0.0f, 0.0f}, "aperture grille in output pixels; x = strength"},
+    {"cas", false, {0.5f, 0.0f, 0.0f, 0.0f}, "contrast adaptive sharpening; x = sharpness 0..1"},
+};
+
+inline const BuiltinPass* FindBuiltinPass(const std::string& name) {
+    for (const BuiltinPass& b : kBuiltinPasses) {
+        if (name == b.name) return &b;
+    }
+    return nullptr;
+}
+
+struct PresetPass {
+    std::string shader;         // Built-in name, or the file path as resolved
+    std::string source;         // File contents; empty for built-ins
+    bool builtin = false;
+    PassScaleType scaleType = PassScaleType::Source;
+    float scaleX = 1.0f, scaleY = 1.0f;
+    bool filterLinear = true;
+    bool pointwise = false;
+    float params[4] = {};
+};
+
+struct Preset {
+    std::string path;
+    std::vector<PresetPass> passes;
+};
+
+// Reads a whole file; false if it cannot be opened
+inline bool ReadTextFile(const std::string& path, std::string* text) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    text->clear();
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) text->append(buf, n);
+    fclose(f);
+    return true;
+}
+
+namespace preset_detail {
+
+inline std::string Trim(const std::string& s) {
+    size_t a = s.find_first_not_of(" \t\r\n"), b = s.find_last_not_of(" \t\r\n");
+    if (a == std::string::npos) return "";
+    std::string t = s.substr(a, b - a + 1);
+    if (t.size() >= 2 && t.front() == '"' && t.back() == '"') t = t.substr(1, t.size() - 2);
+    return t;
+}
+
+inline bool ParseFloat(const std::string& s, float* v) {
+    char* end;
+    *v = strtof(s.c_str(), &end);
+    return !s.empty() && *end == '\0' && isfinite(*v);
+}
+
+inline bool ParseBool(const std::string& s, bool* v) {
+    if (s == "true" || s == "1") *v = true;
+    else if (s == "false" || s == "0") *v = false;
+    else return false;
+    return true;
+}
+
+// "scale_x2" -> ("scale_x", 2); keys without a pass index return -1
+inline int SplitKey(const std::string& key, std::string* base) {
+    size_t i = key.size();
+    while (i > 0 && key[i - 1] >= '0' && key[i - 1] <= '9') i--;
+    *base = key.substr(0, i);
+    if (i == key.size() || key.size() - i > 2) return -1;
+    return atoi(key.c_str() + i);
+}
+
+inline bool IsAbsolutePath(const std::string& p) {
+    return !p.empty() && (p[0] == '/' || p[0] == '\\' || (p.size() > 1 && p[1] == ':'));
+}
+
+}  // namespace preset_detail
+
+// Parses preset text; file passes are resolved against dir and read. On
+// failure *error says why (with the line for syntax errors).
+inline bool ParsePreset(const std::string& text, const std::string& dir, Preset* preset, std::string* error) {
+    using namespace preset_detail;
+    struct Seen { bool shader, scaleType, scale, pointwise, params; };
+    std::vector<PresetPass> passes(kMaxPresetPasses);
+    std::vector<Seen> seen(kMaxPresetPasses, Seen{});
+    int count = -1;
+    char msg[160];
+
+    size_t pos = 0;
+    for (int line = 1; pos < text.size(); line++) {
+        size_t end = text.find('\n', pos);
+        if (end == std::string::npos) end = text.size();
+        std::string s = text.substr(pos, end - pos);
+        pos = end + 1;
+        size_t hash = s.find('#');
+        if (hash != std::string::npos) s.resize(hash);
+        if (Trim(s).empty()) continue;
+
+        size_t eq = s.find('=');
+        if (eq == std::string::npos) {
+            snprintf(msg, sizeof(msg), "line %d: expected key = value", line);
+            *error = msg;
+            return false;
+        }
+        std::string key = Trim(s.substr(0, eq)), value = Trim(s.substr(eq + 1)), base;
+        int i = SplitKey(key, &base);
+        auto fail = [&](const char* what) {
+            snprintf(msg, sizeof(msg), "line %d: %s: %s", line, key.c_str(), what);
+            *error = msg;
+            return false;
+        };
+
+        if (key == "shaders") {
+            float n;
+            if (!ParseFloat(value, &n) || n != floorf(n) || n < 1 || n > kMaxPresetPasses) {
+                return fail("expected 1..8 passes");
+            }
+            count = (int)n;
+            continue;
+        }
+        if (i < 0 || i >= kMaxPresetPasses) return fail("unknown key");
+        PresetPass& p = passes[i];
+        if (base == "shader") {
+            if (value.empty()) return fail("empty shader");
+            p.shader = value;
+            seen[i].shader = true;
+        } else if (base == "scale_type") {
+            if (value == "source") p.scaleType = PassScaleType::Source;
+            else if (value == "viewport") p.scaleType = PassScaleType::Viewport;
+            else if (value == "absolute") p.scaleType = PassScaleType::Absolute;
+            else return fail("expected source, viewport or absolute");
+            seen[i].scaleType = true;
+        } else if (base == "scale" || base == "scale_x" || base == "scale_y") {
+            float v;
+            if (!ParseFloat(value, &v) || v <= 0.0f) return fail("expected a positive number");
+            if (base != "scale_y") p.scaleX = v;
+            if (base != "scale_x") p.scaleY = v;
+            seen[i].scale = true;
+        } else if (base == "filter_linear") {
+            if (!ParseBool(value, &p.filterLinear)) return fail("expected true or false");
+        } else if (base == "pointwise") {
+            if (!ParseBool(value, &p.pointwise)) return fail("expected true or false");
+            seen[i].pointwise = true;
+        } else if (base == "params") {
+            int n = 0;
+            size_t a = 0;
+            while (a <= value.size()) {
+                size_t b = value.find(',', a);
+                if (b == std::string::npos) b = value.size();
+                if (n == 4 || !ParseFloat(Trim(value.substr(a, b - a)), &p.params[n])) {
+                    return fail("expected up to four comma-separated numbers");
+                }
+                n++;
+                a = b + 1;
+            }
+            for (; n < 4; n++) p.params[n] = 0.0f;
+            seen[i].params = true;
+        } else {
+            return fail("unknown key");
+        }
+    }
+
+    if (count < 0) { *error = "missing shaders = N"; return false; }
+    for (int i = count; i < kMaxPresetPasses; i++) {
+        if (seen[i].shader) {
+            snprintf(msg, sizeof(msg), "shader%d is past shaders = %d", i, count);
+            *error = msg;
+            return false;
+        }
+    }
+
+    preset->passes.clear();
+    for (int i = 0; i < count; i++) {
+        PresetPass p = passes[i];
+        if (!seen[i].shader) {
+            snprintf(msg, sizeof(msg), "shader%d is missing", i);
+            *error = msg;
+            return false;
+        }
+        bool last = i == count - 1;
+        if (last && !seen[i].scaleType && !seen[i].scale) p.scaleType = PassScaleType::Viewport;
+        if (last && (p.scaleType != PassScaleType::Viewport || p.scaleX != 1.0f || p.scaleY != 1.0f)) {
+            snprintf(msg, sizeof(msg), "shader%d draws into the window and must be viewport-scaled at 1.0", i);
+            *error = msg;
+            return false;
+        }
+        if (p.scaleType == PassScaleType::Absolute && (p.scaleX < 1.0f || p.scaleY < 1.0f)) {
+            snprintf(msg, sizeof(msg), "shader%d: absolute scale is in pixels", i);
+            *error = msg;
+            return false;
+        }
+
+        if (const BuiltinPass* b = FindBuiltinPass(p.shader)) {
+            p.builtin = true;
+            if (!seen[i].pointwise) p.pointwise = b->pointwise;
+            if (!seen[i].params) memcpy(p.params, b->params, sizeof(p.params));
+        } else {
+            if (!IsAbsolutePath(p.shader) && !dir.empty()) p.shader = dir + "/" + p.shader;
+            if (!ReadTextFile(p.shader, &p.source)) {
+                snprintf(msg, sizeof(msg), "shader%d: cannot read %s", i, p.shader.c_str());
+                *error = msg;
+                return false;
+            }
+        }
+        preset->passes.push_back(p);
+    }
+    return true;
+}
+
+inline bool LoadPreset(const std::string& path, Preset* preset, std::string* error) {
+    std::string text;
+    if (!ReadTextFile(path, &text)) { *error = "cannot read " + path; return false; }
+    size_t slash = path.find_last_of("/\\");
+    preset->path = path;
+    return ParsePreset(text, slash == std::string::npos ? "" : path.substr(0, slash), preset, error);
+}
+
+// One draw: passes [firstPass, lastPass] fused into a single shader
+struct ChainDraw {
+    int firstPass, lastPass;
+    int inputWidth, inputHeight;    // What firstPass samples
+    int width, height;              // Output size
+    int input;                      // Pool target read, -1 = the color pass output (Original)
+    int output;                     // Pool target written, -1 = the window
+};
+
+struct ChainPlan {
+    std::vector<ChainDraw> draws;
+    std::vector<int> targetWidth, targetHeight;     // The pool
+};
+
+inline int PassOutputSize(PassScaleType type, float scale, int input, int viewport) {
+    double v = type == PassScaleType::Source ? input * (double)scale
+             : type == PassScaleType::Viewport ? viewport * (double)scale : scale;
+    int n = (int)floor(v + 0.5);
+    return n < 1 ? 1 : n;
+}
+
+// Sizes every pass from the color pass output (originalW x originalH) and
+// the viewport, fuses, and assigns pool targets
+inline ChainPlan PlanChain(const Preset& preset, int originalW, int originalH, int viewportW, int viewportH) {
+    ChainPlan plan;
+    int w = originalW, h = originalH;
+    for (int i = 0; i < (int)preset.passes.size(); i++) {
+        const PresetPass& p = preset.passes[i];
+        int ow = PassOutputSize(p.scaleType, p.scaleX, w, viewportW);
+        int oh = PassOutputSize(p.scaleType, p.scaleY, h, viewportH);
+        if (!plan.draws.empty() && p.pointwise && ow == w && oh == h) {
+            plan.draws.back().lastPass = i;
+        } else {
+            plan.draws.push_back({i, i, w, h, ow, oh, -1, -1});
+        }
+        w = ow;
+        h = oh;
+    }
+
+    std::vector<bool> busy;
+    int input = -1;
+    for (size_t d = 0; d < plan.draws.size(); d++) {
+        ChainDraw& draw = plan.draws[d];
+        draw.input = input;
+        if (d + 1 < plan.draws.size()) {
+            int t = 0;
+            while (t < (int)busy.size() && (busy[t] || plan.targetWidth[t] != draw.width ||
+                                            plan.targetHeight[t] != draw.height)) t++;
+            if (t == (int)busy.size()) {
+                busy.push_back(false);
+                plan.targetWidth.push_back(draw.width);
+                plan.targetHeight.push_back(draw.height);
+            }
+            busy[t] = true;
+            draw.output = t;
+        }
+        if (input >= 0) busy[input] = false;     // Read for the last time by this draw
+        input = draw.output;
+    }
+    return plan;
+}
@@ -0,0 +1,151 @@
+// Preset loader and chain planner check (preset.h)
+//
+// Without arguments, runs the built-in cases: valid presets must plan into
+// the expected draws (fusion) and pool targets (reuse), invalid ones must
+// fail with the expected message. With preset files, loads each and prints
+// its plan for --size (color pass output : viewport), so a preset can be
+// checked before it is handed to --preset. Exits with 1 on any failure.
+//
+// Plans are printed one draw per '|': passes, input size -> output size,
+// then the pool targets read and written (O = color pass output, W = window).
+//
+// Build: cl /O2 /EHsc preset_check.cpp    or    g++ -O2 preset_check.cpp
+//
+// Usage: preset-check [--size WxH:WxH] [PRESET]...
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "preset.h"
+
+static std::string DescribePlan(const ChainPlan& plan) {
+    std::string s;
+    char buf[96];
+    for (const ChainDraw& d : plan.draws) {
+        char in[16] = "O", out[16] = "W";
+        if (d.input >= 0) snprintf(in, sizeof(in), "T%d", d.input);
+        if (d.output >= 0) snprintf(out, sizeof(out), "T%d", d.output);
+        if (d.firstPass == d.lastPass) snprintf(buf, sizeof(buf), "%d ", d.firstPass);
+        else snprintf(buf, sizeof(buf), "%d-%d ", d.firstPass, d.lastPass);
+        s += (s.empty() ? "" : " | ") + std::string(buf);
+        snprintf(buf, sizeof(buf), "%dx%d->%dx%d %s>%s", d.inputWidth, d.inputHeight, d.width, d.height, in, out);
+        s += buf;
+    }
+    return s;
+}
+
+struct Case {
+    const char* name;
+    const char* text;
+    int originalW, originalH, viewportW, viewportH;
+    const char* expect;     // Plan, or the error message's distinctive part
+};
+
+// Valid presets first: expect is the plan
+const Case kCases[] = {
+    {"crt", "shaders = 3\nshader0 = cas\nshader1 = scanlines\nscale_type1 = viewport\nshader2 = crt-mask\n",
+     256, 224, 1024, 896, "0 256x224->256x224 O>T0 | 1-2 256x224->1024x896 T0>W"},
+    {"fused prescale", "shaders = 2\nshader0 = stock\nscale0 = 4\nfilter_linear0 = false\nshader1 = scanlines\n",
+     256, 224, 1024, 896, "0-1 256x224->1024x896 O>W"},
+    {"ping-pong", "shaders = 4\nshader0 = cas\nshader1 = cas\nshader2 = cas\nshader3 = cas\n",
+     640, 480, 640, 480, "0 640x480->640x480 O>T0 | 1 640x480->640x480 T0>T1 | 2 640x480->640x480 T1>T0 | "
+                         "3 640x480->640x480 T0>W"},
+    {"sizes", "shaders = 4\nshader0 = cas\nshader1 = stock\nscale1 = 2\nshader2 = cas\nshader3 = stock\n",
+     256, 224, 1920, 1080, "0 256x224->256x224 O>T0 | 1 256x224->512x448 T0>T1 | 2 512x448->512x448 T1>T2 | "
+                           "3 512x448->1920x1080 T2>W"},
+    {"absolute", "# comment\nshaders = \"2\"\nshader0 = \"stock\"  # trailing\nscale_type0 = absolute\n"
+                 "scale_x0 = 320\nscale_y0 = 240\nshader1 = crt-mask\n",
+     256, 224, 1280, 960, "0 256x224->320x240 O>T0 | 1 320x240->1280x960 T0>W"},
+    {"not pointwise", "shaders = 2\nshader0 = stock\nscale_type0 = viewport\nshader1 = crt-mask\npointwise1 = false\n",
+     256, 224, 1024, 896, "0 256x224->1024x896 O>T0 | 1 1024x896->1024x896 T0>W"},
+};
+
+// Invalid presets: expect is part of the error
+const Case kErrorCases[] = {
+    {"no count", "shader0 = stock\n", 0, 0, 0, 0, "missing shaders"},
+    {"too many", "shaders = 9\n", 0, 0, 0, 0, "expected 1..8"},
+    {"missing pass", "shaders = 2\nshader0 = stock\n", 0, 0, 0, 0, "shader1 is missing"},
+    {"past count", "shaders = 1\nshader0 = stock\nshader1 = stock\n", 0, 0, 0, 0, "past shaders"},
+    {"last scaled", "shaders = 1\nshader0 = stock\nscale_type0 = source\n", 0, 0, 0, 0, "viewport-scaled"},
+    {"unknown key", "shaders = 1\nshader0 = stock\nwrap_mode0 = clamp\n", 0, 0, 0, 0, "line 3: wrap_mode0: unknown"},
+    {"bad bool", "shaders = 1\nshader0 = stock\nfilter_linear0 = yes\n", 0, 0, 0, 0, "true or false"},
+    {"bad scale", "shaders = 2\nshader0 = stock\nscale0 = -1\nshader1 = stock\n", 0, 0, 0, 0, "positive"},
+    {"bad type", "shaders = 2\nshader0 = stock\nscale_type0 = original\nshader1 = stock\n", 0, 0, 0, 0, "absolute"},
+    {"five params", "shaders = 1\nshader0 = cas\nparams0 = 1, 2, 3, 4, 5\n", 0, 0, 0, 0, "four"},
+    {"no equals", "shaders = 1\nshader0 stock\n", 0, 0, 0, 0, "line 2: expected key = value"},
+    {"missing file", "shaders = 1\nshader0 = no-such-pass.hlsl\n", 0, 0, 0, 0, "cannot read"},
+};
+
+int main(int argc, char** argv) {
+    int originalW = 256, originalH = 224, viewportW = 1024, viewportH = 896;
+    std::vector<const char*> files;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--size") && i+1 < argc) {
+            if (sscanf(argv[++i], "%dx%d:%dx%d", &originalW, &originalH, &viewportW, &viewportH) != 4 ||
+                originalW <= 0 || originalH <= 0 || viewportW <= 0 || viewportH <= 0) {
+                fprintf(stderr, "Invalid size (expected WxH:WxH)\n");
+                return 1;
+            }
+        }
+        else if (argv[i][0] != '-') files.push_back(argv[i]);
+        else {
+            fprintf(stderr, "Usage: %s [--size WxH:WxH] [PRESET]...\n", argv[0]);
+            return 1;
+        }
+    }
+
+    bool ok = true;
+    if (!files.empty()) {
+        for (const char* path : files) {
+            Preset preset;
+            std::string error;
+            if (!LoadPreset(path, &preset, &error)) {
+                printf("%s: %s\n", path, error.c_str());
+                ok = false;
+                continue;
+            }
+            ChainPlan plan = PlanChain(preset, originalW, originalH, viewportW, viewportH);
+            printf("%s: %zu passes, %zu draws, %zu targets\n  %s\n", path, preset.passes.size(), plan.draws.size(),
+                   plan.targetWidth.size(), DescribePlan(plan).c_str());
+        }
+        return ok ? 0 : 1;
+    }
+
+    printf("%-16s %s\n", "case", "result");
+    for (const Case& c : kCases) {
+        Preset preset;
+        std::string error, plan;
+        bool parsed = ParsePreset(c.text, "", &preset, &error);
+        if (parsed) plan = DescribePlan(PlanChain(preset, c.originalW, c.originalH, c.viewportW, c.viewportH));
+        bool pass = parsed && plan == c.expect;
+        printf("%-16s %s%s\n", c.name, parsed ? plan.c_str() : error.c_str(), pass ? "" : "  FAILED");
+        if (!pass) {
+            printf("%-16s expected %s\n", "", c.expect);
+            ok = false;
+        }
+    }
+    for (const Case& c : kErrorCases) {
+        Preset preset;
+        std::string error;
+        bool parsed = ParsePreset(c.text, "", &preset, &error);
+        bool pass = !parsed && error.find(c.expect) != std::string::npos;
+        printf("%-16s %s%s\n", c.name, parsed ? "(accepted)" : error.c_str(), pass ? "" : "  FAILED");
+        if (!pass) ok = false;
+    }
+
+    // Built-in defaults apply unless the preset sets them
+    Preset preset;
+    std::string error;
+    bool pass = ParsePreset("shaders = 2\nshader0 = cas\nparams0 = 0.8\nshader1 = scanlines\npointwise1 = false\n", "",
+                            &preset, &error) &&
+                preset.passes[0].params[0] == 0.8f && preset.passes[0].params[1] == 0.0f &&
+                preset.passes[1].params[0] == FindBuiltinPass("scanlines")->params[0] && !preset.passes[1].pointwise &&
+                !preset.passes[0].pointwise && preset.passes[0].builtin;
+    printf("%-16s %s\n", "defaults", pass ? "params and pointwise as set" : "FAILED");
+    if (!pass) ok = false;
+
+    if (!ok) printf("\nFAILED\n");
+    return ok ? 0 : 1;
+}
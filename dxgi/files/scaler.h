@@ -0,0 +1,270 @@
+// Render-side scaling kernels (--scaler)
+//
+//   nearest    the source pixel under the destination pixel's center
+//   bilinear   triangle over 2x2 source pixels, what the hardware sampler does
+//   bicubic    Catmull-Rom (B=0, C=1/2), 4 taps per axis
+//   lanczos3   3-lobe windowed sinc, 6 taps per axis
+//   area       box as wide as a destination pixel, weighted by coverage
+//   sharp-bilinear  nearest up to the integer part of the zoom, then bilinear
+//              for the remainder: pixel art stays crisp at any size
+//
+// nearest and bilinear are a single draw with a point or linear sampler,
+// sharp-bilinear one bilinear tap at a shifted position.
+// The others run separably on the GPU: a horizontal pass filters the slot
+// into an FP16 target as wide as the viewport, and the vertical pass is
+// folded into the color pass (g_SourceSample in main.cpp). When downscaling,
+// bicubic and lanczos3 are stretched by the scale factor so they still
+// low-pass the source; area does so by construction. Like the sampler, all
+// of them filter the stored values (sRGB for SDR slots, scRGB for HDR).
+//
+// BuildScalerTaps turns a kernel into per-axis taps for SeparableResampler,
+// the CPU SIMD version (downscale.h). ScaleReference evaluates the 2D kernel
+// per destination pixel in double precision and is the golden model both
+// are checked against (scaler-bench).
+//
+// FitViewport places the (cropped) source in the window: stretched, aspect
+// fit, or at the largest integer multiple that fits (--integer-scale).
+//
+// Portable C++17.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+#include "downscale.h"
+
+enum class ScalerKernel {
+    Nearest,
+    Bilinear,
+    Bicubic,
+    Lanczos3,
+    Area,
+    SharpBilinear,
+};
+
+const int kScalerKernelCount = 6;
+
+inline const char* ScalerKernelName(ScalerKernel k) {
+    switch (k) {
+        case ScalerKernel::Nearest: return "nearest";
+        case ScalerKernel::Bilinear: return "bilinear";
+        case ScalerKernel::Bicubic: return "bicubic";
+        case ScalerKernel::Lanczos3: return "lanczos3";
+        case ScalerKernel::Area: return "area";
+        case ScalerKernel::SharpBilinear: return "sharp-bilinear";
+    }
+    return "?";
+}
+
+inline bool ParseScalerKernel(const char* name, ScalerKernel* k) {
+    for (int i = 0; i < kScalerKernelCount; i++) {
+        if (!strcmp(name, ScalerKernelName((ScalerKernel)i))) { *k = (ScalerKernel)i; return true; }
+    }
+    return false;
+}
+
+// Kernels that need the two-pass path (the rest are a sampler)
+inline bool ScalerIsSeparable(ScalerKernel k) {
+    return k == ScalerKernel::Bicubic || k == ScalerKernel::Lanczos3 || k == ScalerKernel::Area;
+}
+
+// Kernels that are just a sampler state (no constants, no frame shader variants)
+inline bool ScalerIsHardware(ScalerKernel k) {
+    return k == ScalerKernel::Nearest || k == ScalerKernel::Bilinear;
+}
+
+// Integer part of the zoom, at least 1 (sharp-bilinear's prescale)
+inline double SharpBilinearPrescale(double scale) {
+    double n = floor(1.0 / scale + 1e-6);
+    return n < 1.0 ? 1.0 : n;
+}
+
+// sharp-bilinear tap position for destination pixel i, in source pixel
+// centers: inside each prescaled pixel the position snaps to the source
+// pixel, only the band at its edge (one destination pixel wide) blends
+inline double SharpBilinearCenter(double scale, int i) {
+    double n = SharpBilinearPrescale(scale);
+    double texel = (i + 0.5) * scale;
+    double range = 0.5 - 0.5 / n;
+    double d = texel - floor(texel) - 0.5;
+    double f = (d - std::min(std::max(d, -range), range)) * n + 0.5;
+    return floor(texel) + f - 0.5;
+}
+
+// Value at x source pixels from the tap center (bilinear, bicubic, lanczos3)
+inline double ScalerKernelValue(ScalerKernel k, double x) {
+    x = fabs(x);
+    switch (k) {
+        case ScalerKernel::Bilinear:
+            return x < 1.0 ? 1.0 - x : 0.0;
+        case ScalerKernel::Bicubic:
+            if (x < 1.0) return (1.5 * x - 2.5) * x * x + 1.0;
+            if (x < 2.0) return ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;
+            return 0.0;
+        case ScalerKernel::Lanczos3: {
+            if (x < 1e-8) return 1.0;
+            if (x >= 3.0) return 0.0;
+            double px = 3.14159265358979323846 * x;
+            return 3.0 * sin(px) * sin(px / 3.0) / (px * px);
+        }
+        default:
+            return 0.0;
+    }
+}
+
+inline double ScalerKernelRadius(ScalerKernel k) {
+    switch (k) {
+        case ScalerKernel::Bicubic: return 2.0;
+        case ScalerKernel::Lanczos3: return 3.0;
+        default: return 1.0;
+    }
+}
+
+// Kernel units per source pixel: bicubic and lanczos3 widen when downscaling
+inline double ScalerStretch(ScalerKernel k, double scale) {
+    bool widen = k == ScalerKernel::Bicubic || k == ScalerKernel::Lanczos3;
+    return widen && scale > 1.0 ? scale : 1.0;
+}
+
+// Source pixels [*lo, *hi] that destination pixel i may read, before clamping
+// to the image; scale is source pixels per destination pixel
+inline void ScalerTapRange(ScalerKernel k, double scale, int i, int* lo, int* hi) {
+    if (k == ScalerKernel::Nearest) {
+        *lo = *hi = (int)floor((i + 0.5) * scale);
+    } else if (k == ScalerKernel::Area) {
+        *lo = (int)floor(i * scale);
+        *hi = (int)ceil((i + 1) * scale) - 1;
+    } else if (k == ScalerKernel::SharpBilinear) {
+        *lo = (int)floor(SharpBilinearCenter(scale, i));
+        *hi = *lo + 1;
+    } else {
+        double c = (i + 0.5) * scale - 0.5;
+        double support = ScalerKernelRadius(k) * ScalerStretch(k, scale);
+        *lo = (int)floor(c - support) + 1;
+        *hi = (int)ceil(c + support) - 1;
+    }
+}
+
+// Unnormalized weight of source pixel j for destination pixel i
+inline double ScalerTapWeight(ScalerKernel k, double scale, int i, int j) {
+    if (k == ScalerKernel::Nearest) return j == (int)floor((i + 0.5) * scale) ? 1.0 : 0.0;
+    if (k == ScalerKernel::Area) {
+        double a = i * scale, b = (i + 1) * scale;
+        double cover = (j + 1 < b ? j + 1 : b) - (j > a ? j : a);
+        return cover > 0.0 ? cover : 0.0;
+    }
+    if (k == ScalerKernel::SharpBilinear) return ScalerKernelValue(ScalerKernel::Bilinear, j - SharpBilinearCenter(scale, i));
+    double c = (i + 0.5) * scale - 0.5;
+    return ScalerKernelValue(k, (j - c) / ScalerStretch(k, scale));
+}
+
+// Taps past the edges fold onto the border pixel (clamp addressing), then
+// each destination pixel's weights are normalized to sum to 1
+inline void BuildScalerTaps(ScalerKernel k, int srcSize, int dstSize, FilterTaps* t) {
+    t->first.resize(dstSize);
+    t->count.resize(dstSize);
+    t->offset.resize(dstSize);
+    t->weights.clear();
+    t->maxCount = 0;
+    double scale = (double)srcSize / dstSize;
+    std::vector<double> w;
+    for (int i = 0; i < dstSize; i++) {
+        int lo, hi;
+        ScalerTapRange(k, scale, i, &lo, &hi);
+        int first = std::max(lo, 0), last = std::min(hi, srcSize - 1);
+        first = std::min(first, srcSize - 1);
+        last = std::max(last, first);
+        w.assign(last - first + 1, 0.0);
+        double sum = 0.0;
+        for (int j = lo; j <= hi; j++) {
+            double v = ScalerTapWeight(k, scale, i, j);
+            w[std::min(std::max(j, first), last) - first] += v;
+            sum += v;
+        }
+        t->first[i] = first;
+        t->count[i] = (int)w.size();
+        t->offset[i] = (int)t->weights.size();
+        for (double v : w) t->weights.push_back((float)(v / sum));
+        if (t->count[i] > t->maxCount) t->maxCount = t->count[i];
+    }
+}
+
+class ImageScaler : public SeparableResampler {
+public:
+    void Configure(ScalerKernel k, FramePixelFormat f, int sw, int sh, int dw, int dh) {
+        FilterTaps x, y;
+        BuildScalerTaps(k, sw, dw, &x);
+        BuildScalerTaps(k, sh, dh, &y);
+        tapsPerPixel = (double)x.weights.size() / dw + (double)y.weights.size() / dh;
+        SeparableResampler::Configure(f, sw, sh, dw, dh, x, y, false);
+    }
+
+    double tapsPerPixel = 0;    // Horizontal plus vertical, on average
+};
+
+// Each destination pixel summed over the 2D product of its taps, clamped at
+// the edges and normalized, in double precision on the stored values
+inline void ScaleReference(ScalerKernel k, FramePixelFormat format, const uint8_t* src, size_t srcPitch, int srcW,
+                           int srcH, uint8_t* dst, size_t dstPitch, int dstW, int dstH) {
+    double sx = (double)srcW / dstW, sy = (double)srcH / dstH;
+    for (int y = 0; y < dstH; y++) {
+        int ylo, yhi;
+        ScalerTapRange(k, sy, y, &ylo, &yhi);
+        for (int x = 0; x < dstW; x++) {
+            int xlo, xhi;
+            ScalerTapRange(k, sx, x, &xlo, &xhi);
+            double sum[4] = {}, total = 0.0;
+            for (int j = ylo; j <= yhi; j++) {
+                double wy = ScalerTapWeight(k, sy, y, j);
+                const uint8_t* row = src + (size_t)std::min(std::max(j, 0), srcH - 1) * srcPitch;
+                for (int i = xlo; i <= xhi; i++) {
+                    double w = wy * ScalerTapWeight(k, sx, x, i);
+                    int ci = std::min(std::max(i, 0), srcW - 1);
+                    for (int c = 0; c < 4; c++) {
+                        double v = format == FramePixelFormat::BGRA8 ? row[ci * 4 + c] / 255.0
+                                                                     : HalfToFloat(((const uint16_t*)row)[ci * 4 + c]);
+                        sum[c] += w * v;
+                    }
+                    total += w;
+                }
+            }
+            uint8_t* out = dst + (size_t)y * dstPitch;
+            for (int c = 0; c < 4; c++) {
+                float v = (float)(sum[c] / total);
+                if (format == FramePixelFormat::BGRA8) out[x * 4 + c] = (uint8_t)(Saturate(v) * 255.0f + 0.5f);
+                else ((uint16_t*)out)[x * 4 + c] = FloatToHalf(v);
+            }
+        }
+    }
+}
+
+enum class ViewportFit {
+    Stretch,
+    Aspect,
+    Integer,    // Falls back to Aspect when the source is larger than the window
+};
+
+struct ViewportRect {
+    float x, y, width, height;
+};
+
+// Centered placement of a srcW x srcH image in a dstW x dstH window, in whole pixels
+inline ViewportRect FitViewport(ViewportFit fit, int srcW, int srcH, int dstW, int dstH) {
+    ViewportRect v = {0.0f, 0.0f, (float)dstW, (float)dstH};
+    int n = std::min(dstW / srcW, dstH / srcH);
+    if (fit == ViewportFit::Integer && n >= 1) {
+        v.width = (float)(n * srcW);
+        v.height = (float)(n * srcH);
+    } else if (fit != ViewportFit::Stretch) {
+        float srcAspect = (float)srcW / srcH, dstAspect = (float)dstW / dstH;
+        if (srcAspect > dstAspect) v.height = floorf(dstW / srcAspect + 0.5f);
+        else v.width = floorf(dstH * srcAspect + 0.5f);
+    }
+    v.x = floorf((dstW - v.width) / 2 + 0.5f);
+    v.y = floorf((dstH - v.height) / 2 + 0.5f);
+    return v;
+}
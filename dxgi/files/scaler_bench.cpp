@@ -0,0 +1,251 @@
+// Render scaler kernel check and cost per resolution pair
+//
+// Scales a synthetic desktop-like frame (zone plate, one-pixel lines and
+// text-sized checkers, an HDR ramp with specular dots for RGBA16F) with every
+// --scaler kernel (scaler.h), for each source -> destination pair. Reports
+// the average taps per destination pixel (horizontal plus vertical), the
+// ImageScaler (SIMD) throughput in destination Mpix/s and ms per frame, and
+// the largest difference from ScaleReference, the double-precision golden
+// model. Exits with 1 if any kernel differs from it by more than one 8-bit
+// step or one half-float ULP. Half-float values within 2^-12 of each other
+// (0.02 nits) count as equal: bicubic and lanczos3 subtract lobes, and next
+// to the 1000-nit dots the float sums cannot resolve ULPs near black.
+//
+// --dump DIR writes the BGRA8 results as binary PPMs named
+// <kernel>_<src>_<dst>.ppm; --golden DIR compares against such a set (from
+// an earlier build, or GPU captures saved the same way) with the same limit.
+//
+// Build: cl /O2 /EHsc /arch:AVX2 scaler_bench.cpp    or    g++ -O2 -mf16c scaler_bench.cpp
+//
+// Usage: scaler-bench [--pair WxH:WxH]... [--kernel NAME] [--dump DIR] [--golden DIR]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "scaler.h"
+#include "tonemap.h"
+
+struct Image {
+    FramePixelFormat format;
+    int width = 0, height = 0;
+    size_t pitch = 0;
+    std::vector<uint8_t> pixels;
+
+    void Resize(FramePixelFormat f, int w, int h) {
+        format = f;
+        width = w;
+        height = h;
+        pitch = (size_t)w * FrameBytesPerPixel(f);
+        pixels.assign(pitch * h, 0);
+    }
+
+    void Set(int x, int y, const float rgb[3]) {
+        uint8_t* p = pixels.data() + (size_t)y * pitch + (size_t)x * FrameBytesPerPixel(format);
+        if (format == FramePixelFormat::BGRA8) {
+            for (int c = 0; c < 3; c++) p[2 - c] = (uint8_t)(SrgbEncode(Saturate(rgb[c])) * 255.0f + 0.5f);
+            p[3] = 255;
+        } else {
+            uint16_t* h = (uint16_t*)p;
+            for (int c = 0; c < 3; c++) h[c] = FloatToHalf(rgb[c]);
+            h[3] = FloatToHalf(1.0f);
+        }
+    }
+};
+
+// Same layout as downscale-bench's test frame
+static void MakeTestImage(Image* img) {
+    int w = img->width, h = img->height;
+    bool hdr = img->format == FramePixelFormat::RGBA16F;
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            float rgb[3];
+            if (hdr && y >= h * 3 / 4) {
+                float t = (float)x / w;
+                float v = exp2f(-6.0f + t * 10.5f);
+                bool dot = (x % 37 == 0) && (y % 29 == 0);
+                rgb[0] = rgb[1] = rgb[2] = dot ? 12.5f : v * (0.6f + 0.4f * ((x >> 3) & 1));
+            } else if (x < w / 2) {
+                float cx = x - w / 4.0f, cy = y - h / 2.0f;
+                float v = 0.5f + 0.5f * cosf((cx * cx + cy * cy) * 3.14159265f / (float)w);
+                rgb[0] = v;
+                rgb[1] = v * 0.8f;
+                rgb[2] = 1.0f - v;
+            } else if (y < h / 2) {
+                bool line = (x % 4 == 0) || (y % 5 == 0);
+                rgb[0] = rgb[1] = rgb[2] = line ? 0.02f : 0.9f;
+            } else {
+                bool check = ((x ^ y) & 1) != 0;
+                rgb[0] = check ? 1.0f : 0.0f;
+                rgb[1] = check ? 0.3f : 0.6f;
+                rgb[2] = 0.1f;
+            }
+            if (hdr && y < h * 3 / 4) for (float& c : rgb) c *= 3.0f;
+            img->Set(x, y, rgb);
+        }
+    }
+}
+
+// Largest difference in 8-bit steps or half-float ULPs
+static int MaxDifference(const Image& a, const Image& b) {
+    int worst = 0;
+    if (a.format == FramePixelFormat::BGRA8) {
+        for (size_t i = 0; i < a.pixels.size(); i++) worst = std::max(worst, abs((int)a.pixels[i] - (int)b.pixels[i]));
+    } else {
+        const uint16_t* ha = (const uint16_t*)a.pixels.data();
+        const uint16_t* hb = (const uint16_t*)b.pixels.data();
+        for (size_t i = 0; i < a.pixels.size() / 2; i++) {
+            if (fabsf(HalfToFloat(ha[i]) - HalfToFloat(hb[i])) <= 1.0f / 4096) continue;
+            worst = std::max(worst, abs((int)ha[i] - (int)hb[i]));
+        }
+    }
+    return worst;
+}
+
+static bool WritePpm(const std::string& path, const Image& img) {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) return false;
+    fprintf(f, "P6\n%d %d\n255\n", img.width, img.height);
+    std::vector<uint8_t> row((size_t)img.width * 3);
+    for (int y = 0; y < img.height; y++) {
+        const uint8_t* p = img.pixels.data() + (size_t)y * img.pitch;
+        for (int x = 0; x < img.width; x++) {
+            row[x * 3 + 0] = p[x * 4 + 2];
+            row[x * 3 + 1] = p[x * 4 + 1];
+            row[x * 3 + 2] = p[x * 4 + 0];
+        }
+        fwrite(row.data(), 1, row.size(), f);
+    }
+    return fclose(f) == 0;
+}
+
+// Into BGRA8 with opaque alpha; false if missing or a different size
+static bool ReadPpm(const std::string& path, Image* img) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    int w, h, max;
+    bool ok = fscanf(f, "P6 %d %d %d", &w, &h, &max) == 3 && max == 255 && fgetc(f) != EOF &&
+              w == img->width && h == img->height;
+    std::vector<uint8_t> row((size_t)w * 3);
+    for (int y = 0; ok && y < h; y++) {
+        ok = fread(row.data(), 1, row.size(), f) == row.size();
+        uint8_t* p = img->pixels.data() + (size_t)y * img->pitch;
+        for (int x = 0; ok && x < w; x++) {
+            p[x * 4 + 0] = row[x * 3 + 2];
+            p[x * 4 + 1] = row[x * 3 + 1];
+            p[x * 4 + 2] = row[x * 3 + 0];
+            p[x * 4 + 3] = 255;
+        }
+    }
+    fclose(f);
+    return ok;
+}
+
+template <typename F>
+static double SecondsPerRun(F&& run) {
+    auto t0 = std::chrono::steady_clock::now();
+    int runs = 0;
+    double elapsed;
+    do {
+        run();
+        runs++;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    } while (elapsed < 0.5);
+    return elapsed / runs;
+}
+
+struct Pair { int sw, sh, dw, dh; };
+
+int main(int argc, char** argv) {
+    std::vector<Pair> pairs;
+    std::vector<ScalerKernel> kernels;
+    const char* dumpDir = nullptr;
+    const char* goldenDir = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--pair") && i+1 < argc) {
+            Pair p;
+            if (sscanf(argv[++i], "%dx%d:%dx%d", &p.sw, &p.sh, &p.dw, &p.dh) != 4 ||
+                p.sw <= 0 || p.sh <= 0 || p.dw <= 0 || p.dh <= 0) {
+                fprintf(stderr, "Invalid pair (expected WxH:WxH)\n");
+                return 1;
+            }
+            pairs.push_back(p);
+        }
+        else if (!strcmp(argv[i], "--kernel") && i+1 < argc) {
+            ScalerKernel k;
+            if (!ParseScalerKernel(argv[++i], &k)) { fprintf(stderr, "Unknown kernel: %s\n", argv[i]); return 1; }
+            kernels.push_back(k);
+        }
+        else if (!strcmp(argv[i], "--dump") && i+1 < argc) dumpDir = argv[++i];
+        else if (!strcmp(argv[i], "--golden") && i+1 < argc) goldenDir = argv[++i];
+        else {
+            fprintf(stderr, "Usage: %s [--pair WxH:WxH]... [--kernel NAME] [--dump DIR] [--golden DIR]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (pairs.empty()) {
+        pairs = {{1920, 1080, 3840, 2160}, {2560, 1440, 3840, 2160}, {1920, 1080, 2560, 1440},
+                 {3840, 2160, 2560, 1440}, {3840, 2160, 1920, 1080}};
+    }
+    if (kernels.empty()) for (int k = 0; k < kScalerKernelCount; k++) kernels.push_back((ScalerKernel)k);
+
+    printf("Render scalers, %s\n\n", DownscaleSimdName());
+    printf("%-8s %-24s %-14s %7s %10s %9s %6s %7s\n", "format", "pair", "kernel", "taps", "Mpix/s", "ms", "diff",
+           goldenDir ? "golden" : "");
+
+    bool ok = true;
+    for (FramePixelFormat f : {FramePixelFormat::BGRA8, FramePixelFormat::RGBA16F}) {
+        for (const Pair& p : pairs) {
+            Image src;
+            src.Resize(f, p.sw, p.sh);
+            MakeTestImage(&src);
+            char pair[40];
+            snprintf(pair, sizeof(pair), "%dx%d -> %dx%d", p.sw, p.sh, p.dw, p.dh);
+            for (ScalerKernel k : kernels) {
+                Image ref, out;
+                ref.Resize(f, p.dw, p.dh);
+                out.Resize(f, p.dw, p.dh);
+                ScaleReference(k, f, src.pixels.data(), src.pitch, p.sw, p.sh, ref.pixels.data(), ref.pitch, p.dw, p.dh);
+
+                ImageScaler scaler;
+                scaler.Configure(k, f, p.sw, p.sh, p.dw, p.dh);
+                double seconds = SecondsPerRun([&] {
+                    scaler.Run(src.pixels.data(), src.pitch, out.pixels.data(), out.pitch);
+                });
+
+                int diff = MaxDifference(ref, out);
+                bool failed = diff > 1;
+
+                char file[128];
+                snprintf(file, sizeof(file), "/%s_%dx%d_%dx%d.ppm", ScalerKernelName(k), p.sw, p.sh, p.dw, p.dh);
+                if (dumpDir && f == FramePixelFormat::BGRA8 && !WritePpm(dumpDir + std::string(file), out)) {
+                    fprintf(stderr, "Cannot write %s%s\n", dumpDir, file);
+                    return 1;
+                }
+                char golden[16] = "";
+                if (goldenDir && f == FramePixelFormat::BGRA8) {
+                    Image g;
+                    g.Resize(f, p.dw, p.dh);
+                    if (!ReadPpm(goldenDir + std::string(file), &g)) {
+                        snprintf(golden, sizeof(golden), "missing");
+                        failed = true;
+                    } else {
+                        int gd = MaxDifference(g, out);
+                        snprintf(golden, sizeof(golden), "%d", gd);
+                        if (gd > 1) failed = true;
+                    }
+                }
+                if (failed) ok = false;
+                printf("%-8s %-24s %-14s %7.1f %10.0f %9.2f %6d %7s%s\n", FramePixelFormatName(f), pair,
+                       ScalerKernelName(k), scaler.tapsPerPixel, (double)p.dw * p.dh / seconds / 1e6,
+                       seconds * 1e3, diff, golden, failed ? "  FAILED" : "");
+            }
+        }
+    }
+
+    if (!ok) printf("\nFAILED\n");
+    return ok ? 0 : 1;
+}
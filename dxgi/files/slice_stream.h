@@ -0,0 +1,940 @@
+// Low-latency frame streaming over UDP (--stream)
+//
+// SliceSender cuts each captured frame into horizontal slices of sliceRows
+// rows and sends the slices whose pixels changed since the last frame it
+// sent, plus a few unchanged ones per frame: a rolling refresh that sends
+// every slice at least once per refreshFrames frames, so a lost slice is
+// repaired without keyframes. Each slice is coded on its own, losslessly:
+// QOI's run / index / difference ops without alpha, or raw B, G, R when that
+// is smaller. It goes out in fragments of one datagram each.
+//
+// Every datagram carries the sender's session (new with every Open, so a
+// receiver follows a restarted mirror) and a sequence number. With fecGroup > 0 each group of
+// up to fecGroup data packets (a group never spans frames) is followed by a
+// parity packet, the XOR of their payloads, from which the receiver rebuilds
+// any one lost packet of the group.
+//
+// SliceReceiver reassembles slices into a BGRA canvas. A slice is applied
+// only if the canvas doesn't already hold a newer one, and a frame is
+// reported once every slice it carried is in. It counts lost packets
+// (sequence gaps, before FEC), slices of frames that never completed and
+// frames lost whole, and measures reassembly: first packet of a slice or
+// frame to its last one decoded.
+//
+// The capture thread never waits on the network: Push copies the frame and
+// returns, and a frame still waiting when the next one arrives is dropped.
+// The wire format is little-endian and no datagram exceeds mtu bytes. IPv4.
+//
+// Portable C++17.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "frame_source.h"
+#include "latency_histogram.h"
+
+const uint32_t kSliceStreamMagic = 0x53434C53;  // "SLCS"
+const uint8_t kSliceStreamVersion = 1;
+const int kSliceStreamMaxDimension = 8192;     // Width and height; bounds what a receiver allocates for a datagram
+
+enum class SlicePacketType : uint8_t {
+    Data = 1,       // SliceFragmentHeader + a fragment of a coded slice
+    Parity = 2,     // XOR of the payloads of the group's data packets
+};
+
+// Slice coding; the numbers are part of the protocol
+enum class SliceCodec : uint8_t {
+    Raw = 0,        // B, G, R per pixel
+    Run = 1,        // QOI ops without alpha (EncodeSliceRun)
+};
+
+// Starts every datagram
+struct SlicePacketHeader {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t type;           // SlicePacketType
+    uint8_t fecGroup;       // Data packets per parity packet, 0 = no FEC
+    uint8_t groupIndex;     // Data: position in its group; parity: data packets it covers
+    uint32_t session;       // Random per sender Open; a new one restarts the receiver's counting
+    uint32_t sequence;      // Every datagram, parity included
+    uint32_t groupFirst;    // Sequence of the group's first data packet
+};
+
+// Follows SlicePacketHeader in data packets
+struct SliceFragmentHeader {
+    uint64_t frameId;       // Sender's frame id (gaps: frames dropped before sending)
+    int64_t captureTime;    // Sender clock ticks
+    uint32_t streamFrame;   // Frames sent, counts up by one (gaps: frames lost whole)
+    uint16_t width, height;
+    uint16_t sliceRows;
+    uint16_t slice;
+    uint16_t slicesSent;    // Slices this frame carries
+    uint8_t codec;          // SliceCodec
+    uint8_t reserved;
+    uint16_t fragment, fragmentCount;
+    uint32_t sliceBytes;    // Coded slice
+    uint32_t offset;        // Of this fragment in the coded slice
+    uint32_t dataBytes;     // Fragment bytes after this header
+};
+
+static_assert(sizeof(SlicePacketHeader) == 20, "SlicePacketHeader is part of the protocol");
+static_assert(sizeof(SliceFragmentHeader) == 48, "SliceFragmentHeader is part of the protocol");
+
+// QOI op tags
+const uint8_t kSliceOpIndex = 0x00;
+const uint8_t kSliceOpDiff = 0x40;
+const uint8_t kSliceOpLuma = 0x80;
+const uint8_t kSliceOpRun = 0xC0;
+const uint8_t kSliceOpRgb = 0xFE;
+
+inline int SliceHash(uint32_t px) {
+    return (int)(((px >> 16) * 3 + ((px >> 8) & 0xFF) * 5 + (px & 0xFF) * 7) % 64);
+}
+
+// Appends the coded rows (BGRA, alpha ignored) to out. Every slice starts
+// from black with an empty index, so slices decode independently.
+inline void EncodeSliceRun(const uint8_t* bgra, size_t pitch, int width, int rows, std::vector<uint8_t>* out) {
+    size_t pos = out->size();
+    out->resize(pos + (size_t)width * rows * 4 + 1);   // RGB ops for every pixel
+    uint8_t* o = out->data();
+    uint32_t index[64] = {};
+    uint32_t prev = 0;      // B | G << 8 | R << 16
+    int run = 0;
+    for (int y = 0; y < rows; y++) {
+        const uint8_t* row = bgra + (size_t)y * pitch;
+        for (int x = 0; x < width; x++) {
+            uint32_t px = row[x * 4] | row[x * 4 + 1] << 8 | row[x * 4 + 2] << 16;
+            if (px == prev) {
+                if (++run == 62) {
+                    o[pos++] = (uint8_t)(kSliceOpRun | (run - 1));
+                    run = 0;
+                }
+                continue;
+            }
+            if (run) {
+                o[pos++] = (uint8_t)(kSliceOpRun | (run - 1));
+                run = 0;
+            }
+            int h = SliceHash(px);
+            if (index[h] == px) {
+                o[pos++] = (uint8_t)(kSliceOpIndex | h);
+            } else {
+                index[h] = px;
+                int db = (int8_t)((px & 0xFF) - (prev & 0xFF));
+                int dg = (int8_t)(((px >> 8) & 0xFF) - ((prev >> 8) & 0xFF));
+                int dr = (int8_t)((px >> 16) - (prev >> 16));
+                int drg = dr - dg, dbg = db - dg;
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                    o[pos++] = (uint8_t)(kSliceOpDiff | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+                } else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7) {
+                    o[pos++] = (uint8_t)(kSliceOpLuma | (dg + 32));
+                    o[pos++] = (uint8_t)((drg + 8) << 4 | (dbg + 8));
+                } else {
+                    o[pos++] = kSliceOpRgb;
+                    o[pos++] = (uint8_t)(px >> 16);
+                    o[pos++] = (uint8_t)(px >> 8);
+                    o[pos++] = (uint8_t)px;
+                }
+            }
+            prev = px;
+        }
+    }
+    if (run) o[pos++] = (uint8_t)(kSliceOpRun | (run - 1));
+    out->resize(pos);
+}
+
+// Decodes into BGRA rows (alpha 255). False if the data is short, runs past
+// the rows or has bytes left over; the rows are then partly written.
+inline bool DecodeSliceRun(const uint8_t* data, size_t bytes, uint8_t* bgra, size_t pitch, int width, int rows) {
+    uint32_t index[64] = {};
+    uint32_t px = 0;
+    int run = 0;
+    size_t pos = 0;
+    for (int y = 0; y < rows; y++) {
+        uint8_t* row = bgra + (size_t)y * pitch;
+        for (int x = 0; x < width; x++) {
+            if (run > 0) {
+                run--;
+            } else {
+                if (pos >= bytes) return false;
+                uint8_t op = data[pos++];
+                if (op == kSliceOpRgb) {
+                    if (bytes - pos < 3) return false;
+                    px = (uint32_t)data[pos] << 16 | data[pos + 1] << 8 | data[pos + 2];
+                    pos += 3;
+                    index[SliceHash(px)] = px;
+                } else if ((op & 0xC0) == kSliceOpIndex) {
+                    px = index[op & 63];
+                } else if ((op & 0xC0) == kSliceOpDiff) {
+                    uint32_t r = ((px >> 16) + ((op >> 4) & 3) - 2) & 0xFF;
+                    uint32_t g = (((px >> 8) & 0xFF) + ((op >> 2) & 3) - 2) & 0xFF;
+                    uint32_t b = ((px & 0xFF) + (op & 3) - 2) & 0xFF;
+                    px = r << 16 | g << 8 | b;
+                    index[SliceHash(px)] = px;
+                } else if ((op & 0xC0) == kSliceOpLuma) {
+                    if (pos >= bytes) return false;
+                    int dg = (op & 63) - 32;
+                    int drg = (data[pos] >> 4) - 8, dbg = (data[pos] & 15) - 8;
+                    pos++;
+                    uint32_t r = ((px >> 16) + dg + drg) & 0xFF;
+                    uint32_t g = (((px >> 8) & 0xFF) + dg) & 0xFF;
+                    uint32_t b = ((px & 0xFF) + dg + dbg) & 0xFF;
+                    px = r << 16 | g << 8 | b;
+                    index[SliceHash(px)] = px;
+                } else {
+                    if (op == 0xFF) return false;       // Reserved
+                    run = op & 63;                      // This pixel and run more
+                }
+            }
+            row[x * 4] = (uint8_t)px;
+            row[x * 4 + 1] = (uint8_t)(px >> 8);
+            row[x * 4 + 2] = (uint8_t)(px >> 16);
+            row[x * 4 + 3] = 255;
+        }
+    }
+    return run == 0 && pos == bytes;
+}
+
+inline void EncodeSliceRaw(const uint8_t* bgra, size_t pitch, int width, int rows, std::vector<uint8_t>* out) {
+    size_t pos = out->size();
+    out->resize(pos + (size_t)width * rows * 3);
+    uint8_t* o = out->data() + pos;
+    for (int y = 0; y < rows; y++) {
+        const uint8_t* row = bgra + (size_t)y * pitch;
+        for (int x = 0; x < width; x++, o += 3) memcpy(o, row + x * 4, 3);
+    }
+}
+
+inline bool DecodeSliceRaw(const uint8_t* data, size_t bytes, uint8_t* bgra, size_t pitch, int width, int rows) {
+    if (bytes != (size_t)width * rows * 3) return false;
+    for (int y = 0; y < rows; y++) {
+        uint8_t* row = bgra + (size_t)y * pitch;
+        for (int x = 0; x < width; x++, data += 3) {
+            memcpy(row + x * 4, data, 3);
+            row[x * 4 + 3] = 255;
+        }
+    }
+    return true;
+}
+
+// Blocking IPv4 UDP socket; Receive waits with a timeout
+class UdpSocket {
+public:
+    UdpSocket() = default;
+    UdpSocket(const UdpSocket&) = delete;
+    UdpSocket& operator=(const UdpSocket&) = delete;
+    ~UdpSocket() { Close(); }
+
+    // port 0 binds any free port (see LocalPort)
+    bool Open(int bindPort, std::string* error) {
+        Close();
+#if defined(_WIN32)
+        WSADATA wsa;
+        if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) { *error = "WSAStartup failed"; return false; }
+        started = true;
+        s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (s == INVALID_SOCKET) return Failed("socket", error);
+#else
+        s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (s < 0) return Failed("socket", error);
+#endif
+        // Room for a whole frame of slices in flight
+        int buffer = 8 << 20;
+        setsockopt(s, SOL_SOCKET, SO_SNDBUF, (const char*)&buffer, sizeof(buffer));
+        setsockopt(s, SOL_SOCKET, SO_RCVBUF, (const char*)&buffer, sizeof(buffer));
+        sockaddr_in local = {};
+        local.sin_family = AF_INET;
+        local.sin_addr.s_addr = htonl(INADDR_ANY);
+        local.sin_port = htons((uint16_t)bindPort);
+        if (bind(s, (const sockaddr*)&local, sizeof(local)) != 0) return Failed("bind", error);
+        return true;
+    }
+
+    bool SetTarget(const char* host, int port, std::string* error) {
+        addrinfo hints = {}, *result = nullptr;
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_DGRAM;
+        if (getaddrinfo(host, nullptr, &hints, &result) != 0 || !result) {
+            *error = std::string("cannot resolve ") + host;
+            return false;
+        }
+        memcpy(&target, result->ai_addr, sizeof(target));
+        target.sin_port = htons((uint16_t)port);
+        freeaddrinfo(result);
+        return true;
+    }
+
+    int LocalPort() const {
+        sockaddr_in local = {};
+        socklen_t size = sizeof(local);
+        if (getsockname(s, (sockaddr*)&local, &size) != 0) return 0;
+        return ntohs(local.sin_port);
+    }
+
+    bool Send(const void* data, size_t bytes) { return SendTo(data, bytes, target); }
+
+    bool SendTo(const void* data, size_t bytes, const sockaddr_in& to) {
+        return sendto(s, (const char*)data, (int)bytes, 0, (const sockaddr*)&to, sizeof(to)) == (int)bytes;
+    }
+
+    // Datagram size, 0 on timeout, -1 on error
+    int Receive(void* buffer, size_t size, int timeoutMs, sockaddr_in* from = nullptr) {
+        fd_set read;
+        FD_ZERO(&read);
+        FD_SET(s, &read);
+        timeval tv = {timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+        int ready = select((int)s + 1, &read, nullptr, nullptr, &tv);
+        if (ready <= 0) return ready;
+        sockaddr_in source = {};
+        socklen_t sourceSize = sizeof(source);
+        int n = (int)recvfrom(s, (char*)buffer, (int)size, 0, (sockaddr*)&source, &sourceSize);
+#if defined(_WIN32)
+        // An ICMP port unreachable for an earlier send, not an error of this socket
+        if (n < 0 && WSAGetLastError() == WSAECONNRESET) return 0;
+#endif
+        if (n >= 0 && from) *from = source;
+        return n;
+    }
+
+    bool IsOpen() const {
+#if defined(_WIN32)
+        return s != INVALID_SOCKET;
+#else
+        return s >= 0;
+#endif
+    }
+
+    void Close() {
+#if defined(_WIN32)
+        if (s != INVALID_SOCKET) closesocket(s);
+        s = INVALID_SOCKET;
+        if (started) WSACleanup();
+        started = false;
+#else
+        if (s >= 0) close(s);
+        s = -1;
+#endif
+    }
+
+private:
+    bool Failed(const char* what, std::string* error) {
+#if defined(_WIN32)
+        *error = std::string(what) + " failed (error " + std::to_string(WSAGetLastError()) + ")";
+#else
+        *error = std::string(what) + " failed: " + strerror(errno);
+#endif
+        Close();
+        return false;
+    }
+
+#if defined(_WIN32)
+    SOCKET s = INVALID_SOCKET;
+    bool started = false;
+#else
+    int s = -1;
+#endif
+    sockaddr_in target = {};
+};
+
+struct SliceStreamConfig {
+    int width = 0, height = 0;
+    bool rgba = false;          // Pushed pixels are R, G, B, A (otherwise B, G, R, A)
+    int sliceRows = 16;
+    int refreshFrames = 60;     // Every slice goes out at least this often, changed or not; 0 = changed only
+    int fecGroup = 0;           // Data packets per parity packet (1..255), 0 = no FEC
+    int mtu = 1400;             // Datagram bytes
+};
+
+struct SliceStreamFrame {
+    uint64_t frameId = 0;
+    int64_t captureTime = 0;
+};
+
+class SliceSender {
+public:
+    SliceSender() = default;
+    SliceSender(const SliceSender&) = delete;
+    SliceSender& operator=(const SliceSender&) = delete;
+    ~SliceSender() { Close(); }
+
+    bool Open(const char* host, int port, const SliceStreamConfig& c, std::string* error) {
+        Close();
+        if (c.width <= 0 || c.height <= 0 || c.width > kSliceStreamMaxDimension || c.height > kSliceStreamMaxDimension) {
+            *error = "bad frame size (up to " + std::to_string(kSliceStreamMaxDimension) + " per side)";
+            return false;
+        }
+        if (c.sliceRows < 1 || c.sliceRows > c.height) { *error = "slice rows out of range"; return false; }
+        if (c.fecGroup < 0 || c.fecGroup > 255) { *error = "FEC group out of range (0..255)"; return false; }
+        if (c.mtu < 256 || c.mtu > 65000) { *error = "MTU out of range (256..65000)"; return false; }
+        // A coded slice is at most 3 bytes per pixel (raw) and its fragment count has 16 bits
+        if ((size_t)c.width * c.sliceRows * 3 > FragmentChunk(c.mtu) * 65535) {
+            *error = "slices too large for the MTU (fewer rows per slice or a larger MTU)";
+            return false;
+        }
+        if (!socket.Open(0, error) || !socket.SetTarget(host, port, error)) return false;
+        config = c;
+        rowBytes = (size_t)c.width * 4;
+        sliceCount = (c.height + c.sliceRows - 1) / c.sliceRows;
+        for (Buffer& b : buffers) b.pixels.resize(rowBytes * c.height);
+        reference.assign(rowBytes * c.height, 0);
+        sent.assign(sliceCount, 0);
+        chosen.assign(sliceCount, 0);
+        packet.assign(c.mtu, 0);
+        parity.assign(c.mtu - sizeof(SlicePacketHeader), 0);
+        filling = 0;
+        pending = -1;
+        sending = -1;
+        refreshCursor = 0;
+        session = (uint32_t)FrameClockNow() * 2654435761u ^ (uint32_t)(uintptr_t)this;
+        streamFrame = 0;
+        sequence = 0;
+        groupCount = 0;
+        parityBytes = 0;
+        stopping = false;
+        sender = std::thread(&SliceSender::SenderThread, this);
+        return true;
+    }
+
+    bool IsOpen() const { return sender.joinable(); }
+    int SliceCount() const { return sliceCount; }
+
+    // Copies the frame (rows of width * 4 bytes) and returns at once. False
+    // if it replaced a frame the sender had not picked up yet.
+    bool Push(const SliceStreamFrame& frame, const uint8_t* pixels, size_t pitch) {
+        Buffer& b = buffers[filling];
+        for (int y = 0; y < config.height; y++) memcpy(b.pixels.data() + y * rowBytes, pixels + y * pitch, rowBytes);
+        b.frame = frame;
+        bool replaced;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            replaced = pending >= 0;
+            if (replaced) {
+                std::swap(pending, filling);
+            } else {
+                pending = filling;
+                filling = 0;
+                while (filling == pending || filling == sending) filling++;
+            }
+        }
+        if (replaced) framesDropped.fetch_add(1, std::memory_order_relaxed);
+        wake.notify_one();
+        return !replaced;
+    }
+
+    void Close() {
+        if (!sender.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        sender.join();
+        socket.Close();
+    }
+
+    // Totals since Open
+    std::atomic<uint64_t> framesSent{0};
+    std::atomic<uint64_t> framesDropped{0};     // Replaced while waiting for the sender
+    std::atomic<uint64_t> slicesSent{0};
+    std::atomic<uint64_t> slicesRefreshed{0};   // Of slicesSent: unchanged, sent by the rolling refresh
+    std::atomic<uint64_t> packetsSent{0};
+    std::atomic<uint64_t> parityPackets{0};     // Of packetsSent
+    std::atomic<uint64_t> bytesSent{0};         // Datagram bytes
+    std::atomic<uint64_t> sendErrors{0};        // Datagrams the socket refused
+
+private:
+    struct Buffer {
+        std::vector<uint8_t> pixels;    // As pushed (BGRA once SendFrame starts), rowBytes per row
+        SliceStreamFrame frame;
+    };
+
+    void SenderThread() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wake.wait(lock, [this] { return pending >= 0 || stopping; });
+            if (stopping) break;
+            sending = pending;
+            pending = -1;
+            lock.unlock();
+            SendFrame(buffers[sending]);
+            lock.lock();
+            sending = -1;
+        }
+    }
+
+    int SliceRowCount(int s) const { return std::min(config.sliceRows, config.height - s * config.sliceRows); }
+    static size_t FragmentChunk(int mtu) { return mtu - sizeof(SlicePacketHeader) - sizeof(SliceFragmentHeader); }
+
+    void SendFrame(Buffer& b) {
+        if (config.rgba) {
+            for (size_t i = 0; i < b.pixels.size(); i += 4) std::swap(b.pixels[i], b.pixels[i + 2]);
+        }
+
+        // Slices that changed since the frame sent last, then the refresh
+        int count = 0, refreshed = 0;
+        for (int s = 0; s < sliceCount; s++) {
+            size_t offset = (size_t)s * config.sliceRows * rowBytes, bytes = SliceRowCount(s) * rowBytes;
+            chosen[s] = !sent[s] || memcmp(reference.data() + offset, b.pixels.data() + offset, bytes) != 0;
+            count += chosen[s];
+        }
+        if (config.refreshFrames > 0) {
+            int perFrame = (sliceCount + config.refreshFrames - 1) / config.refreshFrames;
+            for (int k = 0; k < perFrame; k++) {
+                int s = (refreshCursor + k) % sliceCount;
+                if (!chosen[s]) { chosen[s] = 1; count++; refreshed++; }
+            }
+            refreshCursor = (refreshCursor + perFrame) % sliceCount;
+        }
+        if (count == 0) return;     // Nothing changed and no refresh due
+        streamFrame++;
+
+        SliceFragmentHeader f = {};
+        f.frameId = b.frame.frameId;
+        f.captureTime = b.frame.captureTime;
+        f.streamFrame = streamFrame;
+        f.width = (uint16_t)config.width;
+        f.height = (uint16_t)config.height;
+        f.sliceRows = (uint16_t)config.sliceRows;
+        f.slicesSent = (uint16_t)count;
+        size_t chunk = FragmentChunk(config.mtu);
+        for (int s = 0; s < sliceCount; s++) {
+            if (!chosen[s]) continue;
+            size_t offset = (size_t)s * config.sliceRows * rowBytes;
+            int rows = SliceRowCount(s);
+            coded.clear();
+            EncodeSliceRun(b.pixels.data() + offset, rowBytes, config.width, rows, &coded);
+            f.codec = (uint8_t)SliceCodec::Run;
+            if (coded.size() >= (size_t)config.width * rows * 3) {
+                coded.clear();
+                EncodeSliceRaw(b.pixels.data() + offset, rowBytes, config.width, rows, &coded);
+                f.codec = (uint8_t)SliceCodec::Raw;
+            }
+            f.slice = (uint16_t)s;
+            f.sliceBytes = (uint32_t)coded.size();
+            f.fragmentCount = (uint16_t)((coded.size() + chunk - 1) / chunk);
+            for (f.fragment = 0; f.fragment < f.fragmentCount; f.fragment++) {
+                f.offset = (uint32_t)(f.fragment * chunk);
+                f.dataBytes = (uint32_t)std::min(chunk, coded.size() - f.offset);
+                uint8_t* payload = packet.data() + sizeof(SlicePacketHeader);
+                memcpy(payload, &f, sizeof(f));
+                memcpy(payload + sizeof(f), coded.data() + f.offset, f.dataBytes);
+                SendData(sizeof(f) + f.dataBytes);
+            }
+            memcpy(reference.data() + offset, b.pixels.data() + offset, rows * rowBytes);
+            sent[s] = 1;
+        }
+        SendParity();   // Groups end with the frame, so recovery never waits for the next one
+        framesSent.fetch_add(1, std::memory_order_relaxed);
+        slicesSent.fetch_add(count, std::memory_order_relaxed);
+        slicesRefreshed.fetch_add(refreshed, std::memory_order_relaxed);
+    }
+
+    // Sends the data packet whose payload is in packet, and folds it into the parity
+    void SendData(size_t payloadBytes) {
+        if (groupCount == 0) groupFirst = sequence;
+        SlicePacketHeader h = {kSliceStreamMagic, kSliceStreamVersion, (uint8_t)SlicePacketType::Data,
+                               (uint8_t)config.fecGroup, (uint8_t)groupCount, session, sequence++, groupFirst};
+        memcpy(packet.data(), &h, sizeof(h));
+        SendPacket(sizeof(h) + payloadBytes);
+        if (config.fecGroup == 0) return;
+        const uint8_t* payload = packet.data() + sizeof(h);
+        for (size_t i = 0; i < payloadBytes; i++) parity[i] ^= payload[i];
+        parityBytes = std::max(parityBytes, payloadBytes);
+        if (++groupCount == config.fecGroup) SendParity();
+    }
+
+    void SendParity() {
+        if (groupCount == 0) return;
+        SlicePacketHeader h = {kSliceStreamMagic, kSliceStreamVersion, (uint8_t)SlicePacketType::Parity,
+                               (uint8_t)config.fecGroup, (uint8_t)groupCount, session, sequence++, groupFirst};
+        memcpy(packet.data(), &h, sizeof(h));
+        memcpy(packet.data() + sizeof(h), parity.data(), parityBytes);
+        SendPacket(sizeof(h) + parityBytes);
+        parityPackets.fetch_add(1, std::memory_order_relaxed);
+        memset(parity.data(), 0, parityBytes);
+        parityBytes = 0;
+        groupCount = 0;
+    }
+
+    void SendPacket(size_t bytes) {
+        if (!socket.Send(packet.data(), bytes)) sendErrors.fetch_add(1, std::memory_order_relaxed);
+        packetsSent.fetch_add(1, std::memory_order_relaxed);
+        bytesSent.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    SliceStreamConfig config;
+    UdpSocket socket;
+    size_t rowBytes = 0;
+    int sliceCount = 0;
+
+    // Push fills one buffer, the sender thread sends another, the third waits
+    Buffer buffers[3];
+    int filling = 0, pending = -1, sending = -1;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread sender;
+    bool stopping = false;
+
+    // Sender thread only
+    std::vector<uint8_t> reference;     // The pixels of every slice as last sent
+    std::vector<uint8_t> sent;          // Per slice: sent at least once
+    std::vector<uint8_t> chosen;        // Per slice: goes out with this frame
+    std::vector<uint8_t> coded, packet, parity;
+    size_t parityBytes = 0;
+    int refreshCursor = 0;
+    uint32_t session = 0;
+    uint32_t streamFrame = 0;
+    uint32_t sequence = 0, groupFirst = 0;
+    int groupCount = 0;
+};
+
+struct SliceReceivedFrame {
+    uint64_t frameId = 0;
+    uint32_t streamFrame = 0;
+    int64_t captureTime = 0;        // Sender clock
+    int64_t firstPacketTime = 0;    // FrameClockNow() on arrival
+    int64_t completeTime = 0;
+    int slices = 0;
+};
+
+struct SliceReceiverStats {
+    uint64_t packets = 0;           // Datagrams, parity included
+    uint64_t bytes = 0;
+    uint64_t packetsLost = 0;       // Sequence numbers that never arrived
+    uint64_t recovered = 0;         // Data packets rebuilt from parity
+    uint64_t malformed = 0;         // Datagrams or slices that did not parse or decode
+    uint64_t slicesDecoded = 0;
+    uint64_t slicesStale = 0;       // A newer version was already on the canvas
+    uint64_t slicesLost = 0;        // Carried by frames that never completed
+    uint64_t framesComplete = 0;
+    uint64_t framesIncomplete = 0;
+    uint64_t framesLost = 0;        // Not one packet arrived
+};
+
+class SliceReceiver {
+public:
+    static const int kFramesInFlight = 4;   // Older incomplete frames are given up
+    static const int kMaxCompleted = 64;
+
+    bool Open(int port, std::string* error) { return socket.Open(port, error); }
+    int Port() const { return socket.LocalPort(); }
+    void Close() { socket.Close(); }
+
+    // Waits up to timeoutMs for one datagram and processes it. False on
+    // timeout or a socket error.
+    bool ReceiveOne(int timeoutMs) {
+        buffer.resize(65536);
+        int n = socket.Receive(buffer.data(), buffer.size(), timeoutMs);
+        if (n <= 0) return false;
+        Process(buffer.data(), (size_t)n, FrameClockNow());
+        return true;
+    }
+
+    void Process(const uint8_t* data, size_t bytes, int64_t now) {
+        stats.packets++;
+        stats.bytes += bytes;
+        SlicePacketHeader h;
+        if (bytes < sizeof(h)) { stats.malformed++; return; }
+        memcpy(&h, data, sizeof(h));
+        if (h.magic != kSliceStreamMagic || h.version != kSliceStreamVersion) { stats.malformed++; return; }
+        if (haveSequence && h.session != session) {
+            // The sender started over: keep the totals, count from here
+            SliceReceiverStats s = Stats();
+            stats.packetsLost = s.packetsLost;
+            stats.framesLost = s.framesLost;
+            Flush();
+            haveSequence = haveFrame = false;
+            received = framesSeen = 0;
+        }
+        session = h.session;
+        if (!haveSequence) {
+            firstSequence = highestSequence = h.sequence;
+            haveSequence = true;
+        } else if ((int32_t)(h.sequence - highestSequence) > 0) {
+            highestSequence = h.sequence;
+        }
+        received++;
+        const uint8_t* payload = data + sizeof(h);
+        size_t payloadBytes = bytes - sizeof(h);
+        if (h.type == (uint8_t)SlicePacketType::Data) {
+            if (h.fecGroup > 0) AddToGroup(h, payload, payloadBytes, now);
+            ProcessFragment(payload, payloadBytes, now);
+        } else if (h.type == (uint8_t)SlicePacketType::Parity) {
+            AddToGroup(h, payload, payloadBytes, now);
+        } else {
+            stats.malformed++;
+        }
+    }
+
+    // Gives up on every frame still incomplete (end of stream)
+    void Flush() {
+        DropFrames();
+        groups.clear();
+    }
+
+    // Frames completed since the last call, oldest first
+    bool TakeFrame(SliceReceivedFrame* frame) {
+        if (completed.empty()) return false;
+        *frame = completed.front();
+        completed.pop_front();
+        return true;
+    }
+
+    SliceReceiverStats Stats() const {
+        SliceReceiverStats s = stats;
+        uint64_t sequences = haveSequence ? (uint64_t)(highestSequence - firstSequence) + 1 : 0;
+        uint64_t streamFrames = haveFrame ? (uint64_t)(newestFrame - firstFrame) + 1 : 0;
+        s.packetsLost += sequences > received ? sequences - received : 0;
+        s.framesLost += streamFrames > framesSeen ? streamFrames - framesSeen : 0;
+        return s;
+    }
+
+    // BGRA, alpha 255; empty until the first packet
+    const uint8_t* Canvas() const { return canvas.data(); }
+    int Width() const { return width; }
+    int Height() const { return height; }
+    size_t Pitch() const { return (size_t)width * 4; }
+
+    LatencyHistogram sliceLatency;  // First fragment of a slice to the slice decoded
+    LatencyHistogram frameLatency;  // First packet of a frame to its last slice decoded
+
+private:
+    struct FrameState {
+        uint64_t frameId = 0;
+        int64_t captureTime = 0, firstPacketTime = 0;
+        int slicesSent = 0, slicesDone = 0;
+        std::vector<uint8_t> sliceDone;     // Late duplicates of a decoded slice are ignored
+        bool complete = false;
+    };
+
+    struct Assembly {
+        std::vector<uint8_t> data;
+        std::vector<uint8_t> have;
+        int received = 0;
+        int64_t firstTime = 0;
+    };
+
+    struct Group {
+        std::vector<std::vector<uint8_t>> data;     // By group index; empty = missing
+        std::vector<uint8_t> parity;
+        int count = -1;                             // Known once the parity arrives
+        int received = 0;
+        bool done = false;
+    };
+
+    void AddToGroup(const SlicePacketHeader& h, const uint8_t* payload, size_t bytes, int64_t now) {
+        // Groups live within one frame; anything this far back is finished or lost
+        while (!groups.empty() && (int32_t)(highestSequence - groups.begin()->first) > 65536) groups.erase(groups.begin());
+        Group& g = groups[h.groupFirst];
+        if (g.done) return;
+        if (g.data.empty()) g.data.resize(h.fecGroup);
+        if (h.type == (uint8_t)SlicePacketType::Parity) {
+            if (h.groupIndex == 0 || h.groupIndex > g.data.size() || !g.parity.empty()) return;
+            g.count = h.groupIndex;
+            g.parity.assign(payload, payload + bytes);
+        } else {
+            if (h.groupIndex >= g.data.size() || !g.data[h.groupIndex].empty() || bytes == 0) return;
+            g.data[h.groupIndex].assign(payload, payload + bytes);
+            g.received++;
+        }
+        if (g.count < 0) return;
+        if (g.received >= g.count) {
+            g.done = true;
+        } else if (g.received == g.count - 1) {
+            // Missing packet = parity ^ every other payload, zero-padded
+            std::vector<uint8_t> rebuilt = g.parity;
+            for (int i = 0; i < g.count; i++) {
+                const std::vector<uint8_t>& d = g.data[i];
+                for (size_t k = 0; k < d.size() && k < rebuilt.size(); k++) rebuilt[k] ^= d[k];
+            }
+            g.done = true;
+            SliceFragmentHeader f;
+            if (rebuilt.size() < sizeof(f)) { stats.malformed++; return; }
+            memcpy(&f, rebuilt.data(), sizeof(f));
+            size_t length = sizeof(f) + (size_t)f.dataBytes;
+            if (length > rebuilt.size()) { stats.malformed++; return; }
+            stats.recovered++;
+            ProcessFragment(rebuilt.data(), length, now);
+        }
+        if (g.done) {
+            g.data.clear();
+            g.parity.clear();
+            g.data.shrink_to_fit();
+        }
+    }
+
+    void DropFrames() {
+        for (auto& entry : frames) {
+            if (!entry.second.complete) GiveUp(entry.second);
+        }
+        frames.clear();
+        assemblies.clear();
+    }
+
+    // New frame geometry; FEC groups in flight are kept, they may still rebuild packets of it
+    void Reset(int w, int h, int rows) {
+        DropFrames();
+        width = w;
+        height = h;
+        sliceRows = rows;
+        canvas.assign((size_t)w * h * 4, 0);
+        for (size_t i = 3; i < canvas.size(); i += 4) canvas[i] = 255;
+        int slices = (h + rows - 1) / rows;
+        applied.assign(slices, 0);
+        appliedValid.assign(slices, 0);
+    }
+
+    void GiveUp(FrameState& fs) {
+        stats.framesIncomplete++;
+        stats.slicesLost += fs.slicesSent - fs.slicesDone;
+    }
+
+    void ProcessFragment(const uint8_t* p, size_t bytes, int64_t now) {
+        SliceFragmentHeader f;
+        if (bytes < sizeof(f)) { stats.malformed++; return; }
+        memcpy(&f, p, sizeof(f));
+        // The geometry cap bounds the canvas, and sliceBytes is bounded by the raw size of
+        // its slice, so a forged header cannot make the receiver allocate more than that
+        if (f.width == 0 || f.height == 0 || f.width > kSliceStreamMaxDimension || f.height > kSliceStreamMaxDimension ||
+            f.sliceRows == 0 || f.sliceRows > f.height || bytes != sizeof(f) + (size_t)f.dataBytes ||
+            f.fragment >= f.fragmentCount || (uint64_t)f.offset + f.dataBytes > f.sliceBytes ||
+            f.slice >= (f.height + f.sliceRows - 1) / f.sliceRows || f.slicesSent == 0 ||
+            f.sliceBytes > (size_t)f.width * std::min<int>(f.sliceRows, f.height - f.slice * f.sliceRows) * 3) {
+            stats.malformed++;
+            return;
+        }
+        if (f.width != width || f.height != height || f.sliceRows != sliceRows) Reset(f.width, f.height, f.sliceRows);
+
+        if (!haveFrame) {
+            firstFrame = newestFrame = f.streamFrame;
+            haveFrame = true;
+        }
+        if ((int32_t)(newestFrame - f.streamFrame) >= kFramesInFlight) return;   // Given up on already
+        if ((int32_t)(f.streamFrame - newestFrame) > 0) {
+            newestFrame = f.streamFrame;
+            for (auto it = frames.begin(); it != frames.end();) {
+                if ((int32_t)(newestFrame - it->first) < kFramesInFlight) { ++it; continue; }
+                if (!it->second.complete) GiveUp(it->second);
+                uint64_t key = (uint64_t)it->first << 16;
+                assemblies.erase(assemblies.lower_bound(key), assemblies.lower_bound(key + 0x10000));
+                it = frames.erase(it);
+            }
+        }
+        auto found = frames.find(f.streamFrame);
+        if (found == frames.end()) {
+            FrameState fs;
+            fs.frameId = f.frameId;
+            fs.captureTime = f.captureTime;
+            fs.firstPacketTime = now;
+            fs.slicesSent = f.slicesSent;
+            fs.sliceDone.assign(applied.size(), 0);
+            found = frames.emplace(f.streamFrame, fs).first;
+            framesSeen++;
+        }
+        FrameState& fs = found->second;
+        if (fs.complete || fs.sliceDone[f.slice]) return;
+
+        uint64_t key = (uint64_t)f.streamFrame << 16 | f.slice;
+        Assembly& a = assemblies[key];
+        if (a.data.empty()) {
+            a.data.resize(f.sliceBytes);
+            a.have.assign(f.fragmentCount, 0);
+            a.firstTime = now;
+        } else if (a.data.size() != f.sliceBytes || a.have.size() != f.fragmentCount) {
+            stats.malformed++;
+            return;
+        }
+        if (a.have[f.fragment]) return;
+        a.have[f.fragment] = 1;
+        memcpy(a.data.data() + f.offset, p + sizeof(f), f.dataBytes);
+        if (++a.received < (int)a.have.size()) return;
+
+        // Whole slice: onto the canvas unless a newer one is already there
+        if (appliedValid[f.slice] && (int32_t)(f.streamFrame - applied[f.slice]) <= 0) {
+            stats.slicesStale++;
+        } else {
+            int rows = std::min<int>(sliceRows, height - f.slice * sliceRows);
+            uint8_t* dst = canvas.data() + (size_t)f.slice * sliceRows * Pitch();
+            bool ok = f.codec == (uint8_t)SliceCodec::Run ? DecodeSliceRun(a.data.data(), a.data.size(), dst, Pitch(), width, rows)
+                    : f.codec == (uint8_t)SliceCodec::Raw ? DecodeSliceRaw(a.data.data(), a.data.size(), dst, Pitch(), width, rows)
+                    : false;
+            if (ok) {
+                stats.slicesDecoded++;
+            } else {
+                stats.malformed++;
+            }
+            applied[f.slice] = f.streamFrame;
+            appliedValid[f.slice] = 1;
+        }
+        int64_t decoded = FrameClockNow();
+        sliceLatency.RecordTicks(decoded - a.firstTime, FrameClockFrequency());
+        assemblies.erase(key);
+
+        fs.sliceDone[f.slice] = 1;
+        if (++fs.slicesDone < fs.slicesSent) return;
+        fs.complete = true;
+        stats.framesComplete++;
+        frameLatency.RecordTicks(decoded - fs.firstPacketTime, FrameClockFrequency());
+        SliceReceivedFrame done;
+        done.frameId = fs.frameId;
+        done.streamFrame = f.streamFrame;
+        done.captureTime = fs.captureTime;
+        done.firstPacketTime = fs.firstPacketTime;
+        done.completeTime = decoded;
+        done.slices = fs.slicesSent;
+        if (completed.size() == kMaxCompleted) completed.pop_front();
+        completed.push_back(done);
+    }
+
+    UdpSocket socket;
+    std::vector<uint8_t> buffer;
+
+    int width = 0, height = 0, sliceRows = 0;
+    std::vector<uint8_t> canvas;
+    std::vector<uint32_t> applied;          // Per slice: stream frame on the canvas
+    std::vector<uint8_t> appliedValid;
+
+    std::map<uint32_t, FrameState> frames;  // By stream frame, the last kFramesInFlight
+    std::map<uint64_t, Assembly> assemblies;    // By stream frame << 16 | slice
+    std::map<uint32_t, Group> groups;       // By first sequence
+    std::deque<SliceReceivedFrame> completed;
+
+    SliceReceiverStats stats;
+    bool haveSequence = false, haveFrame = false;
+    uint32_t session = 0;
+    uint32_t firstSequence = 0, highestSequence = 0;
+    uint32_t firstFrame = 0, newestFrame = 0;
+    uint64_t received = 0, framesSeen = 0;
+};
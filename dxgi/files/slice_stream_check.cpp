@@ -0,0 +1,516 @@
+// Slice stream (slice_stream.h) check
+//
+// Runs SliceSender into SliceReceiver over loopback UDP, the way --stream
+// feeds it from the capture thread, through a relay that drops datagrams at
+// a set rate:
+//
+//   codec      EncodeSliceRun / DecodeSliceRun round trip on flat, gradient
+//              and noise rows, and every truncation of a coded slice is
+//              rejected.
+//   desktop    a static desktop with a window moving over it, no loss: every
+//              frame the receiver completes equals the frame pushed, and
+//              only the slices the window touches go out.
+//   limits     SliceSender::Open rejects frames over the size cap and slices
+//              whose fragments would not fit the 16-bit fragment count, and
+//              the receiver rejects forged headers with a huge geometry or a
+//              coded slice larger than its raw size, without taking them.
+//   restart    a second sender session at another size, pushing R, G, B, A
+//              (sdr8 slots): the receiver follows it instead of taking its
+//              frames for old ones.
+//   loss       the synthetic source's sweeping bar with 3% of datagrams
+//              dropped, without and with FEC: the receiver counts the lost
+//              packets and slices, FEC rebuilds most of them, and once the
+//              relay stops dropping the rolling refresh brings the canvas
+//              back to the last frame.
+//
+// Prints bandwidth, loss and reassembly / end-to-end latency for each case.
+// Exits with 1 on any failure.
+//
+// Build: cl /O2 /EHsc slice_stream_check.cpp ws2_32.lib    or    g++ -O2 -pthread slice_stream_check.cpp
+//
+// Usage: slice-stream-check
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "slice_stream.h"
+
+static double Seconds(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+}
+
+// Forwards datagrams to the receiver, dropping lossRate of them (fixed seed)
+struct Relay {
+    UdpSocket socket;
+    std::atomic<double> lossRate{0};
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> forwarded{0}, dropped{0};
+    std::thread thread;
+
+    bool Start(int receiverPort, std::string* error) {
+        if (!socket.Open(0, error) || !socket.SetTarget("127.0.0.1", receiverPort, error)) return false;
+        thread = std::thread([this] {
+            std::vector<uint8_t> buffer(65536);
+            uint32_t rng = 0x2545F491;
+            while (!stop.load()) {
+                int n = socket.Receive(buffer.data(), buffer.size(), 20);
+                if (n <= 0) continue;
+                rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+                if ((rng >> 8) * (1.0 / (1 << 24)) < lossRate.load()) {
+                    dropped++;
+                    continue;
+                }
+                socket.Send(buffer.data(), (size_t)n);
+                forwarded++;
+            }
+        });
+        return true;
+    }
+
+    void Stop() {
+        stop = true;
+        if (thread.joinable()) thread.join();
+    }
+};
+
+// Pumps the receiver on its own thread; onFrame runs for every completed frame
+struct Receiving {
+    SliceReceiver receiver;
+    std::atomic<bool> stop{false};
+    std::thread thread;
+    LatencyHistogram endToEnd;
+    std::function<void(const SliceReceiver&, const SliceReceivedFrame&)> onFrame;
+
+    void Start() {
+        thread = std::thread([this] {
+            while (!stop.load()) {
+                receiver.ReceiveOne(20);
+                SliceReceivedFrame f;
+                while (receiver.TakeFrame(&f)) {
+                    endToEnd.RecordTicks(f.completeTime - f.captureTime, FrameClockFrequency());
+                    if (onFrame) onFrame(receiver, f);
+                }
+            }
+        });
+    }
+
+    void Stop() {
+        stop = true;
+        if (thread.joinable()) thread.join();
+        receiver.Flush();
+    }
+};
+
+static bool CanvasEquals(const SliceReceiver& rx, const uint8_t* bgra, int width, int height) {
+    if (rx.Width() != width || rx.Height() != height) return false;
+    for (int y = 0; y < height; y++) {
+        const uint8_t* a = rx.Canvas() + y * rx.Pitch();
+        const uint8_t* b = bgra + (size_t)y * width * 4;
+        for (int x = 0; x < width; x++) {
+            if (memcmp(a + x * 4, b + x * 4, 3) != 0) return false;
+        }
+    }
+    return true;
+}
+
+static void PrintStats(const char* name, const SliceSender& tx, Receiving& receiving, double seconds) {
+    SliceReceiver& rx = receiving.receiver;
+    SliceReceiverStats s = rx.Stats();
+    LatencyHistogram::Summary slice = rx.sliceLatency.TakeSummary();
+    LatencyHistogram::Summary frame = rx.frameLatency.TakeSummary();
+    LatencyHistogram::Summary e2e = receiving.endToEnd.TakeSummary();
+    uint64_t frames = tx.framesSent.load();
+    printf("%-20s %5llu frames %6.1f Mbit/s  slices %5.1f%% (%llu refresh)  packets %6llu lost %4llu fec %4llu\n"
+           "%-20s slices lost %4llu  frames incomplete %3llu lost %3llu  reassembly slice %.2f/%.2f ms, frame %.2f/%.2f ms,"
+           " end-to-end %.2f/%.2f ms (p50/p99)\n",
+           name, (unsigned long long)frames, tx.bytesSent.load() * 8 / seconds / 1e6,
+           frames ? 100.0 * tx.slicesSent.load() / (frames * (double)tx.SliceCount()) : 0.0,
+           (unsigned long long)tx.slicesRefreshed.load(), (unsigned long long)tx.packetsSent.load(),
+           (unsigned long long)s.packetsLost, (unsigned long long)s.recovered, "",
+           (unsigned long long)s.slicesLost, (unsigned long long)s.framesIncomplete, (unsigned long long)s.framesLost,
+           slice.p50, slice.p99, frame.p50, frame.p99, e2e.p50, e2e.p99);
+}
+
+// Codec round trips and malformed input
+static CaseResult CheckCodec() {
+    CaseResult r;
+    r.name = "codec";
+    const int w = 97, rows = 7;
+    std::vector<uint8_t> src(w * rows * 4), dst(w * rows * 4), coded;
+    uint32_t rng = 12345;
+    for (int pattern = 0; pattern < 4; pattern++) {
+        for (int i = 0; i < w * rows; i++) {
+            rng = rng * 1664525 + 1013904223;
+            uint8_t* p = &src[i * 4];
+            int x = i % w, y = i / w;
+            switch (pattern) {
+                case 0: p[0] = 30; p[1] = 60; p[2] = 90; break;                                 // Flat
+                case 1: p[0] = (uint8_t)(x * 2); p[1] = (uint8_t)(y * 9); p[2] = (uint8_t)(x + y); break;   // Gradient
+                case 2: p[0] = (uint8_t)(rng >> 24); p[1] = (uint8_t)(rng >> 16); p[2] = (uint8_t)(rng >> 8); break;  // Noise
+                default: {  // Text-like: a few colors in runs
+                    uint8_t v = ((x / 3 + y) % 5 == 0) ? 20 : 235;
+                    p[0] = p[1] = p[2] = v;
+                    if (rng >> 30 == 0) p[2] = 200;
+                }
+            }
+            p[3] = 255;
+        }
+        coded.clear();
+        EncodeSliceRun(src.data(), w * 4, w, rows, &coded);
+        std::fill(dst.begin(), dst.end(), 0);
+        if (!DecodeSliceRun(coded.data(), coded.size(), dst.data(), w * 4, w, rows) || dst != src) {
+            Fail(&r, "pattern " + std::to_string(pattern) + " does not round-trip");
+        }
+        for (size_t n = 0; n < coded.size(); n++) {
+            if (DecodeSliceRun(coded.data(), n, dst.data(), w * 4, w, rows)) {
+                Fail(&r, "pattern " + std::to_string(pattern) + " decodes truncated to " + std::to_string(n) + " bytes");
+                break;
+            }
+        }
+        coded.push_back(kSliceOpIndex);
+        if (DecodeSliceRun(coded.data(), coded.size(), dst.data(), w * 4, w, rows)) Fail(&r, "trailing bytes accepted");
+        printf("%-20s pattern %d: %5zu bytes for %d pixels (%.2f bytes/pixel)\n", "codec", pattern, coded.size() - 1,
+               w * rows, (coded.size() - 1) / (double)(w * rows));
+    }
+    coded.clear();
+    EncodeSliceRaw(src.data(), w * 4, w, rows, &coded);
+    if (!DecodeSliceRaw(coded.data(), coded.size(), dst.data(), w * 4, w, rows) || dst != src) Fail(&r, "raw does not round-trip");
+    if (DecodeSliceRaw(coded.data(), coded.size() - 1, dst.data(), w * 4, w, rows)) Fail(&r, "raw accepts a short slice");
+    return r;
+}
+
+// A static desktop (gradient and rows of "text") with a window moving over
+// it and a clock that ticks every frame
+static void RenderDesktop(uint64_t frame, int width, int height, std::vector<uint8_t>* out) {
+    out->resize((size_t)width * height * 4);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint8_t* p = out->data() + ((size_t)y * width + x) * 4;
+            bool ink = (y % 24) >= 6 && (y % 24) < 16 && ((x * 7 + (y / 24) * 13) % 11) < 4;
+            p[0] = ink ? 30 : (uint8_t)(160 + x * 60 / width);
+            p[1] = ink ? 30 : (uint8_t)(150 + y * 60 / height);
+            p[2] = ink ? 30 : 170;
+            p[3] = 255;
+        }
+    }
+    int wx = (int)(frame * 6 % (uint64_t)(width - 200)), wy = height / 2 + (int)(frame / 20 % 3) * 4;
+    for (int y = wy; y < wy + 120 && y < height; y++) {
+        for (int x = wx; x < wx + 200; x++) {
+            uint8_t* p = out->data() + ((size_t)y * width + x) * 4;
+            bool title = y < wy + 20;
+            p[0] = title ? 200 : 250;
+            p[1] = title ? 120 : 250;
+            p[2] = title ? 40 : 250;
+        }
+    }
+    for (int y = 4; y < 20; y++) {
+        for (int x = width - 64; x < width - 4; x++) {
+            uint8_t* p = out->data() + ((size_t)y * width + x) * 4;
+            p[0] = p[1] = p[2] = (uint8_t)((x + frame) % 7 < 2 ? 0 : 255);
+        }
+    }
+}
+
+static CaseResult CheckDesktop() {
+    CaseResult r;
+    r.name = "desktop";
+    const int width = 960, height = 540;
+    SliceStreamConfig c;
+    c.width = width;
+    c.height = height;
+    c.refreshFrames = 60;
+
+    std::string error;
+    Receiving receiving;
+    Relay relay;
+    if (!receiving.receiver.Open(0, &error) || !relay.Start(receiving.receiver.Port(), &error)) {
+        Fail(&r, error);
+        return r;
+    }
+    std::atomic<uint64_t> checked{0}, mismatched{0};
+    receiving.onFrame = [&](const SliceReceiver& rx, const SliceReceivedFrame& f) {
+        std::vector<uint8_t> expect;
+        RenderDesktop(f.frameId, width, height, &expect);
+        checked++;
+        if (!CanvasEquals(rx, expect.data(), width, height)) mismatched++;
+    };
+    receiving.Start();
+
+    SliceSender tx;
+    if (!tx.Open("127.0.0.1", relay.socket.LocalPort(), c, &error)) {
+        Fail(&r, error);
+        relay.Stop();
+        receiving.Stop();
+        return r;
+    }
+    std::vector<uint8_t> pixels;
+    auto start = std::chrono::steady_clock::now();
+    double maxPushMs = 0;
+    uint64_t frames = 90;
+    for (uint64_t id = 1; id <= frames; id++) {
+        RenderDesktop(id, width, height, &pixels);
+        auto t0 = std::chrono::steady_clock::now();
+        tx.Push({id, FrameClockNow()}, pixels.data(), (size_t)width * 4);
+        maxPushMs = std::max(maxPushMs, Seconds(t0) * 1000.0);
+        std::this_thread::sleep_until(start + std::chrono::microseconds(id * 16667));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    double seconds = Seconds(start);
+    tx.Close();
+    relay.Stop();
+    receiving.Stop();
+
+    PrintStats("desktop", tx, receiving, seconds);
+    SliceReceiverStats s = receiving.receiver.Stats();
+    double changedShare = (double)(tx.slicesSent - tx.slicesRefreshed) / (tx.framesSent * (double)tx.SliceCount());
+    if (mismatched) Fail(&r, std::to_string(mismatched.load()) + " of " + std::to_string(checked.load()) + " frames differ");
+    if (s.framesComplete != tx.framesSent || s.slicesLost || s.packetsLost || s.malformed) {
+        Fail(&r, "frames or slices lost without loss");
+    }
+    if (tx.framesSent + tx.framesDropped != frames) Fail(&r, "frames unaccounted for");
+    if (changedShare > 0.4) Fail(&r, "sends " + std::to_string((int)(changedShare * 100)) + "% of slices for a small change");
+    if (r.pass) {
+        char text[128];
+        snprintf(text, sizeof(text), "%llu frames equal, %.0f%% of slices changed, max push %.2f ms",
+                 (unsigned long long)checked.load(), changedShare * 100, maxPushMs);
+        r.detail = text;
+    }
+    return r;
+}
+
+// One data datagram carrying f and dataBytes zero bytes
+static std::vector<uint8_t> ForgeFragment(SliceFragmentHeader f, uint32_t sequence) {
+    SlicePacketHeader h = {};
+    h.magic = kSliceStreamMagic;
+    h.version = kSliceStreamVersion;
+    h.type = (uint8_t)SlicePacketType::Data;
+    h.session = 1;
+    h.sequence = sequence;
+    h.groupFirst = sequence;
+    std::vector<uint8_t> packet(sizeof(h) + sizeof(f) + f.dataBytes, 0);
+    memcpy(packet.data(), &h, sizeof(h));
+    memcpy(packet.data() + sizeof(h), &f, sizeof(f));
+    return packet;
+}
+
+static CaseResult CheckLimits() {
+    CaseResult r;
+    r.name = "limits";
+    struct { int width, height, sliceRows, mtu; bool valid; } configs[] = {
+        {kSliceStreamMaxDimension, 4320, 16, 1400, true},
+        {kSliceStreamMaxDimension + 1, 1080, 16, 1400, false},
+        {1920, kSliceStreamMaxDimension + 1, 16, 1400, false},
+        {kSliceStreamMaxDimension, 4320, 4320, 1400, false},  // The raw fallback would need 80K fragments
+        {4096, 4096, 4096, 256, false},     // 50 MB raw slice, 65535 fragments carry 12 MB
+    };
+    std::string error;
+    for (const auto& k : configs) {
+        SliceSender tx;
+        SliceStreamConfig c;
+        c.width = k.width;
+        c.height = k.height;
+        c.sliceRows = k.sliceRows;
+        c.mtu = k.mtu;
+        bool opened = tx.Open("127.0.0.1", 9, c, &error);
+        if (opened != k.valid) {
+            Fail(&r, std::string("Open ") + (opened ? "accepts " : "rejects ") + std::to_string(k.width) + "x" +
+                 std::to_string(k.height) + ", " + std::to_string(k.sliceRows) + " rows, MTU " + std::to_string(k.mtu));
+        }
+    }
+
+    SliceFragmentHeader good = {};
+    good.width = 1920;
+    good.height = 1080;
+    good.sliceRows = 16;
+    good.slicesSent = 1;
+    good.fragmentCount = 2;      // First half only: takes the geometry, decodes nothing
+    good.dataBytes = 64;
+    good.sliceBytes = 128;
+    SliceFragmentHeader forged[4] = {good, good, good, good};
+    forged[0].width = forged[0].height = 65535;                 // 17 GB canvas
+    forged[1].width = kSliceStreamMaxDimension + 1;
+    forged[2].sliceBytes = 1920 * 16 * 3 + 1;                   // Larger than the slice's raw size
+    forged[3].slice = 1080 / 16;                                // The last slice has 8 rows
+    forged[3].sliceBytes = 1920 * 16 * 3;
+    SliceReceiver rx;
+    uint32_t sequence = 0;
+    for (const SliceFragmentHeader& f : forged) {
+        std::vector<uint8_t> packet = ForgeFragment(f, sequence++);
+        rx.Process(packet.data(), packet.size(), FrameClockNow());
+    }
+    if (rx.Stats().malformed != 4 || rx.Width() != 0) {
+        Fail(&r, "receiver took " + std::to_string(4 - rx.Stats().malformed) + " of 4 forged headers");
+    }
+    std::vector<uint8_t> packet = ForgeFragment(good, sequence++);
+    rx.Process(packet.data(), packet.size(), FrameClockNow());
+    if (rx.Stats().malformed != 4 || rx.Width() != good.width) Fail(&r, "receiver rejects a valid header");
+    if (r.pass) r.detail = "oversized configs and forged headers rejected";
+    return r;
+}
+
+static CaseResult CheckRestart() {
+    CaseResult r;
+    r.name = "restart";
+    std::string error;
+    Receiving receiving;
+    std::atomic<uint64_t> completed{0};
+    receiving.onFrame = [&](const SliceReceiver&, const SliceReceivedFrame&) { completed++; };
+    if (!receiving.receiver.Open(0, &error)) {
+        Fail(&r, error);
+        return r;
+    }
+    receiving.Start();
+    const int sizes[2][2] = {{640, 360}, {320, 240}};
+    std::vector<uint8_t> pixels, rgba;
+    uint64_t sent = 0;
+    for (const int* size : sizes) {
+        SliceSender tx;
+        SliceStreamConfig c;
+        c.width = size[0];
+        c.height = size[1];
+        c.rgba = size == sizes[1];
+        if (!tx.Open("127.0.0.1", receiving.receiver.Port(), c, &error)) {
+            Fail(&r, error);
+            break;
+        }
+        for (uint64_t id = 1; id <= 20; id++) {
+            RenderDesktop(id, c.width, c.height, &pixels);
+            rgba = pixels;
+            if (c.rgba) {
+                for (size_t k = 0; k < rgba.size(); k += 4) std::swap(rgba[k], rgba[k + 2]);
+            }
+            tx.Push({id, FrameClockNow()}, rgba.data(), (size_t)c.width * 4);
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        tx.Close();
+        sent += tx.framesSent;
+    }
+    receiving.Stop();
+    SliceReceiverStats s = receiving.receiver.Stats();
+    if (completed != sent || s.framesLost || s.packetsLost) {
+        Fail(&r, std::to_string(completed.load()) + " of " + std::to_string(sent) + " frames completed across the restart");
+    } else if (!CanvasEquals(receiving.receiver, pixels.data(), sizes[1][0], sizes[1][1])) {
+        Fail(&r, "canvas is not the second session's last frame");
+    } else {
+        r.detail = std::to_string(sent) + " frames over two sessions";
+    }
+    return r;
+}
+
+struct LossResult {
+    CaseResult result;
+    double sliceLossRate = 0;
+    uint64_t recovered = 0;
+};
+
+static LossResult CheckLoss(const char* name, int fecGroup) {
+    LossResult out;
+    CaseResult& r = out.result;
+    r.name = name;
+    SyntheticSourceDesc d;
+    d.width = 640;
+    d.height = 360;
+    d.motion = SyntheticMotion::Bar;
+    SliceStreamConfig c;
+    c.width = (int)d.width;
+    c.height = (int)d.height;
+    c.refreshFrames = 20;
+    c.fecGroup = fecGroup;
+
+    std::string error;
+    Receiving receiving;
+    Relay relay;
+    if (!receiving.receiver.Open(0, &error) || !relay.Start(receiving.receiver.Port(), &error)) {
+        Fail(&r, error);
+        return out;
+    }
+    receiving.Start();
+    SliceSender tx;
+    if (!tx.Open("127.0.0.1", relay.socket.LocalPort(), c, &error)) {
+        Fail(&r, error);
+        relay.Stop();
+        receiving.Stop();
+        return out;
+    }
+
+    // Lossy for 2 s, then the last frame again for twice the refresh period without loss
+    relay.lossRate = 0.03;
+    SyntheticFrameSource source(d);
+    std::vector<uint8_t> last;
+    uint64_t id = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (Seconds(start) < 2.0) {
+        FrameInfo info;
+        if (source.AcquireFrame(100, &info) != FrameStatus::Ok) continue;
+        last.assign(info.pixels, info.pixels + (size_t)info.pitch * info.height);
+        tx.Push({++id, FrameClockNow()}, info.pixels, info.pitch);
+        source.ReleaseFrame();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    SliceReceiverStats lossy = receiving.receiver.Stats();
+    uint64_t sliceTotal = tx.slicesSent.load();
+    relay.lossRate = 0;
+    for (int k = 0; k < c.refreshFrames * 2; k++) {
+        tx.Push({++id, FrameClockNow()}, last.data(), d.width * 4);
+        std::this_thread::sleep_for(std::chrono::milliseconds(17));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    double seconds = Seconds(start);
+    tx.Close();
+    relay.Stop();
+    receiving.Stop();
+
+    PrintStats(name, tx, receiving, seconds);
+    out.sliceLossRate = sliceTotal ? (double)lossy.slicesLost / sliceTotal : 0;
+    out.recovered = lossy.recovered;
+    uint64_t relayDropped = relay.dropped.load();
+    if (lossy.packetsLost == 0 || lossy.packetsLost > relayDropped) {
+        Fail(&r, "counted " + std::to_string(lossy.packetsLost) + " lost packets, relay dropped " + std::to_string(relayDropped));
+    }
+    if (fecGroup == 0 && lossy.slicesLost == 0) Fail(&r, "no slice loss counted");
+    if (fecGroup > 0 && lossy.recovered == 0) Fail(&r, "FEC recovered nothing");
+    if (lossy.malformed) Fail(&r, std::to_string(lossy.malformed) + " malformed");
+    if (!CanvasEquals(receiving.receiver, last.data(), (int)d.width, (int)d.height)) Fail(&r, "canvas not repaired by the refresh");
+    if (r.pass) {
+        char text[160];
+        snprintf(text, sizeof(text), "relay dropped %llu, slice loss %.2f%%, %llu rebuilt, canvas repaired",
+                 (unsigned long long)relayDropped, out.sliceLossRate * 100, (unsigned long long)lossy.recovered);
+        r.detail = text;
+    }
+    return out;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        fprintf(stderr, "Usage: %s\n", argv[0]);
+        return 1;
+    }
+    std::vector<CaseResult> results;
+    results.push_back(CheckCodec());
+    printf("\n");
+    results.push_back(CheckDesktop());
+    results.push_back(CheckLimits());
+    results.push_back(CheckRestart());
+    printf("\n");
+    LossResult plain = CheckLoss("loss 3%", 0);
+    printf("\n");
+    LossResult fec = CheckLoss("loss 3%, fec 8", 8);
+    if (fec.result.pass && fec.sliceLossRate >= plain.sliceLossRate) {
+        Fail(&fec.result, "FEC does not reduce slice loss");
+    }
+    results.push_back(plain.result);
+    results.push_back(fec.result);
+
+    printf("\n");
+    return ReportResults(results, 20);
+}
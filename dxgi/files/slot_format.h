@@ -0,0 +1,142 @@
+// Compact capture-slot formats for HDR sources
+//
+// HDR frames arrive as R16G16B16A16_FLOAT, 8 bytes per pixel. With
+// --slot-format the capture thread converts each frame into a smaller slot
+// in a compute pass (g_ComputeShaderPack) instead of copying it:
+//
+//   r11g11b10   R11G11B10_FLOAT, linear scRGB. Negative (wide gamut) values clip to 0.
+//   pq10        R10G10B10A2_UNORM, BT.2020 primaries and PQ. Keeps the wide gamut.
+//   sdr8        R8G8B8A8_UNORM, tonemapped at capture and sRGB encoded
+//
+// Pack* are the CPU versions of the pack shader and Unpack* of the render
+// side's decode (g_SlotDecode). The R11G11B10 rounding follows the D3D
+// float conversion rules bit for bit. slot-format-bench uses these to
+// measure what each format costs in precision.
+//
+// Portable C++17.
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "tonemap.h"
+
+enum class SlotFormat {
+    Native,
+    R11G11B10,
+    Pq10,
+    Sdr8,
+};
+
+const int kSlotFormatCount = 4;
+
+inline const char* SlotFormatName(SlotFormat f) {
+    switch (f) {
+        case SlotFormat::Native: return "native";
+        case SlotFormat::R11G11B10: return "r11g11b10";
+        case SlotFormat::Pq10: return "pq10";
+        case SlotFormat::Sdr8: return "sdr8";
+    }
+    return "?";
+}
+
+inline bool ParseSlotFormat(const char* name, SlotFormat* f) {
+    for (int i = 0; i < kSlotFormatCount; i++) {
+        if (!strcmp(name, SlotFormatName((SlotFormat)i))) { *f = (SlotFormat)i; return true; }
+    }
+    return false;
+}
+
+// Bytes per pixel of an HDR slot (native = RGBA16F)
+inline int SlotFormatBytesPerPixel(SlotFormat f) { return f == SlotFormat::Native ? 8 : 4; }
+
+// Unsigned float with a 5-bit exponent (bias 15) and mantBits of mantissa,
+// the channels of R11G11B10_FLOAT. Round to nearest even, negatives and NaN
+// to 0, overflow to the largest finite value.
+inline uint32_t FloatToUFloat(float f, int mantBits) {
+    if (!(f > 0.0f)) return 0;
+    const uint32_t maxFinite = (30u << mantBits) | ((1u << mantBits) - 1);
+    uint32_t x; memcpy(&x, &f, 4);
+    uint32_t shift = 23 - mantBits;
+    uint32_t bits;
+    if (x < 0x38800000) {
+        // Denormal (below 2^-14): shift the implicit-one mantissa into place
+        uint32_t e = x >> 23;
+        if (e < 113 - (uint32_t)mantBits - 1) return 0;
+        uint32_t m = (x & 0x7FFFFF) | 0x800000;
+        uint32_t s = shift + (113 - e);
+        bits = m >> s;
+        uint32_t rem = m & ((1u << s) - 1), halfway = 1u << (s - 1);
+        if (rem > halfway || (rem == halfway && (bits & 1))) bits++;
+    } else {
+        bits = (x - 0x38000000) >> shift;
+        uint32_t rem = x & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+        if (rem > halfway || (rem == halfway && (bits & 1))) bits++;
+    }
+    return bits > maxFinite ? maxFinite : bits;
+}
+
+inline float UFloatToFloat(uint32_t bits, int mantBits) {
+    uint32_t e = bits >> mantBits;
+    uint32_t m = bits & ((1u << mantBits) - 1);
+    if (e == 0) return ldexpf((float)m, -14 - mantBits);
+    if (e == 31) return m ? NAN : INFINITY;
+    return ldexpf((float)(m | (1u << mantBits)), (int)e - 15 - mantBits);
+}
+
+// R in bits 0-10, G in 11-21, B in 22-31
+inline uint32_t PackR11G11B10(const float rgb[3]) {
+    return FloatToUFloat(rgb[0], 6) | (FloatToUFloat(rgb[1], 6) << 11) | (FloatToUFloat(rgb[2], 5) << 22);
+}
+
+inline void UnpackR11G11B10(uint32_t v, float rgb[3]) {
+    rgb[0] = UFloatToFloat(v & 0x7FF, 6);
+    rgb[1] = UFloatToFloat((v >> 11) & 0x7FF, 6);
+    rgb[2] = UFloatToFloat(v >> 22, 5);
+}
+
+inline uint32_t FloatToUnorm(float v, uint32_t max) {
+    return (uint32_t)(Saturate(v) * max + 0.5f);
+}
+
+// Linear scRGB (BT.709) <-> linear BT.2020, both in the same units
+inline void Bt709ToBt2020(const float in[3], float out[3]) {
+    out[0] = 0.6274040f * in[0] + 0.3292820f * in[1] + 0.0433136f * in[2];
+    out[1] = 0.0690970f * in[0] + 0.9195400f * in[1] + 0.0113612f * in[2];
+    out[2] = 0.0163916f * in[0] + 0.0880132f * in[1] + 0.8955950f * in[2];
+}
+
+inline void Bt2020ToBt709(const float in[3], float out[3]) {
+    out[0] = 1.6604910f * in[0] - 0.5876411f * in[1] - 0.0728499f * in[2];
+    out[1] = -0.1245505f * in[0] + 1.1328999f * in[1] - 0.0083494f * in[2];
+    out[2] = -0.0181508f * in[0] - 0.1005789f * in[1] + 1.1187297f * in[2];
+}
+
+// R in bits 0-9, G in 10-19, B in 20-29, alpha 1
+inline uint32_t PackPq10(const float scrgb[3]) {
+    float wide[3];
+    Bt709ToBt2020(scrgb, wide);
+    uint32_t v = 3u << 30;
+    for (int i = 0; i < 3; i++) v |= FloatToUnorm(PqEncode(wide[i] * 80.0f), 1023) << (10 * i);
+    return v;
+}
+
+inline void UnpackPq10(uint32_t v, float scrgb[3]) {
+    float wide[3];
+    for (int i = 0; i < 3; i++) wide[i] = PqDecode(((v >> (10 * i)) & 0x3FF) / 1023.0f) / 80.0f;
+    Bt2020ToBt709(wide, scrgb);
+}
+
+// Tonemapped at capture: the analytic transform, then 8-bit quantization
+inline uint32_t PackSdr8(const TonemapParams& p, const TonemapConstants& c, const float scrgb[3]) {
+    float srgb[3];
+    HdrToSdrReference(p, c, scrgb, srgb);
+    return FloatToUnorm(srgb[0], 255) | (FloatToUnorm(srgb[1], 255) << 8) |
+           (FloatToUnorm(srgb[2], 255) << 16) | 0xFF000000u;
+}
+
+inline void UnpackSdr8(uint32_t v, float srgb[3]) {
+    for (int i = 0; i < 3; i++) srgb[i] = ((v >> (8 * i)) & 0xFF) / 255.0f;
+}
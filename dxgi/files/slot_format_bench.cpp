@@ -0,0 +1,192 @@
+// Capture-slot format precision and size check
+//
+// Round-trips a sweep of scRGB colors through every --slot-format with the
+// CPU pack/unpack references (slot_format.h). For each format it reports:
+// slot memory and bytes per copy at the chosen size; the worst and mean
+// luminance error in linear light; and delta E of the displayed 8-bit SDR
+// output (tonemapped with --tonemap) against the native slot's. Colors
+// outside BT.709 are reported apart, because each format clips them in its
+// own way. ">1step" is the share of BT.709 colors whose displayed value
+// moves by more than one 8-bit step.
+//
+// Exits with 1 if the implementation is off rather than the format being
+// lossy: R11G11B10 rounding must match an exact double-precision rounding;
+// its luminance error must stay within half an ULP of the 5-bit blue
+// mantissa; and sdr8 must never be more than one step from the native slot.
+//
+// Build: cl /O2 /EHsc slot_format_bench.cpp    or    g++ -O2 slot_format_bench.cpp
+//
+// Usage: slot-format-bench [--size WxH] [--buffers N] [--tonemap OP] [--sdr-white N] [--peak-nits N]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#include "slot_format.h"
+
+// Exact round-to-nearest-even of a positive float into the unsigned float format
+static uint32_t UFloatExact(float f, int mantBits) {
+    if (!(f > 0.0f)) return 0;
+    int e;
+    frexp((double)f, &e);               // f = m * 2^e, m in [0.5, 1)
+    int exp = e - 1 < -14 ? -14 : e - 1;
+    double scaled = ldexp((double)f, mantBits - exp);
+    double r = nearbyint(scaled);       // Default rounding mode: nearest even
+    double v = ldexp(r, exp - mantBits);
+    if (v > ldexp((double)((2u << mantBits) - 1), 15 - mantBits)) v = ldexp((double)((2u << mantBits) - 1), 15 - mantBits);
+    // Back to bits
+    if (v < ldexp(1.0, -14)) return (uint32_t)ldexp(v, 14 + mantBits);
+    int ve;
+    double vm = frexp(v, &ve);
+    return ((uint32_t)(ve - 1 + 15) << mantBits) | ((uint32_t)ldexp(vm * 2.0 - 1.0, mantBits));
+}
+
+static bool CheckUFloatRounding() {
+    uint64_t mismatches = 0;
+    for (uint64_t x = 0; x < 0x7F800000ull; x += 61) {
+        uint32_t bits = (uint32_t)x;
+        float f; memcpy(&f, &bits, 4);
+        for (int mant : {5, 6}) {
+            if (FloatToUFloat(f, mant) != UFloatExact(f, mant)) mismatches++;
+        }
+    }
+    printf("R11G11B10 rounding vs exact: %llu mismatches\n\n", (unsigned long long)mismatches);
+    return mismatches == 0;
+}
+
+// Luminance 2^-12 .. 2^7 scRGB in 1/16 stops, 48 hues, 4 saturations, plus
+// wide-gamut colors with one negative channel
+static void MakeSamples(std::vector<float>* samples) {
+    for (int l = 0; l <= 19 * 16; l++) {
+        float lum = exp2f(-12.0f + l / 16.0f);
+        for (int h = 0; h < 48; h++) {
+            float hue = h / 8.0f;
+            float hc[3] = {
+                Saturate(fabsf(hue - 3.0f) - 1.0f),
+                Saturate(2.0f - fabsf(hue - 2.0f)),
+                Saturate(2.0f - fabsf(hue - 4.0f)),
+            };
+            for (int s = 0; s < 5; s++) {
+                float sat = s < 4 ? s / 3.0f : 1.0f;
+                for (int c = 0; c < 3; c++) samples->push_back(lum * (1.0f - sat + sat * hc[c]));
+                if (s == 4) samples->back() = -0.05f * lum;   // Wide gamut
+            }
+        }
+    }
+}
+
+// What the 8-bit swap chain shows
+static void Quantize8(float srgb[3]) {
+    for (int i = 0; i < 3; i++) srgb[i] = FloatToUnorm(srgb[i], 255) / 255.0f;
+}
+
+static void RoundTrip(SlotFormat f, const TonemapParams& p, const TonemapConstants& c, const float in[3], float out[3]) {
+    switch (f) {
+        case SlotFormat::Native:
+            for (int i = 0; i < 3; i++) out[i] = HalfToFloat(FloatToHalf(in[i]));
+            break;
+        case SlotFormat::R11G11B10: UnpackR11G11B10(PackR11G11B10(in), out); break;
+        case SlotFormat::Pq10: UnpackPq10(PackPq10(in), out); break;
+        case SlotFormat::Sdr8: UnpackSdr8(PackSdr8(p, c, in), out); break;
+    }
+}
+
+int main(int argc, char** argv) {
+    int w = 3840, h = 2160, buffers = 3;
+    TonemapParams params;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--size") && i+1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0) { fprintf(stderr, "Invalid size\n"); return 1; }
+        }
+        else if (!strcmp(argv[i], "--buffers") && i+1 < argc) buffers = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--tonemap") && i+1 < argc) {
+            const char* m = argv[++i];
+            if (!ParseTonemapOperator(m, &params.op)) { fprintf(stderr, "Unknown tonemap operator: %s\n", m); return 1; }
+        }
+        else if (!strcmp(argv[i], "--sdr-white") && i+1 < argc) params.sdrWhiteNits = (float)atof(argv[++i]);
+        else if (!strcmp(argv[i], "--peak-nits") && i+1 < argc) params.peakNits = (float)atof(argv[++i]);
+        else {
+            fprintf(stderr, "Usage: %s [--size WxH] [--buffers N] [--tonemap OP] [--sdr-white N] [--peak-nits N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    bool ok = CheckUFloatRounding();
+
+    std::vector<float> samples;
+    MakeSamples(&samples);
+    size_t count = samples.size() / 3;
+    TonemapConstants tc = ComputeTonemapConstants(params);
+
+    printf("%dx%d x %d slots, %zu colors, %s tonemapping at %.0f nits SDR white\n\n",
+           w, h, buffers, count, TonemapOperatorName(params.op), params.sdrWhiteNits);
+    printf("%-10s %9s %8s %12s %12s %7s %7s %8s %6s %10s\n", "format", "slots MB", "copy MB",
+           "lum err max", "lum err mean", "dE max", "dE p99", "dE mean", ">1step", "wide dE max");
+
+    double nativeBytes = (double)w * h * SlotFormatBytesPerPixel(SlotFormat::Native);
+    for (int fi = 0; fi < kSlotFormatCount; fi++) {
+        SlotFormat f = (SlotFormat)fi;
+        double maxLumErr = 0, sumLumErr = 0, sumDeltaE = 0, wideDeltaE = 0;
+        size_t lumCount = 0, offByMore = 0;
+        std::vector<float> deltaE;
+        for (size_t k = 0; k < count; k++) {
+            const float* in = &samples[k * 3];
+            float ref[3], out[3], refSdr[3], outSdr[3];
+            RoundTrip(SlotFormat::Native, params, tc, in, ref);
+            RoundTrip(f, params, tc, in, out);
+
+            bool wide = in[0] < 0 || in[1] < 0 || in[2] < 0;
+            HdrToSdrReference(params, tc, ref, refSdr);
+            Quantize8(refSdr);
+            if (f == SlotFormat::Sdr8) {
+                memcpy(outSdr, out, sizeof(outSdr));
+            } else {
+                HdrToSdrReference(params, tc, out, outSdr);
+                Quantize8(outSdr);
+
+                // Linear-light error of the luminance
+                float yIn = 0.2126f * ref[0] + 0.7152f * ref[1] + 0.0722f * ref[2];
+                float yOut = 0.2126f * out[0] + 0.7152f * out[1] + 0.0722f * out[2];
+                if (!wide && yIn > 1e-3f) {
+                    double err = fabs(yOut / yIn - 1.0);
+                    if (err > maxLumErr) maxLumErr = err;
+                    sumLumErr += err;
+                    lumCount++;
+                }
+            }
+
+            float dE = DeltaE76(refSdr, outSdr);
+            if (wide) {
+                if (dE > wideDeltaE) wideDeltaE = dE;
+            } else {
+                deltaE.push_back(dE);
+                sumDeltaE += dE;
+                for (int i = 0; i < 3; i++) {
+                    if (fabsf(refSdr[i] - outSdr[i]) * 255.0f > 1.5f) { offByMore++; break; }
+                }
+            }
+        }
+        std::sort(deltaE.begin(), deltaE.end());
+        float p99 = deltaE[deltaE.size() * 99 / 100];
+
+        double slotBytes = (double)w * h * SlotFormatBytesPerPixel(f);
+        double offPct = 100.0 * offByMore / deltaE.size();
+        bool failed = (f == SlotFormat::R11G11B10 && maxLumErr > 1.0 / 64) || (f == SlotFormat::Sdr8 && offByMore > 0);
+        if (failed) ok = false;
+        char lumMax[16] = "-", lumMean[16] = "-";
+        if (lumCount) {
+            snprintf(lumMax, sizeof(lumMax), "%.3f%%", maxLumErr * 100.0);
+            snprintf(lumMean, sizeof(lumMean), "%.3f%%", sumLumErr * 100.0 / lumCount);
+        }
+        printf("%-10s %9.1f %8.1f %12s %12s %7.2f %7.2f %8.4f %5.2f%% %10.2f%s\n", SlotFormatName(f),
+               slotBytes * buffers / 1048576.0, slotBytes / 1048576.0, lumMax, lumMean,
+               deltaE.back(), p99, sumDeltaE / deltaE.size(), offPct, wideDeltaE, failed ? "  FAILED" : "");
+    }
+    printf("\nnative slots: %.1f MB, %.1f MB per full copy\n", nativeBytes * buffers / 1048576.0, nativeBytes / 1048576.0);
+
+    if (!ok) printf("\nFAILED\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,178 @@
+// HDR -> SDR tonemapping operators
+//
+// Scalar reference for the operators in g_PixelShaderHDR. Everything works
+// in SDR-white-relative linear light (1.0 = SDR white = target peak):
+//
+//   reinhard   maxRGB Reinhard above SDR white (the original operator)
+//   bt2390     ITU-R BT.2390 EETF on maxRGB, in the PQ domain
+//   hable      Uncharted 2 filmic curve per channel, white = source peak
+//   aces       Narkowicz's ACES fit per channel
+//   knee       identity up to the knee, then linear compression of maxRGB
+//              so the source peak lands on 1.0
+//
+// ComputeTonemapConstants derives everything the operators need from the
+// user-facing parameters once. The same struct is the shader's constant
+// buffer, so the CPU and GPU paths cannot drift apart.
+//
+// Portable C++17.
+
+#pragma once
+
+#include <string.h>
+#include <math.h>
+
+#include "color_math.h"
+
+enum class TonemapOperator {
+    Reinhard = 0,   // Values match TONEMAP_OP in the shader
+    Bt2390 = 1,
+    Hable = 2,
+    Aces = 3,
+    Knee = 4,
+};
+
+const int kTonemapOperatorCount = 5;
+
+inline const char* TonemapOperatorName(TonemapOperator op) {
+    switch (op) {
+        case TonemapOperator::Reinhard: return "reinhard";
+        case TonemapOperator::Bt2390: return "bt2390";
+        case TonemapOperator::Hable: return "hable";
+        case TonemapOperator::Aces: return "aces";
+        case TonemapOperator::Knee: return "knee";
+    }
+    return "?";
+}
+
+inline bool ParseTonemapOperator(const char* name, TonemapOperator* op) {
+    for (int i = 0; i < kTonemapOperatorCount; i++) {
+        if (!strcmp(name, TonemapOperatorName((TonemapOperator)i))) { *op = (TonemapOperator)i; return true; }
+    }
+    return false;
+}
+
+struct TonemapParams {
+    TonemapOperator op = TonemapOperator::Reinhard;
+    float sdrWhiteNits = 240.0f;    // Maps to 1.0 on the SDR output
+    float peakNits = 1000.0f;       // Brightest source value (bt2390, hable, knee)
+    float knee = 0.75f;             // Knee start, relative to SDR white (knee)
+    float exposure = 1.0f;          // Input multiplier (hable, aces)
+};
+
+// Mirrors cbuffer Constants in g_PixelShaderHDR (3 x float4)
+struct TonemapConstants {
+    float scale;            // scRGB -> SDR-white-relative (80 / sdrWhiteNits)
+    float sdrWhiteNits;
+    float peak;             // peakNits / sdrWhiteNits
+    float exposure;
+    float knee;
+    float kneeSlope;        // (1 - knee) / (peak - knee)
+    float hableWhiteScale;  // 1 / Hable(2 * peak)
+    float padding0;
+    float pqPeak;           // PQ(peakNits)
+    float maxLum;           // PQ(sdrWhiteNits) / PQ(peakNits)
+    float ks;               // BT.2390 knee start, PQ domain
+    float padding1;
+};
+
+// SMPTE ST 2084 encode/decode, nits in [0, 10000]
+inline float PqEncode(float nits) {
+    const float m1 = 0.1593017578125f, m2 = 78.84375f;
+    const float c1 = 0.8359375f, c2 = 18.8515625f, c3 = 18.6875f;
+    float y = powf((nits > 0.0f ? nits : 0.0f) / 10000.0f, m1);
+    return powf((c1 + c2 * y) / (1.0f + c3 * y), m2);
+}
+
+inline float PqDecode(float e) {
+    const float m1 = 0.1593017578125f, m2 = 78.84375f;
+    const float c1 = 0.8359375f, c2 = 18.8515625f, c3 = 18.6875f;
+    float p = powf(e > 0.0f ? e : 0.0f, 1.0f / m2);
+    float num = p - c1;
+    return 10000.0f * powf((num > 0.0f ? num : 0.0f) / (c2 - c3 * p), 1.0f / m1);
+}
+
+inline float HableCurve(float x) {
+    const float A = 0.15f, B = 0.50f, C = 0.10f, D = 0.20f, E = 0.02f, F = 0.30f;
+    return (x * (A * x + C * B) + D * E) / (x * (A * x + B) + D * F) - E / F;
+}
+
+inline float AcesCurve(float x) {
+    x *= 0.6f;
+    return (x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f);
+}
+
+inline TonemapConstants ComputeTonemapConstants(const TonemapParams& p) {
+    TonemapConstants c = {};
+    c.scale = 80.0f / p.sdrWhiteNits;
+    c.sdrWhiteNits = p.sdrWhiteNits;
+    c.peak = p.peakNits / p.sdrWhiteNits;
+    if (c.peak < 1.0f) c.peak = 1.0f;
+    c.exposure = p.exposure;
+    c.knee = p.knee < 0.0f ? 0.0f : (p.knee > 1.0f ? 1.0f : p.knee);
+    c.kneeSlope = c.peak > c.knee ? (1.0f - c.knee) / (c.peak - c.knee) : 0.0f;
+    c.hableWhiteScale = 1.0f / HableCurve(2.0f * c.peak);
+    c.pqPeak = PqEncode(c.peak * p.sdrWhiteNits);
+    c.maxLum = PqEncode(p.sdrWhiteNits) / c.pqPeak;
+    c.ks = 1.5f * c.maxLum - 0.5f;
+    return c;
+}
+
+// BT.2390 EETF on a PQ value normalized to the source peak. With the peak
+// at SDR white the knee starts at 1 and leaves no span to roll off in: clip
+inline float Bt2390Eetf(const TonemapConstants& c, float e1) {
+    if (e1 < c.ks) return e1;
+    if (c.ks >= 1.0f) return e1 < 1.0f ? e1 : 1.0f;
+    float t = (e1 - c.ks) / (1.0f - c.ks);
+    float t2 = t * t, t3 = t2 * t;
+    return (2.0f * t3 - 3.0f * t2 + 1.0f) * c.ks + (t3 - 2.0f * t2 + t) * (1.0f - c.ks) +
+           (-2.0f * t3 + 3.0f * t2) * c.maxLum;
+}
+
+// SDR-white-relative linear in (>= 0), linear [0, 1] out (before clamping)
+inline void ApplyTonemap(TonemapOperator op, const TonemapConstants& c, float rgb[3]) {
+    float m = rgb[0] > rgb[1] ? rgb[0] : rgb[1];
+    if (rgb[2] > m) m = rgb[2];
+
+    float s = 1.0f;     // maxRGB operators scale all channels by s
+    switch (op) {
+        case TonemapOperator::Reinhard:
+            if (m > 1.0f) s = 1.0f / (1.0f + m);
+            break;
+        case TonemapOperator::Bt2390: {
+            float nits = m * c.sdrWhiteNits;
+            float e1 = PqEncode(nits) / c.pqPeak;
+            if (m > 0.0f && e1 >= c.ks) {
+                float e2 = Bt2390Eetf(c, e1 < 1.0f ? e1 : 1.0f);
+                s = PqDecode(e2 * c.pqPeak) / nits;
+            }
+            break;
+        }
+        case TonemapOperator::Hable:
+            for (int i = 0; i < 3; i++) rgb[i] = HableCurve(2.0f * c.exposure * rgb[i]) * c.hableWhiteScale;
+            return;
+        case TonemapOperator::Aces:
+            for (int i = 0; i < 3; i++) rgb[i] = AcesCurve(c.exposure * rgb[i]);
+            return;
+        case TonemapOperator::Knee:
+            if (m > c.knee) {
+                float mapped = c.knee + (m - c.knee) * c.kneeSlope;
+                s = (mapped < 1.0f ? mapped : 1.0f) / m;
+            }
+            break;
+    }
+    for (int i = 0; i < 3; i++) rgb[i] *= s;
+}
+
+// The full per-pixel transform of g_PixelShaderHDR: scRGB in, sRGB-encoded
+// [0, 1] out (negative wide-gamut values are clipped to BT.709)
+inline void HdrToSdrReference(const TonemapParams& p, const TonemapConstants& c, const float in[3], float out[3]) {
+    float rgb[3];
+    for (int i = 0; i < 3; i++) rgb[i] = (in[i] > 0.0f ? in[i] : 0.0f) * c.scale;
+    ApplyTonemap(p.op, c, rgb);
+    for (int i = 0; i < 3; i++) out[i] = SrgbEncode(Saturate(rgb[i]));
+}
+
+inline void HdrToSdrReference(const TonemapParams& p, const float in[3], float out[3]) {
+    TonemapConstants c = ComputeTonemapConstants(p);
+    HdrToSdrReference(p, c, in, out);
+}
@@ -0,0 +1,264 @@
+// Tonemap operator benchmark and golden check
+//
+// Runs every operator over a synthetic scRGB test image through the
+// vectorized kernel and the scalar reference (tonemap_simd.h), reports
+// Mpix/s for both and the largest per-channel difference between them.
+// Exits with 1 if any operator is off by more than one 8-bit step.
+//
+// The reference itself is pinned by golden vectors: fixed scRGB inputs
+// (black, grays around SDR white, highlights up to 100x, saturated and
+// wide-gamut colors) with their expected BGRA8 output per operator at the
+// default parameters. A change to any operator's math moves them; the one
+// step of slack absorbs libm differences between compilers. One more row
+// runs bt2390 with its peak at SDR white, where the EETF must clip, through
+// the reference and the SIMD kernel.
+//
+// Also times the CPU luminance histogram (luminance_histogram.h), checks its
+// peak and average against an exact sort of the same samples, and reports
+// how fast the adapter follows a step in scene peak. A dim scene must leave
+// the adapted bt2390 peak above SDR white, with white still mapped to white.
+//
+// Build: cl /O2 /EHsc /arch:AVX2 tonemap_bench.cpp
+//        g++ -O2 -mavx2 -mf16c tonemap_bench.cpp    (or -O2 alone for the scalar path)
+//
+// Usage: tonemap-bench [--size WxH] [--sdr-white N] [--peak-nits N]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "luminance_histogram.h"
+#include "tonemap_simd.h"
+
+// Luminance ramp (2^-10 .. 2^7 scRGB) across, hue and saturation sweep down.
+// The bottom eighth carries a negative channel like wide-gamut scRGB does.
+static void MakeTestImage(std::vector<uint16_t>* img, int w, int h) {
+    img->resize((size_t)w * h * 4);
+    for (int y = 0; y < h; y++) {
+        float hue = (float)(y % 64) / 64.0f * 6.0f;
+        float sat = (float)(y / 64 % 4) / 3.0f;
+        float hc[3] = {
+            Saturate(fabsf(hue - 3.0f) - 1.0f),
+            Saturate(2.0f - fabsf(hue - 2.0f)),
+            Saturate(2.0f - fabsf(hue - 4.0f)),
+        };
+        bool wideGamut = y >= h - h / 8;
+        for (int x = 0; x < w; x++) {
+            float lum = exp2f(-10.0f + 17.0f * x / (w > 1 ? w - 1 : 1));
+            uint16_t* p = img->data() + ((size_t)y * w + x) * 4;
+            for (int c = 0; c < 3; c++) p[c] = FloatToHalf(lum * (1.0f - sat + sat * hc[c]));
+            if (wideGamut) p[2] = FloatToHalf(-0.05f * lum);
+            p[3] = 0x3C00;
+        }
+    }
+}
+
+// Golden inputs, scRGB (1.0 = 80 nits; SDR white is 3.0 at the default 240)
+const float kGoldenInput[][3] = {
+    {0.0f, 0.0f, 0.0f}, {0.01f, 0.01f, 0.01f}, {0.5f, 0.5f, 0.5f}, {3.0f, 3.0f, 3.0f},
+    {4.5f, 4.5f, 4.5f}, {11.0f, 11.0f, 11.0f}, {12.5f, 12.5f, 12.5f}, {100.0f, 100.0f, 100.0f},
+    {3.0f, 0.5f, 0.1f}, {8.0f, 0.0f, 0.0f}, {0.2f, 6.0f, 1.0f}, {2.0f, 1.0f, -0.2f},
+    {0.05f, 0.4f, 40.0f},
+};
+const int kGoldenCount = sizeof(kGoldenInput) / sizeof(kGoldenInput[0]);
+
+// Expected TonemapImageReference output (0xRRGGBB, alpha is always 0xFF), by operator
+const uint32_t kGoldenOutput[kTonemapOperatorCount][kGoldenCount] = {
+    {0x000000, 0x0B0B0B, 0x717171, 0xFFFFFF, 0xCBCBCB, 0xE5E5E5, 0xE8E8E8, 0xFCFCFC, 0xFF7133, 0xDE0000, 0x29D55E, 0xD59C00, 0x0418F7},   // reinhard
+    {0x000000, 0x0B0B0B, 0x717171, 0xE8E8E8, 0xF6F6F6, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xE8662E, 0xFE0000, 0x32FC70, 0xD19900, 0x0419FF},   // bt2390
+    {0x000000, 0x090909, 0x656565, 0xC1C1C1, 0xD5D5D5, 0xFBFBFB, 0xFFFFFF, 0xFFFFFF, 0xC1652E, 0xEF0000, 0x42E386, 0xAB8600, 0x1F5BFF},   // hable
+    {0x000000, 0x020202, 0x636363, 0xD6D6D6, 0xE5E5E5, 0xF6F6F6, 0xF8F8F8, 0xFFFFFF, 0xD6631A, 0xF20000, 0x31EC95, 0xC29500, 0x0C55FF},   // aces
+    {0x000000, 0x0B0B0B, 0x717171, 0xE3E3E3, 0xE8E8E8, 0xFBFBFB, 0xFFFFFF, 0xFFFFFF, 0xE3642C, 0xF20000, 0x2FEC69, 0xD59C00, 0x0419FF},   // knee
+};
+
+// bt2390 with --peak-nits 240 at the default SDR white: the knee starts at 1,
+// so the EETF is a plain clip at SDR white (not 0 / 0 and black)
+const uint32_t kGoldenBt2390PeakAtWhite[kGoldenCount] = {
+    0x000000, 0x0B0B0B, 0x717171, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFF7133, 0xFF0000, 0x33FF71, 0xD59C00, 0x0419FF,
+};
+
+typedef void (*TonemapFn)(const TonemapParams&, const uint8_t*, size_t, uint8_t*, size_t, int, int);
+
+// Every golden input through fn at p, each channel within one step of expected
+static bool CheckGoldenRow(const char* name, TonemapFn fn, const TonemapParams& p, const std::vector<uint16_t>& src,
+                           const uint32_t* expected) {
+    std::vector<uint32_t> out(kGoldenCount);
+    fn(p, (const uint8_t*)src.data(), src.size() * 2, (uint8_t*)out.data(), out.size() * 4, kGoldenCount, 1);
+    bool ok = true;
+    for (int i = 0; i < kGoldenCount; i++) {
+        uint32_t expect = expected[i] | 0xFF000000u;
+        int diff = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+            int d = abs((int)((out[i] >> shift) & 0xFF) - (int)((expect >> shift) & 0xFF));
+            if (d > diff) diff = d;
+        }
+        if (diff > 1) {
+            printf("FAILED: %s golden %d (%g, %g, %g): %08X, expected %08X\n", name, i,
+                   kGoldenInput[i][0], kGoldenInput[i][1], kGoldenInput[i][2], out[i], expect);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+static bool CheckGolden() {
+    std::vector<uint16_t> src((size_t)kGoldenCount * 4);
+    for (int i = 0; i < kGoldenCount; i++) {
+        for (int c = 0; c < 3; c++) src[i * 4 + c] = FloatToHalf(kGoldenInput[i][c]);
+        src[i * 4 + 3] = 0x3C00;
+    }
+    bool ok = true;
+    for (int op = 0; op < kTonemapOperatorCount; op++) {
+        TonemapParams p;    // Defaults: the table is only valid for them
+        p.op = (TonemapOperator)op;
+        ok = CheckGoldenRow(TonemapOperatorName(p.op), TonemapImageReference, p, src, kGoldenOutput[op]) && ok;
+    }
+    TonemapParams atWhite;
+    atWhite.op = TonemapOperator::Bt2390;
+    atWhite.peakNits = atWhite.sdrWhiteNits;
+    ok = CheckGoldenRow("bt2390 peak at white", TonemapImageReference, atWhite, src, kGoldenBt2390PeakAtWhite) && ok;
+    ok = CheckGoldenRow("bt2390 peak at white, simd", TonemapImage, atWhite, src, kGoldenBt2390PeakAtWhite) && ok;
+    if (ok) {
+        printf("golden: reference output matches for %d inputs x %d operators, and bt2390 with its peak at SDR white\n\n",
+               kGoldenCount, kTonemapOperatorCount);
+    }
+    return ok;
+}
+
+// Runs fn until at least 0.3s have passed, returns Mpix/s
+static double Measure(TonemapFn fn, const TonemapParams& p, const std::vector<uint16_t>& src,
+                      std::vector<uint32_t>* dst, int w, int h) {
+    auto start = std::chrono::steady_clock::now();
+    int runs = 0;
+    double seconds = 0;
+    do {
+        fn(p, (const uint8_t*)src.data(), (size_t)w * 8, (uint8_t*)dst->data(), (size_t)w * 4, w, h);
+        runs++;
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (seconds < 0.3);
+    return (double)w * h * runs / seconds / 1e6;
+}
+
+// Histogram estimate vs the exact geometric mean and percentile of the same
+// samples: the peak must land in the right bin, the average within half a bin
+static bool CheckLuminanceHistogram(const std::vector<uint16_t>& src, int w, int h) {
+    uint32_t step = LuminanceSampleStep(w, h);
+    uint32_t hist[kLuminanceBins];
+    auto start = std::chrono::steady_clock::now();
+    BuildLuminanceHistogram((const uint8_t*)src.data(), (size_t)w * 8, w, h, step, hist);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    SceneLuminance s = EstimateSceneLuminance(hist);
+
+    std::vector<float> nits;
+    double logSum = 0;
+    for (int y = 0; y < h; y += step) {
+        for (int x = 0; x < w; x += step) {
+            const uint16_t* p = src.data() + ((size_t)y * w + x) * 4;
+            float m = std::max(HalfToFloat(p[0]), std::max(HalfToFloat(p[1]), HalfToFloat(p[2]))) * 80.0f;
+            m = std::min(std::max(m, exp2f(kLuminanceMinLog2)), exp2f(kLuminanceMaxLog2));
+            nits.push_back(m);
+            logSum += log2(m);
+        }
+    }
+    size_t rank = (size_t)ceil(0.999 * nits.size()) - 1;
+    std::nth_element(nits.begin(), nits.begin() + rank, nits.end());
+    float exactPeak = nits[rank];
+    float exactAvg = (float)exp2(logSum / nits.size());
+
+    const float binWidth = (kLuminanceMaxLog2 - kLuminanceMinLog2) / kLuminanceBins;
+    bool peakOk = s.peakNits == LuminanceBinEdge(LuminanceBin(exactPeak) + 1);
+    bool avgOk = fabsf(log2f(s.averageNits) - log2f(exactAvg)) <= binWidth * 0.5f;
+
+    printf("\nluminance histogram: %u samples (step %u) in %.2fms\n", s.samples, step, ms);
+    printf("  peak %.0f nits (exact p99.9 %.0f), avg %.1f nits (exact %.1f)\n", s.peakNits, exactPeak, s.averageNits, exactAvg);
+
+    // Adapter: settle on 1000 nits, step to 4000 and back at 60 fps
+    LuminanceAdapter adapter;
+    SceneLuminance scene = s;
+    scene.peakNits = 1000.0f;
+    adapter.Update(scene, 0.0);
+    for (int i = 0; i < 60; i++) adapter.Update(scene, 1.0 / 60);
+    int upFrames = 0, downFrames = 0;
+    scene.peakNits = 4000.0f;
+    while (adapter.PeakNits() < 3600.0f && upFrames < 10000) { adapter.Update(scene, 1.0 / 60); upFrames++; }
+    for (int i = 0; i < 600; i++) adapter.Update(scene, 1.0 / 60);
+    scene.peakNits = 1000.0f;
+    while (adapter.PeakNits() > 1100.0f && downFrames < 10000) { adapter.Update(scene, 1.0 / 60); downFrames++; }
+    printf("  adapter 1000 -> 4000 nits: 90%% in %d frames, back to within 10%% in %d frames\n", upFrames, downFrames);
+
+    // Dim scene: the adapter settles far below SDR white. The peak in use must
+    // stay above it, so bt2390 keeps a roll-off and SDR white and a highlight
+    // come out white, not black or clipped by 0 / 0
+    scene.peakNits = 60.0f;
+    for (int i = 0; i < 1200; i++) adapter.Update(scene, 1.0 / 60);
+    TonemapParams dim;
+    dim.op = TonemapOperator::Bt2390;
+    dim.peakNits = ClampAdaptivePeak(adapter.PeakNits(), dim.sdrWhiteNits, dim.peakNits);
+    const float white = dim.sdrWhiteNits / 80.0f;
+    uint16_t px[8] = {FloatToHalf(white), FloatToHalf(white), FloatToHalf(white), 0x3C00,
+                      FloatToHalf(100.0f), FloatToHalf(100.0f), FloatToHalf(100.0f), 0x3C00};
+    uint32_t out[2];
+    TonemapImageReference(dim, (const uint8_t*)px, sizeof(px), (uint8_t*)out, sizeof(out), 2, 1);
+    bool dimOk = dim.peakNits > dim.sdrWhiteNits && ComputeTonemapConstants(dim).ks < 1.0f;
+    for (uint32_t o : out) dimOk = dimOk && (o & 0xFF) >= 0xF8 && (o >> 8 & 0xFF) >= 0xF8 && (o >> 16 & 0xFF) >= 0xF8;
+    printf("  dim scene at %.0f nits: bt2390 peak %.1f nits, SDR white -> %06X, 100x -> %06X\n", adapter.PeakNits(),
+           dim.peakNits, out[0] & 0xFFFFFF, out[1] & 0xFFFFFF);
+
+    if (!peakOk || !avgOk) printf("\nFAILED: histogram estimate disagrees with the exact %s\n", peakOk ? "average" : "peak");
+    if (!dimOk) printf("\nFAILED: dim scene peak leaves bt2390 no roll-off above SDR white\n");
+    return peakOk && avgOk && dimOk;
+}
+
+int main(int argc, char** argv) {
+    int w = 1920, h = 1080;
+    TonemapParams params;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--size") && i+1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0) { fprintf(stderr, "Invalid size\n"); return 1; }
+        }
+        else if (!strcmp(argv[i], "--sdr-white") && i+1 < argc) params.sdrWhiteNits = (float)atof(argv[++i]);
+        else if (!strcmp(argv[i], "--peak-nits") && i+1 < argc) params.peakNits = (float)atof(argv[++i]);
+        else { fprintf(stderr, "Usage: %s [--size WxH] [--sdr-white N] [--peak-nits N]\n", argv[0]); return 1; }
+    }
+
+    std::vector<uint16_t> src;
+    MakeTestImage(&src, w, h);
+    std::vector<uint32_t> ref((size_t)w * h), out((size_t)w * h);
+
+    bool golden = CheckGolden();
+
+    printf("%dx%d RGBA16F -> BGRA8, sdrWhite %.0f nits, peak %.0f nits, kernel %s (%d lanes)\n\n",
+           w, h, params.sdrWhiteNits, params.peakNits, TonemapSimdName(), kTonemapLanes);
+    printf("%-10s %12s %12s %8s %8s %10s\n", "operator", "simd Mpix/s", "ref Mpix/s", "speedup", "maxdiff", "off-by-1");
+
+    bool ok = true;
+    for (int i = 0; i < kTonemapOperatorCount; i++) {
+        params.op = (TonemapOperator)i;
+        double refRate = Measure(TonemapImageReference, params, src, &ref, w, h);
+        double simdRate = Measure(TonemapImage, params, src, &out, w, h);
+
+        int maxDiff = 0;
+        size_t offByOne = 0;
+        for (size_t k = 0; k < ref.size(); k++) {
+            int pixelDiff = 0;
+            for (int shift = 0; shift < 24; shift += 8) {
+                int d = abs((int)((ref[k] >> shift) & 0xFF) - (int)((out[k] >> shift) & 0xFF));
+                if (d > pixelDiff) pixelDiff = d;
+            }
+            if (pixelDiff > maxDiff) maxDiff = pixelDiff;
+            if (pixelDiff == 1) offByOne++;
+        }
+        if (maxDiff > 1) ok = false;
+
+        printf("%-10s %12.1f %12.1f %7.1fx %8d %9.3f%%\n", TonemapOperatorName(params.op),
+               simdRate, refRate, simdRate / refRate, maxDiff, 100.0 * offByOne / ref.size());
+    }
+
+    if (!ok) printf("\nFAILED: SIMD output differs from the reference by more than 1\n");
+    if (!golden) ok = false;
+    if (!CheckLuminanceHistogram(src, w, h)) ok = false;
+    return ok ? 0 : 1;
+}
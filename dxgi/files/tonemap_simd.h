@@ -0,0 +1,357 @@
+// Vectorized CPU tonemapping of RGBA16F scRGB images
+//
+// TonemapImage turns an RGBA16F (scRGB) image into BGRA8 sRGB with any of
+// the tonemap.h operators - the CPU counterpart of g_PixelShaderHDR for
+// paths that never touch the GPU. The kernel is written once against a
+// small vector type with three backends:
+//
+//   AVX2 + F16C   8 lanes (x64 built with /arch:AVX2 or -mavx2 -mf16c)
+//   NEON          4 lanes (AArch64)
+//   scalar        1 lane, everywhere else
+//
+// log2/exp2 (and so pow and PQ) are polynomial approximations with a
+// relative error around 1e-7, so a pixel may differ from
+// TonemapImageReference (libm, one pixel at a time) by one 8-bit step where
+// the exact value sits on a rounding boundary.
+//
+// Portable C++17.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+#include "color_math.h"
+#include "tonemap.h"
+
+#if defined(__AVX2__) && (defined(__F16C__) || defined(_MSC_VER))
+#include <immintrin.h>
+#define TONEMAP_SIMD_AVX2 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define TONEMAP_SIMD_NEON 1
+#endif
+
+#if defined(TONEMAP_SIMD_AVX2)
+
+const int kTonemapLanes = 8;
+inline const char* TonemapSimdName() { return "AVX2+F16C"; }
+
+struct VecF { __m256 v; };
+typedef __m256 VecMask;
+
+inline VecF VSet(float x) { return {_mm256_set1_ps(x)}; }
+inline VecF operator+(VecF a, VecF b) { return {_mm256_add_ps(a.v, b.v)}; }
+inline VecF operator-(VecF a, VecF b) { return {_mm256_sub_ps(a.v, b.v)}; }
+inline VecF operator*(VecF a, VecF b) { return {_mm256_mul_ps(a.v, b.v)}; }
+inline VecF operator/(VecF a, VecF b) { return {_mm256_div_ps(a.v, b.v)}; }
+inline VecF VMin(VecF a, VecF b) { return {_mm256_min_ps(a.v, b.v)}; }
+inline VecF VMax(VecF a, VecF b) { return {_mm256_max_ps(a.v, b.v)}; }
+inline VecMask VGreater(VecF a, VecF b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+inline VecMask VAnd(VecMask a, VecMask b) { return _mm256_and_ps(a, b); }
+inline bool VAny(VecMask m) { return _mm256_movemask_ps(m) != 0; }
+inline VecF VSelect(VecMask m, VecF t, VecF f) { return {_mm256_blendv_ps(f.v, t.v, m)}; }
+inline VecF VRound(VecF a) { return {_mm256_round_ps(a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)}; }
+
+// x > 0: mantissa in [1, 2) and unbiased exponent
+inline void VSplitExponent(VecF x, VecF* m, VecF* e) {
+    __m256i bits = _mm256_castps_si256(x.v);
+    __m256i exp = _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127));
+    e->v = _mm256_cvtepi32_ps(exp);
+    m->v = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)),
+                                               _mm256_set1_epi32(0x3F800000)));
+}
+
+// p * 2^i for integral i in [-126, 127]
+inline VecF VScaleByPow2(VecF p, VecF i) {
+    __m256i bits = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(i.v), _mm256_set1_epi32(127)), 23);
+    return {_mm256_mul_ps(p.v, _mm256_castsi256_ps(bits))};
+}
+
+// 8 RGBA16F pixels. After the in-lane transpose the lanes hold pixels
+// 0,2,4,6 | 1,3,5,7; StoreBGRA8 undoes that order.
+inline void LoadRGB(const uint16_t* src, VecF* r, VecF* g, VecF* b) {
+    __m256 p01 = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + 0)));
+    __m256 p23 = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + 8)));
+    __m256 p45 = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + 16)));
+    __m256 p67 = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + 24)));
+    __m256 t0 = _mm256_unpacklo_ps(p01, p23);
+    __m256 t1 = _mm256_unpacklo_ps(p45, p67);
+    __m256 t2 = _mm256_unpackhi_ps(p01, p23);
+    __m256 t3 = _mm256_unpackhi_ps(p45, p67);
+    r->v = _mm256_shuffle_ps(t0, t1, 0x44);
+    g->v = _mm256_shuffle_ps(t0, t1, 0xEE);
+    b->v = _mm256_shuffle_ps(t2, t3, 0x44);
+}
+
+// Channels in [0, 1]
+inline void StoreBGRA8(uint32_t* dst, VecF r, VecF g, VecF b) {
+    const __m256 k = _mm256_set1_ps(255.0f), half = _mm256_set1_ps(0.5f);
+    __m256i ri = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(r.v, k), half));
+    __m256i gi = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(g.v, k), half));
+    __m256i bi = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(b.v, k), half));
+    __m256i px = _mm256_or_si256(_mm256_or_si256(bi, _mm256_slli_epi32(gi, 8)),
+                                 _mm256_or_si256(_mm256_slli_epi32(ri, 16), _mm256_set1_epi32((int)0xFF000000)));
+    px = _mm256_permutevar8x32_epi32(px, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+    _mm256_storeu_si256((__m256i*)dst, px);
+}
+
+#elif defined(TONEMAP_SIMD_NEON)
+
+const int kTonemapLanes = 4;
+inline const char* TonemapSimdName() { return "NEON"; }
+
+struct VecF { float32x4_t v; };
+typedef uint32x4_t VecMask;
+
+inline VecF VSet(float x) { return {vdupq_n_f32(x)}; }
+inline VecF operator+(VecF a, VecF b) { return {vaddq_f32(a.v, b.v)}; }
+inline VecF operator-(VecF a, VecF b) { return {vsubq_f32(a.v, b.v)}; }
+inline VecF operator*(VecF a, VecF b) { return {vmulq_f32(a.v, b.v)}; }
+inline VecF operator/(VecF a, VecF b) { return {vdivq_f32(a.v, b.v)}; }
+inline VecF VMin(VecF a, VecF b) { return {vminq_f32(a.v, b.v)}; }
+inline VecF VMax(VecF a, VecF b) { return {vmaxq_f32(a.v, b.v)}; }
+inline VecMask VGreater(VecF a, VecF b) { return vcgtq_f32(a.v, b.v); }
+inline VecMask VAnd(VecMask a, VecMask b) { return vandq_u32(a, b); }
+inline bool VAny(VecMask m) { return vmaxvq_u32(m) != 0; }
+inline VecF VSelect(VecMask m, VecF t, VecF f) { return {vbslq_f32(m, t.v, f.v)}; }
+inline VecF VRound(VecF a) { return {vrndnq_f32(a.v)}; }
+
+inline void VSplitExponent(VecF x, VecF* m, VecF* e) {
+    int32x4_t bits = vreinterpretq_s32_f32(x.v);
+    e->v = vcvtq_f32_s32(vsubq_s32(vshrq_n_s32(bits, 23), vdupq_n_s32(127)));
+    m->v = vreinterpretq_f32_s32(vorrq_s32(vandq_s32(bits, vdupq_n_s32(0x007FFFFF)), vdupq_n_s32(0x3F800000)));
+}
+
+inline VecF VScaleByPow2(VecF p, VecF i) {
+    int32x4_t bits = vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(i.v), vdupq_n_s32(127)), 23);
+    return {vmulq_f32(p.v, vreinterpretq_f32_s32(bits))};
+}
+
+inline void LoadRGB(const uint16_t* src, VecF* r, VecF* g, VecF* b) {
+    uint16x4x4_t p = vld4_u16(src);
+    r->v = vcvt_f32_f16(vreinterpret_f16_u16(p.val[0]));
+    g->v = vcvt_f32_f16(vreinterpret_f16_u16(p.val[1]));
+    b->v = vcvt_f32_f16(vreinterpret_f16_u16(p.val[2]));
+}
+
+inline void StoreBGRA8(uint32_t* dst, VecF r, VecF g, VecF b) {
+    const float32x4_t k = vdupq_n_f32(255.0f), half = vdupq_n_f32(0.5f);
+    uint32x4_t ri = vcvtq_u32_f32(vmlaq_f32(half, r.v, k));
+    uint32x4_t gi = vcvtq_u32_f32(vmlaq_f32(half, g.v, k));
+    uint32x4_t bi = vcvtq_u32_f32(vmlaq_f32(half, b.v, k));
+    uint32x4_t px = vorrq_u32(vorrq_u32(bi, vshlq_n_u32(gi, 8)),
+                              vorrq_u32(vshlq_n_u32(ri, 16), vdupq_n_u32(0xFF000000u)));
+    vst1q_u32(dst, px);
+}
+
+#else
+
+const int kTonemapLanes = 1;
+inline const char* TonemapSimdName() { return "scalar"; }
+
+struct VecF { float v; };
+typedef bool VecMask;
+
+inline VecF VSet(float x) { return {x}; }
+inline VecF operator+(VecF a, VecF b) { return {a.v + b.v}; }
+inline VecF operator-(VecF a, VecF b) { return {a.v - b.v}; }
+inline VecF operator*(VecF a, VecF b) { return {a.v * b.v}; }
+inline VecF operator/(VecF a, VecF b) { return {a.v / b.v}; }
+inline VecF VMin(VecF a, VecF b) { return {a.v < b.v ? a.v : b.v}; }
+inline VecF VMax(VecF a, VecF b) { return {a.v > b.v ? a.v : b.v}; }
+inline VecMask VGreater(VecF a, VecF b) { return a.v > b.v; }
+inline VecMask VAnd(VecMask a, VecMask b) { return a && b; }
+inline bool VAny(VecMask m) { return m; }
+inline VecF VSelect(VecMask m, VecF t, VecF f) { return m ? t : f; }
+inline VecF VRound(VecF a) { return {floorf(a.v + 0.5f)}; }
+
+inline void VSplitExponent(VecF x, VecF* m, VecF* e) {
+    int exp;
+    float f = frexpf(x.v, &exp);    // [0.5, 1)
+    m->v = f * 2.0f;
+    e->v = (float)(exp - 1);
+}
+
+inline VecF VScaleByPow2(VecF p, VecF i) { return {ldexpf(p.v, (int)i.v)}; }
+
+inline void LoadRGB(const uint16_t* src, VecF* r, VecF* g, VecF* b) {
+    r->v = HalfToFloat(src[0]);
+    g->v = HalfToFloat(src[1]);
+    b->v = HalfToFloat(src[2]);
+}
+
+inline void StoreBGRA8(uint32_t* dst, VecF r, VecF g, VecF b) {
+    uint32_t ri = (uint32_t)(r.v * 255.0f + 0.5f);
+    uint32_t gi = (uint32_t)(g.v * 255.0f + 0.5f);
+    uint32_t bi = (uint32_t)(b.v * 255.0f + 0.5f);
+    *dst = bi | (gi << 8) | (ri << 16) | 0xFF000000u;
+}
+
+#endif
+
+// log2 for x > 0: atanh series on a mantissa folded into [sqrt(1/2), sqrt(2))
+inline VecF VLog2(VecF x) {
+    VecF m, e;
+    VSplitExponent(x, &m, &e);
+    VecMask big = VGreater(m, VSet(1.41421356f));
+    m = VSelect(big, m * VSet(0.5f), m);
+    e = VSelect(big, e + VSet(1.0f), e);
+    VecF t = (m - VSet(1.0f)) / (m + VSet(1.0f));
+    VecF t2 = t * t;
+    VecF ln = t * (VSet(2.0f) + t2 * (VSet(2.0f / 3.0f) + t2 * (VSet(2.0f / 5.0f) +
+                   t2 * (VSet(2.0f / 7.0f) + t2 * VSet(2.0f / 9.0f)))));
+    return e + ln * VSet(1.44269504f);
+}
+
+// 2^x, Cephes exp2f polynomial on the fraction in [-0.5, 0.5]
+inline VecF VExp2(VecF x) {
+    x = VMin(VMax(x, VSet(-126.0f)), VSet(126.0f));
+    VecF i = VRound(x);
+    VecF f = x - i;
+    VecF p = VSet(1.535336188319500e-4f);
+    p = p * f + VSet(1.339887440266574e-3f);
+    p = p * f + VSet(9.618437357674640e-3f);
+    p = p * f + VSet(5.550332471162809e-2f);
+    p = p * f + VSet(2.402264791363012e-1f);
+    p = p * f + VSet(6.931472028550421e-1f);
+    p = p * f + VSet(1.0f);
+    return VScaleByPow2(p, i);
+}
+
+// x >= 0 (0 returns a denormal-sized value rather than exactly 0)
+inline VecF VPow(VecF x, float y) {
+    return VExp2(VLog2(VMax(x, VSet(1e-30f))) * VSet(y));
+}
+
+inline VecF VPqEncode(VecF nits) {
+    const float m1 = 0.1593017578125f, m2 = 78.84375f;
+    const float c1 = 0.8359375f, c2 = 18.8515625f, c3 = 18.6875f;
+    VecF y = VPow(nits * VSet(1.0f / 10000.0f), m1);
+    return VPow((VSet(c1) + VSet(c2) * y) / (VSet(1.0f) + VSet(c3) * y), m2);
+}
+
+inline VecF VPqDecode(VecF e) {
+    const float m1 = 0.1593017578125f, m2 = 78.84375f;
+    const float c1 = 0.8359375f, c2 = 18.8515625f, c3 = 18.6875f;
+    VecF p = VPow(e, 1.0f / m2);
+    VecF num = VMax(p - VSet(c1), VSet(0.0f));
+    return VSet(10000.0f) * VPow(num / (VSet(c2) - VSet(c3) * p), 1.0f / m1);
+}
+
+inline VecF VHable(VecF x) {
+    const float A = 0.15f, B = 0.50f, C = 0.10f, D = 0.20f, E = 0.02f, F = 0.30f;
+    return (x * (VSet(A) * x + VSet(C * B)) + VSet(D * E)) / (x * (VSet(A) * x + VSet(B)) + VSet(D * F)) - VSet(E / F);
+}
+
+inline VecF VAces(VecF x) {
+    x = x * VSet(0.6f);
+    return (x * (VSet(2.51f) * x + VSet(0.03f))) / (x * (VSet(2.43f) * x + VSet(0.59f)) + VSet(0.14f));
+}
+
+inline VecF VSrgbEncode(VecF lin) {
+    VecF curve = VSet(1.055f) * VPow(lin, 1.0f / 2.4f) - VSet(0.055f);
+    return VSelect(VGreater(lin, VSet(0.0031308f)), curve, VSet(12.92f) * lin);
+}
+
+// Same as ApplyTonemap (tonemap.h), kTonemapLanes pixels at a time
+inline void TonemapVec(TonemapOperator op, const TonemapConstants& c, VecF* r, VecF* g, VecF* b) {
+    const VecF one = VSet(1.0f);
+    VecF m = VMax(VMax(*r, *g), *b);
+    VecF s = one;
+    switch (op) {
+        case TonemapOperator::Reinhard:
+            s = VSelect(VGreater(m, one), one / (one + m), one);
+            break;
+        case TonemapOperator::Bt2390: {
+            VecF nits = m * VSet(c.sdrWhiteNits);
+            VecF e1 = VPqEncode(nits) / VSet(c.pqPeak);
+            VecMask mapped = VAnd(VGreater(e1, VSet(c.ks)), VGreater(m, VSet(0.0f)));
+            if (!VAny(mapped)) break;
+            VecF e2 = VMin(e1, one);    // ks = 1 (peak at SDR white): a plain clip
+            if (c.ks < 1.0f) {
+                VecF t = (e2 - VSet(c.ks)) / VSet(1.0f - c.ks);
+                VecF t2 = t * t, t3 = t2 * t;
+                e2 = (VSet(2.0f) * t3 - VSet(3.0f) * t2 + one) * VSet(c.ks) +
+                     (t3 - VSet(2.0f) * t2 + t) * VSet(1.0f - c.ks) +
+                     (VSet(3.0f) * t2 - VSet(2.0f) * t3) * VSet(c.maxLum);
+            }
+            s = VSelect(mapped, VPqDecode(e2 * VSet(c.pqPeak)) / nits, one);
+            break;
+        }
+        case TonemapOperator::Hable: {
+            VecF k = VSet(2.0f * c.exposure), w = VSet(c.hableWhiteScale);
+            *r = VHable(k * *r) * w;
+            *g = VHable(k * *g) * w;
+            *b = VHable(k * *b) * w;
+            return;
+        }
+        case TonemapOperator::Aces: {
+            VecF k = VSet(c.exposure);
+            *r = VAces(k * *r);
+            *g = VAces(k * *g);
+            *b = VAces(k * *b);
+            return;
+        }
+        case TonemapOperator::Knee: {
+            VecF knee = VSet(c.knee);
+            VecF mapped = VMin(knee + (m - knee) * VSet(c.kneeSlope), one);
+            s = VSelect(VGreater(m, knee), mapped / m, one);
+            break;
+        }
+    }
+    *r = *r * s;
+    *g = *g * s;
+    *b = *b * s;
+}
+
+// One pixel through the scalar reference, rounded like StoreBGRA8
+inline uint32_t TonemapPixelReference(const TonemapParams& p, const TonemapConstants& c, const uint16_t* src) {
+    float in[3] = {HalfToFloat(src[0]), HalfToFloat(src[1]), HalfToFloat(src[2])}, out[3];
+    HdrToSdrReference(p, c, in, out);
+    uint32_t r = (uint32_t)(out[0] * 255.0f + 0.5f);
+    uint32_t g = (uint32_t)(out[1] * 255.0f + 0.5f);
+    uint32_t b = (uint32_t)(out[2] * 255.0f + 0.5f);
+    return b | (g << 8) | (r << 16) | 0xFF000000u;
+}
+
+// src: RGBA16F scRGB, dst: BGRA8 sRGB; pitches in bytes
+inline void TonemapImageReference(const TonemapParams& p, const uint8_t* src, size_t srcPitch,
+                                  uint8_t* dst, size_t dstPitch, int width, int height) {
+    TonemapConstants c = ComputeTonemapConstants(p);
+    for (int y = 0; y < height; y++) {
+        const uint16_t* s = (const uint16_t*)(src + y * srcPitch);
+        uint32_t* d = (uint32_t*)(dst + y * dstPitch);
+        for (int x = 0; x < width; x++) d[x] = TonemapPixelReference(p, c, s + x * 4);
+    }
+}
+
+inline void TonemapImage(const TonemapParams& p, const uint8_t* src, size_t srcPitch,
+                         uint8_t* dst, size_t dstPitch, int width, int height) {
+    if (kTonemapLanes == 1) {
+        // Polynomial log/exp only pay off with several lanes
+        TonemapImageReference(p, src, srcPitch, dst, dstPitch, width, height);
+        return;
+    }
+    TonemapConstants c = ComputeTonemapConstants(p);
+    const VecF zero = VSet(0.0f), one = VSet(1.0f), scale = VSet(c.scale);
+    for (int y = 0; y < height; y++) {
+        const uint16_t* s = (const uint16_t*)(src + y * srcPitch);
+        uint32_t* d = (uint32_t*)(dst + y * dstPitch);
+        int x = 0;
+        for (; x + kTonemapLanes <= width; x += kTonemapLanes) {
+            VecF r, g, b;
+            LoadRGB(s + x * 4, &r, &g, &b);
+            r = VMax(r, zero) * scale;
+            g = VMax(g, zero) * scale;
+            b = VMax(b, zero) * scale;
+            TonemapVec(p.op, c, &r, &g, &b);
+            r = VSrgbEncode(VMin(VMax(r, zero), one));
+            g = VSrgbEncode(VMin(VMax(g, zero), one));
+            b = VSrgbEncode(VMin(VMax(b, zero), one));
+            StoreBGRA8(d + x, r, g, b);
+        }
+        for (; x < width; x++) d[x] = TonemapPixelReference(p, c, s + x * 4);
+    }
+}
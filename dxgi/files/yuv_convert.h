@@ -0,0 +1,457 @@
+// Capture slot -> NV12 / P010 for video encoders
+//
+//   nv12   8-bit 4:2:0, BT.709 limited range, from SDR slots (sRGB taken as
+//          BT.709 R'G'B', the way desktop capture is usually encoded)
+//   p010   10-bit 4:2:0 in the high bits of 16, BT.2020 PQ limited range,
+//          from HDR slots (scRGB FP16, R11G11B10 or pq10)
+//
+// Both planes share one pitch; the chroma plane follows the luma plane (the
+// layout encoders take). Chroma is the plain average of each 2x2 block.
+// Sizes are padded to a multiple of 4 columns and 2 rows by repeating the
+// last source column and row.
+//
+// Every step is integer arithmetic so the three implementations agree bit
+// for bit: ConvertToYuvReference (scalar, the golden model), the AVX2 path
+// of YuvConverter, and the compute shader in main.cpp (g_ComputeShaderYuv),
+// which gets its coefficients and PQ table from YuvTables. HDR values become
+// fixed-point linear light (2^20 per scRGB 1.0, up to 10000 nits), are
+// rotated to BT.2020 with 14-bit coefficients and PQ encoded to 12 bits by a
+// binary search over the code boundaries, so nothing depends on how a
+// platform rounds pow. The AVX2 path narrows that search with an index of
+// 1/16-octave buckets; it finds the same code, only with fewer gathers.
+//
+// Portable C++17.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define YUV_SIMD_AVX2 1
+#endif
+
+enum class YuvFormat {
+    Nv12,
+    P010,
+};
+
+inline const char* YuvFormatName(YuvFormat f) { return f == YuvFormat::Nv12 ? "nv12" : "p010"; }
+
+inline bool ParseYuvFormat(const char* name, YuvFormat* f) {
+    if (!strcmp(name, "nv12")) { *f = YuvFormat::Nv12; return true; }
+    if (!strcmp(name, "p010")) { *f = YuvFormat::P010; return true; }
+    return false;
+}
+
+// Capture slot pixel layouts
+enum class YuvSource {
+    Bgra8,      // SDR sources
+    Rgba8,      // --slot-format sdr8
+    Rgba16F,    // HDR, native slots
+    R11G11B10,  // HDR, --slot-format r11g11b10
+    Pq10,       // HDR, --slot-format pq10 (R10G10B10A2, BT.2020 PQ)
+};
+
+inline const char* YuvSourceName(YuvSource s) {
+    switch (s) {
+        case YuvSource::Bgra8: return "bgra8";
+        case YuvSource::Rgba8: return "rgba8";
+        case YuvSource::Rgba16F: return "rgba16f";
+        case YuvSource::R11G11B10: return "r11g11b10";
+        case YuvSource::Pq10: return "pq10";
+    }
+    return "?";
+}
+
+inline bool YuvSourceIsHdr(YuvSource s) { return s != YuvSource::Bgra8 && s != YuvSource::Rgba8; }
+inline int YuvSourceBytesPerPixel(YuvSource s) { return s == YuvSource::Rgba16F ? 8 : 4; }
+
+struct YuvLayout {
+    int width = 0, height = 0;              // Source size
+    int paddedWidth = 0, paddedHeight = 0;  // Multiples of 4 and 2
+    size_t pitch = 0;                       // Bytes per row, both planes
+    size_t chromaOffset = 0;
+    size_t size = 0;
+};
+
+inline YuvLayout MakeYuvLayout(YuvFormat f, int w, int h) {
+    YuvLayout l;
+    l.width = w;
+    l.height = h;
+    l.paddedWidth = (w + 3) & ~3;
+    l.paddedHeight = (h + 1) & ~1;
+    l.pitch = (size_t)l.paddedWidth * (f == YuvFormat::Nv12 ? 1 : 2);
+    l.chromaOffset = l.pitch * l.paddedHeight;
+    l.size = l.chromaOffset + l.pitch * (l.paddedHeight / 2);
+    return l;
+}
+
+const uint32_t kYuvLinearOne = 1u << 20;            // scRGB 1.0 (80 nits)
+const uint32_t kYuvLinearMax = 125u * kYuvLinearOne;  // 10000 nits
+const int kYuvPqCodes = 4096;                       // 12-bit R'G'B' between linear and Y'CbCr
+
+// BT.709 -> BT.2020 (slot_format.h Bt709ToBt2020) in 1/16384, rows summing to 16384
+const uint32_t kYuvBt709ToBt2020[3][3] = {
+    {10279, 5395, 710},
+    {1132, 15066, 186},
+    {269, 1442, 14673},
+};
+
+// Fixed-point linear -> 12-bit PQ code: the number of code boundaries at or below it
+inline uint32_t YuvPqCode(uint32_t linear, const uint32_t* thresholds) {
+    uint32_t pos = 0;
+    for (uint32_t step = kYuvPqCodes / 2; step; step >>= 1) {
+        if (thresholds[pos + step - 1] <= linear) pos += step;
+    }
+    return pos;
+}
+
+// Exponent and top 4 mantissa bits of linear / 16 as a float (exact below 2^24)
+inline uint32_t YuvPqIndexKey(uint32_t linear) {
+    float f = (float)(linear >> 4);
+    uint32_t bits;
+    memcpy(&bits, &f, 4);
+    return bits >> 19;
+}
+
+// Everything the integer pipeline needs besides the pixels; the GPU gets the
+// same numbers (YuvConstants and a buffer with pqThresholds)
+struct YuvTables {
+    YuvFormat format = YuvFormat::Nv12;
+    int32_t y[4] = {};      // R', G', B' -> Y' in 1/65536, then the offset (black + rounding)
+    int32_t cb[4] = {};     // Sum of a 2x2 block's R', G', B' -> Cb in 1/262144, then the offset
+    int32_t cr[4] = {};
+    uint32_t outShift = 0;  // P010 keeps its 10 bits at the top of 16
+    std::vector<uint32_t> pqThresholds;     // P010: linear value where each 12-bit code starts, + sentinels
+    std::vector<uint32_t> pqIndex;          // P010: first code of each YuvPqIndexKey bucket (AVX2 search start)
+    int pqIndexSteps = 0;                   // Binary search steps that cover any bucket
+
+    void Init(YuvFormat f) {
+        format = f;
+        bool hdr = f == YuvFormat::P010;
+        double kr = hdr ? 0.2627 : 0.2126, kb = hdr ? 0.0593 : 0.0722, kg = 1.0 - kr - kb;
+        double inMax = hdr ? kYuvPqCodes - 1 : 255.0;
+        int bits = hdr ? 10 : 8;
+        double black = 16 << (bits - 8), yRange = 219 << (bits - 8), cRange = 224 << (bits - 8);
+        double center = 128 << (bits - 8);
+
+        double ys = yRange / inMax * 65536.0;
+        y[0] = (int32_t)lround(kr * ys);
+        y[1] = (int32_t)lround(kg * ys);
+        y[2] = (int32_t)lround(kb * ys);
+        y[3] = (int32_t)(black * 65536.0) + (1 << 15);
+
+        // Rows sum to 0 so neutral colors land exactly on the center
+        double cs = cRange / inMax * 262144.0 / 4.0;
+        cb[0] = -(int32_t)lround(kr / (2.0 * (1.0 - kb)) * cs);
+        cb[1] = -(int32_t)lround(kg / (2.0 * (1.0 - kb)) * cs);
+        cb[2] = -(cb[0] + cb[1]);
+        cb[3] = (int32_t)(center * 262144.0) + (1 << 17);
+        cr[1] = -(int32_t)lround(kg / (2.0 * (1.0 - kr)) * cs);
+        cr[2] = -(int32_t)lround(kb / (2.0 * (1.0 - kr)) * cs);
+        cr[0] = -(cr[1] + cr[2]);
+        cr[3] = cb[3];
+        outShift = hdr ? 6 : 0;
+
+        pqThresholds.clear();
+        pqIndex.clear();
+        if (!hdr) return;
+        // Code k + 1 starts at PQ value (k + 0.5) / 4095: the first fixed-point
+        // value at or above that, decoded in double precision
+        const double m1 = 0.1593017578125, m2 = 78.84375;
+        const double c1 = 0.8359375, c2 = 18.8515625, c3 = 18.6875;
+        pqThresholds.resize(kYuvPqCodes);
+        for (int k = 0; k + 1 < kYuvPqCodes; k++) {
+            double e = pow((k + 0.5) / (kYuvPqCodes - 1), 1.0 / m2);
+            double nits = 10000.0 * pow(std::max(e - c1, 0.0) / (c2 - c3 * e), 1.0 / m1);
+            double fixed = ceil(nits / 80.0 * kYuvLinearOne);
+            pqThresholds[k] = fixed > kYuvLinearMax ? kYuvLinearMax + 1 : (uint32_t)fixed;
+        }
+        pqThresholds[kYuvPqCodes - 1] = 0xFFFFFFFF;     // Never reached, keeps the search branchless
+
+        // Buckets of 1/16 octave: walk them by bisecting for each one's last value
+        uint32_t top = kYuvLinearMax >> 4, widest = 0;
+        pqIndex.assign(YuvPqIndexKey(kYuvLinearMax) + 1, 0);
+        for (uint32_t lo = 0; lo <= top;) {
+            uint32_t key = YuvPqIndexKey(lo << 4), hi = lo;
+            for (uint32_t step = 1u << 22; step; step >>= 1) {
+                if (hi + step <= top && YuvPqIndexKey((hi + step) << 4) == key) hi += step;
+            }
+            pqIndex[key] = YuvPqCode(lo << 4, pqThresholds.data());
+            widest = std::max(widest, YuvPqCode((hi << 4) | 15, pqThresholds.data()) - pqIndex[key]);
+            lo = hi + 1;
+        }
+        for (pqIndexSteps = 0; (1u << pqIndexSteps) <= widest; pqIndexSteps++) {}
+        pqThresholds.resize(kYuvPqCodes + (1u << pqIndexSteps), 0xFFFFFFFF);   // A search may start near the top
+    }
+
+};
+
+// Half-float bits -> fixed-point linear, rounded; negative values give 0,
+// anything from 10000 nits up (and Inf/NaN) the maximum
+inline uint32_t YuvHalfToLinear(uint32_t h) {
+    if (h & 0x8000) return 0;
+    uint32_t e = h >> 10, m = h & 0x3FF;
+    if (e >= 22) return kYuvLinearMax;
+    uint32_t mant = e ? m | 0x400 : m;  // Denormals scale like exponent 1
+    if (e < 1) e = 1;
+    uint32_t v = e >= 5 ? mant << (e - 5) : (mant + (1u << (4 - e))) >> (5 - e);
+    return std::min(v, kYuvLinearMax);
+}
+
+// 10-bit unorm -> 12 bits by bit replication
+inline uint32_t YuvExpand10(uint32_t c) { return (c << 2) | (c >> 8); }
+
+// Scalar pixel decode: R', G', B' as the Y'CbCr matrix takes them (8 or 12 bits)
+inline void YuvLoadPixel(YuvSource s, const uint8_t* p, const YuvTables& t, int32_t rgb[3]) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    uint32_t half[3] = {};
+    switch (s) {
+        case YuvSource::Bgra8:
+            rgb[0] = (v >> 16) & 0xFF; rgb[1] = (v >> 8) & 0xFF; rgb[2] = v & 0xFF;
+            return;
+        case YuvSource::Rgba8:
+            rgb[0] = v & 0xFF; rgb[1] = (v >> 8) & 0xFF; rgb[2] = (v >> 16) & 0xFF;
+            return;
+        case YuvSource::Pq10:
+            for (int c = 0; c < 3; c++) rgb[c] = (int32_t)YuvExpand10((v >> (10 * c)) & 0x3FF);
+            return;
+        case YuvSource::R11G11B10:
+            // Same exponent bias as half: only the mantissa moves up
+            half[0] = (v & 0x7FF) << 4; half[1] = ((v >> 11) & 0x7FF) << 4; half[2] = (v >> 22) << 5;
+            break;
+        case YuvSource::Rgba16F: {
+            uint16_t h[3];
+            memcpy(h, p, 6);
+            for (int c = 0; c < 3; c++) half[c] = h[c];
+            break;
+        }
+    }
+    uint32_t linear[3];
+    for (int c = 0; c < 3; c++) linear[c] = YuvHalfToLinear(half[c]);
+    for (int r = 0; r < 3; r++) {
+        // Split so every product fits in 32 bits (as on the GPU)
+        uint32_t sum = 0;
+        for (int c = 0; c < 3; c++) {
+            uint32_t k = kYuvBt709ToBt2020[r][c];
+            sum += (linear[c] >> 14) * k + (((linear[c] & 0x3FFF) * k) >> 14);
+        }
+        rgb[r] = (int32_t)YuvPqCode(sum, t.pqThresholds.data());
+    }
+}
+
+inline int32_t YuvLuma(const YuvTables& t, const int32_t rgb[3]) {
+    return (t.y[0] * rgb[0] + t.y[1] * rgb[1] + t.y[2] * rgb[2] + t.y[3]) >> 16;
+}
+
+inline int32_t YuvChroma(const int32_t k[4], const int32_t sum[3]) {
+    return (k[0] * sum[0] + k[1] * sum[1] + k[2] * sum[2] + k[3]) >> 18;
+}
+
+inline void YuvStoreSample(const YuvTables& t, uint8_t* p, int i, int32_t v) {
+    if (t.format == YuvFormat::Nv12) p[i] = (uint8_t)v;
+    else ((uint16_t*)p)[i] = (uint16_t)(v << t.outShift);
+}
+
+// One 4x2 block (two chroma samples) at (bx, by), reading with clamping
+inline void ConvertYuvBlock(YuvSource s, const uint8_t* src, size_t srcPitch, const YuvLayout& l,
+                            const YuvTables& t, uint8_t* dst, int bx, int by) {
+    int bpp = YuvSourceBytesPerPixel(s);
+    uint8_t* luma[2] = {dst + (size_t)by * l.pitch, dst + (size_t)(by + 1) * l.pitch};
+    uint8_t* chroma = dst + l.chromaOffset + (size_t)(by / 2) * l.pitch;
+    for (int pair = 0; pair < 2; pair++) {
+        int32_t sum[3] = {};
+        for (int j = 0; j < 2; j++) {
+            const uint8_t* row = src + (size_t)std::min(by + j, l.height - 1) * srcPitch;
+            for (int i = 0; i < 2; i++) {
+                int x = bx + pair * 2 + i;
+                int32_t rgb[3];
+                YuvLoadPixel(s, row + (size_t)std::min(x, l.width - 1) * bpp, t, rgb);
+                YuvStoreSample(t, luma[j], x, YuvLuma(t, rgb));
+                for (int c = 0; c < 3; c++) sum[c] += rgb[c];
+            }
+        }
+        int x = bx / 2 + pair;
+        YuvStoreSample(t, chroma, 2 * x, YuvChroma(t.cb, sum));
+        YuvStoreSample(t, chroma, 2 * x + 1, YuvChroma(t.cr, sum));
+    }
+}
+
+// The golden model: one block at a time, dst holds l.size bytes
+inline void ConvertToYuvReference(YuvSource s, const uint8_t* src, size_t srcPitch, const YuvLayout& l,
+                                  const YuvTables& t, uint8_t* dst) {
+    for (int by = 0; by < l.paddedHeight; by += 2) {
+        for (int bx = 0; bx < l.paddedWidth; bx += 4) ConvertYuvBlock(s, src, srcPitch, l, t, dst, bx, by);
+    }
+}
+
+#if defined(YUV_SIMD_AVX2)
+
+inline const char* YuvSimdName() { return "AVX2"; }
+
+// Half bits (low 16 of each lane) -> fixed-point linear, as YuvHalfToLinear
+inline __m256i YuvHalfToLinear8(__m256i h) {
+    const __m256i one = _mm256_set1_epi32(1), five = _mm256_set1_epi32(5);
+    __m256i e = _mm256_and_si256(_mm256_srli_epi32(h, 10), _mm256_set1_epi32(0x1F));
+    __m256i m = _mm256_and_si256(h, _mm256_set1_epi32(0x3FF));
+    __m256i denormal = _mm256_cmpeq_epi32(e, _mm256_setzero_si256());
+    __m256i mant = _mm256_or_si256(m, _mm256_andnot_si256(denormal, _mm256_set1_epi32(0x400)));
+    e = _mm256_max_epi32(e, one);
+    __m256i left = _mm256_sllv_epi32(mant, _mm256_sub_epi32(e, five));
+    __m256i s = _mm256_sub_epi32(five, e);
+    __m256i right = _mm256_srlv_epi32(_mm256_add_epi32(mant, _mm256_sllv_epi32(one, _mm256_sub_epi32(s, one))), s);
+    __m256i v = _mm256_blendv_epi8(right, left, _mm256_cmpgt_epi32(e, _mm256_set1_epi32(4)));
+    __m256i max = _mm256_set1_epi32((int)kYuvLinearMax);
+    v = _mm256_min_epu32(v, max);
+    v = _mm256_blendv_epi8(v, max, _mm256_cmpgt_epi32(e, _mm256_set1_epi32(21)));
+    return _mm256_andnot_si256(_mm256_cmpgt_epi32(h, _mm256_set1_epi32(0x7FFF)), v);
+}
+
+// Same count as YuvPqCode, searching only the bucket's codes (pqIndexSteps
+// gathers instead of 12)
+inline __m256i YuvPqCode8(__m256i linear, const YuvTables& t) {
+    __m256i key = _mm256_srli_epi32(_mm256_castps_si256(_mm256_cvtepi32_ps(_mm256_srli_epi32(linear, 4))), 19);
+    __m256i pos = _mm256_i32gather_epi32((const int*)t.pqIndex.data(), key, 4);
+    for (int step = 1 << (t.pqIndexSteps - 1); step; step >>= 1) {
+        __m256i idx = _mm256_add_epi32(pos, _mm256_set1_epi32(step - 1));
+        __m256i bound = _mm256_i32gather_epi32((const int*)t.pqThresholds.data(), idx, 4);
+        __m256i below = _mm256_cmpeq_epi32(_mm256_max_epu32(bound, linear), linear);   // bound <= linear, unsigned
+        pos = _mm256_add_epi32(pos, _mm256_and_si256(below, _mm256_set1_epi32(step)));
+    }
+    return pos;
+}
+
+// 8 pixels -> R', G', B' per lane, in pixel order
+inline void YuvLoad8(YuvSource s, const uint8_t* p, const YuvTables& t, __m256i rgb[3]) {
+    const __m256i byte = _mm256_set1_epi32(0xFF), ten = _mm256_set1_epi32(0x3FF);
+    __m256i half[3] = {};
+    __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    switch (s) {
+        case YuvSource::Bgra8:
+            rgb[0] = _mm256_and_si256(_mm256_srli_epi32(v, 16), byte);
+            rgb[1] = _mm256_and_si256(_mm256_srli_epi32(v, 8), byte);
+            rgb[2] = _mm256_and_si256(v, byte);
+            return;
+        case YuvSource::Rgba8:
+            rgb[0] = _mm256_and_si256(v, byte);
+            rgb[1] = _mm256_and_si256(_mm256_srli_epi32(v, 8), byte);
+            rgb[2] = _mm256_and_si256(_mm256_srli_epi32(v, 16), byte);
+            return;
+        case YuvSource::Pq10:
+            for (int c = 0; c < 3; c++) {
+                __m256i x = _mm256_and_si256(_mm256_srli_epi32(v, 10 * c), ten);
+                rgb[c] = _mm256_or_si256(_mm256_slli_epi32(x, 2), _mm256_srli_epi32(x, 8));
+            }
+            return;
+        case YuvSource::R11G11B10:
+            half[0] = _mm256_slli_epi32(_mm256_and_si256(v, _mm256_set1_epi32(0x7FF)), 4);
+            half[1] = _mm256_slli_epi32(_mm256_and_si256(_mm256_srli_epi32(v, 11), _mm256_set1_epi32(0x7FF)), 4);
+            half[2] = _mm256_slli_epi32(_mm256_srli_epi32(v, 22), 5);
+            break;
+        case YuvSource::Rgba16F: {
+            // Pixels as (g:r, a:b) pairs: gather the halves of 0-3 and 4-7, then join
+            const __m256i order = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+            __m256i lo = _mm256_permutevar8x32_epi32(v, order);
+            __m256i hi = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i*)(p + 32)), order);
+            __m256i rg = _mm256_permute2x128_si256(lo, hi, 0x20), ba = _mm256_permute2x128_si256(lo, hi, 0x31);
+            const __m256i low16 = _mm256_set1_epi32(0xFFFF);
+            half[0] = _mm256_and_si256(rg, low16);
+            half[1] = _mm256_srli_epi32(rg, 16);
+            half[2] = _mm256_and_si256(ba, low16);
+            break;
+        }
+    }
+    __m256i linear[3];
+    for (int c = 0; c < 3; c++) linear[c] = YuvHalfToLinear8(half[c]);
+    const __m256i lowMask = _mm256_set1_epi32(0x3FFF);
+    for (int r = 0; r < 3; r++) {
+        __m256i sum = _mm256_setzero_si256();
+        for (int c = 0; c < 3; c++) {
+            __m256i k = _mm256_set1_epi32((int)kYuvBt709ToBt2020[r][c]);
+            sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(_mm256_srli_epi32(linear[c], 14), k));
+            sum = _mm256_add_epi32(sum, _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_and_si256(linear[c], lowMask), k), 14));
+        }
+        rgb[r] = YuvPqCode8(sum, t);
+    }
+}
+
+inline __m256i YuvDot8(const int32_t k[4], const __m256i v[3], int shift) {
+    __m256i acc = _mm256_set1_epi32(k[3]);
+    for (int c = 0; c < 3; c++) acc = _mm256_add_epi32(acc, _mm256_mullo_epi32(v[c], _mm256_set1_epi32(k[c])));
+    return _mm256_srai_epi32(acc, shift);
+}
+
+// 8 samples (one per lane, each 128-bit half holding 4 in order) -> bytes or shifted 16-bit words
+inline void YuvStore8(const YuvTables& t, uint8_t* p, __m256i v) {
+    if (t.format == YuvFormat::Nv12) {
+        __m256i w = _mm256_packus_epi16(_mm256_packus_epi32(v, v), _mm256_setzero_si256());
+        uint32_t lo = (uint32_t)_mm256_extract_epi32(w, 0), hi = (uint32_t)_mm256_extract_epi32(w, 4);
+        memcpy(p, &lo, 4);
+        memcpy(p + 4, &hi, 4);
+    } else {
+        __m256i w = _mm256_packus_epi32(_mm256_slli_epi32(v, (int)t.outShift), _mm256_setzero_si256());
+        _mm_storeu_si128((__m128i*)p, _mm256_castsi256_si128(_mm256_permute4x64_epi64(w, 0x08)));
+    }
+}
+
+#else
+
+inline const char* YuvSimdName() { return "scalar"; }
+
+#endif
+
+// Converts whole frames for one source layout and size. With AVX2, 8x2
+// pixels at a time; the columns past the last full group (and the padding)
+// go through the scalar block.
+class YuvConverter {
+public:
+    void Configure(YuvFormat f, YuvSource s, int w, int h) {
+        source = s;
+        layout = MakeYuvLayout(f, w, h);
+        tables.Init(f);
+    }
+
+    void Convert(const uint8_t* src, size_t srcPitch, uint8_t* dst) const {
+        const YuvLayout& l = layout;
+        int bpp = YuvSourceBytesPerPixel(source);
+        int simdWidth = 0;
+#if defined(YUV_SIMD_AVX2)
+        simdWidth = l.width & ~7;
+#endif
+        for (int by = 0; by < l.paddedHeight; by += 2) {
+#if defined(YUV_SIMD_AVX2)
+            const uint8_t* rows[2] = {src + (size_t)by * srcPitch, src + (size_t)std::min(by + 1, l.height - 1) * srcPitch};
+            uint8_t* chroma = dst + l.chromaOffset + (size_t)(by / 2) * l.pitch;
+            size_t sampleBytes = tables.format == YuvFormat::Nv12 ? 1 : 2;
+            for (int x = 0; x < simdWidth; x += 8) {
+                __m256i sum[3];
+                for (int j = 0; j < 2; j++) {
+                    __m256i rgb[3];
+                    YuvLoad8(source, rows[j] + (size_t)x * bpp, tables, rgb);
+                    YuvStore8(tables, dst + (size_t)(by + j) * l.pitch + x * sampleBytes, YuvDot8(tables.y, rgb, 16));
+                    for (int c = 0; c < 3; c++) sum[c] = j ? _mm256_add_epi32(sum[c], rgb[c]) : rgb[c];
+                }
+                // Pairs within each 128-bit half: lanes 0,1 and 4,5 hold the four 2x2 sums
+                for (int c = 0; c < 3; c++) sum[c] = _mm256_hadd_epi32(sum[c], sum[c]);
+                __m256i uv = _mm256_unpacklo_epi32(YuvDot8(tables.cb, sum, 18), YuvDot8(tables.cr, sum, 18));
+                YuvStore8(tables, chroma + x * sampleBytes, uv);
+            }
+#endif
+            for (int bx = simdWidth; bx < l.paddedWidth; bx += 4) {
+                ConvertYuvBlock(source, src, srcPitch, l, tables, dst, bx, by);
+            }
+        }
+        (void)bpp;
+    }
+
+    YuvSource source = YuvSource::Bgra8;
+    YuvLayout layout;
+    YuvTables tables;
+};